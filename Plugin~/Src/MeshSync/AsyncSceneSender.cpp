@@ -52,7 +52,7 @@ bool AsyncSceneSender::isServerAvaileble()
 
 bool AsyncSceneSender::isExporting()
 {
-    if (m_future.valid() && m_future.wait_for(std::chrono::milliseconds(0)) == std::future_status::timeout)
+    if (m_future.valid() && !m_future.isReady())
         return true;
     return false;
 }
@@ -68,7 +68,7 @@ void AsyncSceneSender::wait()
 void AsyncSceneSender::kick()
 {
     wait();
-    m_future = std::async(std::launch::async, [this]() { send(); });
+    m_future = mu::TaskScheduler::instance().submit([this]() { send(); });
 }
 
 void AsyncSceneSender::requestLiveEditMessage()
@@ -5,6 +5,7 @@
 #include "MeshSync/SceneExporter.h"
 #include "MeshSync/msClientSettings.h" //ClientSettings
 #include "MeshSync/msClient.h"
+#include "MeshUtils/muTaskScheduler.h"
 
 namespace ms {
 
@@ -34,7 +35,7 @@ private:
     void send();
     void requestLiveEditMessageImpl();
 
-    std::future<void> m_future;
+    mu::TaskFuture<void> m_future;
     std::future<void> m_live_edit_future;
     std::string m_error_message;
     std::atomic_bool m_destroyed{ false };
@@ -27,10 +27,10 @@ enum MeshDataFlagsBit {
     MESH_DATA_FLAG_HAS_BLENDSHAPE_WEIGHTS,
     MESH_DATA_FLAG_HAS_SUBMESHES,
     MESH_DATA_FLAG_HAS_BOUNDS,
-    MESH_DATA_FLAG_UNUSED_20,
-    MESH_DATA_FLAG_UNUSED_21,
-    MESH_DATA_FLAG_UNUSED_22,
-    MESH_DATA_FLAG_UNUSED_23,
+    MESH_DATA_FLAG_HAS_SPARSE_BONE_WEIGHTS, //20
+    MESH_DATA_FLAG_HAS_MESHLETS,
+    MESH_DATA_FLAG_HAS_INDICES16,
+    MESH_DATA_FLAG_HAS_BATCH_SOURCES,
     MESH_DATA_FLAG_HAS_UV0,    //24
     MESH_DATA_FLAG_HAS_UV1,
     MESH_DATA_FLAG_HAS_UV2,
@@ -16,7 +16,7 @@ struct SceneCacheExportSettings
     uint32_t stripUnchanged : 1;
     uint32_t applyRefinement : 1;
     uint32_t flattenHierarchy : 1;
-    uint32_t mergeMeshes : 1; // todo
+    uint32_t mergeMeshes : 1;
     uint32_t stripNormals : 1;
     uint32_t stripTangents : 1;
 
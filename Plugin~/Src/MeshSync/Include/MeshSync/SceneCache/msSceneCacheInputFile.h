@@ -1,10 +1,12 @@
 #pragma once
-#include <future>
 #include <deque>
 
+#include "MeshUtils/muTaskScheduler.h"
+
 #include "MeshSync/SceneCache/msBaseSceneCacheInput.h"
 #include "MeshSync/SceneCache/msCacheFileHeader.h"
 #include "MeshSync/SceneCache/msSceneCacheInputSettings.h"
+#include "MeshSync/SceneGraph/msMeshRefineCache.h"
 
 
 msDeclClassPtr(SceneCacheInputFile)
@@ -48,13 +50,14 @@ private:
     ScenePtr PostProcess(ScenePtr& sp, size_t sceneIndex);
     bool KickPreload(size_t i);
     void WaitAllPreloads();
+    void CancelAllPreloads();
     void PopOverflowedSamples();
 
 private:
     struct SceneSegment
     {
         RawVector<char> encodedBuf;
-        std::future<void> task;
+        mu::TaskFuture<void> task;
         ScenePtr segment;
         bool error = false;
 
@@ -73,7 +76,7 @@ private:
         float time = 0.0f;
 
         ScenePtr scene;
-        std::future<void> preload;
+        mu::TaskFuture<void> preload;
         RawVector<uint64_t> bufferSizes;
         std::vector<SceneSegment> segments;
     };
@@ -91,6 +94,7 @@ private:
     int m_loadedFrame0 = -1, m_loadedFrame1 = -1;
     ScenePtr m_baseScene, m_lastScene, m_lastDiff;
     std::deque<size_t> m_history;
+    MeshRefineCache m_refineCache; // deforming meshes reuse the remap tables of the previous frame
 
 };
 
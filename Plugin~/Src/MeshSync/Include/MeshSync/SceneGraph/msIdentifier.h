@@ -1,11 +1,23 @@
 #pragma once
 
+#include <climits> //INT_MAX
 #include "MeshSync/msFoundation.h" //msSerializable
 
 namespace ms {
 
 const int InvalidID = -1;
 
+// ids of entities generated from another entity (LOD levels, merged meshes). ids given by the host are 0 or
+// greater, so derived ids use the negative range below InvalidID. they are stable as long as the source id is.
+// slot: 0 to MaxDerivedIDs-1. returns InvalidID if id is invalid or too large.
+const int MaxDerivedIDs = 16;
+inline int DerivedID(int id, int slot)
+{
+    if (id < 0 || id > (INT_MAX - MaxDerivedIDs) / MaxDerivedIDs)
+        return InvalidID;
+    return InvalidID - 1 - (id * MaxDerivedIDs + slot);
+}
+
 struct Identifier
 {
     std::string name;
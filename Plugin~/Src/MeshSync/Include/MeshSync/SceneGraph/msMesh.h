@@ -8,11 +8,13 @@
 #include "MeshSync/SceneGraph/msTransform.h"
 
 #include "MeshUtils/muVertex.h" //mu::Weights4
+#include "MeshUtils/muMeshlet.h"
 
 //Forward declarations
 msDeclStructPtr(BlendShapeFrameData);
 msDeclStructPtr(BoneData);
 msDeclStructPtr(BlendShapeData);
+msDeclStructPtr(MeshRefineTables);
 
 namespace ms {
 
@@ -33,6 +35,32 @@ struct SubmeshData
     int material_id = 0;
 };
 
+enum class VertexSemantic : int
+{
+    Position,
+    Normal,
+    Tangent,
+    Color,
+    Velocity,
+    UV0,
+    UV1,
+    UV2,
+    UV3,
+    UV4,
+    UV5,
+    UV6,
+    UV7,
+};
+
+// an attribute of the interleaved vertex buffer written by Mesh::writeVertexBuffer()
+struct VertexAttributeLayout
+{
+    VertexSemantic semantic = VertexSemantic::Position;
+    mu::VertexAttributeFormat format = mu::VertexAttributeFormat::Float32;
+    int dimension = 0; // 0: dimension of the semantic (3 for position, 4 for color, etc)
+    int offset = 0;    // byte offset in the vertex
+};
+
 struct BlendShapeFrameData
 {
     // serializable
@@ -102,6 +130,38 @@ public:
 msSerializable(BoneData);
 msDetachable(BoneData);
 
+// remap and split tables of a re-indexing refine. Mesh::refine() reuses them while the topology is unchanged,
+// so that deforming meshes are refined by gathering their vertex attributes.
+struct MeshRefineTables
+{
+    // the topology the tables were built for
+    uint64_t settings = 0;
+    size_t num_points = 0;
+    RawVector<int> counts;
+    RawVector<int> indices;
+    RawVector<int> material_ids;
+
+    // new2old_points: new vertex to old point. remap_*: new vertex to old index for per-index attributes.
+    // old2new_indices: old index to new vertex.
+    RawVector<int> new2old_points;
+    RawVector<int> old2new_indices;
+    RawVector<int> remap_normals;
+    RawVector<int> remap_colors;
+    RawVector<int> remap_uv[MeshSyncConstants::MAX_UV];
+
+    RawVector<int> new_indices;
+    RawVector<uint16_t> new_indices16;
+    RawVector<SubmeshData> submeshes;
+    RawVector<mu::Meshlet> meshlets;
+    RawVector<int> meshlet_vertices;
+    RawVector<uint8_t> meshlet_triangles;
+
+    int reuse_count = 0; // number of refines that reused the tables
+
+    void clear();
+    uint64_t size() const; // in bytes
+};
+
 class Mesh : public Transform
 {
 using super = Transform;
@@ -122,11 +182,30 @@ public:
 
     std::string root_bone;
     std::vector<BoneDataPtr> bones;
+    // optional compact alternative to BoneData::weights. bone weights are taken from here if not empty.
+    // sparse_bone_counts: influence count of each vertex. sparse_bone_weights: vertex-major (weight, bone index).
+    SharedVector<uint8_t>       sparse_bone_counts;
+    SharedVector<mu::Weights1>  sparse_bone_weights;
     std::vector<BlendShapeDataPtr> blendshapes;
 
     SharedVector<SubmeshData> submeshes;
     Bounds bounds{};
 
+    // optional. generated by refine with MESH_REFINE_FLAG_GEN_MESHLETS.
+    // meshlet_vertices: indices to points. meshlet_triangles: 3 indices to the vertices of the meshlet per triangle.
+    SharedVector<mu::Meshlet>   meshlets;
+    SharedVector<int>           meshlet_vertices;
+    SharedVector<uint8_t>       meshlet_triangles;
+
+    // optional. generated by refine with MESH_REFINE_FLAG_GEN_INDICES16 if every split has 65536 or less vertices.
+    // same layout as indices (submesh-ordered, local to the split). indices is empty when this is used.
+    SharedVector<uint16_t>      indices16;
+
+    // optional. set by Scene::mergeMeshes() on combined meshes.
+    // batch_sources: paths of the merged meshes. batch_source_ids: per-vertex index to batch_sources.
+    std::vector<std::string>    batch_sources;
+    SharedVector<int>           batch_source_ids;
+
     // non-serializable
     // *update clear() when add member*
     SharedVector<mu::Weights4>  weights4;
@@ -134,6 +213,8 @@ public:
     SharedVector<int>       bone_offsets;
     SharedVector<mu::Weights1>  weights1;
     uint32_t bone_weight_count = 0; // sum of bone_counts
+    // set by Scene::import() with SCENE_IMPORT_FLAG_GENERATE_LODS. see generateLODs().
+    std::vector<std::shared_ptr<Mesh>> lods;
 
 
 protected:
@@ -163,10 +244,31 @@ public:
     EntityPtr clone(bool detach = false) override;
 
     void refine();
+    // tables: if given, reused when they match the topology. otherwise rebuilt.
+    void refine(MeshRefineTables *tables);
     void makeDoubleSided();
     void mirrorMesh(const mu::float3& plane_n, float plane_d, bool welding = false);
     void transformMesh(const mu::float4x4& t);
     void mergeMesh(const Mesh& to_be_merged);
+    // copies geometry, skinning, blendshapes and bone weights of src. the copy owns its memory.
+    void copyGeometry(const Mesh& src);
+    // approximate size of the geometry arrays in bytes
+    uint64_t geometrySize() const;
+    // order sensitive hash of everything refine() reads. unlike checksumGeom(), reordered elements change it.
+    uint64_t hashGeom() const;
+    // true if everything refine() reads is bitwise identical to v
+    bool equalGeometry(const Mesh& v) const;
+    // LOD chain of a refined mesh by quadric edge collapse. dst[i] has about ratio^(i+1) of the triangles of this mesh.
+    // each level is simplified from the previous one and collapses stop at target_error (relative to the mesh size).
+    // vertex attributes, bone weights, blendshapes, submesh boundaries and uv seams are preserved.
+    // level i is named path + "_LOD<i+1>" and gets the id DerivedID(id, i), so that the levels of all meshes have
+    // their own ids that are stable across imports. at most MaxLODLevels levels are generated.
+    void generateLODs(std::vector<std::shared_ptr<Mesh>>& dst, int num_levels, float ratio = 0.5f, float target_error = FLT_MAX);
+    static const int MaxLODLevels = 8;
+
+    // writes per-vertex attributes into dst (vertexCount() * stride bytes) converted to the given formats.
+    // empty attributes are written as zeros. returns false if an attribute is not per-vertex (not refined).
+    bool writeVertexBuffer(void *dst, size_t stride, const VertexAttributeLayout *layout, size_t num_attributes) const;
 
     void setupBoneWeights4();
     void setupBoneWeightsVariable();
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <list>
+#include <map>
+#include <mutex>
+#include <string>
+
+#include "MeshSync/MeshSync.h" //msDeclClassPtr
+
+msDeclStructPtr(MeshRefineTables);
+
+namespace ms {
+
+enum class MeshRefineCacheEviction {
+    Disabled,
+    LeastRecentlyUsed,
+    FirstInFirstOut,    // hits don't renew records. suits DCCs that resend everything in the same order
+};
+
+struct MeshRefineCacheSettings {
+    MeshRefineCacheEviction eviction = MeshRefineCacheEviction::LeastRecentlyUsed;
+    uint32_t max_memory_mb = 256;   // budget for the refined geometry
+    uint32_t max_records = 4096;
+};
+
+struct MeshRefineCacheStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+    uint64_t topology_hits = 0;     // refines that reused the remap tables of the previous refine of the mesh
+    uint64_t topology_misses = 0;
+    uint64_t memory_usage = 0;  // in bytes
+    uint32_t num_records = 0;
+};
+
+// stores the results of Mesh::refine() keyed by an order sensitive geometry hash (Mesh::hashGeom()) and the refine settings,
+// so that meshes resent without changes skip refinement. the source geometry is kept with each result and compared on hits.
+// also keeps the remap tables of each mesh path (MeshRefineTables), so that meshes that only deform skip re-indexing.
+// thread safe.
+class MeshRefineCache
+{
+public:
+    void setSettings(const MeshRefineCacheSettings& v);
+    const MeshRefineCacheSettings& getSettings() const;
+
+    // refines mesh, or restores the result of a previous refine of the same geometry and settings.
+    void refine(Mesh& mesh);
+
+    void clear();
+    MeshRefineCacheStats getStats() const;
+
+private:
+    struct Key
+    {
+        uint64_t geometry;
+        uint64_t settings;
+        size_t num_points;
+        size_t num_indices;
+
+        bool operator<(const Key& v) const;
+    };
+
+    // either a refined mesh or the remap tables of a mesh path
+    struct Record
+    {
+        Key key;
+        MeshPtr refined;
+        MeshPtr source; // the geometry before refine
+        std::string path;
+        MeshRefineTablesPtr tables;
+        uint64_t size;
+    };
+    using Records = std::list<Record>;
+    using lock_t = std::unique_lock<std::mutex>;
+
+    void evictImpl(uint64_t memory_budget, size_t max_records);
+    void eraseImpl(Records::iterator it);
+
+    mutable std::mutex m_mutex;
+    MeshRefineCacheSettings m_settings;
+    MeshRefineCacheStats m_stats;
+    Records m_records; // front is the next to be evicted
+    std::map<Key, Records::iterator> m_table;
+    std::map<std::string, Records::iterator> m_topologies;
+};
+
+} // namespace ms
@@ -30,10 +30,10 @@ enum MeshRefineFlagsBit {
     MESH_REFINE_FLAG_BAKE_CLOTH,
     MESH_REFINE_FLAG_QUADIFY,
     MESH_REFINE_FLAG_QUADIFY_FULL_SEARCH, //24
-    MESH_REFINE_FLAG_UNUSED_25,
-    MESH_REFINE_FLAG_UNUSED_26,
-    MESH_REFINE_FLAG_UNUSED_27,
-    MESH_REFINE_FLAG_UNUSED_28,
+    MESH_REFINE_FLAG_OPTIMIZE_VERTEX_CACHE,
+    MESH_REFINE_FLAG_GEN_MESHLETS,
+    MESH_REFINE_FLAG_GEN_INDICES16,
+    MESH_REFINE_FLAG_DEDUP_BY_HASH,
     MESH_REFINE_FLAG_UNUSED_29,
     MESH_REFINE_FLAG_UNUSED_30,
     MESH_REFINE_FLAG_UNUSED_31,
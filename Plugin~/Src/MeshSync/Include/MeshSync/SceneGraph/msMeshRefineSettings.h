@@ -12,6 +12,8 @@ struct MeshRefineSettings {
     float scale_factor = 1.0f;
     float smooth_angle = 0.0f; // in degree
     float quadify_threshold = 15.0f; // in degree
+    uint32_t meshlet_max_vertices = 64;
+    uint32_t meshlet_max_triangles = 124;
     mu::float4x4 local2world = mu::float4x4::identity();
     mu::float4x4 world2local = mu::float4x4::identity();
     mu::float4x4 mirror_basis = mu::float4x4::identity();
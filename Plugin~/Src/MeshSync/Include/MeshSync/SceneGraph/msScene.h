@@ -24,6 +24,7 @@ msDeclStructPtr(SceneImportSettings);
 msDeclStructPtr(InstanceInfo)
 msDeclStructPtr(PropertyInfo)
 msDeclClassPtr(EntityConverter)
+msDeclClassPtr(MeshRefineCache)
 
 namespace ms {
 
@@ -90,7 +91,8 @@ public:
 
     static void sanitizeHierarchyPath(std::string& path);
     static void sanitizeObjectName(std::string& name);
-    void import(const SceneImportSettings& cv);
+    // refine_cache: optional. reuses the refined meshes of previous imports if given.
+    void import(const SceneImportSettings& cv, MeshRefineCache *refine_cache = nullptr);
 
     TransformPtr findEntity(const std::string& path) const;
     template<class AssetType> std::vector<std::shared_ptr<AssetType>> getAssets() const;
@@ -114,6 +116,14 @@ public:
 
     void buildHierarchy();
     void flatternHierarchy();
+    // static batching. meshes that share materials, visibility and refine settings are merged into combined meshes
+    // of split_unit or less vertices with world transforms baked. the merged meshes are left as transforms so that
+    // their children stay valid. skinned, blendshape, instanced and already refined meshes are not merged.
+    // meshes whose parents are not all in the scene are skipped because their world matrices are unknown.
+    // a combined mesh is named "/MeshBatch<id>" after the id of its first source and gets DerivedID(id, MaxDerivedIDs-1),
+    // so that the batches of partial scenes (e.g. separate server messages) don't collide.
+    // if the first source has no id, the batch index is used and the names are only unique within the scene.
+    void mergeMeshes(uint32_t split_unit);
     bool submeshesHaveUniqueMaterial() const;
 
     void dbgDump() const;
@@ -121,7 +131,8 @@ public:
     static std::vector<EntityConverterPtr> getConverters(const SceneImportSettings& cv, const SceneSettings& settings, bool invert);
 
 private:
-    void updateEntities(const ms::SceneImportSettings& cv, const std::vector<ms::EntityConverterPtr>& converters, std::vector<ms::TransformPtr> entities);
+    void updateEntities(const ms::SceneImportSettings& cv, const std::vector<ms::EntityConverterPtr>& converters, std::vector<ms::TransformPtr> entities,
+        MeshRefineCache *refine_cache);
 
 };
 msSerializable(Scene);
@@ -7,11 +7,19 @@ enum class ZUpCorrectionMode {
     RotateX,
 };
 
+enum SceneImportFlagsBit {
+    SCENE_IMPORT_FLAG_GENERATE_LODS = 0, // Mesh::generateLODs() into Mesh::lods after the mesh is refined
+    SCENE_IMPORT_FLAG_GEN_INDICES16,     // MESH_REFINE_FLAG_GEN_INDICES16 on every mesh. the receiver must handle Mesh::indices16
+    SCENE_IMPORT_FLAG_MERGE_MESHES,      // Scene::mergeMeshes() with mesh_split_unit before the meshes are refined
+};
+
 struct SceneImportSettings {
-    uint32_t flags = 0; // reserved
+    uint32_t flags = 0; // SceneImportFlagsBit
     uint32_t mesh_split_unit = 0xffffffff;
     int mesh_max_bone_influence = 4; // 4 or 255 (variable up to 255)
     ZUpCorrectionMode zup_correction_mode = ZUpCorrectionMode::FlipYZ;
+    int lod_levels = 3; // used with SCENE_IMPORT_FLAG_GENERATE_LODS
+    float lod_ratio = 0.5f; // triangle ratio of each level to the previous one
 };
 
 } // namespace ms
@@ -3,7 +3,7 @@
 //Note: Every update to the plugin must increase the version number
 #define msPluginVersionStr "0.14.x-preview"
 #define msVendor "Unity Technologies"
-#define msProtocolVersion 124
+#define msProtocolVersion 125
 
 //#define msEnableProfiling
 //#define msRuntime
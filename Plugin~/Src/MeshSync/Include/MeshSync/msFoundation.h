@@ -1,9 +1,12 @@
 #pragma once
 
+#include <atomic>
+#include <functional>
 #include <iostream>
 #include <memory> //std::shared_ptr
 #include <vector>
 #include <mutex>
+#include <typeinfo>
 
 //Dependency to MeshUtils
 #include "MeshUtils/muRawVector.h" //SharedVector
@@ -359,10 +362,44 @@ template<class T> inline uint64_t csum(const T& v) { return csum_impl<T>()(v); }
 
 
 
+struct PoolStats
+{
+    const char *name = nullptr;
+    int64_t live = 0;   // objects handed out and not returned yet
+    int64_t cached = 0; // objects kept for reuse (thread caches + depot)
+    int64_t peak = 0;   // max number of objects that existed at the same time
+};
+
+class IPool
+{
+public:
+    virtual ~IPool() {}
+    virtual PoolStats getStats() const = 0;
+    // max number of objects kept in the shared depot. excess objects are deleted.
+    virtual void setHighWaterMark(size_t n) = 0;
+    virtual size_t getHighWaterMark() const = 0;
+    // deletes depot objects above the high-water mark
+    virtual void trim() = 0;
+};
+
+void RegisterPool(IPool *pool);
+void UnregisterPool(IPool *pool);
+void EachPool(const std::function<void(IPool&)>& body);
+void TrimAllPools();
+
+
+// Object pool used by msDefinePool.
+// Each thread keeps a small cache of objects and exchanges them with a lock-free depot in magazines of
+// MagazineSize objects, so create() / release() from many threads don't contend on a lock.
+// The depot is a tagged index stack over magazine slots that are never freed while the pool lives (no ABA).
 template<class T>
-class Pool
+class Pool : public IPool
 {
 public:
+    static const int MagazineSize = 32;
+    static const int SegmentSize = 64;  // magazines per segment
+    static const int MaxSegments = 64;
+
     static Pool& instance()
     {
         static Pool s_instance;
@@ -371,45 +408,273 @@ public:
 
     T* pull()
     {
-        std::unique_lock<std::mutex> lock(m_mutex);
-        if (!m_pool.empty()) {
-            T* ret = m_pool.back();
-            m_pool.pop_back();
-            ++m_used;
-            return ret;
-        }
-        else {
-            ++m_capacity;
-            ++m_used;
+        LocalCache& local = s_local;
+        if (local.count == 0 && !refill(local)) {
+            ++m_created;
+            updatePeak();
             return new T();
         }
+        T *ret = local.objects[--local.count];
+        local.published.store(local.count, std::memory_order_relaxed);
+        return ret;
     }
 
     void push(T *v)
     {
-        std::unique_lock<std::mutex> lock(m_mutex);
-        m_pool.push_back(v);
-        --m_used;
+        LocalCache& local = s_local;
+        if (local.count == MagazineSize * 2)
+            flush(local, MagazineSize);
+        local.objects[local.count++] = v;
+        local.published.store(local.count, std::memory_order_relaxed);
     }
 
+    // deletes all objects cached in the depot and in the calling thread
     void release()
     {
-        std::unique_lock<std::mutex> lock(m_mutex);
-        for (T *v : m_pool)
-            delete v;
-        m_pool.clear();
-        m_capacity = m_used = 0;
+        LocalCache& local = s_local;
+        destroy(local.objects, local.count);
+        local.count = 0;
+        local.published.store(0, std::memory_order_relaxed);
+
+        uint32_t idx;
+        while (m_full.pop(*this, idx)) {
+            Magazine& mag = node(idx);
+            m_depot_cached -= mag.count;
+            destroy(mag.objects, mag.count);
+            m_empty.push(*this, idx);
+        }
+    }
+
+    PoolStats getStats() const override
+    {
+        PoolStats ret;
+        ret.name = typeid(T).name();
+        int64_t cached = m_depot_cached.load();
+        {
+            std::unique_lock<std::mutex> lock(m_locals_mutex);
+            for (LocalCache *local : m_locals)
+                cached += local->published.load(std::memory_order_relaxed);
+        }
+        ret.cached = cached;
+        ret.live = (m_created.load() - m_destroyed.load()) - cached;
+        ret.peak = m_peak.load();
+        return ret;
+    }
+
+    void setHighWaterMark(size_t n) override
+    {
+        m_high_water = (int64_t)n;
+        trim();
+    }
+
+    size_t getHighWaterMark() const override
+    {
+        return (size_t)m_high_water.load();
+    }
+
+    void trim() override
+    {
+        uint32_t idx;
+        while (m_depot_cached.load() > m_high_water.load() && m_full.pop(*this, idx)) {
+            Magazine& mag = node(idx);
+            m_depot_cached -= mag.count;
+            destroy(mag.objects, mag.count);
+            m_empty.push(*this, idx);
+        }
     }
 
 private:
-    Pool() {}
-    ~Pool() { release(); }
+    struct Magazine
+    {
+        std::atomic<uint32_t> next{ 0 };
+        int count = 0;
+        T *objects[MagazineSize];
+    };
+
+    // head is (tag << 32) | (index + 1). 0 is empty. the tag is bumped on every change.
+    class TaggedStack
+    {
+    public:
+        void push(Pool& pool, uint32_t idx)
+        {
+            uint64_t old = m_head.load(std::memory_order_acquire);
+            for (;;) {
+                pool.node(idx).next.store((uint32_t)old, std::memory_order_relaxed);
+                uint64_t head = (((old >> 32) + 1) << 32) | (uint64_t)(idx + 1);
+                if (m_head.compare_exchange_weak(old, head, std::memory_order_acq_rel, std::memory_order_acquire))
+                    return;
+            }
+        }
+
+        bool pop(Pool& pool, uint32_t& idx)
+        {
+            uint64_t old = m_head.load(std::memory_order_acquire);
+            for (;;) {
+                uint32_t top = (uint32_t)old;
+                if (top == 0)
+                    return false;
+                uint32_t next = pool.node(top - 1).next.load(std::memory_order_relaxed);
+                uint64_t head = (((old >> 32) + 1) << 32) | (uint64_t)next;
+                if (m_head.compare_exchange_weak(old, head, std::memory_order_acq_rel, std::memory_order_acquire)) {
+                    idx = top - 1;
+                    return true;
+                }
+            }
+        }
+
+    private:
+        std::atomic<uint64_t> m_head{ 0 };
+    };
+
+    struct LocalCache
+    {
+        T *objects[MagazineSize * 2];
+        int count = 0;
+        std::atomic<int> published{ 0 }; // count visible to getStats()
+
+        LocalCache()
+        {
+            if (s_alive)
+                Pool::instance().addLocal(this);
+        }
+
+        ~LocalCache()
+        {
+            if (s_alive) {
+                Pool& pool = Pool::instance();
+                while (count > 0)
+                    pool.flush(*this, std::min(count, (int)MagazineSize));
+                pool.removeLocal(this);
+            }
+            else {
+                // the pool is already gone (static destruction order)
+                for (int i = 0; i < count; ++i)
+                    delete objects[i];
+            }
+        }
+    };
+
+    Pool()
+    {
+        m_high_water = (int64_t)SegmentSize * MaxSegments * MagazineSize;
+        s_alive = true;
+        RegisterPool(this);
+    }
+
+    ~Pool()
+    {
+        release();
+        s_alive = false;
+        UnregisterPool(this);
+        for (auto& seg : m_segments)
+            delete[] seg.load();
+    }
+
+    Magazine& node(uint32_t idx)
+    {
+        return m_segments[idx / SegmentSize].load(std::memory_order_acquire)[idx % SegmentSize];
+    }
+
+    bool allocNode(uint32_t& idx)
+    {
+        if (m_empty.pop(*this, idx))
+            return true;
+
+        uint32_t n = m_num_nodes.load();
+        do {
+            if (n >= (uint32_t)(SegmentSize * MaxSegments))
+                return false;
+        } while (!m_num_nodes.compare_exchange_weak(n, n + 1));
+
+        auto& seg = m_segments[n / SegmentSize];
+        if (!seg.load(std::memory_order_acquire)) {
+            Magazine *mags = new Magazine[SegmentSize];
+            Magazine *expected = nullptr;
+            if (!seg.compare_exchange_strong(expected, mags, std::memory_order_acq_rel))
+                delete[] mags;
+        }
+        idx = n;
+        return true;
+    }
+
+    bool refill(LocalCache& local)
+    {
+        uint32_t idx;
+        if (!m_full.pop(*this, idx))
+            return false;
+        Magazine& mag = node(idx);
+        std::copy(mag.objects, mag.objects + mag.count, local.objects + local.count);
+        local.count += mag.count;
+        m_depot_cached -= mag.count;
+        m_empty.push(*this, idx);
+        return local.count > 0;
+    }
+
+    // moves the oldest n objects of the local cache to the depot, or deletes them if the depot is full
+    void flush(LocalCache& local, int n)
+    {
+        uint32_t idx;
+        if (m_depot_cached.fetch_add(n) + n <= m_high_water.load() && allocNode(idx)) {
+            Magazine& mag = node(idx);
+            std::copy(local.objects, local.objects + n, mag.objects);
+            mag.count = n;
+            m_full.push(*this, idx);
+        }
+        else {
+            m_depot_cached -= n;
+            destroy(local.objects, n);
+        }
+        std::copy(local.objects + n, local.objects + local.count, local.objects);
+        local.count -= n;
+        local.published.store(local.count, std::memory_order_relaxed);
+    }
+
+    void destroy(T **objects, int n)
+    {
+        for (int i = 0; i < n; ++i)
+            delete objects[i];
+        m_destroyed += n;
+    }
+
+    void updatePeak()
+    {
+        int64_t total = m_created.load() - m_destroyed.load();
+        int64_t peak = m_peak.load();
+        while (total > peak && !m_peak.compare_exchange_weak(peak, total)) {}
+    }
+
+    void addLocal(LocalCache *local)
+    {
+        std::unique_lock<std::mutex> lock(m_locals_mutex);
+        m_locals.push_back(local);
+    }
+
+    void removeLocal(LocalCache *local)
+    {
+        std::unique_lock<std::mutex> lock(m_locals_mutex);
+        m_locals.erase(std::remove(m_locals.begin(), m_locals.end(), local), m_locals.end());
+    }
+
+    TaggedStack m_full;
+    TaggedStack m_empty;
+    std::atomic<Magazine*> m_segments[MaxSegments] = {};
+    std::atomic<uint32_t> m_num_nodes{ 0 };
+
+    std::atomic<int64_t> m_depot_cached{ 0 };
+    std::atomic<int64_t> m_high_water{ 0 };
+    std::atomic<int64_t> m_created{ 0 };
+    std::atomic<int64_t> m_destroyed{ 0 };
+    std::atomic<int64_t> m_peak{ 0 };
+
+    // only touched when a thread uses the pool for the first time / exits, and by getStats()
+    mutable std::mutex m_locals_mutex;
+    std::vector<LocalCache*> m_locals;
 
-    std::vector<T*> m_pool;
-    std::mutex m_mutex;
-    int m_capacity = 0;
-    int m_used = 0;
+    static bool s_alive;
+    static thread_local LocalCache s_local;
 };
+template<class T> bool Pool<T>::s_alive = false;
+template<class T> thread_local typename Pool<T>::LocalCache Pool<T>::s_local;
 
 template<class T>
 struct releaser
@@ -3,10 +3,11 @@
 #include <list>
 #include <map>
 #include <mutex>
-#include <future>
+#include "MeshUtils/muTaskScheduler.h"
 
 #include "MeshSync/msProtocol.h"
 #include "MeshSync/SceneGraph/msSceneImportSettings.h"
+#include "MeshSync/SceneGraph/msMeshRefineCache.h"
 
 namespace Poco {
     namespace Net {
@@ -35,6 +36,7 @@ struct ServerSettings
     uint16_t port = 8080;
 
     SceneImportSettings import_settings;
+    MeshRefineCacheSettings refine_cache;
 };
 
 class Server {
@@ -46,6 +48,7 @@ public:
     void stop();
     void clear();
     ServerSettings& getSettings();
+    MeshRefineCache& getRefineCache();
 
     inline const bool IsPublicAccessAllowed();
     inline void AllowPublicAccess(const bool access);
@@ -73,11 +76,14 @@ public:
     struct MessageHolder
     {
         MessagePtr message;
-        std::future<void> task;
+        mu::TaskFuture<void> task;
         std::atomic_bool ready = { false };
 
         MessageHolder();
         MessageHolder(MessageHolder&& v);
+        // cancels the import task if it has not started yet and waits for it otherwise,
+        // because the task refers to the server's settings and refine cache.
+        ~MessageHolder();
     };
 
     Scene* getHostScene();
@@ -104,7 +110,7 @@ private:
     std::shared_ptr<MessageT> deserializeMessage(Poco::Net::HTTPServerRequest& request, Poco::Net::HTTPServerResponse& response);
 
     MessageHolder* queueMessage(MessagePtr mes);
-    MessageHolder* queueMessage(MessagePtr mes, std::future<void>&& task);
+    MessageHolder* queueMessage(MessagePtr mes, mu::TaskFuture<void>&& task);
 
     bool loadMIMETypes(const std::string& path);
     const std::string& getMIMEType(const std::string& filename);
@@ -118,6 +124,7 @@ private:
     bool m_serving = true;
     bool m_allowPublicAccess = false;
     ServerSettings m_settings;
+    MeshRefineCache m_refine_cache;
     HTTPServerPtr m_server;
     std::map<std::string, std::string> m_mimetypes;
     std::mutex m_message_mutex;
@@ -9,7 +9,7 @@
 namespace ms {
 
 SceneCacheInputFile::~SceneCacheInputFile() {
-    WaitAllPreloads();
+    CancelAllPreloads();
 }
 
 bool SceneCacheInputFile::IsValid() const {
@@ -201,6 +201,9 @@ ScenePtr SceneCacheInputFile::LoadByFrameInternal(const size_t sceneIndex, const
     const size_t seg_count = rec.bufferSizes.size();
     rec.segments.resize(seg_count);
 
+    // someone is waiting for this scene unless it is a preload
+    const mu::TaskPriority priority = waitPreload ? mu::TaskPriority::High : mu::TaskPriority::Low;
+
     {
         // get exclusive file access
         std::unique_lock<std::mutex> lock(m_mutex);
@@ -222,7 +225,7 @@ ScenePtr SceneCacheInputFile::LoadByFrameInternal(const size_t sceneIndex, const
             }
 
             // launch async decode
-            seg.task = std::async(std::launch::async, [this, &seg, sceneIndex, si]() {
+            seg.task = mu::TaskScheduler::instance().submit([this, &seg, sceneIndex, si]() {
                 msProfileScope("SceneCacheInputFile: [%d] decode segment (%d)", (int)sceneIndex, (int)si);
                 mu::ScopedTimer timer;
 
@@ -251,7 +254,7 @@ ScenePtr SceneCacheInputFile::LoadByFrameInternal(const size_t sceneIndex, const
                 }
 
                 seg.decodeTime = timer.elapsed();
-            });
+            }, priority);
         }
     }
 
@@ -306,7 +309,7 @@ ScenePtr SceneCacheInputFile::LoadByFrameInternal(const size_t sceneIndex, const
 
             // do import
             const SceneCacheInputSettings& settings = GetSettings();
-            ret->import(settings.importSettings);
+            ret->import(settings.importSettings, &m_refineCache);
 
             prof.setup_time = timer.elapsed();
         }
@@ -356,7 +359,7 @@ bool SceneCacheInputFile::KickPreload(size_t i)
     if (rec.scene || rec.preload.valid())
         return false; // already loaded or loading
 
-    rec.preload = std::async(std::launch::async, [this, i]() { LoadByFrameInternal(i, false); });
+    rec.preload = mu::TaskScheduler::instance().submit([this, i]() { LoadByFrameInternal(i, false); }, mu::TaskPriority::Low);
     return true;
 }
 
@@ -370,6 +373,16 @@ void SceneCacheInputFile::WaitAllPreloads()
     }
 }
 
+void SceneCacheInputFile::CancelAllPreloads()
+{
+    // preloads that have not started yet are dropped. running ones are waited.
+    for (std::vector<SceneRecord>::value_type& rec : m_records) {
+        if (rec.preload.valid())
+            rec.preload.cancel();
+    }
+    WaitAllPreloads();
+}
+
 ScenePtr SceneCacheInputFile::LoadByFrameV(const int32_t frame)
 {
     if (!IsValid())
@@ -129,13 +129,15 @@ void SceneCacheOutputFile::AddScene(const ScenePtr scene, const float time) {
     rec.time = time;
     rec.scene = scene;
 
-    rec.task = std::async(std::launch::async, [this, &rec]() {
+    rec.task = mu::TaskScheduler::instance().submit([this, &rec]() {
         {
             msProfileScope("SceneCacheOutputFile: [%d] scene optimization", rec.index);
             const SceneCacheExportSettings& exportSettings = m_outputSettings.exportSettings;
             ScenePtr& scene = rec.scene;
             std::sort(scene->entities.begin(), scene->entities.end(), [](auto& a, auto& b) { return a->id < b->id; });
 
+            if (exportSettings.mergeMeshes)
+                scene->mergeMeshes(m_outputSettings.mesh_split_unit);
             if (exportSettings.flattenHierarchy)
                 scene->flatternHierarchy();
 
@@ -189,7 +191,7 @@ void SceneCacheOutputFile::AddScene(const ScenePtr scene, const float time) {
         }
 
         for (std::vector<SceneSegment>::value_type& seg : rec.segments) {
-            seg.task = std::async(std::launch::async, [this, &rec, &seg]() {
+            seg.task = mu::TaskScheduler::instance().submit([this, &rec, &seg]() {
                 msProfileScope("SceneCacheOutputFile: [%d] serialize & encode segment (%d)", rec.index, seg.index);
 
                 mu::MemoryStream scene_buf;
@@ -217,7 +219,7 @@ void SceneCacheOutputFile::Flush()
 
 bool SceneCacheOutputFile::IsWriting() const
 {
-    return m_task.valid() && m_task.wait_for(std::chrono::milliseconds(0)) == std::future_status::timeout;
+    return m_task.valid() && !m_task.isReady();
 }
 
 int SceneCacheOutputFile::GetSceneCountWritten() const
@@ -302,7 +304,7 @@ void SceneCacheOutputFile::DoWrite()
     {
         std::unique_lock<std::mutex> l(m_mutex);
         if (!m_queue.empty() && !IsWriting()) {
-            m_task = std::async(std::launch::async, body);
+            m_task = mu::TaskScheduler::instance().submit(body);
         }
     }
 }
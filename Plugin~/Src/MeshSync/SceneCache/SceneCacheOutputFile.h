@@ -1,5 +1,7 @@
 #pragma once
 
+#include "MeshUtils/muTaskScheduler.h"
+
 #include "MeshSync/SceneGraph/msScene.h" 
 #include "MeshSync/SceneCache/msSceneCacheOutputSettings.h"
 
@@ -39,7 +41,7 @@ private:
         int index = 0;
         ScenePtr segment;
         RawVector<char> encodedBuf;
-        std::future<void> task;
+        mu::TaskFuture<void> task;
     };
 
     struct SceneRecord
@@ -48,7 +50,7 @@ private:
         float time = 0.0f;
         ScenePtr scene;
         std::vector<SceneSegment> segments;
-        std::future<void> task;
+        mu::TaskFuture<void> task;
     };
     using SceneRecordPtr = std::shared_ptr<SceneRecord>;
 
@@ -65,7 +67,7 @@ private:
 
     std::mutex m_mutex;
     std::list<SceneRecordPtr> m_queue;
-    std::future<void> m_task;
+    mu::TaskFuture<void> m_task;
 
     ScenePtr m_baseScene;
     int m_sceneCountQueued = 0;
@@ -1,4 +1,5 @@
 #include "pch.h"
+#include <climits> //INT_MAX
 #include "MeshSync/SceneGraph/msScene.h"
 #include "MeshSync/SceneGraph/msMesh.h"
 
@@ -28,6 +29,10 @@ static_assert(sizeof(MeshRefineFlags) == sizeof(uint32_t), "");
     if (flags.Get(MESH_REFINE_FLAG_QUADIFY) || flags.Get(MESH_REFINE_FLAG_QUADIFY_FULL_SEARCH)) { \
         op(stream, quadify_threshold); \
     } \
+    if (flags.Get(MESH_REFINE_FLAG_GEN_MESHLETS)) { \
+        op(stream, meshlet_max_vertices); \
+        op(stream, meshlet_max_triangles); \
+    } \
 }
 
 
@@ -59,6 +64,10 @@ uint64_t MeshRefineSettings::checksum() const
         ret += csum(smooth_angle);
     if (flags.Get(MESH_REFINE_FLAG_QUADIFY) || flags.Get(MESH_REFINE_FLAG_QUADIFY_FULL_SEARCH))
         ret += csum(quadify_threshold);
+    if (flags.Get(MESH_REFINE_FLAG_GEN_MESHLETS)) {
+        ret += csum(meshlet_max_vertices);
+        ret += csum(meshlet_max_triangles);
+    }
     if (flags.Get(MESH_REFINE_FLAG_LOCAL2WORLD))
         ret += csum(local2world);
     if (flags.Get(MESH_REFINE_FLAG_WORLD2LOCAL))
@@ -217,7 +226,7 @@ void BoneData::clear()
 }
 
 #define EachTopologyAttribute(F)\
-    F(counts) F(indices) F(material_ids)
+    F(counts) F(indices) F(indices16) F(material_ids)
 
 #define EachVertexAttribute(F)\
     F(points) F(normals) F(tangents) F(colors) F(velocities) \
@@ -227,7 +236,8 @@ void BoneData::clear()
     EachVertexAttribute(F) EachTopologyAttribute(F)
 
 #define EachMember(F)\
-    F(refine_settings) EachGeometryAttribute(F) F(root_bone) F(bones) F(blendshapes) F(submeshes) F(bounds)
+    F(refine_settings) EachGeometryAttribute(F) F(root_bone) F(bones) F(sparse_bone_counts) F(sparse_bone_weights) F(blendshapes) F(submeshes) F(bounds) \
+    F(meshlets) F(meshlet_vertices) F(meshlet_triangles) F(batch_sources) F(batch_source_ids)
 
 //----------------------------------------------------------------------------------------------------------------------
 
@@ -246,10 +256,14 @@ void BoneData::clear()
     if (flags.Get(MESH_DATA_FLAG_HAS_MATERIAL_IDS))     { op(stream, material_ids); } \
     if (flags.Get(MESH_DATA_FLAG_HAS_ROOT_BONE))        { op(stream, root_bone); } \
     if (flags.Get(MESH_DATA_FLAG_HAS_BONES))            { op(stream, bones); } \
+    if (flags.Get(MESH_DATA_FLAG_HAS_SPARSE_BONE_WEIGHTS)) { op(stream, sparse_bone_counts); op(stream, sparse_bone_weights); } \
     if (flags.Get(MESH_DATA_FLAG_HAS_BLENDSHAPES))      { op(stream, blendshapes); } \
     if (flags.Get(MESH_DATA_FLAG_HAS_BLENDSHAPE_WEIGHTS)) { op(stream, refine_settings); } \
     if (flags.Get(MESH_DATA_FLAG_HAS_SUBMESHES))        { op(stream, submeshes); } \
     if (flags.Get(MESH_DATA_FLAG_HAS_BOUNDS))           { op(stream, bounds); } \
+    if (flags.Get(MESH_DATA_FLAG_HAS_MESHLETS))         { op(stream, meshlets); op(stream, meshlet_vertices); op(stream, meshlet_triangles); } \
+    if (flags.Get(MESH_DATA_FLAG_HAS_INDICES16))        { op(stream, indices16); } \
+    if (flags.Get(MESH_DATA_FLAG_HAS_BATCH_SOURCES))    { op(stream, batch_sources); op(stream, batch_source_ids); } \
     for (uint32_t i=0;i<MeshSyncConstants::MAX_UV;++i) { \
         if ((flags).GetUV(i)) { \
             op(stream, m_uv[i]); \
@@ -310,15 +324,19 @@ void Mesh::setupDataFlags()
     md_flags.Set(MESH_DATA_FLAG_HAS_COLORS, !colors.empty());
     md_flags.Set(MESH_DATA_FLAG_HAS_VELOCITIES, !velocities.empty());
     md_flags.Set(MESH_DATA_FLAG_HAS_COUNTS, !counts.empty());
-    md_flags.Set(MESH_DATA_FLAG_HAS_INDICES, !indices.empty());
+    md_flags.Set(MESH_DATA_FLAG_HAS_INDICES, !indices.empty() || !indices16.empty());
     md_flags.Set(MESH_DATA_FLAG_HAS_MATERIAL_IDS, !material_ids.empty());
     md_flags.Set(MESH_DATA_FLAG_HAS_FACE_GROUPS, md_flags.Get(MESH_DATA_FLAG_HAS_FACE_GROUPS) && !material_ids.empty());
     md_flags.Set(MESH_DATA_FLAG_HAS_ROOT_BONE, !root_bone.empty());
     md_flags.Set(MESH_DATA_FLAG_HAS_BONES, !bones.empty());
+    md_flags.Set(MESH_DATA_FLAG_HAS_SPARSE_BONE_WEIGHTS, !bones.empty() && !sparse_bone_counts.empty());
     md_flags.Set(MESH_DATA_FLAG_HAS_BLENDSHAPES, !blendshapes.empty() && !blendshapes.front()->frames.empty());
     md_flags.Set(MESH_DATA_FLAG_HAS_BLENDSHAPE_WEIGHTS, !blendshapes.empty());
     md_flags.Set(MESH_DATA_FLAG_HAS_SUBMESHES, (!submeshes.empty()));
     md_flags.Set(MESH_DATA_FLAG_HAS_BOUNDS, bounds != Bounds{});
+    md_flags.Set(MESH_DATA_FLAG_HAS_MESHLETS, !meshlets.empty());
+    md_flags.Set(MESH_DATA_FLAG_HAS_INDICES16, !indices16.empty());
+    md_flags.Set(MESH_DATA_FLAG_HAS_BATCH_SOURCES, !batch_sources.empty());
 
     md_flags.Set(MESH_DATA_FLAG_HAS_REFINE_SETTINGS, 
         (uint32_t&)refine_settings.flags != 0 ||
@@ -464,14 +482,22 @@ void Mesh::clear()
 
     root_bone.clear();
     bones.clear();
+    vclear(sparse_bone_counts);
+    vclear(sparse_bone_weights);
     blendshapes.clear();
     submeshes.clear();
+    vclear(meshlets);
+    vclear(meshlet_vertices);
+    vclear(meshlet_triangles);
+    batch_sources.clear();
+    vclear(batch_source_ids);
 
     vclear(weights4);
     vclear(bone_counts);
     vclear(bone_offsets);
     vclear(weights1);
     bone_weight_count = 0;
+    lods.clear();
     bounds = {};
 }
 
@@ -485,6 +511,12 @@ uint64_t Mesh::hash() const
     // bones
     for (const std::vector<std::shared_ptr<BoneData>>::value_type& b : bones)
         ret += vhash(b->weights);
+    ret += vhash(sparse_bone_counts);
+    ret += vhash(sparse_bone_weights);
+    ret += vhash(meshlets);
+    ret += vhash(meshlet_vertices);
+    ret += vhash(meshlet_triangles);
+    ret += vhash(batch_source_ids);
 
     // blendshapes
     for (const std::vector<std::shared_ptr<BlendShapeData>>::value_type& bs : blendshapes) {
@@ -505,25 +537,153 @@ uint64_t Mesh::checksumGeom() const
     EachGeometryAttribute(Body);
 #undef Body
 
+    // large arrays are summed in parallel by SumInt32(). bones and blendshapes are many mid-sized arrays,
+    // so they are distributed per element instead.
     // bones
     ret += csum(root_bone);
-    for (auto& b : bones) {
-        ret += csum(b->path);
-        ret += csum(b->bindpose);
-        ret += csum(b->weights);
-    }
+    ret += mu::parallel_reduce(0, (int)bones.size(), 4, uint64_t(0),
+        [this](int begin, int end, uint64_t acc) {
+            for (int i = begin; i < end; ++i) {
+                const BoneData& b = *bones[i];
+                acc += csum(b.path);
+                acc += csum(b.bindpose);
+                acc += csum(b.weights);
+            }
+            return acc;
+        }, std::plus<uint64_t>());
+    ret += csum(sparse_bone_counts);
+    ret += csum(sparse_bone_weights);
+    ret += csum(meshlets);
+    ret += csum(meshlet_vertices);
+    ret += csum(meshlet_triangles);
+    for (auto& s : batch_sources)
+        ret += csum(s);
+    ret += csum(batch_source_ids);
 
     // blendshapes
-    for (const std::vector<std::shared_ptr<BlendShapeData>>::value_type& bs : blendshapes) {
-        ret += csum(bs->name);
-        ret += csum(bs->weight);
-        for (std::vector<std::shared_ptr<BlendShapeFrameData>>::value_type& b : bs->frames) {
-            ret += csum(b->weight);
-            ret += csum(b->points);
-            ret += csum(b->normals);
-            ret += csum(b->tangents);
+    ret += mu::parallel_reduce(0, (int)blendshapes.size(), 1, uint64_t(0),
+        [this](int begin, int end, uint64_t acc) {
+            for (int i = begin; i < end; ++i) {
+                const BlendShapeData& bs = *blendshapes[i];
+                acc += csum(bs.name);
+                acc += csum(bs.weight);
+                for (const std::shared_ptr<BlendShapeFrameData>& b : bs.frames) {
+                    acc += csum(b->weight);
+                    acc += csum(b->points);
+                    acc += csum(b->normals);
+                    acc += csum(b->tangents);
+                }
+            }
+            return acc;
+        }, std::plus<uint64_t>());
+    return ret;
+}
+
+// 64 bit multiply-xorshift finalizer (splitmix64)
+static inline uint64_t MixHash(uint64_t h)
+{
+    h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ull;
+    h = (h ^ (h >> 27)) * 0x94d049bb133111ebull;
+    return h ^ (h >> 31);
+}
+
+// order sensitive hash of a byte range. 4 independent lanes keep the multiplies pipelined.
+static uint64_t HashBytesImpl(const char *data, size_t size, uint64_t seed)
+{
+    const uint64_t prime = 0x100000001b3ull;
+    uint64_t h[4] = { seed, seed + 1, seed + 2, seed + 3 };
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+        uint64_t w[4];
+        memcpy(w, data + i, 32);
+        for (int l = 0; l < 4; ++l)
+            h[l] = (h[l] ^ w[l]) * prime;
+    }
+    uint64_t tail = 0;
+    for (int s = 0; i < size; ++i, s = (s + 8) & 63) {
+        tail ^= (uint64_t)(uint8_t)data[i] << s;
+        if (s == 56)
+            h[0] = (h[0] ^ tail) * prime, tail = 0;
+    }
+    h[1] = (h[1] ^ tail) * prime;
+    return MixHash(MixHash(MixHash(MixHash(h[0]) ^ h[1]) ^ h[2]) ^ h[3]);
+}
+
+// large ranges are hashed in chunks in parallel. each chunk hash is mixed with its position, so it stays order sensitive.
+static const size_t HashChunkSize = 0x10000;
+
+static uint64_t HashBytes(const void *data_, size_t size)
+{
+    const char *data = (const char*)data_;
+    if (size <= HashChunkSize)
+        return HashBytesImpl(data, size, size);
+    const int num_chunks = (int)((size + HashChunkSize - 1) / HashChunkSize);
+    return mu::parallel_reduce(0, num_chunks, 4, uint64_t(size),
+        [data, size](int begin, int end, uint64_t acc) {
+            for (int ci = begin; ci < end; ++ci) {
+                const size_t offset = ci * HashChunkSize;
+                acc += MixHash(HashBytesImpl(data + offset, std::min(HashChunkSize, size - offset), offset));
+            }
+            return acc;
+        }, std::plus<uint64_t>());
+}
+
+// calls body() with the pairs of everything refine() reads, in a fixed order.
+// a and b must have the same numbers of bones, blendshapes and blendshape frames.
+template<class F>
+static void EachRefineSource(const Mesh& a, const Mesh& b, const F& body)
+{
+#define Body(A) body(a.A, b.A);
+    EachGeometryAttribute(Body);
+    Body(root_bone) Body(sparse_bone_counts) Body(sparse_bone_weights)
+#undef Body
+    for (size_t bi = 0; bi < a.bones.size(); ++bi) {
+        const BoneData &b1 = *a.bones[bi], &b2 = *b.bones[bi];
+        body(b1.path, b2.path);
+        body(b1.bindpose, b2.bindpose);
+        body(b1.weights, b2.weights);
+    }
+    for (size_t bi = 0; bi < a.blendshapes.size(); ++bi) {
+        const BlendShapeData &bs1 = *a.blendshapes[bi], &bs2 = *b.blendshapes[bi];
+        body(bs1.name, bs2.name);
+        body(bs1.weight, bs2.weight);
+        for (size_t fi = 0; fi < bs1.frames.size(); ++fi) {
+            const BlendShapeFrameData &f1 = *bs1.frames[fi], &f2 = *bs2.frames[fi];
+            body(f1.weight, f2.weight);
+            body(f1.points, f2.points);
+            body(f1.normals, f2.normals);
+            body(f1.tangents, f2.tangents);
         }
     }
+}
+
+template<class T> static inline uint64_t HashSource(const SharedVector<T>& v) { return HashBytes(v.cdata(), v.size_in_byte()); }
+static inline uint64_t HashSource(const std::string& v) { return HashBytes(v.data(), v.size()); }
+template<class T> static inline uint64_t HashSource(const T& v) { return HashBytes(&v, sizeof(T)); }
+
+uint64_t Mesh::hashGeom() const
+{
+    uint64_t ret = 0;
+    EachRefineSource(*this, *this, [&ret](const auto& v, const auto&) {
+        ret = MixHash(ret ^ HashSource(v));
+    });
+    return ret;
+}
+
+bool Mesh::equalGeometry(const Mesh& v) const
+{
+    if (bones.size() != v.bones.size() || blendshapes.size() != v.blendshapes.size())
+        return false;
+    for (size_t bi = 0; bi < blendshapes.size(); ++bi) {
+        if (blendshapes[bi]->frames.size() != v.blendshapes[bi]->frames.size())
+            return false;
+    }
+
+    bool ret = true;
+    EachRefineSource(*this, v, [&ret](const auto& a, const auto& b) {
+        if (ret && !(a == b))
+            ret = false;
+    });
     return ret;
 }
 
@@ -541,6 +701,44 @@ EntityPtr Mesh::clone(bool detach_)
     return ret;
 }
 
+template<class T>
+static inline void CopyMember(T& dst, const T& src) { dst = src; }
+// SharedVector's assignment shares the source. copy into the existing buffer instead.
+template<class T>
+static inline void CopyMember(SharedVector<T>& dst, const SharedVector<T>& src) { dst.assign(src.cdata(), src.cdata() + src.size()); }
+
+void Mesh::copyGeometry(const Mesh& src)
+{
+#define Body(A) CopyMember(A, src.A);
+    EachMember(Body);
+    Body(weights4) Body(bone_counts) Body(bone_offsets) Body(weights1) Body(bone_weight_count)
+#undef Body
+    for (auto& b : bones)
+        b = b->clone();
+    for (auto& bs : blendshapes)
+        bs = bs->clone();
+    vdetach(bones);
+    vdetach(blendshapes);
+    setupDataFlags();
+}
+
+uint64_t Mesh::geometrySize() const
+{
+    uint64_t ret = 0;
+#define Body(A) ret += A.size_in_byte();
+    EachGeometryAttribute(Body);
+    Body(sparse_bone_counts) Body(sparse_bone_weights) Body(submeshes)
+    Body(meshlets) Body(meshlet_vertices) Body(meshlet_triangles) Body(batch_source_ids)
+    Body(weights4) Body(bone_counts) Body(bone_offsets) Body(weights1)
+#undef Body
+    for (auto& b : bones)
+        ret += b->weights.size_in_byte();
+    for (auto& bs : blendshapes)
+        for (auto& f : bs->frames)
+            ret += f->points.size_in_byte() + f->normals.size_in_byte() + f->tangents.size_in_byte();
+    return ret;
+}
+
 #undef EachTopologyAttribute
 #undef EachVertexAttribute
 #undef EachGeometryAttribute
@@ -558,12 +756,130 @@ static inline void Remap(C1& dst, const C2& src, const C3& indices)
     }
 }
 
+// remaps many attributes at once. attributes that share an index array are gathered by one mu::GatherAttributes()
+// call and swapped into place by apply().
+class RemapList
+{
+public:
+    template<class C>
+    void add(C& data, const RawVector<int>& indices)
+    {
+        // same as Remap(): empty indices leave data as is
+        if (data.empty() || indices.empty())
+            return;
+
+        using T = typename C::value_type;
+        auto tmp = std::make_shared<RawVector<T>>();
+        tmp->resize_discard(indices.size());
+
+        auto it = std::find_if(m_groups.begin(), m_groups.end(), [&](const Group& g) { return g.indices == &indices; });
+        if (it == m_groups.end())
+            it = m_groups.insert(m_groups.end(), Group{ &indices });
+        it->streams.push_back({ tmp->data(), data.cdata(), sizeof(T) });
+        m_swaps.push_back([&data, tmp]() { data.swap(*tmp); });
+    }
+
+    void apply()
+    {
+        for (auto& g : m_groups)
+            mu::GatherAttributes(g.streams.data(), g.streams.size(), g.indices->cdata(), g.indices->size());
+        for (auto& swap : m_swaps)
+            swap();
+        m_groups.clear();
+        m_swaps.clear();
+    }
+
+private:
+    struct Group
+    {
+        const RawVector<int> *indices;
+        std::vector<mu::GatherStream> streams;
+    };
+    std::vector<Group> m_groups;
+    std::vector<std::function<void()>> m_swaps;
+};
+
+void MeshRefineTables::clear()
+{
+    settings = 0;
+    num_points = 0;
+    counts.clear();
+    indices.clear();
+    material_ids.clear();
+    new2old_points.clear();
+    old2new_indices.clear();
+    remap_normals.clear();
+    remap_colors.clear();
+    for (auto& r : remap_uv)
+        r.clear();
+    new_indices.clear();
+    new_indices16.clear();
+    submeshes.clear();
+    meshlets.clear();
+    meshlet_vertices.clear();
+    meshlet_triangles.clear();
+    reuse_count = 0;
+}
+
+uint64_t MeshRefineTables::size() const
+{
+    uint64_t ret = counts.size_in_byte() + indices.size_in_byte() + material_ids.size_in_byte() +
+        new2old_points.size_in_byte() + old2new_indices.size_in_byte() + remap_normals.size_in_byte() + remap_colors.size_in_byte() +
+        new_indices.size_in_byte() + new_indices16.size_in_byte() + submeshes.size_in_byte() +
+        meshlets.size_in_byte() + meshlet_vertices.size_in_byte() + meshlet_triangles.size_in_byte();
+    for (auto& r : remap_uv)
+        ret += r.size_in_byte();
+    return ret;
+}
+
+template<class A1, class A2>
+static inline bool ArrayEqual(const A1& a1, const A2& a2)
+{
+    return a1.size() == a2.size() && (a1.empty() || memcmp(a1.cdata(), a2.cdata(), a1.size_in_byte()) == 0);
+}
+
+// per-index attribute: the tables are valid as long as the indices merged into a vertex still have equal values.
+// indices that became equal stay split, which is still a correct result.
+template<class T>
+static inline bool IsRemapValid(const SharedVector<T>& values, const RawVector<int>& remap, const RawVector<int>& old2new, size_t num_indices)
+{
+    if (remap.empty())
+        return values.size() != num_indices;
+    if (values.size() != num_indices)
+        return false;
+
+    std::atomic_bool ret{ true };
+    const T *src = values.cdata();
+    mu::parallel_for_blocked(0, (int)num_indices, 1024 * 16, [&](int begin, int end) {
+        for (int ii = begin; ii < end && ret; ++ii) {
+            if (!(src[ii] == src[remap[old2new[ii]]]))
+                ret = false;
+        }
+    });
+    return ret;
+}
+
 void Mesh::refine()
+{
+    refine(nullptr);
+}
+
+void Mesh::refine(MeshRefineTables *tables)
 {
     if (cache_flags.constant)
         return;
 
     MeshRefineSettings& mrs = refine_settings;
+    // settings and face groups decide the result as much as the topology
+    const uint64_t settings_key = mrs.checksum() * 2 + (md_flags.Get(MESH_DATA_FLAG_HAS_FACE_GROUPS) ? 1 : 0);
+    // mirroring welds vertices by their positions, so the topology is not stable
+    if (mrs.flags.Get(MESH_REFINE_FLAG_MIRROR_X) || mrs.flags.Get(MESH_REFINE_FLAG_MIRROR_Y) || mrs.flags.Get(MESH_REFINE_FLAG_MIRROR_Z))
+        tables = nullptr;
+
+    // refine works on 32 bit indices
+    if (indices.empty() && !indices16.empty())
+        indices.assign(indices16.begin(), indices16.end());
+    indices16.clear();
 
     if (mrs.flags.Get(MESH_REFINE_FLAG_FLIP_U))
         mu::InvertU(m_uv[0].data(), m_uv[0].size());
@@ -595,13 +911,17 @@ void Mesh::refine()
         }
     }
 
+    // connectivity is built on first use and shared by the normals, tangents and re-indexing below
+    mu::MeshTopologyContext topology;
+    topology.setup(counts, indices, points);
+
     // normals
     const bool flip_normals = mrs.flags.Get(MESH_REFINE_FLAG_FLIP_NORMALS) ^ mrs.flags.Get(MESH_REFINE_FLAG_FLIP_FACES);
     if (mrs.flags.Get(MESH_REFINE_FLAG_GEN_NORMALS) 
         || (mrs.flags.Get(MESH_REFINE_FLAG_GEN_NORMALS_WITH_SMOOTH_ANGLE) && mrs.smooth_angle >= 180.0f)) 
     {
         if (!counts.empty()) {
-            GenerateNormalsPoly(normals.as_raw(), points, counts, indices, flip_normals);
+            GenerateNormalsPoly(normals.as_raw(), topology, flip_normals);
         }
         else {
             normals.resize_discard(points.size());
@@ -611,27 +931,31 @@ void Mesh::refine()
     } else if (mrs.flags.Get(MESH_REFINE_FLAG_GEN_NORMALS_WITH_SMOOTH_ANGLE) 
                && !mrs.flags.Get(MESH_REFINE_FLAG_NO_REINDEXING)) 
     {
-        GenerateNormalsWithSmoothAngle(normals.as_raw(), points, counts, indices, mrs.smooth_angle, flip_normals);
+        GenerateNormalsWithSmoothAngle(normals.as_raw(), topology, mrs.smooth_angle, flip_normals);
     }
 
     // generate back faces
     // this must be after generating normals.
-    if (mrs.flags.Get(MESH_REFINE_FLAG_MAKE_DOUBLE_SIDED))
+    if (mrs.flags.Get(MESH_REFINE_FLAG_MAKE_DOUBLE_SIDED)) {
         makeDoubleSided();
+        topology.setup(counts, indices, points);
+    }
 
-    auto handle_tangents = [this, &mrs]() {
+    // triangulated: indices are re-indexed triangles. the topology of the source mesh doesn't apply to them.
+    auto handle_tangents = [this, &mrs, &topology](bool triangulated) {
         // generating tangents require normals and uvs
         if (mrs.flags.Get(MESH_REFINE_FLAG_GEN_TANGENTS) && normals.size() == points.size() && m_uv[0].size() == points.size()) {
-            tangents.resize(points.size());
-            GenerateTangentsTriangleIndexed(tangents.data(),
-                points.cdata(), m_uv[0].cdata(), normals.cdata(), indices.cdata(), (int)indices.size() / 3, (int)points.size());
+            if (triangulated)
+                GenerateTangentsPoly(tangents.as_raw(), points, m_uv[0], normals, IArray<int>(), indices);
+            else
+                GenerateTangentsPoly(tangents.as_raw(), m_uv[0], normals, topology);
         }
     };
 
     if (mrs.flags.Get(MESH_REFINE_FLAG_NO_REINDEXING)) {
         // tangents
         // normals and tangents can be generated on the fly even if re-indexing is disabled.
-        handle_tangents();
+        handle_tangents(false);
 
         size_t num_points = points.size();
 #define CheckAttr(A)\
@@ -663,98 +987,162 @@ void Mesh::refine()
         size_t num_indices_old = indices.size();
         size_t num_points_old = points.size();
 
-        RawVector<mu::float3> tmp_normals;
-        RawVector<mu::float2> tmp_uv[MeshSyncConstants::MAX_UV];
-        RawVector<int> remap_uv[MeshSyncConstants::MAX_UV];
-        RawVector<mu::float4> tmp_colors;
-        RawVector<int> remap_normals, remap_colors;
+        MeshRefineTables local_tables;
+        MeshRefineTables& rt = tables ? *tables : local_tables;
 
-        mu::MeshRefiner refiner;
-        refiner.split_unit = mrs.flags.Get(MESH_REFINE_FLAG_SPLIT)? mrs.split_unit : INT_MAX;
-        refiner.points = points;
-        refiner.indices = indices;
-        refiner.counts = counts;
-        refiner.buildConnection();
+        bool reuse = tables && rt.settings == settings_key && rt.num_points == num_points_old &&
+            ArrayEqual(rt.indices, indices) && ArrayEqual(rt.counts, counts) && ArrayEqual(rt.material_ids, material_ids);
+        if (reuse) {
+            reuse = reuse && IsRemapValid(normals, rt.remap_normals, rt.old2new_indices, num_indices_old);
+            reuse = reuse && IsRemapValid(colors, rt.remap_colors, rt.old2new_indices, num_indices_old);
+            for (uint32_t i = 0; i < MeshSyncConstants::MAX_UV; ++i)
+                reuse = reuse && IsRemapValid(m_uv[i], rt.remap_uv[i], rt.old2new_indices, num_indices_old);
+        }
 
-        const size_t numIndices = indices.size();
+        RawVector<mu::float3> tmp_points;
+        if (reuse) {
+            ++rt.reuse_count;
+            Remap(tmp_points, points, rt.new2old_points);
+        }
+        else {
+            rt.clear();
+            RawVector<mu::float3> tmp_normals;
+            RawVector<mu::float2> tmp_uv[MeshSyncConstants::MAX_UV];
+            RawVector<mu::float4> tmp_colors;
+
+            mu::MeshRefiner refiner;
+            refiner.split_unit = mrs.flags.Get(MESH_REFINE_FLAG_SPLIT)? mrs.split_unit : INT_MAX;
+            refiner.dedup_by_hash = mrs.flags.Get(MESH_REFINE_FLAG_DEDUP_BY_HASH);
+            refiner.points = points;
+            refiner.indices = indices;
+            refiner.counts = counts;
+            if (!counts.empty())
+                refiner.topology = &topology;
+
+            const size_t numIndices = indices.size();
+
+            if (normals.size() == numIndices)
+                refiner.addExpandedAttribute<mu::float3>(normals, tmp_normals, rt.remap_normals);
+            for (uint32_t i=0;i<MeshSyncConstants::MAX_UV;++i) {
+                if (m_uv[i].size() != numIndices) {
+                    continue;
+                }
 
-        if (normals.size() == numIndices)
-            refiner.addExpandedAttribute<mu::float3>(normals, tmp_normals, remap_normals);
-        for (uint32_t i=0;i<MeshSyncConstants::MAX_UV;++i) {
-            if (m_uv[i].size() != numIndices) {
-                continue;
+                refiner.addExpandedAttribute<mu::float2>(m_uv[i], tmp_uv[i], rt.remap_uv[i]);
             }
 
-            refiner.addExpandedAttribute<mu::float2>(m_uv[i], tmp_uv[i], remap_uv[i]);
+            if (colors.size() == indices.size())
+                refiner.addExpandedAttribute<mu::float4>(colors, tmp_colors, rt.remap_colors);
+
+            // refine
+            refiner.refine();
+            refiner.retopology(mrs.flags.Get(MESH_REFINE_FLAG_FLIP_FACES));
+            refiner.genSubmeshes(material_ids, md_flags.Get(MESH_DATA_FLAG_HAS_FACE_GROUPS));
+            if (mrs.flags.Get(MESH_REFINE_FLAG_OPTIMIZE_VERTEX_CACHE))
+                refiner.optimizeVertexCache();
+            if (mrs.flags.Get(MESH_REFINE_FLAG_GEN_MESHLETS))
+                refiner.genMeshlets((int)mrs.meshlet_max_vertices, (int)mrs.meshlet_max_triangles);
+            if (mrs.flags.Get(MESH_REFINE_FLAG_GEN_INDICES16))
+                refiner.genIndices16();
+
+            // record the tables
+            refiner.new_points.swap(tmp_points);
+            refiner.new2old_points.swap(rt.new2old_points);
+            refiner.new_indices_submeshes.swap(rt.new_indices);
+            refiner.new_indices_submeshes16.swap(rt.new_indices16);
+            refiner.meshlets.swap(rt.meshlets);
+            refiner.meshlet_vertices.swap(rt.meshlet_vertices);
+            refiner.meshlet_triangles.swap(rt.meshlet_triangles);
+            for (auto& src : refiner.submeshes) {
+                SubmeshData sm;
+                sm.index_count = src.index_count;
+                sm.index_offset = src.index_offset;
+                sm.topology = (Topology)src.topology;
+                sm.material_id = src.material_id;
+                rt.submeshes.push_back(sm);
+            }
+            if (tables) {
+                rt.settings = settings_key;
+                rt.num_points = num_points_old;
+                rt.counts.assign(counts.cdata(), counts.cdata() + counts.size());
+                rt.indices.assign(indices.cdata(), indices.cdata() + indices.size());
+                rt.material_ids.assign(material_ids.cdata(), material_ids.cdata() + material_ids.size());
+                refiner.old2new_indices.swap(rt.old2new_indices);
+            }
         }
 
-        if (colors.size() == indices.size())
-            refiner.addExpandedAttribute<mu::float4>(colors, tmp_colors, remap_colors);
-
-        // refine
-        refiner.refine();
-        refiner.retopology(mrs.flags.Get(MESH_REFINE_FLAG_FLIP_FACES));
-        refiner.genSubmeshes(material_ids, md_flags.Get(MESH_DATA_FLAG_HAS_FACE_GROUPS));
-
-        // apply new points & indices
-        refiner.new_points.swap(points);
-        refiner.new_counts.swap(counts);
-        refiner.new_indices_submeshes.swap(indices);
-
-        // setup submeshes
-        submeshes.clear();
-        for (auto& src : refiner.submeshes) {
-            SubmeshData sm;
-            sm.index_count = src.index_count;
-            sm.index_offset = src.index_offset;
-            sm.topology = (Topology)src.topology;
-            sm.material_id = src.material_id;
-            submeshes.push_back(sm);
+        // apply new points & indices. tables that are kept for later refines are copied.
+        auto take = [tables](auto& dst, auto& src) {
+            if (tables)
+                dst.assign(src.cdata(), src.cdata() + src.size());
+            else
+                dst.swap(src);
+        };
+        tmp_points.swap(points);
+        indices16.clear();
+        if (!rt.new_indices16.empty()) {
+            take(indices16, rt.new_indices16);
+            indices.clear();
         }
-
-        // remap vertex attributes
-        if (!normals.empty()) {
-            Remap(tmp_normals, normals, !remap_normals.empty() ? remap_normals : refiner.new2old_points);
-            tmp_normals.swap(normals);
+        else {
+            take(indices, rt.new_indices);
         }
+        take(submeshes, rt.submeshes);
+        take(meshlets, rt.meshlets);
+        take(meshlet_vertices, rt.meshlet_vertices);
+        take(meshlet_triangles, rt.meshlet_triangles);
 
-        for (uint32_t i=0;i<MeshSyncConstants::MAX_UV;++i) {
+        const RawVector<int>& new2old_points = rt.new2old_points;
 
-            if (m_uv[i].empty())
-                continue;
+        // remap vertex attributes and blendshape deltas. attributes that share an index array are gathered together.
+        RemapList remaps;
+        remaps.add(normals, !rt.remap_normals.empty() ? rt.remap_normals : new2old_points);
+        for (uint32_t i=0;i<MeshSyncConstants::MAX_UV;++i) {
+            remaps.add(m_uv[i], !rt.remap_uv[i].empty() ? rt.remap_uv[i] : new2old_points);
+        }
+        remaps.add(colors, !rt.remap_colors.empty() ? rt.remap_colors : new2old_points);
 
-            Remap(tmp_uv[i], m_uv[i], !remap_uv[i].empty() ? remap_uv[i] : refiner.new2old_points);
-            tmp_uv[i].swap(m_uv[i]);
+        // velocities
+        if (velocities.size() == num_points_old)
+            remaps.add(velocities, new2old_points);
 
-        }
+        // batch sources
+        if (batch_source_ids.size() == num_points_old)
+            remaps.add(batch_source_ids, new2old_points);
 
-        if (!colors.empty()) {
-            Remap(tmp_colors, colors, !remap_colors.empty() ? remap_colors : refiner.new2old_points);
-            tmp_colors.swap(colors);
+        // bone weights
+        if (weights4.size() == num_points_old)
+            remaps.add(weights4, new2old_points);
+
+        // blendshape deltas
+        for (auto& bs : blendshapes) {
+            bs->sort();
+            for (auto& fp : bs->frames) {
+                auto& f = *fp;
+                if (f.points.size() == num_points_old)
+                    remaps.add(f.points, new2old_points);
+
+                if (f.normals.size() == num_points_old)
+                    remaps.add(f.normals, new2old_points);
+                else if (f.normals.size() == num_indices_old)
+                    remaps.add(f.normals, rt.remap_normals);
+
+                if (f.tangents.size() == num_points_old)
+                    remaps.add(f.tangents, new2old_points);
+            }
         }
+        remaps.apply();
 
         // tangents
-        handle_tangents();
+        handle_tangents(true);
 
-        // velocities
-        if (velocities.size() == num_points_old) {
-            RawVector<mu::float3> tmp_velocities;
-            Remap(tmp_velocities, velocities, refiner.new2old_points);
-            tmp_velocities.swap(velocities);
-        }
-
-        // bone weights
-        if (weights4.size() == num_points_old) {
-            RawVector<mu::Weights4> tmp_weights;
-            Remap(tmp_weights, weights4, refiner.new2old_points);
-            weights4.swap(tmp_weights);
-        }
+        // variable bone weights
         if (!weights1.empty() && bone_counts.size() == num_points_old && bone_offsets.size() == num_points_old) {
             RawVector<uint8_t> tmp_bone_counts;
             RawVector<int> tmp_bone_offsets;
             RawVector<mu::Weights1> tmp_weights;
 
-            Remap(tmp_bone_counts, bone_counts, refiner.new2old_points);
+            Remap(tmp_bone_counts, bone_counts, new2old_points);
 
             size_t num_points = points.size();
             tmp_bone_offsets.resize_discard(num_points);
@@ -770,7 +1158,7 @@ void Mesh::refine()
             // remap weights
             for (size_t i = 0; i < num_points; ++i) {
                 int new_offset = tmp_bone_offsets[i];
-                int old_offset = bone_offsets[refiner.new2old_points[i]];
+                int old_offset = bone_offsets[new2old_points[i]];
                 weights1[old_offset].copy_to(&tmp_weights[new_offset], tmp_bone_counts[i]);
             }
 
@@ -784,35 +1172,6 @@ void Mesh::refine()
             bone_weight_count = wc;
         }
 
-        // remap blendshape delta
-        if (!blendshapes.empty()) {
-            RawVector<mu::float3> tmp;
-            for (auto& bs : blendshapes) {
-                bs->sort();
-                for (auto& fp : bs->frames) {
-                    auto& f = *fp;
-                    if (f.points.size() == num_points_old) {
-                        Remap(tmp, f.points, refiner.new2old_points);
-                        f.points.swap(tmp);
-                    }
-
-                    if (f.normals.size() == num_points_old) {
-                        Remap(tmp, f.normals, refiner.new2old_points);
-                        f.normals.swap(tmp);
-                    }
-                    else if (f.normals.size() == num_indices_old) {
-                        Remap(tmp, f.normals, remap_normals);
-                        f.normals.swap(tmp);
-                    }
-
-                    if (f.tangents.size() == num_points_old) {
-                        Remap(tmp, f.tangents, refiner.new2old_points);
-                        f.tangents.swap(tmp);
-                    }
-                }
-            }
-        }
-
         // all faces are triangles
         counts.clear();
         // material_ids can be regenerated by submeshes
@@ -934,7 +1293,7 @@ void Mesh::makeDoubleSided()
     copy_index_elements(colors);
 }
 
-void Mesh::mirrorMesh(const mu::float3 & plane_n, float plane_d, bool /*welding*/)
+void Mesh::mirrorMesh(const mu::float3 & plane_n, float plane_d, bool welding)
 {
     size_t num_points_old = points.size();
     size_t num_faces_old = counts.size();
@@ -958,6 +1317,39 @@ void Mesh::mirrorMesh(const mu::float3 & plane_n, float plane_d, bool /*welding*
         }
     }
 
+    if (welding && !copylist.empty()) {
+        // also weld mirrored points that land on existing points (e.g. the seam of an already mirrored half)
+        RawVector<mu::float3> tmp;
+        tmp.assign(points.cdata(), points.cdata() + num_points_old);
+        tmp.resize(num_points_old + copylist.size());
+        mu::float3 *mirrored = &tmp[num_points_old];
+        mu::CopyWithIndices(mirrored, points.cdata(), copylist);
+        if (refine_settings.flags.Get(MESH_REFINE_FLAG_MIRROR_BASIS))
+            mu::MulPoints(refine_settings.mirror_basis, mirrored, mirrored, copylist.size());
+        mu::MirrorPoints(mirrored, copylist.size(), plane_n, plane_d);
+        if (refine_settings.flags.Get(MESH_REFINE_FLAG_MIRROR_BASIS))
+            mu::MulPoints(mu::invert(refine_settings.mirror_basis), mirrored, mirrored, copylist.size());
+
+        RawVector<int> weld_map;
+        mu::WeldVertices(weld_map, tmp, muEpsilon);
+
+        // weld targets are either original points or earlier mirrored points
+        RawVector<int> candidates = copylist;
+        copylist.clear();
+        for (size_t ci = 0; ci < candidates.size(); ++ci) {
+            int pi = candidates[ci];
+            int wi = weld_map[num_points_old + ci];
+            if (wi < (int)num_points_old)
+                indirect[pi] = wi;
+            else if (wi != (int)(num_points_old + ci))
+                indirect[pi] = indirect[candidates[wi - num_points_old]];
+            else {
+                indirect[pi] = (int)(num_points_old + copylist.size());
+                copylist.push_back(pi);
+            }
+        }
+    }
+
     const size_t num_additional_points = copylist.size();
     const size_t num_additional_indices = num_indices_old;
 
@@ -1055,6 +1447,12 @@ void Mesh::mirrorMesh(const mu::float3 & plane_n, float plane_d, bool /*welding*
         }
     }
 
+    // batch sources
+    if (batch_source_ids.size() == num_points_old) {
+        batch_source_ids.resize(points.size());
+        mu::CopyWithIndices(&batch_source_ids[num_points_old], batch_source_ids.cdata(), copylist);
+    }
+
     // material ids
     if (!material_ids.empty()) {
         size_t n = material_ids.size();
@@ -1065,9 +1463,35 @@ void Mesh::mirrorMesh(const mu::float3 & plane_n, float plane_d, bool /*welding*
     // bone weights
     for (auto& bone : bones) {
         auto& weights = bone->weights;
+        if (weights.empty())
+            continue;
         weights.resize(points.size());
         mu::CopyWithIndices(&weights[num_points_old], weights.cdata(), copylist);
     }
+    if (sparse_bone_counts.size() == num_points_old) {
+        RawVector<int> offsets(num_points_old);
+        int offset = 0;
+        for (size_t pi = 0; pi < num_points_old; ++pi) {
+            offsets[pi] = offset;
+            offset += sparse_bone_counts[pi];
+        }
+
+        size_t num_weights_old = sparse_bone_weights.size();
+        size_t num_additional_weights = 0;
+        for (int pi : copylist)
+            num_additional_weights += sparse_bone_counts[pi];
+        sparse_bone_counts.resize(points.size());
+        sparse_bone_weights.resize(num_weights_old + num_additional_weights);
+
+        mu::Weights1 *dst = &sparse_bone_weights[num_weights_old];
+        for (size_t ci = 0; ci < num_additional_points; ++ci) {
+            int pi = copylist[ci];
+            int n = sparse_bone_counts[pi];
+            sparse_bone_counts[num_points_old + ci] = (uint8_t)n;
+            sparse_bone_weights[offsets[pi]].copy_to(dst, n);
+            dst += n;
+        }
+    }
 
     // blendshapes
     for (auto& bs : blendshapes) {
@@ -1118,6 +1542,10 @@ void Mesh::transformMesh(const mu::float4x4& m)
     mu::MulVectors(m, normals.cdata(), normals.data(), normals.size());
     mu::Normalize(normals.data(), normals.size());
     mu::MulVectors(m, velocities.cdata(), velocities.data(), velocities.size());
+    for (auto& t : tangents) {
+        mu::float3 v = mu::normalize(mu::mul_v(m, (mu::float3&)t));
+        t = { v.x, v.y, v.z, t.w };
+    }
 }
 
 void Mesh::mergeMesh(const Mesh& v)
@@ -1204,39 +1632,366 @@ void Mesh::mergeMesh(const Mesh& v)
     bone_offsets.clear();
     weights4.clear();
     blendshapes.clear();
+    meshlets.clear();
+    meshlet_vertices.clear();
+    meshlet_triangles.clear();
+    indices16.clear();
+    batch_sources.clear();
+    batch_source_ids.clear();
 }
 
-void Mesh::setupBoneWeights4()
+namespace {
+
+// keeps the vertices in new2old (in that order) and rewrites indices. mesh must be refined (all attributes per-vertex).
+void CompactVertices(Mesh& mesh, const RawVector<int>& new2old)
 {
-    if (bones.empty())
+    const size_t num_points_old = mesh.points.size();
+    const size_t num_points = new2old.size();
+
+    RawVector<int> old2new;
+    old2new.resize_discard(num_points_old);
+    std::fill(old2new.begin(), old2new.end(), -1);
+    for (size_t i = 0; i < num_points; ++i)
+        old2new[new2old[i]] = (int)i;
+    for (int& i : mesh.indices)
+        i = old2new[i];
+
+    auto remap = [&](auto& values) {
+        if (values.size() != num_points_old)
+            return;
+        std::remove_reference_t<decltype(values)> tmp;
+        tmp.resize_discard(num_points);
+        mu::CopyWithIndices(tmp.data(), values.cdata(), new2old);
+        values.swap(tmp);
+    };
+    // variable length per-vertex data
+    auto remap_variable = [&](auto& counts, auto& values, const RawVector<int>& offsets) {
+        if (counts.size() != num_points_old)
+            return;
+        std::remove_reference_t<decltype(counts)> tmp_counts;
+        std::remove_reference_t<decltype(values)> tmp_values;
+        tmp_counts.resize_discard(num_points);
+        for (size_t i = 0; i < num_points; ++i) {
+            int vi = new2old[i];
+            tmp_counts[i] = counts[vi];
+            tmp_values.insert(tmp_values.end(), values.cdata() + offsets[vi], values.cdata() + offsets[vi] + counts[vi]);
+        }
+        counts.swap(tmp_counts);
+        values.swap(tmp_values);
+    };
+    auto counts_to_offsets = [](const auto& counts, size_t total, RawVector<int>& dst) {
+        dst.resize_discard(counts.size());
+        int offset = 0;
+        for (size_t i = 0; i < counts.size(); ++i) {
+            dst[i] = offset;
+            offset += counts[i];
+        }
+        return (size_t)offset <= total;
+    };
+
+    remap(mesh.points);
+    remap(mesh.normals);
+    remap(mesh.tangents);
+    remap(mesh.colors);
+    remap(mesh.velocities);
+    remap(mesh.batch_source_ids);
+    for (uint32_t i = 0; i < MeshSyncConstants::MAX_UV; ++i)
+        remap(mesh.m_uv[i]);
+
+    for (auto& bone : mesh.bones)
+        remap(bone->weights);
+    if (!mesh.sparse_bone_counts.empty()) {
+        RawVector<int> offsets;
+        if (counts_to_offsets(mesh.sparse_bone_counts, mesh.sparse_bone_weights.size(), offsets))
+            remap_variable(mesh.sparse_bone_counts, mesh.sparse_bone_weights, offsets);
+    }
+    remap(mesh.weights4);
+    if (mesh.bone_offsets.size() == num_points_old) {
+        RawVector<int> offsets;
+        offsets.assign(mesh.bone_offsets.begin(), mesh.bone_offsets.end());
+        remap_variable(mesh.bone_counts, mesh.weights1, offsets);
+        counts_to_offsets(mesh.bone_counts, mesh.weights1.size(), offsets);
+        mesh.bone_offsets.assign(offsets.begin(), offsets.end());
+        mesh.bone_weight_count = (uint32_t)mesh.weights1.size();
+    }
+
+    for (auto& bs : mesh.blendshapes) {
+        for (auto& f : bs->frames) {
+            remap(f->points);
+            remap(f->normals);
+            remap(f->tangents);
+        }
+    }
+}
+
+} // namespace
+
+void Mesh::generateLODs(std::vector<std::shared_ptr<Mesh>>& dst, int num_levels, float ratio, float target_error)
+{
+    if (!counts.empty() || submeshes.empty()) {
+        muLogWarning("Mesh::generateLODs(): mesh is not refined\n");
         return;
+    }
+    num_levels = std::min(num_levels, MaxLODLevels);
+
+    // 16 bit indices are widened while simplifying and narrowed back for each level
+    const bool use_indices16 = indices.empty() && !indices16.empty();
+    RawVector<int> indices32;
+    if (use_indices16)
+        indices32.assign(indices16.begin(), indices16.end());
+    const IArray<int> src_indices = use_indices16 ? IArray<int>(indices32) : IArray<int>(indices);
+
+    // triangle submeshes are simplified together so that shared vertices stay consistent. submesh index is the face group.
+    RawVector<int> tri_indices, face_groups;
+    const int num_submeshes = (int)submeshes.size();
+    for (int smi = 0; smi < num_submeshes; ++smi) {
+        const SubmeshData& sm = submeshes[smi];
+        if (sm.topology != Topology::Triangles)
+            continue;
+        tri_indices.insert(tri_indices.end(), src_indices.data() + sm.index_offset, src_indices.data() + sm.index_offset + sm.index_count);
+        face_groups.resize(tri_indices.size() / 3, smi);
+    }
 
-    int num_bones = (int)bones.size();
-    int num_vertices = (int)points.size();
-    weights4.resize_zeroclear(num_vertices);
+    mu::MeshSimplifier simplifier;
+    simplifier.points = points;
+    simplifier.target_ratio = ratio;
+    simplifier.target_error = target_error;
+    for (int level = 0; level < num_levels; ++level) {
+        simplifier.indices = tri_indices;
+        simplifier.face_groups = face_groups;
+        simplifier.simplify();
+        tri_indices.swap(simplifier.new_indices);
+        face_groups.swap(simplifier.new_face_groups);
+
+        std::shared_ptr<Mesh> lod = std::static_pointer_cast<Mesh>(clone(true));
+        lod->id = DerivedID(id, level);
+        lod->path = path + "_LOD" + std::to_string(level + 1);
+        lod->lods.clear();
+        // meshlets refer to the source triangles
+        lod->meshlets.clear();
+        lod->meshlet_vertices.clear();
+        lod->meshlet_triangles.clear();
+
+        // rebuild indices in submesh order
+        SharedVector<int> new_indices;
+        for (int smi = 0; smi < num_submeshes; ++smi) {
+            SubmeshData& sm = lod->submeshes[smi];
+            const int offset = (int)new_indices.size();
+            if (sm.topology == Topology::Triangles) {
+                for (size_t ti = 0; ti < face_groups.size(); ++ti) {
+                    if (face_groups[ti] == smi)
+                        new_indices.insert(new_indices.end(), tri_indices.cdata() + ti * 3, tri_indices.cdata() + ti * 3 + 3);
+                }
+            }
+            else {
+                new_indices.insert(new_indices.end(), src_indices.data() + sm.index_offset, src_indices.data() + sm.index_offset + sm.index_count);
+            }
+            sm.index_offset = offset;
+            sm.index_count = (int)new_indices.size() - offset;
+        }
+        lod->indices.swap(new_indices);
+
+        // drop unreferenced vertices
+        RawVector<char> used;
+        used.resize_zeroclear(points.size());
+        for (int i : lod->indices)
+            used[i] = 1;
+        RawVector<int> new2old;
+        for (int vi = 0; vi < (int)points.size(); ++vi) {
+            if (used[vi])
+                new2old.push_back(vi);
+        }
+        CompactVertices(*lod, new2old);
+        if (use_indices16) {
+            // vertices are only removed, so the level fits in 16 bit as the source does
+            lod->indices16.assign(lod->indices.begin(), lod->indices.end());
+            lod->indices.clear();
+        }
+        lod->updateBounds();
+        lod->setupDataFlags();
+        dst.push_back(lod);
+    }
+}
 
-    RawVector<mu::Weights1> tmp(num_bones);
-    for (int vi = 0; vi < num_vertices; ++vi) {
-        int num_influence = 0;
+bool Mesh::writeVertexBuffer(void *dst, size_t stride, const VertexAttributeLayout *layout, size_t num_attributes) const
+{
+    const size_t num_points = points.size();
+    RawVector<mu::VertexAttributeDesc> attrs;
+    attrs.resize_discard(num_attributes);
+    for (size_t i = 0; i < num_attributes; ++i) {
+        const VertexAttributeLayout& l = layout[i];
+        mu::VertexAttributeDesc& a = attrs[i];
+
+        auto set_source = [&](const auto& values, int dim) {
+            if (!values.empty() && values.size() != num_points)
+                return false;
+            a.src = values.empty() ? nullptr : (const float*)values.cdata();
+            a.src_dimension = dim;
+            return true;
+        };
+        bool ok = false;
+        switch (l.semantic) {
+        case VertexSemantic::Position: ok = set_source(points, 3); break;
+        case VertexSemantic::Normal: ok = set_source(normals, 3); break;
+        case VertexSemantic::Tangent: ok = set_source(tangents, 4); break;
+        case VertexSemantic::Color: ok = set_source(colors, 4); break;
+        case VertexSemantic::Velocity: ok = set_source(velocities, 3); break;
+        default: {
+            const int uv = (int)l.semantic - (int)VertexSemantic::UV0;
+            if (uv >= 0 && uv < (int)MeshSyncConstants::MAX_UV)
+                ok = set_source(m_uv[uv], 2);
+            break;
+        }
+        }
+        if (!ok) {
+            muLogWarning("Mesh::writeVertexBuffer(): invalid attribute (%d)\n", (int)l.semantic);
+            return false;
+        }
+        a.format = l.format;
+        a.dimension = l.dimension > 0 ? l.dimension : a.src_dimension;
+        a.offset = l.offset;
+    }
+    mu::Interleave(dst, stride, num_points, attrs.cdata(), attrs.size());
+    return true;
+}
+
+namespace {
+
+// vertex-major list of the positive bone influences.
+// influences of each vertex are in bone order if built from BoneData::weights, and in given order if built from sparse weights.
+struct BoneInfluences
+{
+    RawVector<int> counts;
+    RawVector<int> offsets;
+    RawVector<mu::Weights1> weights;
+
+    const mu::Weights1* get(int vi) const { return weights.cdata() + offsets[vi]; }
+};
+
+// transposes bone-major dense weights. vertices are processed in blocks and each block streams through the bones'
+// weights, so memory access stays sequential and blocks don't share any output.
+void BuildBoneInfluences(BoneInfluences& dst, const std::vector<BoneDataPtr>& bones, int num_vertices)
+{
+    const int block_size = 1024;
+    const int num_bones = (int)bones.size();
+    auto each_bone = [&](int begin, int end, const auto& body) {
         for (int bi = 0; bi < num_bones; ++bi) {
-            const auto& bone = *bones[bi];
-            float w = bone.weights[vi];
-            if (w > 0.0f) {
-                tmp[num_influence].index = bi;
-                tmp[num_influence].weight = bone.weights[vi];
-                ++num_influence;
+            const SharedVector<float>& weights = bones[bi]->weights;
+            const float *w = weights.cdata();
+            int e = std::min(end, (int)weights.size());
+            for (int vi = begin; vi < e; ++vi) {
+                if (w[vi] > 0.0f)
+                    body(bi, vi, w[vi]);
             }
         }
-        if (num_influence > 4) {
-            std::nth_element(&tmp[0], &tmp[4], &tmp[num_influence],
-                [&](auto& a, auto& b) { return a.weight > b.weight; });
+    };
+
+    dst.counts.resize_discard(num_vertices);
+    dst.offsets.resize_discard(num_vertices);
+    mu::parallel_for_blocked(0, num_vertices, block_size, [&](int begin, int end) {
+        std::fill(dst.counts.data() + begin, dst.counts.data() + end, 0);
+        each_bone(begin, end, [&](int, int vi, float) { ++dst.counts[vi]; });
+    });
+    int total = mu::parallel_exclusive_scan(dst.counts.cdata(), dst.offsets.data(), num_vertices);
+
+    dst.weights.resize_discard(total);
+    mu::parallel_for_blocked(0, num_vertices, block_size, [&](int begin, int end) {
+        RawVector<int> cursor(end - begin);
+        for (int vi = begin; vi < end; ++vi)
+            cursor[vi - begin] = dst.offsets[vi];
+        each_bone(begin, end, [&](int bi, int vi, float w) {
+            mu::Weights1& w1 = dst.weights[cursor[vi - begin]++];
+            w1.weight = w;
+            w1.index = bi;
+        });
+    });
+}
+
+void BuildBoneInfluences(BoneInfluences& dst, const SharedVector<uint8_t>& counts, const SharedVector<mu::Weights1>& weights)
+{
+    const int num_vertices = (int)counts.size();
+    RawVector<int> src_offsets(num_vertices);
+    dst.counts.resize_discard(num_vertices);
+    dst.offsets.resize_discard(num_vertices);
+
+    int num_src = 0;
+    for (int vi = 0; vi < num_vertices; ++vi) {
+        src_offsets[vi] = num_src;
+        num_src += counts[vi];
+    }
+    if (num_src > (int)weights.size()) {
+        muLogWarning("Mesh: sparse bone weights are shorter than sparse bone counts\n");
+        dst.counts.zeroclear();
+        dst.offsets.zeroclear();
+        dst.weights.clear();
+        return;
+    }
+
+    mu::parallel_for_blocked(0, num_vertices, 1024 * 4, [&](int begin, int end) {
+        for (int vi = begin; vi < end; ++vi) {
+            const mu::Weights1 *src = &weights[src_offsets[vi]];
+            int n = 0;
+            for (int i = 0; i < counts[vi]; ++i)
+                n += src[i].weight > 0.0f ? 1 : 0;
+            dst.counts[vi] = n;
+        }
+    });
+    int total = mu::parallel_exclusive_scan(dst.counts.cdata(), dst.offsets.data(), num_vertices);
+
+    dst.weights.resize_discard(total);
+    mu::parallel_for_blocked(0, num_vertices, 1024 * 4, [&](int begin, int end) {
+        for (int vi = begin; vi < end; ++vi) {
+            const mu::Weights1 *src = &weights[src_offsets[vi]];
+            mu::Weights1 *d = &dst.weights[dst.offsets[vi]];
+            for (int i = 0; i < counts[vi]; ++i) {
+                if (src[i].weight > 0.0f)
+                    *d++ = src[i];
+            }
         }
+    });
+}
 
-        int n = std::min(4, num_influence);
-        if (n == 0) {
-            // should do something?
+void GetBoneInfluences(const Mesh& mesh, BoneInfluences& dst)
+{
+    const int num_vertices = (int)mesh.points.size();
+    if (!mesh.sparse_bone_counts.empty()) {
+        if ((int)mesh.sparse_bone_counts.size() == num_vertices) {
+            BuildBoneInfluences(dst, mesh.sparse_bone_counts, mesh.sparse_bone_weights);
+            return;
         }
-        else {
+        muLogWarning("Mesh: sparse bone counts don't match the vertex count. ignored\n");
+    }
+    BuildBoneInfluences(dst, mesh.bones, num_vertices);
+}
+
+} // namespace
+
+void Mesh::setupBoneWeights4()
+{
+    if (bones.empty())
+        return;
+
+    const int num_vertices = (int)points.size();
+    BoneInfluences influences;
+    GetBoneInfluences(*this, influences);
+
+    weights4.resize_zeroclear(num_vertices);
+    mu::parallel_for_blocked(0, num_vertices, 1024 * 4, [&](int begin, int end) {
+        RawVector<mu::Weights1> tmp;
+        for (int vi = begin; vi < end; ++vi) {
+            const int num_influence = influences.counts[vi];
+            if (num_influence == 0) {
+                // should do something?
+                continue;
+            }
+
+            tmp.assign(influences.get(vi), influences.get(vi) + num_influence);
+            if (num_influence > 4) {
+                std::nth_element(&tmp[0], &tmp[4], &tmp[num_influence],
+                    [&](auto& a, auto& b) { return a.weight > b.weight; });
+            }
+
+            const int n = std::min(4, num_influence);
             auto& w4 = weights4[vi];
             for (int bi = 0; bi < n; ++bi) {
                 w4.indices[bi] = tmp[bi].index;
@@ -1244,7 +1999,7 @@ void Mesh::setupBoneWeights4()
             }
             w4.normalize();
         }
-    }
+    });
 }
 
 void Mesh::setupBoneWeightsVariable()
@@ -1252,55 +2007,49 @@ void Mesh::setupBoneWeightsVariable()
     if (bones.empty())
         return;
 
-    int num_bones = (int)bones.size();
-    int num_vertices = (int)points.size();
-    bone_offsets.resize_discard(num_vertices);
-    bone_counts.resize_discard(num_vertices);
+    const int num_vertices = (int)points.size();
+    BoneInfluences influences;
+    GetBoneInfluences(*this, influences);
 
     // count bone influence and offset
-    int offset = 0;
-    for (int vi = 0; vi < num_vertices; ++vi) {
-        int num_influence = 0;
-        for (int bi = 0; bi < num_bones; ++bi) {
-            float weight = bones[bi]->weights[vi];
-            if (weight > 0.0f) {
-                if (++num_influence == 255)
-                    break;
+    bone_counts.resize_discard(num_vertices);
+    bone_offsets.resize_discard(num_vertices);
+    mu::parallel_for_blocked(0, num_vertices, 1024 * 16, [&](int begin, int end) {
+        for (int vi = begin; vi < end; ++vi)
+            bone_counts[vi] = (uint8_t)std::min(influences.counts[vi], 255);
+    });
+    int total = mu::parallel_scan(0, num_vertices, 1024 * 16, 0,
+        [&](int begin, int end, int acc) {
+            for (int vi = begin; vi < end; ++vi)
+                acc += bone_counts[vi];
+            return acc;
+        },
+        [&](int begin, int end, int acc) {
+            for (int vi = begin; vi < end; ++vi) {
+                bone_offsets[vi] = acc;
+                acc += bone_counts[vi];
             }
-        }
-        bone_offsets[vi] = offset;
-        bone_counts[vi] = (uint8_t)num_influence;
-        offset += num_influence;
-    }
-    weights1.resize_zeroclear(offset);
+        },
+        std::plus<int>());
+    weights1.resize_zeroclear(total);
 
     // calculate bone weights
-    offset = 0;
-    for (int vi = 0; vi < num_vertices; ++vi) {
-        auto *dst = &weights1[offset];
-        int num_influence = 0;
-        for (int bi = 0; bi < num_bones; ++bi) {
-            float weight = bones[bi]->weights[vi];
-            if (weight > 0.0f) {
-                auto& w1 = dst[num_influence];
-                w1.weight = weight;
-                w1.index = bi;
-                if (++num_influence == 255)
-                    break;
+    mu::parallel_for_blocked(0, num_vertices, 1024 * 4, [&](int begin, int end) {
+        for (int vi = begin; vi < end; ++vi) {
+            const int num_influence = bone_counts[vi];
+            if (num_influence == 0) {
+                // should do something?
+                continue;
             }
-        }
-        offset += num_influence;
 
-        if (num_influence == 0) {
-            // should do something?
-        }
-        else {
+            auto *dst = &weights1[bone_offsets[vi]];
+            memcpy(dst, influences.get(vi), sizeof(mu::Weights1) * num_influence);
             dst->normalize(num_influence);
             // Unity requires descending order of weights
             std::sort(dst, dst + num_influence,
                 [&](auto& a, auto& b) { return a.weight > b.weight; });
         }
-    }
+    });
 }
 
 bool Mesh::submeshesHaveUniqueMaterial() const
@@ -0,0 +1,167 @@
+#include "pch.h"
+#include "MeshSync/SceneGraph/msMeshRefineCache.h"
+#include "MeshSync/SceneGraph/msMesh.h"
+
+namespace ms {
+
+bool MeshRefineCache::Key::operator<(const Key& v) const
+{
+    return std::tie(geometry, settings, num_points, num_indices) <
+        std::tie(v.geometry, v.settings, v.num_points, v.num_indices);
+}
+
+void MeshRefineCache::setSettings(const MeshRefineCacheSettings& v)
+{
+    lock_t lock(m_mutex);
+    m_settings = v;
+    if (m_settings.eviction == MeshRefineCacheEviction::Disabled)
+        evictImpl(0, 0);
+    else
+        evictImpl((uint64_t)m_settings.max_memory_mb << 20, m_settings.max_records);
+}
+
+const MeshRefineCacheSettings& MeshRefineCache::getSettings() const
+{
+    return m_settings;
+}
+
+void MeshRefineCache::refine(Mesh& mesh)
+{
+    MeshRefineCacheSettings settings;
+    {
+        lock_t lock(m_mutex);
+        settings = m_settings;
+    }
+    if (settings.eviction == MeshRefineCacheEviction::Disabled || mesh.cache_flags.constant || mesh.points.empty()) {
+        mesh.refine();
+        return;
+    }
+
+    // refine() also depends on whether material ids are face groups
+    Key key;
+    key.geometry = mesh.hashGeom();
+    key.settings = mesh.refine_settings.checksum() * 2 + (mesh.md_flags.Get(MESH_DATA_FLAG_HAS_FACE_GROUPS) ? 1 : 0);
+    key.num_points = mesh.points.size();
+    key.num_indices = mesh.indices.size() + mesh.indices16.size();
+
+    // records are never modified once stored. comparing with and copying from them doesn't need the lock.
+    MeshPtr refined, source;
+    {
+        lock_t lock(m_mutex);
+        auto it = m_table.find(key);
+        if (it != m_table.end()) {
+            refined = it->second->refined;
+            source = it->second->source;
+        }
+    }
+    // the hash only narrows down the candidate. the source arrays decide.
+    const bool hit = refined && source->equalGeometry(mesh);
+    {
+        lock_t lock(m_mutex);
+        if (hit) {
+            auto it = m_table.find(key);
+            if (settings.eviction == MeshRefineCacheEviction::LeastRecentlyUsed && it != m_table.end() && it->second->refined == refined)
+                m_records.splice(m_records.end(), m_records, it->second);
+            ++m_stats.hits;
+        }
+        else {
+            ++m_stats.misses;
+        }
+    }
+    if (hit) {
+        mesh.copyGeometry(*refined);
+        return;
+    }
+
+    // the tables are taken out while refining so that they are never shared between threads
+    MeshRefineTablesPtr tables;
+    {
+        lock_t lock(m_mutex);
+        auto it = m_topologies.find(mesh.path);
+        if (it != m_topologies.end()) {
+            tables = it->second->tables;
+            eraseImpl(it->second);
+        }
+    }
+    if (!tables)
+        tables = std::make_shared<MeshRefineTables>();
+    // refine() works in place. keep the source to compare with on hits.
+    source = Mesh::create();
+    source->copyGeometry(mesh);
+    const int reuse_count = tables->reuse_count;
+    mesh.refine(tables.get());
+    const bool reused = tables->reuse_count != reuse_count;
+
+    const uint64_t memory_budget = (uint64_t)settings.max_memory_mb << 20;
+    const uint64_t tables_size = tables->new2old_points.empty() ? 0 : tables->size();
+    if (tables_size > 0) {
+        lock_t lock(m_mutex);
+        if (reused)
+            ++m_stats.topology_hits;
+        else
+            ++m_stats.topology_misses;
+        if (tables_size <= memory_budget && settings.max_records > 0 && m_topologies.find(mesh.path) == m_topologies.end()) {
+            evictImpl(memory_budget - tables_size, settings.max_records - 1);
+            m_records.push_back({ {}, nullptr, nullptr, mesh.path, tables, tables_size });
+            m_topologies[mesh.path] = std::prev(m_records.end());
+            m_stats.memory_usage += tables_size;
+            m_stats.num_records = (uint32_t)m_records.size();
+        }
+    }
+
+    // deforming meshes change every frame. their results would only push out useful records.
+    if (reused)
+        return;
+
+    const uint64_t size = mesh.geometrySize() + source->geometrySize();
+    if (size > memory_budget || settings.max_records == 0)
+        return;
+
+    MeshPtr record = Mesh::create();
+    record->copyGeometry(mesh);
+
+    lock_t lock(m_mutex);
+    if (m_table.find(key) != m_table.end())
+        return; // stored by another thread meanwhile
+    evictImpl(memory_budget - size, settings.max_records - 1);
+    m_records.push_back({ key, record, source, {}, nullptr, size });
+    m_table[key] = std::prev(m_records.end());
+    m_stats.memory_usage += size;
+    m_stats.num_records = (uint32_t)m_records.size();
+}
+
+void MeshRefineCache::clear()
+{
+    lock_t lock(m_mutex);
+    m_records.clear();
+    m_table.clear();
+    m_topologies.clear();
+    m_stats = {};
+}
+
+MeshRefineCacheStats MeshRefineCache::getStats() const
+{
+    lock_t lock(m_mutex);
+    return m_stats;
+}
+
+void MeshRefineCache::evictImpl(uint64_t memory_budget, size_t max_records)
+{
+    while (!m_records.empty() && (m_stats.memory_usage > memory_budget || m_records.size() > max_records)) {
+        ++m_stats.evictions;
+        eraseImpl(m_records.begin());
+    }
+}
+
+void MeshRefineCache::eraseImpl(Records::iterator it)
+{
+    if (it->tables)
+        m_topologies.erase(it->path);
+    else
+        m_table.erase(it->key);
+    m_stats.memory_usage -= it->size;
+    m_records.erase(it);
+    m_stats.num_records = (uint32_t)m_records.size();
+}
+
+} // namespace ms
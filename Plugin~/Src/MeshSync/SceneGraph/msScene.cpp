@@ -10,6 +10,7 @@
 #include "MeshSync/SceneGraph/msConstraints.h"
 #include "MeshSync/SceneGraph/msMaterial.h"
 #include "MeshSync/SceneGraph/msMesh.h"
+#include "MeshSync/SceneGraph/msMeshRefineCache.h"
 #include "MeshSync/SceneGraph/msPoints.h"
 #include "MeshSync/SceneGraph/msLight.h"
 #include "MeshSync/SceneGraph/msTexture.h"
@@ -208,11 +209,20 @@ void Scene::clear()
 
 uint64_t Scene::hash() const
 {
+    // asset hashes may sum up whole texture / file data, so they are split finer than entities
     uint64_t ret = 0;
-    for (auto& a : assets)
-        ret += a->hash();
-    for (auto& e : entities)
-        ret += e->hash();
+    ret += mu::parallel_reduce(0, (int)assets.size(), 1, uint64_t(0),
+        [this](int begin, int end, uint64_t acc) {
+            for (int i = begin; i < end; ++i)
+                acc += assets[i]->hash();
+            return acc;
+        }, std::plus<uint64_t>());
+    ret += mu::parallel_reduce(0, (int)entities.size(), 64, uint64_t(0),
+        [this](int begin, int end, uint64_t acc) {
+            for (int i = begin; i < end; ++i)
+                acc += entities[i]->hash();
+            return acc;
+        }, std::plus<uint64_t>());
     for (auto& i : instanceInfos)
         ret += i->hash();
     for (auto& i : instanceMeshes)
@@ -284,13 +294,16 @@ std::vector<EntityConverterPtr> Scene::getConverters(const SceneImportSettings&
     return converters;
 }
 
-void Scene::import(const SceneImportSettings& cv)
+void Scene::import(const SceneImportSettings& cv, MeshRefineCache *refine_cache)
 {
+    if (BitUtility::Get(&cv.flags, SCENE_IMPORT_FLAG_MERGE_MESHES))
+        mergeMeshes(cv.mesh_split_unit);
+
     // receive and convert assets
     std::vector<EntityConverterPtr> converters = getConverters(cv, settings, false);
 
-    updateEntities(cv, converters, entities);
-    updateEntities(cv, converters, instanceMeshes);
+    updateEntities(cv, converters, entities, refine_cache);
+    updateEntities(cv, converters, instanceMeshes, refine_cache);
 
     for (auto& asset : assets) {
         sanitizeObjectName(asset->name);
@@ -314,7 +327,8 @@ void Scene::import(const SceneImportSettings& cv)
 void Scene::updateEntities(
     const ms::SceneImportSettings& cv, 
     const std::vector<ms::EntityConverterPtr>& converters, 
-    std::vector<ms::TransformPtr> entities)
+    std::vector<ms::TransformPtr> entities,
+    MeshRefineCache *refine_cache)
 {
     mu::parallel_for_each(entities.begin(), entities.end(), [&](TransformPtr& obj) {
         sanitizeHierarchyPath(obj->path);
@@ -328,7 +342,12 @@ void Scene::updateEntities(
             mesh.refine_settings.flags.Set(MESH_REFINE_FLAG_SPLIT, true);
             mesh.refine_settings.split_unit = cv.mesh_split_unit;
             mesh.refine_settings.max_bone_influence = cv.mesh_max_bone_influence;
-            mesh.refine();
+            if (BitUtility::Get(&cv.flags, SCENE_IMPORT_FLAG_GEN_INDICES16))
+                mesh.refine_settings.flags.Set(MESH_REFINE_FLAG_GEN_INDICES16, true);
+            if (refine_cache)
+                refine_cache->refine(mesh);
+            else
+                mesh.refine();
         }
 
         if (!converters.empty()) {
@@ -337,6 +356,14 @@ void Scene::updateEntities(
             }
         }
 
+        // after the converters so that the levels are in the same space as the mesh
+        if (is_mesh && BitUtility::Get(&cv.flags, SCENE_IMPORT_FLAG_GENERATE_LODS)) {
+            Mesh& mesh = dynamic_cast<Mesh&>(*obj);
+            mesh.lods.clear();
+            if (!mesh.indices.empty() || !mesh.indices16.empty())
+                mesh.generateLODs(mesh.lods, cv.lod_levels, cv.lod_ratio);
+        }
+
         obj->updateBounds();
         });
 }
@@ -428,6 +455,152 @@ void Scene::flatternHierarchy()
     }
 }
 
+void Scene::mergeMeshes(uint32_t split_unit)
+{
+    struct BatchKey
+    {
+        std::vector<int> materials;
+        uint64_t refine_settings;
+        uint32_t visibility;
+        int layer;
+
+        bool operator<(const BatchKey& v) const
+        {
+            return std::tie(materials, refine_settings, visibility, layer) <
+                std::tie(v.materials, v.refine_settings, v.visibility, v.layer);
+        }
+    };
+
+    // transform dependent refine settings can't be applied to baked vertices
+    const int transform_dependent_flags[] = {
+        MESH_REFINE_FLAG_LOCAL2WORLD, MESH_REFINE_FLAG_WORLD2LOCAL,
+        MESH_REFINE_FLAG_MIRROR_X, MESH_REFINE_FLAG_MIRROR_Y, MESH_REFINE_FLAG_MIRROR_Z,
+    };
+    auto is_candidate = [&](const Mesh& mesh) {
+        if (mesh.points.empty() || mesh.points.size() > split_unit || mesh.counts.empty() || !mesh.indices16.empty())
+            return false;
+        if (!mesh.bones.empty() || !mesh.blendshapes.empty() || !mesh.reference.empty() || !mesh.batch_sources.empty())
+            return false;
+        if (mesh.md_flags.Get(MESH_DATA_FLAG_UNCHANGED))
+            return false;
+        if (mesh.visibility != VisibilityFlags::uninitialized() && (!mesh.visibility.active || !mesh.visibility.visible_in_render))
+            return false;
+        for (int f : transform_dependent_flags)
+            if (mesh.refine_settings.flags.Get(f))
+                return false;
+        // mirrored transforms flip the winding
+        const mu::float4x4& m = mesh.world_matrix;
+        return mu::dot(mu::cross((const mu::float3&)m[0], (const mu::float3&)m[1]), (const mu::float3&)m[2]) > 0.0f;
+    };
+
+    buildHierarchy();
+
+    auto has_all_parents = [](const Transform& t) {
+        std::string parent_path;
+        for (const Transform *e = &t; e; e = e->parent) {
+            e->getParentPath(parent_path);
+            if (!parent_path.empty() && !e->parent)
+                return false;
+        }
+        return true;
+    };
+
+    // group in path order so that the result is the same every frame for the same scene
+    std::vector<size_t> order(entities.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [this](size_t a, size_t b) { return entities[a]->path < entities[b]->path; });
+
+    std::map<BatchKey, std::vector<size_t>> groups;
+    for (size_t ei : order) {
+        if (entities[ei]->getType() != EntityType::Mesh)
+            continue;
+        Mesh& mesh = static_cast<Mesh&>(*entities[ei]);
+        if (!is_candidate(mesh) || !has_all_parents(mesh))
+            continue;
+
+        BatchKey key;
+        key.materials.assign(mesh.material_ids.begin(), mesh.material_ids.end());
+        std::sort(key.materials.begin(), key.materials.end());
+        key.materials.erase(std::unique(key.materials.begin(), key.materials.end()), key.materials.end());
+        key.refine_settings = mesh.refine_settings.checksum();
+        key.visibility = (uint32_t&)mesh.visibility;
+        key.layer = mesh.layer;
+        groups[key].push_back(ei);
+    }
+
+    // pack each group into batches of split_unit or less vertices
+    std::vector<std::vector<size_t>> batches;
+    for (auto& kvp : groups) {
+        std::vector<size_t> batch;
+        size_t num_points = 0;
+        for (size_t ei : kvp.second) {
+            size_t n = entities[ei]->vertexCount();
+            if (!batch.empty() && num_points + n > split_unit) {
+                batches.push_back(std::move(batch));
+                batch.clear();
+                num_points = 0;
+            }
+            batch.push_back(ei);
+            num_points += n;
+        }
+        batches.push_back(std::move(batch));
+    }
+    batches.erase(std::remove_if(batches.begin(), batches.end(), [](auto& b) { return b.size() < 2; }), batches.end());
+
+    // fallback for sources without ids. stable as long as the batches are, but only unique within this scene.
+    int id_base = 0;
+    for (auto& e : entities)
+        id_base = std::max(id_base, e->id + 1);
+
+    std::vector<TransformPtr> merged(batches.size());
+    mu::parallel_for(0, (int)batches.size(), 1, [&](int bi) {
+        auto& batch = batches[bi];
+        const Mesh& first = static_cast<const Mesh&>(*entities[batch.front()]);
+
+        std::shared_ptr<Mesh> dst = Mesh::create();
+        if (first.id != InvalidID && DerivedID(first.id, MaxDerivedIDs - 1) != InvalidID) {
+            dst->id = DerivedID(first.id, MaxDerivedIDs - 1);
+            dst->path = "/MeshBatch" + std::to_string(first.id);
+        }
+        else {
+            dst->id = id_base + bi;
+            dst->path = "/MeshBatch_" + std::to_string(bi);
+        }
+        dst->visibility = first.visibility;
+        dst->layer = first.layer;
+        dst->refine_settings = first.refine_settings;
+        dst->md_flags.Set(MESH_DATA_FLAG_HAS_FACE_GROUPS, first.md_flags.Get(MESH_DATA_FLAG_HAS_FACE_GROUPS));
+
+        // mergeMesh() clears batch sources of the destination. build them aside.
+        std::vector<std::string> sources;
+        RawVector<int> source_ids;
+        for (size_t ei : batch) {
+            const Mesh& src = static_cast<const Mesh&>(*entities[ei]);
+            std::shared_ptr<Mesh> tmp = std::static_pointer_cast<Mesh>(entities[ei]->clone(true));
+            tmp->transformMesh(src.world_matrix);
+            dst->mergeMesh(*tmp);
+            source_ids.resize(dst->points.size(), (int)sources.size());
+            sources.push_back(src.path);
+        }
+        dst->batch_sources = std::move(sources);
+        dst->batch_source_ids.assign(source_ids.begin(), source_ids.end());
+        dst->setupDataFlags();
+        dst->updateBounds();
+        merged[bi] = dst;
+    });
+
+    // the merged meshes stay as transforms
+    for (auto& batch : batches) {
+        for (size_t ei : batch) {
+            TransformPtr t = Transform::create();
+            static_cast<Transform&>(*t) = static_cast<const Transform&>(*entities[ei]);
+            t->setupDataFlags();
+            entities[ei] = t;
+        }
+    }
+    entities.insert(entities.end(), merged.begin(), merged.end());
+}
+
 bool Scene::submeshesHaveUniqueMaterial() const
 {
     std::atomic_bool ret{true};
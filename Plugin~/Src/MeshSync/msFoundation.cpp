@@ -0,0 +1,50 @@
+#include "pch.h"
+#include "MeshSync/msFoundation.h"
+
+namespace ms {
+
+namespace {
+
+struct PoolRegistry
+{
+    std::mutex mutex;
+    std::vector<IPool*> pools;
+};
+
+PoolRegistry& GetPoolRegistry()
+{
+    // constructed by the first pool, so it outlives all of them
+    static PoolRegistry s_registry;
+    return s_registry;
+}
+
+} // namespace
+
+void RegisterPool(IPool *pool)
+{
+    PoolRegistry& reg = GetPoolRegistry();
+    std::unique_lock<std::mutex> lock(reg.mutex);
+    reg.pools.push_back(pool);
+}
+
+void UnregisterPool(IPool *pool)
+{
+    PoolRegistry& reg = GetPoolRegistry();
+    std::unique_lock<std::mutex> lock(reg.mutex);
+    reg.pools.erase(std::remove(reg.pools.begin(), reg.pools.end(), pool), reg.pools.end());
+}
+
+void EachPool(const std::function<void(IPool&)>& body)
+{
+    PoolRegistry& reg = GetPoolRegistry();
+    std::unique_lock<std::mutex> lock(reg.mutex);
+    for (IPool *pool : reg.pools)
+        body(*pool);
+}
+
+void TrimAllPools()
+{
+    EachPool([](IPool& pool) { pool.trim(); });
+}
+
+} // namespace ms
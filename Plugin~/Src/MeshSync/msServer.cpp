@@ -22,11 +22,13 @@ using namespace Poco::Net;
 Server::Server(const ServerSettings& settings)
     : m_settings(settings)
 {
+    m_refine_cache.setSettings(m_settings.refine_cache);
 }
 
 Server::~Server()
 {
     stop();
+    // waits for pending import tasks before m_settings and m_refine_cache go away
     clear();
 }
 
@@ -62,6 +64,7 @@ void Server::clear()
 {
     lock_t lock(m_message_mutex);
     m_received_messages.clear();
+    m_processing_messages.clear();
     m_host_scene.reset();
 }
 
@@ -70,6 +73,11 @@ ServerSettings& Server::getSettings()
     return m_settings;
 }
 
+MeshRefineCache& Server::getRefineCache()
+{
+    return m_refine_cache;
+}
+
 int Server::getNumMessages() const
 {
     return (int)m_received_messages.size();
@@ -363,7 +371,7 @@ Server::MessageHolder* Server::queueMessage(MessagePtr mes)
     return &m_received_messages.back();
 }
 
-Server::MessageHolder* Server::queueMessage(MessagePtr mes, std::future<void>&& task)
+Server::MessageHolder* Server::queueMessage(MessagePtr mes, mu::TaskFuture<void>&& task)
 {
     if (!mes)
         return nullptr;
@@ -421,8 +429,10 @@ void Server::recvSet(HTTPServerRequest& request, HTTPServerResponse& response)
     if (!mes)
         return;
 
-    auto task = std::async(std::launch::async, [this, mes]() {
-        mes->scene->import(m_settings.import_settings);
+    // settings can be changed at any time via getSettings()
+    m_refine_cache.setSettings(m_settings.refine_cache);
+    auto task = mu::TaskScheduler::instance().submit([this, mes]() {
+        mes->scene->import(m_settings.import_settings, &m_refine_cache);
     });
     queueMessage(mes, std::move(task));
     serveText(response, "ok");
@@ -716,4 +726,12 @@ Server::MessageHolder::MessageHolder(MessageHolder && v)
     ready = v.ready.load();
 }
 
+Server::MessageHolder::~MessageHolder()
+{
+    if (task.valid()) {
+        task.cancel();
+        task.wait();
+    }
+}
+
 } // namespace ms
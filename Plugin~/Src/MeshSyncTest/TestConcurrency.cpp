@@ -0,0 +1,322 @@
+#include "pch.h"
+#include "Test.h"
+#include "Common.h"
+#include "MeshSync/msFoundation.h"
+
+using namespace mu;
+
+TestCase(TestParallelFor)
+{
+    const int N = 1000000;
+
+    RawVector<int> values(N);
+    values.zeroclear();
+    TestScope("parallel_for", [&]() {
+        parallel_for(0, N, [&](int i) { values[i] += i; });
+    });
+    bool ok = true;
+    for (int i = 0; i < N; ++i)
+        ok = ok && values[i] == i;
+    Expect(ok);
+
+    // nested loops must not deadlock and must visit every element once
+    std::atomic<int64_t> sum{ 0 };
+    parallel_for(0, 1000, 8, [&](int) {
+        parallel_for(0, 100, [&](int j) { sum += j; });
+    });
+    Expect(sum == 1000 * 4950);
+
+    int max_block = 0;
+    spin_mutex mutex;
+    parallel_for_blocked(0, N, 4096, [&](int begin, int end) {
+        spin_mutex::lock_t lock(mutex);
+        max_block = std::max(max_block, end - begin);
+    });
+    Expect(max_block <= 4096);
+
+    std::vector<int> elements(5000, 0);
+    parallel_for_each(elements.begin(), elements.end(), [](int& v) { v = 3; });
+    Expect(std::all_of(elements.begin(), elements.end(), [](int v) { return v == 3; }));
+
+    int a = 0, b = 0, c = 0;
+    parallel_invoke([&]() { a = 1; }, [&]() { b = 2; }, [&]() { c = 3; });
+    Expect(a == 1 && b == 2 && c == 3);
+
+    // an exception thrown by a body is rethrown by the call and the pool stays usable
+    auto throw_at = [&](int n) {
+        bool caught = false;
+        try {
+            parallel_for(0, n, 16, [&](int i) {
+                if (i == n / 2)
+                    throw std::runtime_error("test");
+            });
+        }
+        catch (std::runtime_error&) { caught = true; }
+        return caught;
+    };
+#ifdef muEnableThreadPool
+    int workers = ThreadPool::getWorkerCount();
+    ThreadPool::setWorkerCount(std::max(workers, 3));
+    Expect(throw_at(100000));
+    std::atomic<int> count{ 0 };
+    parallel_for(0, 100000, 16, [&](int) { ++count; });
+    Expect(count == 100000);
+    ThreadPool::setWorkerCount(workers);
+#endif
+    Expect(throw_at(100000));
+
+#ifdef muEnableThreadPool
+    Print("    workers: %d\n", ThreadPool::getWorkerCount());
+#endif
+}
+
+TestCase(TestTaskScheduler)
+{
+    TaskScheduler& scheduler = TaskScheduler::instance();
+
+    // results, priorities and continuations
+    {
+        std::vector<TaskFuture<int>> tasks;
+        for (int i = 0; i < 64; ++i)
+            tasks.push_back(scheduler.submit([i]() { return i * 2; }, i % 2 ? TaskPriority::Low : TaskPriority::High));
+        bool ok = true;
+        for (int i = 0; i < 64; ++i)
+            ok = ok && tasks[i].get() == i * 2;
+        Expect(ok);
+
+        TaskFuture<int> c = tasks[10].then([](TaskFuture<int> t) { return t.get() + 1; });
+        Expect(c.get() == 21);
+    }
+
+    // tasks that wait for other tasks must not deadlock even if there are more of them than workers
+    {
+        const int n = scheduler.getMaxConcurrency() * 4;
+        std::atomic<int> count{ 0 };
+        std::vector<TaskFuture<void>> outer;
+        for (int i = 0; i < n; ++i) {
+            outer.push_back(scheduler.submit([&]() {
+                TaskFuture<void> inner = TaskScheduler::instance().submit([&]() { ++count; });
+                inner.wait();
+                ++count;
+            }));
+        }
+        for (auto& t : outer)
+            t.wait();
+        Expect(count == n * 2);
+    }
+
+    // exceptions are delivered to get()
+    {
+        TaskFuture<int> t = scheduler.submit([]() -> int { throw std::runtime_error("test"); });
+        bool caught = false;
+        try { t.get(); }
+        catch (std::runtime_error&) { caught = true; }
+        Expect(caught);
+    }
+
+    // canceling a blocked continuation keeps it from running
+    {
+        std::atomic<bool> go{ false }, ran{ false };
+        TaskFuture<void> a = scheduler.submit([&]() { while (!go) std::this_thread::yield(); });
+        TaskFuture<void> b = a.then([&](TaskFuture<void>) { ran = true; });
+        Expect(b.cancel());
+        go = true;
+        a.wait();
+        b.wait();
+        Expect(b.isCanceled() && !ran);
+    }
+
+    // workers that exit when the concurrency shrinks are joined, so shrinking and growing doesn't pile up threads
+    {
+        for (int cycle = 0; cycle < 30; ++cycle) {
+            scheduler.setMaxConcurrency(4);
+            std::atomic<int> started{ 0 };
+            std::atomic<bool> go{ false };
+            std::vector<TaskFuture<void>> tasks;
+            for (int i = 0; i < 4; ++i) {
+                tasks.push_back(scheduler.submit([&]() { ++started; while (!go) std::this_thread::yield(); }));
+                // all workers are busy when the next task is submitted, so each cycle really spawns threads
+                auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+                while (started <= i && std::chrono::steady_clock::now() < deadline)
+                    std::this_thread::yield();
+            }
+            go = true;
+            for (auto& t : tasks)
+                t.wait();
+            scheduler.setMaxConcurrency(1);
+            // give the excess workers time to exit
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        Expect(scheduler.getNumThreads() <= 8);
+        scheduler.setMaxConcurrency(0);
+    }
+    Print("    max concurrency: %d\n", scheduler.getMaxConcurrency());
+}
+
+TestCase(TestParallelReduceScan)
+{
+    const int N = 1000003;
+
+    RawVector<int> src(N);
+    for (int i = 0; i < N; ++i)
+        src[i] = (i * 7) % 13;
+
+    // reduce
+    {
+        int64_t expected = 0;
+        for (int v : src)
+            expected += v;
+        int64_t sum = parallel_reduce(0, N, 4096, int64_t(0),
+            [&](int begin, int end, int64_t acc) {
+                for (int i = begin; i < end; ++i)
+                    acc += src[i];
+                return acc;
+            }, std::plus<int64_t>());
+        Expect(sum == expected);
+        Expect(parallel_reduce(0, 0, 16, 5, [](int, int, int a) { return a; }, std::plus<int>()) == 5);
+    }
+
+    // inclusive / exclusive / in-place scan
+    {
+        RawVector<int> inclusive(N), exclusive(N), in_place;
+        int total_i = parallel_inclusive_scan(src.cdata(), inclusive.data(), N);
+        int total_e = parallel_exclusive_scan(src.cdata(), exclusive.data(), N);
+        in_place = src;
+        parallel_exclusive_scan(in_place.cdata(), in_place.data(), N);
+
+        bool ok = true;
+        int acc = 0;
+        for (int i = 0; i < N; ++i) {
+            ok = ok && exclusive[i] == acc && in_place[i] == acc;
+            acc += src[i];
+            ok = ok && inclusive[i] == acc;
+        }
+        Expect(ok);
+        Expect(total_i == acc && total_e == acc);
+    }
+
+    // in-place scans that fit in one chunk must return the total of the input, not of the output
+    {
+        int ex[] = { 1, 1, 1, 1 };
+        int in[] = { 1, 1, 1, 1 };
+        int total_e = parallel_exclusive_scan(ex, ex, 4);
+        int total_i = parallel_inclusive_scan(in, in, 4);
+        Expect(total_e == 4 && ex[0] == 0 && ex[3] == 3);
+        Expect(total_i == 4 && in[0] == 1 && in[3] == 4);
+    }
+
+    // chunked MinMax must match the single threaded kernel
+    {
+        RawVector<float3> points(N);
+        for (int i = 0; i < N; ++i)
+            points[i] = { std::sin((float)i), std::cos((float)i * 0.5f), (float)(i % 1000) - 500.0f };
+        float3 bmin, bmax, gmin, gmax;
+        MinMax(points.cdata(), points.size(), bmin, bmax);
+        MinMax_Generic(points.cdata(), points.size(), gmin, gmax);
+        Expect(bmin == gmin && bmax == gmax);
+    }
+
+#ifdef muEnableThreadPool
+    // floating point reduction results must not depend on the number of threads
+    {
+        auto reduce = [&]() {
+            return parallel_reduce(0, N, 1000, 0.0f,
+                [&](int begin, int end, float acc) {
+                    for (int i = begin; i < end; ++i)
+                        acc += 1.0f / (float)(src[i] + 1);
+                    return acc;
+                }, std::plus<float>());
+        };
+        const int workers = ThreadPool::getWorkerCount();
+        float r1 = reduce();
+        ThreadPool::setWorkerCount(3);
+        float r2 = reduce();
+        ThreadPool::setWorkerCount(workers);
+        Expect(r1 == r2);
+    }
+#endif
+}
+
+
+using ms::Pool;
+using ms::make_shared_ptr;
+
+namespace {
+
+class PoolTestObject
+{
+public:
+    msDefinePool(PoolTestObject);
+    void clear() { value = 0; }
+    int value = 0;
+
+private:
+    PoolTestObject() {}
+    ~PoolTestObject() {}
+};
+
+} // namespace
+
+TestCase(TestPool)
+{
+    Pool<PoolTestObject>& pool = Pool<PoolTestObject>::instance();
+    pool.release();
+
+    // many threads creating and releasing objects at the same time
+    {
+        const int num_threads = 8;
+        const int num_objects = 2000;
+        std::vector<std::thread> threads;
+        std::atomic<int> errors{ 0 };
+        for (int ti = 0; ti < num_threads; ++ti) {
+            threads.emplace_back([&, ti]() {
+                std::vector<PoolTestObject*> objs;
+                for (int r = 0; r < 10; ++r) {
+                    for (int i = 0; i < num_objects; ++i) {
+                        PoolTestObject *o = PoolTestObject::create_raw();
+                        if (o->value != 0)
+                            ++errors;
+                        o->value = ti + 1;
+                        objs.push_back(o);
+                    }
+                    for (PoolTestObject *o : objs) {
+                        if (o->value != ti + 1)
+                            ++errors;
+                        o->release();
+                    }
+                    objs.clear();
+                }
+            });
+        }
+        for (auto& t : threads)
+            t.join();
+        Expect(errors == 0);
+
+        ms::PoolStats stats = pool.getStats();
+        Expect(stats.live == 0);
+        Expect(stats.peak >= num_objects && stats.peak <= num_objects * num_threads);
+        Print("    live: %d cached: %d peak: %d\n", (int)stats.live, (int)stats.cached, (int)stats.peak);
+    }
+
+    // live objects are counted while they are in use
+    {
+        std::shared_ptr<PoolTestObject> a = PoolTestObject::create();
+        std::shared_ptr<PoolTestObject> b = PoolTestObject::create();
+        Expect(pool.getStats().live == 2);
+    }
+    Expect(pool.getStats().live == 0);
+
+    // trimming to a high-water mark
+    {
+        const size_t hwm = pool.getHighWaterMark();
+        pool.setHighWaterMark(0);
+        ms::PoolStats stats = pool.getStats();
+        // only the calling thread's small cache can remain
+        Expect(stats.cached <= Pool<PoolTestObject>::MagazineSize * 2);
+        pool.setHighWaterMark(hwm);
+    }
+
+    int num_pools = 0;
+    ms::EachPool([&](ms::IPool&) { ++num_pools; });
+    Expect(num_pools >= 1);
+}
@@ -7,6 +7,7 @@
 #include "MeshSync/SceneGraph/msAnimation.h"
 #include "MeshSync/SceneGraph/msMaterial.h"
 #include "MeshSync/SceneGraph/msMesh.h"
+#include "MeshSync/SceneGraph/msMeshRefineCache.h"
 #include "MeshSync/SceneGraph/msCurve.h"
 #include "MeshSync/SceneGraph/msPoints.h"
 #include "MeshSync/SceneGraph/msScene.h"
@@ -351,6 +352,383 @@ TestCase(Test_MeshMerge)
     TestUtility::Send(scene);
 }
 
+TestCase(Test_SparseBoneWeights)
+{
+    const int num_vertices = 4096;
+    const int num_bones = 64;
+
+    // same influences as dense per-bone weights and as sparse vertex-major weights
+    std::shared_ptr<ms::Mesh> dense = ms::Mesh::create();
+    std::shared_ptr<ms::Mesh> sparse = ms::Mesh::create();
+    dense->points.resize_zeroclear(num_vertices);
+    sparse->points.resize_zeroclear(num_vertices);
+    for (int bi = 0; bi < num_bones; ++bi) {
+        dense->addBone("/Bone" + std::to_string(bi))->weights.resize_zeroclear(num_vertices);
+        sparse->addBone("/Bone" + std::to_string(bi));
+    }
+    sparse->sparse_bone_counts.resize_discard(num_vertices);
+    for (int vi = 0; vi < num_vertices; ++vi) {
+        int n = vi % 9;
+        for (int i = 0; i < n; ++i) {
+            int bi = (vi * 7 + i * 13) % num_bones;
+            float w = (float)(i + 1) / (float)(n + 1);
+            dense->bones[bi]->weights[vi] = w;
+            sparse->sparse_bone_weights.push_back({ w, bi });
+        }
+        sparse->sparse_bone_counts[vi] = (uint8_t)n;
+    }
+
+    dense->setupBoneWeightsVariable();
+    sparse->setupBoneWeightsVariable();
+    Expect(dense->bone_counts == sparse->bone_counts);
+    size_t num_influences = 0;
+    for (uint8_t c : sparse->bone_counts)
+        num_influences += c;
+    Expect(sparse->weights1.size() == num_influences);
+    Expect(dense->weights1.size() == sparse->weights1.size());
+    bool ok = true;
+    for (size_t i = 0; i < dense->weights1.size(); ++i)
+        ok = ok && dense->weights1[i].index == sparse->weights1[i].index && near_equal(dense->weights1[i].weight, sparse->weights1[i].weight);
+    Expect(ok);
+
+    dense->setupBoneWeights4();
+    sparse->setupBoneWeights4();
+    // the order of the 4 influences depends on the input order, so compare them as sets
+    ok = true;
+    for (int vi = 0; vi < num_vertices; ++vi) {
+        const mu::Weights4& d = dense->weights4[vi];
+        const mu::Weights4& s = sparse->weights4[vi];
+        for (int i = 0; i < 4; ++i) {
+            if (d.weights[i] == 0.0f)
+                continue;
+            bool found = false;
+            for (int j = 0; j < 4; ++j)
+                found = found || (d.indices[i] == s.indices[j] && near_equal(d.weights[i], s.weights[j]));
+            ok = ok && found;
+        }
+    }
+    Expect(ok);
+}
+
+TestCase(Test_GenerateLODs)
+{
+    std::shared_ptr<ms::Mesh> mesh = ms::Mesh::create();
+    mesh->path = "/Test/LOD";
+    SharedVector<mu::float2> uv;
+    MeshGenerator::GenerateIcoSphereMesh(mesh->counts, mesh->indices, mesh->points, uv, 1.0f, 4);
+
+    // per-index uv with a seam between the upper and lower halves. bone weights from the height.
+    const int num_points = (int)mesh->points.size();
+    mesh->m_uv[0].resize_discard(mesh->indices.size());
+    for (size_t fi = 0; fi < mesh->indices.size() / 3; ++fi) {
+        const int *tri = &mesh->indices[fi * 3];
+        float z = mesh->points[tri[0]].z + mesh->points[tri[1]].z + mesh->points[tri[2]].z;
+        for (int i = 0; i < 3; ++i) {
+            const mu::float3& p = mesh->points[tri[i]];
+            mesh->m_uv[0][fi * 3 + i] = { p.x * 0.5f + (z < 0.0f ? 1.0f : 0.0f), p.y * 0.5f };
+        }
+    }
+    ms::BoneDataPtr bones[2] = { mesh->addBone("/Test/Bone0"), mesh->addBone("/Test/Bone1") };
+    for (auto& b : bones)
+        b->weights.resize_discard(num_points);
+    for (int vi = 0; vi < num_points; ++vi) {
+        float w = mesh->points[vi].z * 0.5f + 0.5f;
+        bones[0]->weights[vi] = w;
+        bones[1]->weights[vi] = 1.0f - w;
+    }
+    mesh->setupBoneWeights4();
+
+    mesh->refine_settings.flags.Set(ms::MESH_REFINE_FLAG_NO_REINDEXING, false);
+    mesh->refine_settings.flags.Set(ms::MESH_REFINE_FLAG_GEN_NORMALS, true);
+    mesh->refine();
+
+    std::vector<std::shared_ptr<ms::Mesh>> lods;
+    TestScope("Mesh::generateLODs", [&]() { mesh->generateLODs(lods, 3, 0.5f); });
+    Expect(lods.size() == 3);
+
+    size_t prev = mesh->indices.size();
+    bool ok = true;
+    for (auto& lod : lods) {
+        Print("    %s: %d triangles, %d vertices\n", lod->path.c_str(), (int)lod->indices.size() / 3, (int)lod->points.size());
+        ok = ok && lod->indices.size() < prev && lod->indices.size() > prev / 4;
+        ok = ok && lod->normals.size() == lod->points.size() && lod->m_uv[0].size() == lod->points.size();
+        ok = ok && lod->weights4.size() == lod->points.size();
+        ok = ok && lod->submeshes.size() == mesh->submeshes.size() && lod->submeshes[0].index_count == (int)lod->indices.size();
+        for (int i : lod->indices)
+            ok = ok && i >= 0 && i < (int)lod->points.size();
+        // vertices are kept as is, so every lod vertex is one of the source vertices with its attributes
+        for (size_t vi = 0; vi < lod->points.size(); ++vi)
+            ok = ok && near_equal(lod->weights4[vi].weights[0] + lod->weights4[vi].weights[1], 1.0f);
+        prev = lod->indices.size();
+    }
+    Expect(ok);
+
+    // every level has its own id
+    mesh->id = 10;
+    lods.clear();
+    mesh->generateLODs(lods, 3, 0.5f);
+    std::vector<int> ids{ mesh->id };
+    for (auto& lod : lods)
+        ids.push_back(lod->id);
+    std::sort(ids.begin(), ids.end());
+    Expect(std::unique(ids.begin(), ids.end()) == ids.end() && std::count(ids.begin(), ids.end(), ms::InvalidID) == 0);
+
+    // import generates the levels into Mesh::lods
+    {
+        std::shared_ptr<ms::Mesh> src = ms::Mesh::create();
+        src->path = "/Test/LODImport";
+        src->id = 11;
+        MeshGenerator::GenerateIcoSphereMesh(src->counts, src->indices, src->points, uv, 1.0f, 3);
+        src->refine_settings.flags.Set(ms::MESH_REFINE_FLAG_NO_REINDEXING, false);
+        src->setupDataFlags();
+
+        ms::ScenePtr scene = ms::Scene::create();
+        scene->entities.push_back(src);
+        ms::SceneImportSettings settings;
+        ms::BitUtility::Set(&settings.flags, ms::SCENE_IMPORT_FLAG_GENERATE_LODS, true);
+        settings.lod_levels = 2;
+        scene->import(settings);
+        Expect(src->lods.size() == 2);
+        for (auto& lod : src->lods)
+            Expect(lod->id != src->id && lod->lods.empty());
+    }
+}
+
+TestCase(Test_ImportIndices16)
+{
+    // 16 bit indices are opt-in. the default import keeps 32 bit indices for receivers that only read those.
+    for (int gen16 = 0; gen16 < 2; ++gen16) {
+        std::shared_ptr<ms::Mesh> mesh = ms::Mesh::create();
+        mesh->path = "/Test/Indices16";
+        SharedVector<mu::float2> uv;
+        MeshGenerator::GenerateIcoSphereMesh(mesh->counts, mesh->indices, mesh->points, uv, 1.0f, 2);
+        mesh->refine_settings.flags.Set(ms::MESH_REFINE_FLAG_NO_REINDEXING, false);
+        mesh->setupDataFlags();
+
+        ms::ScenePtr scene = ms::Scene::create();
+        scene->entities.push_back(mesh);
+        ms::SceneImportSettings settings;
+        ms::BitUtility::Set(&settings.flags, ms::SCENE_IMPORT_FLAG_GEN_INDICES16, gen16 != 0);
+        scene->import(settings);
+        Expect(mesh->indices.empty() == (gen16 != 0) && mesh->indices16.empty() == (gen16 == 0));
+    }
+}
+
+TestCase(Test_MergeMeshes)
+{
+    std::shared_ptr<ms::Scene> scene = ms::Scene::create();
+    std::shared_ptr<ms::Transform> root = ms::Transform::create();
+    root->path = "/Root";
+    root->position = { 0.0f, 2.0f, 0.0f };
+    root->rotation = quatf::identity();
+    root->scale = { 2.0f, 2.0f, 2.0f };
+    scene->entities.push_back(root);
+
+    // 4 spheres with the same material, 1 with another material, 1 too large to be merged
+    auto add_sphere = [&](const char *name, float x, int material, int iterations) {
+        std::shared_ptr<ms::Mesh> mesh = ms::Mesh::create();
+        mesh->path = std::string("/Root/") + name;
+        mesh->position = { x, 0.0f, 0.0f };
+        mesh->rotation = quatf::identity();
+        mesh->scale = { 1.0f, 1.0f, 1.0f };
+        MeshGenerator::GenerateIcoSphereMesh(mesh->counts, mesh->indices, mesh->points, mesh->m_uv[0], 0.5f, iterations);
+        mesh->material_ids.resize(mesh->counts.size(), material);
+        mesh->setupDataFlags();
+        scene->entities.push_back(mesh);
+        return mesh;
+    };
+    for (int i = 0; i < 4; ++i)
+        add_sphere(("Sphere" + std::to_string(i)).c_str(), (float)i, 0, 1);
+    add_sphere("Other", 5.0f, 1, 1);
+    std::shared_ptr<ms::Mesh> large = add_sphere("Large", 6.0f, 0, 4);
+    const size_t points_per_sphere = static_cast<ms::Mesh&>(*scene->entities[1]).points.size();
+    const size_t num_entities = scene->entities.size();
+
+    TestScope("Scene::mergeMeshes", [&]() { scene->mergeMeshes((uint32_t)(points_per_sphere * 4)); });
+
+    // 4 spheres are merged into one mesh. the others are left as is.
+    Expect(scene->entities.size() == num_entities + 1);
+    std::shared_ptr<ms::Mesh> merged = std::static_pointer_cast<ms::Mesh>(scene->entities.back());
+    Expect(merged->getType() == ms::EntityType::Mesh);
+    Expect(merged->batch_sources.size() == 4 && merged->batch_sources[0] == "/Root/Sphere0");
+    Expect(merged->points.size() == points_per_sphere * 4);
+    Expect(merged->batch_source_ids.size() == merged->points.size());
+    Expect(merged->md_flags.Get(ms::MESH_DATA_FLAG_HAS_BATCH_SOURCES));
+    for (int i = 1; i <= 4; ++i)
+        Expect(scene->entities[i]->getType() == ms::EntityType::Transform && scene->entities[i]->path == "/Root/Sphere" + std::to_string(i - 1));
+    Expect(scene->entities[5]->getType() == ms::EntityType::Mesh);
+    Expect(scene->entities[6] == large);
+
+    // world transforms are baked: Sphere3 is centered at (root.position + 3 * root.scale.x)
+    bool ok = true;
+    mu::float3 center = mu::float3::zero();
+    int count = 0;
+    for (size_t vi = 0; vi < merged->points.size(); ++vi) {
+        ok = ok && merged->batch_source_ids[vi] == (int)(vi / points_per_sphere);
+        if (merged->batch_source_ids[vi] == 3) {
+            center += merged->points[vi];
+            ++count;
+        }
+    }
+    center /= (float)count;
+    Expect(ok);
+    Expect(near_equal(center, mu::float3{ 6.0f, 2.0f, 0.0f }));
+
+    // serialization
+    std::stringstream ss;
+    merged->serialize(ss);
+    std::shared_ptr<ms::Mesh> restored = std::static_pointer_cast<ms::Mesh>(ms::Entity::create(ss));
+    Expect(restored->batch_sources == merged->batch_sources);
+    Expect(restored->batch_source_ids == merged->batch_source_ids);
+
+    // import option. the batches of two messages are named and identified after their sources, so they don't collide.
+    // meshes whose parents are not in the message are left alone.
+    auto make_message = [](const std::string& root_path, int id_base, bool with_root) {
+        ms::ScenePtr mes = ms::Scene::create();
+        if (with_root) {
+            std::shared_ptr<ms::Transform> t = ms::Transform::create();
+            t->path = root_path;
+            t->id = id_base;
+            t->position = mu::float3::zero();
+            t->rotation = quatf::identity();
+            t->scale = { 1.0f, 1.0f, 1.0f };
+            mes->entities.push_back(t);
+        }
+        for (int i = 0; i < 2; ++i) {
+            std::shared_ptr<ms::Mesh> mesh = ms::Mesh::create();
+            mesh->path = root_path + "/Sphere" + std::to_string(i);
+            mesh->id = id_base + 1 + i;
+            mesh->position = { (float)i, 0.0f, 0.0f };
+            mesh->rotation = quatf::identity();
+            mesh->scale = { 1.0f, 1.0f, 1.0f };
+            MeshGenerator::GenerateIcoSphereMesh(mesh->counts, mesh->indices, mesh->points, mesh->m_uv[0], 0.5f, 1);
+            mesh->setupDataFlags();
+            mes->entities.push_back(mesh);
+        }
+        ms::SceneImportSettings settings;
+        ms::BitUtility::Set(&settings.flags, ms::SCENE_IMPORT_FLAG_MERGE_MESHES, true);
+        settings.mesh_split_unit = 0xffff;
+        mes->import(settings);
+        return mes;
+    };
+    ms::ScenePtr mes1 = make_message("/A", 10, true), mes2 = make_message("/B", 20, true), mes3 = make_message("/C", 30, false);
+    Expect(mes1->entities.size() == 4 && mes2->entities.size() == 4 && mes3->entities.size() == 2);
+    const ms::Transform& batch1 = *mes1->entities.back();
+    const ms::Transform& batch2 = *mes2->entities.back();
+    Expect(batch1.getType() == ms::EntityType::Mesh && batch2.getType() == ms::EntityType::Mesh);
+    Expect(batch1.path == "/MeshBatch11" && batch2.path == "/MeshBatch21");
+    Expect(batch1.id != batch2.id && batch1.id != ms::InvalidID && batch2.id != ms::InvalidID);
+    Expect(mes3->entities[0]->getType() == ms::EntityType::Mesh && mes3->entities[1]->getType() == ms::EntityType::Mesh);
+}
+
+TestCase(Test_MeshRefineCache)
+{
+    auto make_mesh = [](float radius, bool reindexing = true) {
+        std::shared_ptr<ms::Mesh> mesh = ms::Mesh::create();
+        mesh->path = "/Test/Sphere";
+        SharedVector<mu::float2> uv;
+        MeshGenerator::GenerateIcoSphereMesh(mesh->counts, mesh->indices, mesh->points, uv, radius, 4);
+        mesh->refine_settings.flags.Set(ms::MESH_REFINE_FLAG_NO_REINDEXING, !reindexing);
+        mesh->refine_settings.flags.Set(ms::MESH_REFINE_FLAG_GEN_NORMALS, true);
+        mesh->refine_settings.flags.Set(ms::MESH_REFINE_FLAG_GEN_INDICES16, true);
+        mesh->setupDataFlags();
+        return mesh;
+    };
+
+    ms::MeshRefineCache cache;
+    std::shared_ptr<ms::Mesh> expected = make_mesh(1.0f);
+    TestScope("Mesh::refine", [&]() { expected->refine(); });
+    std::shared_ptr<ms::Mesh> expected_deformed = make_mesh(2.0f);
+    expected_deformed->refine();
+
+    // m3 has the same topology as m1, so it reuses the remap tables
+    std::shared_ptr<ms::Mesh> m1 = make_mesh(1.0f), m2 = make_mesh(1.0f), m3 = make_mesh(2.0f);
+    TestScope("MeshRefineCache::refine (miss)", [&]() { cache.refine(*m1); });
+    TestScope("MeshRefineCache::refine (hit)", [&]() { cache.refine(*m2); });
+    TestScope("MeshRefineCache::refine (topology hit)", [&]() { cache.refine(*m3); });
+
+    ms::MeshRefineCacheStats stats = cache.getStats();
+    Expect(stats.hits == 1 && stats.misses == 2 && stats.topology_hits == 1 && stats.topology_misses == 1);
+    Expect(stats.num_records == 2); // the tables and m1. the result of a deformed mesh is not kept
+    Expect(m2->points == expected->points && m2->normals == expected->normals && m2->indices16 == expected->indices16);
+    Expect(m2->md_flags.Get(ms::MESH_DATA_FLAG_HAS_INDICES16) && m2->submeshes.size() == expected->submeshes.size());
+    Expect(m3->points == expected_deformed->points && m3->normals == expected_deformed->normals && m3->indices16 == expected_deformed->indices16);
+
+    // reversed winding has the same checksum as m1 but must not restore its result
+    std::shared_ptr<ms::Mesh> m4 = make_mesh(1.0f), expected_flipped = make_mesh(1.0f);
+    std::reverse(m4->indices.begin(), m4->indices.end());
+    std::reverse(expected_flipped->indices.begin(), expected_flipped->indices.end());
+    Expect(m4->checksumGeom() == make_mesh(1.0f)->checksumGeom() && m4->hashGeom() != make_mesh(1.0f)->hashGeom());
+    expected_flipped->refine();
+    cache.refine(*m4);
+    stats = cache.getStats();
+    Expect(stats.hits == 1 && stats.misses == 3);
+    Expect(m4->normals == expected_flipped->normals && m4->indices16 == expected_flipped->indices16);
+
+    // the restored mesh owns its memory
+    cache.clear();
+    Expect(m2->points == expected->points);
+
+    // eviction
+    ms::MeshRefineCacheSettings settings;
+    settings.max_records = 1;
+    cache.setSettings(settings);
+    cache.refine(*make_mesh(1.0f, false));
+    cache.refine(*make_mesh(2.0f, false));
+    cache.refine(*make_mesh(1.0f, false));
+    stats = cache.getStats();
+    Expect(stats.hits == 0 && stats.misses == 3 && stats.evictions == 2 && stats.num_records == 1);
+}
+
+TestCase(Test_MeshRefineTables)
+{
+    // per-index uv with seams and per-index normals, as DCC tools send them
+    auto make_mesh = [](float t) {
+        std::shared_ptr<ms::Mesh> mesh = ms::Mesh::create();
+        MeshGenerator::GenerateWaveMesh(mesh->counts, mesh->indices, mesh->points, mesh->m_uv, 2.0f, 1.0f, 64, t);
+        mesh->m_uv[0].resize_discard(mesh->indices.size());
+        mesh->normals.resize_discard(mesh->indices.size());
+        for (size_t ii = 0; ii < mesh->indices.size(); ++ii) {
+            const mu::float3& p = mesh->points[mesh->indices[ii]];
+            mesh->m_uv[0][ii] = { p.x * 0.5f + (p.z < 0.0f ? 1.0f : 0.0f), p.z * 0.5f };
+            mesh->normals[ii] = mu::normalize(mu::float3{ p.x, 1.0f, p.z });
+        }
+        mesh->material_ids.resize(mesh->counts.size(), 0);
+        mesh->refine_settings.flags.Set(ms::MESH_REFINE_FLAG_GEN_TANGENTS, true);
+        mesh->refine_settings.flags.Set(ms::MESH_REFINE_FLAG_SPLIT, true);
+        mesh->refine_settings.split_unit = 4096;
+        mesh->setupDataFlags();
+        return mesh;
+    };
+    auto same_result = [](const ms::Mesh& a, const ms::Mesh& b) {
+        return a.points == b.points && a.normals == b.normals && a.tangents == b.tangents && a.m_uv[0] == b.m_uv[0] &&
+            a.indices == b.indices && a.indices16 == b.indices16 && a.submeshes.size() == b.submeshes.size();
+    };
+
+    ms::MeshRefineTables tables;
+    std::shared_ptr<ms::Mesh> frame0 = make_mesh(0.0f);
+    frame0->refine(&tables);
+    Expect(tables.reuse_count == 0 && !tables.new2old_points.empty());
+
+    // deformed: same topology and seams
+    std::shared_ptr<ms::Mesh> frame1 = make_mesh(0.5f), expected = make_mesh(0.5f);
+    TestScope("Mesh::refine (rebuild)", [&]() { expected->refine(); });
+    TestScope("Mesh::refine (reuse tables)", [&]() { frame1->refine(&tables); });
+    Expect(tables.reuse_count == 1);
+    Expect(same_result(*frame1, *expected));
+
+    // a uv seam that is not in the tables. the tables are rebuilt.
+    std::shared_ptr<ms::Mesh> frame2 = make_mesh(1.0f);
+    const size_t seam = frame2->indices.size() / 2;
+    frame2->m_uv[0][seam] = { 10.0f, 10.0f };
+    expected = make_mesh(1.0f);
+    expected->m_uv[0][seam] = { 10.0f, 10.0f };
+    expected->refine();
+    frame2->refine(&tables);
+    Expect(tables.reuse_count == 0);
+    Expect(same_result(*frame2, *expected));
+}
+
 TestCase(Test_Points)
 {
     Random rand;
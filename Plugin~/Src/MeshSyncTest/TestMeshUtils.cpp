@@ -112,6 +112,446 @@ TestCase(TestMeshRefiner)
     refiner.genSubmeshes(material_ids);
 }
 
+TestCase(TestMeshRefinerHashDedup)
+{
+    RawVector<int> counts, indices;
+    RawVector<float3> points;
+    RawVector<float2> uv;
+    MeshGenerator::GenerateIcoSphereMesh(counts, indices, points, uv, 1.0f, 5);
+
+    // flat shaded normals & per-face uv make many split vertices
+    RawVector<float3> normals;
+    GenerateNormalsWithSmoothAngle(normals, points, counts, indices, 10.0f, false);
+    RawVector<float2> uv_flattened(indices.size());
+    for (size_t i = 0; i < indices.size(); ++i)
+        uv_flattened[i] = float2{ points[indices[i]].x + (float)((i / 3) % 2), points[indices[i]].y };
+
+    struct Result
+    {
+        RawVector<int> new_indices, new2old_points, old2new_indices;
+        RawVector<float2> uv;
+        RawVector<float3> normals;
+        RawVector<int> remap_uv, remap_normals;
+        int num_splits = 0;
+    };
+    // an indexed attribute has no specialized kernel, so it forces the virtual fallback
+    RawVector<int> identity(indices.size());
+    std::iota(identity.begin(), identity.end(), 0);
+
+    auto refine = [&](Result& r, bool hash, bool fallback = false) {
+        mu::MeshRefiner refiner;
+        refiner.split_unit = 4000;
+        refiner.dedup_by_hash = hash;
+        refiner.counts = counts;
+        refiner.indices = indices;
+        refiner.points = points;
+        refiner.addExpandedAttribute<float2>(uv_flattened, r.uv, r.remap_uv);
+        if (fallback)
+            refiner.addIndexedAttribute<float3>(normals, identity, r.normals, r.remap_normals);
+        else
+            refiner.addExpandedAttribute<float3>(normals, r.normals, r.remap_normals);
+        const char *names[2][2] = { { "refine", "refine (virtual)" }, { "refine (hash)", "refine (hash, virtual)" } };
+        TestScope(names[hash][fallback], [&]() { refiner.refine(); });
+        r.new_indices.swap(refiner.new_indices);
+        r.new2old_points.swap(refiner.new2old_points);
+        r.old2new_indices.swap(refiner.old2new_indices);
+        r.num_splits = (int)refiner.splits.size();
+    };
+
+    Result legacy, hashed, hashed2, legacy_virtual, hashed_virtual;
+    refine(legacy, false);
+    refine(hashed, true);
+    refine(legacy_virtual, false, true);
+    refine(hashed_virtual, true, true);
+#ifdef muEnableThreadPool
+    int workers = ThreadPool::getWorkerCount();
+    ThreadPool::setWorkerCount(std::max(workers, 3));
+    refine(hashed2, true);
+    ThreadPool::setWorkerCount(workers);
+#else
+    refine(hashed2, true);
+#endif
+    Print("    vertices: %d -> %d, splits: %d -> %d\n",
+        (int)legacy.new2old_points.size(), (int)hashed.new2old_points.size(), legacy.num_splits, hashed.num_splits);
+    Expect(hashed.new2old_points.size() <= legacy.new2old_points.size());
+    Expect(hashed.new_indices == hashed2.new_indices);
+    Expect(legacy.new_indices == legacy_virtual.new_indices && legacy.normals == legacy_virtual.normals);
+    Expect(hashed.new_indices == hashed_virtual.new_indices && hashed.normals == hashed_virtual.normals);
+
+    // every corner must still reference a vertex with its own point and attributes, by new_indices and old2new_indices
+    auto maps_corners = [&](const Result& r) {
+        bool ok = r.new_indices.size() == indices.size() && r.old2new_indices.size() == indices.size();
+        for (size_t ii = 0; ii < indices.size() && ok; ++ii) {
+            int ni = r.new_indices[ii];
+            ok = r.old2new_indices[ii] == ni && r.new2old_points[ni] == indices[ii] &&
+                r.uv[ni] == uv_flattened[ii] && r.normals[ni] == normals[ii];
+        }
+        return ok;
+    };
+    Expect(maps_corners(hashed));
+    Expect(maps_corners(legacy));
+}
+
+
+TestCase(TestVertexCacheOptimization)
+{
+    RawVector<int> counts, indices;
+    RawVector<float3> points;
+    RawVector<float2> uv;
+    MeshGenerator::GenerateIcoSphereMesh(counts, indices, points, uv, 1.0f, 5);
+
+    // scanned meshes come in no particular order. shuffle triangles to simulate it.
+    {
+        const int num_triangles = (int)indices.size() / 3;
+        RawVector<int> order(num_triangles), tmp(indices.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::mt19937 rng(1);
+        std::shuffle(order.begin(), order.end(), rng);
+        for (int ti = 0; ti < num_triangles; ++ti)
+            std::copy(&indices[order[ti] * 3], &indices[order[ti] * 3] + 3, &tmp[ti * 3]);
+        indices.swap(tmp);
+    }
+    RawVector<float2> uv_flattened(indices.size());
+    for (size_t i = 0; i < indices.size(); ++i)
+        uv_flattened[i] = float2{ points[indices[i]].x, points[indices[i]].y };
+
+    auto refine = [&](mu::MeshRefiner& refiner, RawVector<float2>& new_uv, RawVector<int>& remap_uv, bool optimize) {
+        refiner.split_unit = 0;
+        refiner.dedup_by_hash = true;
+        refiner.counts = counts;
+        refiner.indices = indices;
+        refiner.points = points;
+        refiner.addExpandedAttribute<float2>(uv_flattened, new_uv, remap_uv);
+        refiner.refine();
+        refiner.retopology(false);
+        refiner.genSubmeshes();
+        if (optimize) {
+            TestScope("optimizeVertexCache", [&]() { refiner.optimizeVertexCache(); });
+        }
+    };
+
+    mu::MeshRefiner base, optimized;
+    RawVector<float2> base_uv, optimized_uv;
+    RawVector<int> base_remap, optimized_remap;
+    refine(base, base_uv, base_remap, false);
+    refine(optimized, optimized_uv, optimized_remap, true);
+    Expect(base.submeshes.size() == optimized.submeshes.size());
+
+    bool ok = true;
+    VertexCacheStatistics before_total, after_total;
+    for (size_t smi = 0; smi < optimized.submeshes.size(); ++smi) {
+        auto& sm0 = base.submeshes[smi];
+        auto& sm1 = optimized.submeshes[smi];
+        auto& split = optimized.splits[sm1.split_index];
+        IArray<int> indices0(base.new_indices_submeshes.data() + sm0.index_offset, sm0.index_count);
+        IArray<int> indices1(optimized.new_indices_submeshes.data() + sm1.index_offset, sm1.index_count);
+
+        auto before = AnalyzeVertexCache(indices0, split.vertex_count);
+        auto after = AnalyzeVertexCache(indices1, split.vertex_count);
+        Print("    submesh %d: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n", (int)smi, before.acmr, after.acmr, before.atvr, after.atvr);
+        ok = ok && after.acmr < before.acmr && after.acmr < 0.8f && after.atvr < before.atvr;
+
+        // same set of triangles referencing the same points and attributes
+        auto corners = [&](mu::MeshRefiner& r, RawVector<float2>& new_uv, IArray<int> idx, int vertex_offset) {
+            std::vector<std::array<float, 15>> ret;
+            for (size_t ti = 0; ti < idx.size() / 3; ++ti) {
+                std::array<std::array<float, 5>, 3> c;
+                for (int i = 0; i < 3; ++i) {
+                    int vi = idx[ti * 3 + i] + vertex_offset;
+                    float3 p = r.new_points[vi];
+                    c[i] = { p.x, p.y, p.z, new_uv[vi].x, new_uv[vi].y };
+                }
+                std::rotate(c.begin(), std::min_element(c.begin(), c.end()), c.end());
+                std::array<float, 15> t;
+                for (int i = 0; i < 3; ++i)
+                    std::copy(c[i].begin(), c[i].end(), t.begin() + i * 5);
+                ret.push_back(t);
+            }
+            std::sort(ret.begin(), ret.end());
+            return ret;
+        };
+        ok = ok && corners(base, base_uv, indices0, split.vertex_offset) == corners(optimized, optimized_uv, indices1, split.vertex_offset);
+    }
+    Expect(ok);
+
+    // corners still reference vertices with their own points
+    ok = true;
+    for (size_t ii = 0; ii < indices.size() && ok; ++ii)
+        ok = optimized.new2old_points[optimized.old2new_indices[ii]] == indices[ii];
+    Expect(ok);
+}
+
+TestCase(TestMeshlets)
+{
+    RawVector<int> counts, indices;
+    RawVector<float3> points;
+    RawVector<float2> uv;
+    MeshGenerator::GenerateIcoSphereMesh(counts, indices, points, uv, 1.0f, 5);
+
+    mu::MeshRefiner refiner;
+    refiner.split_unit = 0;
+    refiner.dedup_by_hash = true;
+    refiner.counts = counts;
+    refiner.indices = indices;
+    refiner.points = points;
+    refiner.refine();
+    refiner.retopology(false);
+    refiner.genSubmeshes();
+    refiner.optimizeVertexCache();
+    TestScope("genMeshlets", [&]() { refiner.genMeshlets(64, 124); });
+
+    auto& sm = refiner.submeshes[0];
+    const int num_triangles = sm.index_count / 3;
+    Print("    %d triangles -> %d meshlets (%.1f triangles per meshlet)\n",
+        num_triangles, (int)refiner.meshlets.size(), (float)num_triangles / (float)refiner.meshlets.size());
+    Expect(refiner.meshlets.size() < (size_t)num_triangles / 64);
+
+    // every triangle exactly once, within the limits and the bounds
+    std::vector<std::array<int, 3>> expected, actual;
+    for (int ti = 0; ti < num_triangles; ++ti) {
+        const int *t = &refiner.new_indices_submeshes[sm.index_offset + ti * 3];
+        std::array<int, 3> tri{ t[0], t[1], t[2] };
+        std::rotate(tri.begin(), std::min_element(tri.begin(), tri.end()), tri.end());
+        expected.push_back(tri);
+    }
+    bool ok = true;
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<float> dist(-4.0f, 4.0f);
+    for (auto& m : refiner.meshlets) {
+        ok = ok && m.vertex_count <= 64 && m.triangle_count <= 124;
+        for (int vi = 0; vi < m.vertex_count; ++vi) {
+            float3 p = refiner.new_points[refiner.meshlet_vertices[m.vertex_offset + vi]];
+            ok = ok && length(p - m.center) <= m.radius * 1.0001f;
+        }
+
+        std::vector<float3> normals;
+        for (int ti = 0; ti < m.triangle_count; ++ti) {
+            std::array<int, 3> tri;
+            for (int c = 0; c < 3; ++c) {
+                int local = refiner.meshlet_triangles[m.triangle_offset + ti * 3 + c];
+                ok = ok && local < m.vertex_count;
+                tri[c] = refiner.meshlet_vertices[m.vertex_offset + local];
+            }
+            normals.push_back(cross(refiner.new_points[tri[1]] - refiner.new_points[tri[0]], refiner.new_points[tri[2]] - refiner.new_points[tri[0]]));
+            std::rotate(tri.begin(), std::min_element(tri.begin(), tri.end()), tri.end());
+            actual.push_back(tri);
+        }
+
+        // cone culling must be conservative: culled meshlets have no front-facing triangle
+        for (int i = 0; i < 16; ++i) {
+            float3 view{ dist(rng), dist(rng), dist(rng) };
+            if (dot(normalize(m.cone_apex - view), m.cone_axis) < m.cone_cutoff)
+                continue;
+            for (int ti = 0; ti < m.triangle_count; ++ti) {
+                int local = refiner.meshlet_triangles[m.triangle_offset + ti * 3];
+                float3 p0 = refiner.new_points[refiner.meshlet_vertices[m.vertex_offset + local]];
+                ok = ok && dot(normals[ti], p0 - view) >= -1e-5f;
+            }
+        }
+    }
+    std::sort(expected.begin(), expected.end());
+    std::sort(actual.begin(), actual.end());
+    Expect(ok);
+    Expect(expected == actual);
+}
+
+TestCase(TestIndices16)
+{
+    RawVector<int> counts, indices;
+    RawVector<float3> points;
+    RawVector<float2> uv;
+    MeshGenerator::GenerateIcoSphereMesh(counts, indices, points, uv, 1.0f, 7);
+    Print("    %d vertices, %d triangles\n", (int)points.size(), (int)indices.size() / 3);
+
+    auto refine = [&](mu::MeshRefiner& refiner, int split_unit) {
+        refiner.split_unit = split_unit;
+        refiner.counts = counts;
+        refiner.indices = indices;
+        refiner.points = points;
+        refiner.refine();
+        refiner.retopology(false);
+        refiner.genSubmeshes();
+    };
+
+    // every split fits in 16 bit
+    {
+        mu::MeshRefiner refiner;
+        refine(refiner, 65000);
+        bool ret = false;
+        TestScope("genIndices16", [&]() { ret = refiner.genIndices16(); });
+        Expect(ret);
+        Expect(refiner.splits.size() > 1);
+        Expect(refiner.new_indices_submeshes16.size() == refiner.new_indices_submeshes.size());
+        bool ok = true;
+        for (size_t i = 0; i < refiner.new_indices_submeshes.size(); ++i)
+            ok = ok && refiner.new_indices_submeshes16[i] == refiner.new_indices_submeshes[i];
+        Expect(ok);
+    }
+
+    // a split exceeds 16 bit
+    {
+        mu::MeshRefiner refiner;
+        refine(refiner, 0);
+        Expect(!refiner.genIndices16());
+        Expect(refiner.new_indices_submeshes16.empty());
+    }
+}
+
+TestCase(TestInterleaveLayout)
+{
+    const int num = 100000;
+    RawVector<float3> points(num), normals(num);
+    RawVector<float2> uv(num);
+    RawVector<float4> colors(num);
+    for (int i = 0; i < num; ++i) {
+        float f = (float)i / num;
+        points[i] = { f * 10.0f, -f, 1.0f + f };
+        normals[i] = normalize(float3{ f, 1.0f, -f });
+        uv[i] = { f, 1.0f - f };
+        colors[i] = { f, 0.5f, 1.0f, 1.0f };
+    }
+
+    // float32x3 position, snorm8x4 normal (padded), float16x2 uv, unorm8x4 color
+    VertexAttributeDesc attrs[4];
+    attrs[0].src = (const float*)points.cdata(); attrs[0].src_dimension = 3; attrs[0].dimension = 3; attrs[0].offset = 0;
+    attrs[1].src = (const float*)normals.cdata(); attrs[1].src_dimension = 3; attrs[1].dimension = 4; attrs[1].offset = 12;
+    attrs[1].format = VertexAttributeFormat::SNorm8;
+    attrs[2].src = (const float*)uv.cdata(); attrs[2].src_dimension = 2; attrs[2].dimension = 2; attrs[2].offset = 16;
+    attrs[2].format = VertexAttributeFormat::Float16;
+    attrs[3].src = (const float*)colors.cdata(); attrs[3].src_dimension = 4; attrs[3].dimension = 4; attrs[3].offset = 20;
+    attrs[3].format = VertexAttributeFormat::UNorm8;
+    const size_t stride = 24;
+    Expect(GetVertexAttributeSize(VertexAttributeFormat::SNorm8, 4) + GetVertexAttributeSize(VertexAttributeFormat::Float16, 2) +
+        GetVertexAttributeSize(VertexAttributeFormat::UNorm8, 4) + 12 == stride);
+
+    RawVector<char> buf(stride * num);
+    TestScope("Interleave", [&]() { Interleave(buf.data(), stride, num, attrs, 4); });
+
+    bool ok = true;
+    for (int i = 0; i < num; ++i) {
+        const char *v = buf.cdata() + stride * i;
+        float3 p = *(const float3*)v;
+        const snorm8 *n = (const snorm8*)(v + 12);
+        const half *u = (const half*)(v + 16);
+        const unorm8 *c = (const unorm8*)(v + 20);
+        ok = ok && p == points[i];
+        ok = ok && near_equal(float3{ n[0], n[1], n[2] }, normals[i], 0.01f) && n[3].value == 0;
+        ok = ok && near_equal(float2{ u[0], u[1] }, uv[i], 0.001f);
+        ok = ok && near_equal(float4{ c[0], c[1], c[2], c[3] }, colors[i], 0.005f);
+    }
+    Expect(ok);
+}
+
+TestCase(TestMeshSimplifier)
+{
+    RawVector<int> counts, indices;
+    RawVector<float3> points;
+    RawVector<float2> uv;
+    MeshGenerator::GenerateIcoSphereMesh(counts, indices, points, uv, 1.0f, 5);
+
+    // two separated spheres. each connected component is reduced to the target ratio.
+    {
+        const int n = (int)points.size();
+        for (int i = 0; i < n; ++i)
+            points.push_back(points[i] + float3{ 4.0f, 0.0f, 0.0f });
+        const size_t ni = indices.size();
+        for (size_t i = 0; i < ni; ++i)
+            indices.push_back(indices[i] + n);
+    }
+    const int num_triangles = (int)indices.size() / 3;
+
+    auto check_triangles = [&](const RawVector<int>& dst) {
+        // no degenerate and no flipped triangles
+        bool ok = true;
+        for (size_t ti = 0; ti < dst.size() / 3; ++ti) {
+            const int *t = &dst[ti * 3];
+            ok = ok && t[0] != t[1] && t[1] != t[2] && t[2] != t[0];
+            float3 n = cross(points[t[1]] - points[t[0]], points[t[2]] - points[t[0]]);
+            float3 c = (points[t[0]] + points[t[1]] + points[t[2]]) / 3.0f;
+            float3 center = c.x > 2.0f ? float3{ 4.0f, 0.0f, 0.0f } : float3::zero();
+            ok = ok && dot(n, c - center) > 0.0f;
+        }
+        return ok;
+    };
+
+    mu::MeshSimplifier simplifier;
+    simplifier.points = points;
+    simplifier.indices = indices;
+    simplifier.target_ratio = 0.1f;
+    TestScope("MeshSimplifier (ratio)", [&]() { simplifier.simplify(); });
+    int result = (int)simplifier.new_indices.size() / 3;
+    Print("    triangles: %d -> %d, error: %f\n", num_triangles, result, simplifier.result_error);
+    Expect(result <= num_triangles / 10 + 2 && result > num_triangles / 20);
+    Expect(check_triangles(simplifier.new_indices));
+
+    // stops at the error bound
+    simplifier.target_ratio = 0.0f;
+    simplifier.target_error = 1e-4f;
+    TestScope("MeshSimplifier (error)", [&]() { simplifier.simplify(); });
+    result = (int)simplifier.new_indices.size() / 3;
+    Print("    triangles: %d -> %d, error: %f\n", num_triangles, result, simplifier.result_error);
+    Expect(simplifier.result_error <= 1e-4f && result < num_triangles && result > num_triangles / 10);
+    Expect(check_triangles(simplifier.new_indices));
+
+    // flat grid with a seam (vertices split along x == div/2) and two face groups along y == div/2.
+    // interior of each part collapses freely, borders, the seam and the group boundary are kept.
+    {
+        const int div = 32;
+        RawVector<float3> gpoints;
+        RawVector<int> gindices, groups;
+        auto vertex = [&](int x, int y, bool right) {
+            // vertices on the seam are duplicated for the right side
+            return y * (div + 2) + (x == div / 2 && right ? div + 1 : x);
+        };
+        for (int y = 0; y <= div; ++y) {
+            for (int x = 0; x <= div + 1; ++x)
+                gpoints.push_back({ (float)(x == div + 1 ? div / 2 : x), (float)y, 0.0f });
+        }
+        for (int y = 0; y < div; ++y) {
+            for (int x = 0; x < div; ++x) {
+                bool right = x >= div / 2;
+                int i0 = vertex(x, y, right), i1 = vertex(x + 1, y, right), i2 = vertex(x + 1, y + 1, right), i3 = vertex(x, y + 1, right);
+                int quad[] = { i0, i1, i2, i0, i2, i3 };
+                gindices.insert(gindices.end(), quad, quad + 6);
+                groups.push_back(y < div / 2 ? 0 : 1);
+                groups.push_back(y < div / 2 ? 0 : 1);
+            }
+        }
+
+        mu::MeshSimplifier gs;
+        gs.points = gpoints;
+        gs.indices = gindices;
+        gs.face_groups = groups;
+        gs.target_ratio = 0.0f;
+        gs.simplify();
+        Print("    grid triangles: %d -> %d\n", (int)gindices.size() / 3, (int)gs.new_indices.size() / 3);
+        Expect(gs.new_indices.size() < gindices.size() / 4);
+        Expect(gs.new_face_groups.size() * 3 == gs.new_indices.size());
+
+        RawVector<char> used;
+        used.resize_zeroclear(gpoints.size());
+        for (int i : gs.new_indices)
+            used[i] = 1;
+        bool ok = true;
+        for (int y = 0; y <= div; ++y) {
+            for (int x = 0; x <= div; ++x) {
+                bool keep = x == 0 || x == div || y == 0 || y == div || x == div / 2 || y == div / 2;
+                if (keep)
+                    ok = ok && used[vertex(x, y, false)] && (x != div / 2 || used[vertex(x, y, true)]);
+            }
+        }
+        Expect(ok);
+
+        // flat and area preserving: the total area must not change
+        auto area = [&](const RawVector<int>& idx) {
+            float a = 0.0f;
+            for (size_t ti = 0; ti < idx.size() / 3; ++ti)
+                a += cross(gpoints[idx[ti * 3 + 1]] - gpoints[idx[ti * 3]], gpoints[idx[ti * 3 + 2]] - gpoints[idx[ti * 3]]).z * 0.5f;
+            return a;
+        };
+        Expect(near_equal(area(gs.new_indices), area(gindices)));
+    }
+}
 
 TestCase(TestNormalsAndTangents)
 {
@@ -229,6 +669,31 @@ TestCase(TestNormalsAndTangents)
     ValidateNormals(normals[5]);
 #endif
 
+    RawVector<float3> normals_poly, normals_smooth;
+    TestScope("GenerateNormalsPoly", [&]() {
+        GenerateNormalsPoly(normals_poly, points, counts, indices, false);
+    }, num_try);
+    Expect(NearEqual(normals[0].data(), normals_poly.data(), normals_poly.size()));
+
+    // 180 degrees smooths everything, so each corner gets the sum of unit face normals around its vertex
+    TestScope("GenerateNormalsWithSmoothAngle", [&]() {
+        GenerateNormalsWithSmoothAngle(normals_smooth, points, counts, indices, 180.0f, false);
+    }, num_try);
+    {
+        RawVector<float3> expected;
+        expected.resize_zeroclear(points.size());
+        for (int ti = 0; ti < num_triangles; ++ti) {
+            const int *t = &indices[ti * 3];
+            float3 n = normalize(cross(points[t[1]] - points[t[0]], points[t[2]] - points[t[0]]));
+            for (int i = 0; i < 3; ++i)
+                expected[t[i]] += n;
+        }
+        bool ok = true;
+        for (size_t ii = 0; ii < indices.size(); ++ii)
+            ok = ok && near_equal(normals_smooth[ii], normalize(expected[indices[ii]]));
+        Expect(ok);
+    }
+
 
     // generate tangents
 
@@ -273,6 +738,12 @@ TestCase(TestNormalsAndTangents)
     ValidateTangents(tangents[5]);
 #endif
 
+    RawVector<float4> tangents_poly;
+    TestScope("GenerateTangentsPoly", [&]() {
+        GenerateTangentsPoly(tangents_poly, points, uv[uvIndex], normals[0], counts, indices);
+    }, num_try);
+    Expect(NearEqual(tangents[0].data(), tangents_poly.data(), tangents_poly.size()));
+
     // try to call CalculateTangents() in Unity.exe
     {
         void* unity_exe = GetModule("Unity.exe");
@@ -559,6 +1030,89 @@ TestCase(TestRayTrianglesIntersection)
 }
 
 
+TestCase(TestTriangleBVH)
+{
+    RawVector<int> counts, indices;
+    RawVector<float3> points;
+    SharedVector<float2> uv[ms::MeshSyncConstants::MAX_UV];
+    MeshGenerator::GenerateWaveMesh(counts, indices, points, uv, 10.0f, 0.5f, 256, 0.0f, true);
+    const int num_triangles = (int)indices.size() / 3;
+    const int num_rays = 1024;
+    const int num_points = 64;
+
+    TriangleBVH bvh;
+    bvh.points = points;
+    bvh.indices = indices;
+    TestScope("build", [&]() { bvh.build(); });
+    Print("    triangles: %d, nodes: %d\n", num_triangles, (int)bvh.getNodeCount());
+
+    // rays from above to random points around the mesh (-5 to 5). some of them miss it
+    Random rnd;
+    RawVector<float3> ray_pos(num_rays), ray_dir(num_rays), query(num_points);
+    for (int i = 0; i < num_rays; ++i) {
+        ray_pos[i] = float3{ rnd.f11(), 5.0f, rnd.f11() };
+        ray_dir[i] = float3{ rnd.f11() * 6.0f, 0.0f, rnd.f11() * 6.0f } - ray_pos[i];
+    }
+    for (auto& q : query)
+        q = float3{ rnd.f11() * 6.0f, rnd.f11(), rnd.f11() * 6.0f };
+
+    // distances are compared, not triangle indices: rays through shared edges hit two triangles at the same distance
+    auto verify = [&]() {
+        RawVector<int> bf_t(num_rays), t1(num_rays), t2(num_rays);
+        RawVector<float> bf_d(num_rays), d1(num_rays), d2(num_rays);
+        TestScope("brute force", [&]() {
+            for (int i = 0; i < num_rays; ++i)
+                RayTrianglesIntersectionIndexed(ray_pos[i], ray_dir[i], points.cdata(), indices.cdata(), num_triangles, bf_t[i], bf_d[i]);
+        });
+
+        // leaves are tested by RayTrianglesIntersectionSoA(), which follows the active ISA. check every one of them
+        for (const char *isa : GetSupportedSIMDISAs()) {
+            SetActiveSIMDISA(isa);
+            Print("    %s\n", isa);
+            TestScope("single", [&]() {
+                for (int i = 0; i < num_rays; ++i)
+                    bvh.raycast(ray_pos[i], ray_dir[i], t1[i], d1[i]);
+            });
+            TestScope("packet", [&]() {
+                bvh.raycast(ray_pos.cdata(), ray_dir.cdata(), num_rays, t2.data(), d2.data());
+            });
+
+            int num_hits = 0, num_mismatches = 0;
+            for (int i = 0; i < num_rays; ++i) {
+                bool hit = bf_d[i] != FLT_MAX;
+                if (hit)
+                    ++num_hits;
+                if (hit != (t1[i] >= 0) || hit != (t2[i] >= 0) || (hit && (!near_equal(bf_d[i], d1[i]) || d1[i] != d2[i])))
+                    ++num_mismatches;
+            }
+            Print("    hits: %d / %d, mismatches: %d\n", num_hits, num_rays, num_mismatches);
+            Expect(num_hits > 0 && num_hits < num_rays);
+            Expect(num_mismatches == 0);
+        }
+        SetActiveSIMDISA("auto");
+
+        for (auto& q : query) {
+            float bf = FLT_MAX;
+            for (int ti = 0; ti < num_triangles; ++ti) {
+                const int *tri = &indices[ti * 3];
+                bf = std::min(bf, length(closest_point_on_triangle(q, points[tri[0]], points[tri[1]], points[tri[2]]) - q));
+            }
+            int ti;
+            float3 p;
+            Expect(bvh.closestPoint(q, ti, p));
+            Expect(near_equal(length(p - q), bf));
+            Expect(!bvh.closestPoint(q, ti, p, bf * 0.9f));
+        }
+    };
+    verify();
+
+    // deform (another phase of the wave) and refit
+    MeshGenerator::GenerateWaveMesh(counts, indices, points, uv, 10.0f, 0.5f, 256, 2.0f, true);
+    bvh.points = points;
+    TestScope("refit", [&]() { bvh.refit(); });
+    verify();
+}
+
 TestCase(TestPolygonInside)
 {
     const int num_try = 100;
@@ -733,6 +1287,173 @@ TestCase(TestEdge)
     }
 }
 
+TestCase(TestWeldVertices)
+{
+    std::mt19937 rnd(1234);
+    std::uniform_int_distribution<int> grid(0, 40);
+    std::uniform_real_distribution<float> jitter(-0.00004f, 0.00004f);
+
+    const int N = 20000;
+    RawVector<float3> points(N);
+    for (auto& p : points)
+        p = { (float)grid(rnd) * 0.1f, (float)grid(rnd) * 0.1f, 0.5f };
+    points[10] = { 0.0f, 0.0f, 0.5f };
+    points[11] = { -0.0f, 0.0f, 0.5f };
+    points[12] = { std::numeric_limits<float>::quiet_NaN(), 0.0f, 0.0f };
+    points[13] = { std::numeric_limits<float>::infinity(), 0.0f, 0.0f };
+    points[14] = { std::numeric_limits<float>::infinity(), 0.0f, 0.0f };
+
+    // exact match must give the same result as brute force
+    {
+        RawVector<int> weld;
+        TestScope("WeldVertices", [&]() { WeldVertices(weld, points); });
+
+        bool ok = true;
+        for (int vi = 0; vi < N; ++vi) {
+            int r = vi;
+            for (int i = 0; i < vi; ++i) {
+                if (points[i] == points[vi]) {
+                    r = i;
+                    break;
+                }
+            }
+            ok = ok && weld[vi] == r;
+        }
+        Expect(ok);
+        Expect(weld[11] == weld[10] && weld[12] == 12 && weld[14] == 13);
+    }
+
+    // with epsilon, jittered copies are welded back to the original points
+    {
+        RawVector<float3> jittered = points;
+        for (int i = 15; i < N; ++i)
+            jittered[i] += float3{ jitter(rnd), jitter(rnd), jitter(rnd) };
+
+        RawVector<int> weld, weld_eps;
+        WeldVertices(weld, points);
+        WeldVertices(weld_eps, jittered, muEpsilon * 2.0f);
+
+        int num_unique = 0, num_unique_eps = 0;
+        for (int i = 15; i < N; ++i) {
+            num_unique += weld[i] == i ? 1 : 0;
+            num_unique_eps += weld_eps[i] == i ? 1 : 0;
+        }
+        Expect(num_unique == num_unique_eps);
+        Print("    %d unique points\n", num_unique_eps);
+    }
+}
+
+TestCase(TestBuildConnection)
+{
+    RawVector<int> counts, indices;
+    RawVector<float3> points;
+    RawVector<float2> uv;
+    MeshGenerator::GenerateIcoSphereMesh(counts, indices, points, uv, 1.0f, 6);
+
+#ifdef muEnableThreadPool
+    // make sure the chunked path is taken even on machines with few cores
+    int workers = ThreadPool::getWorkerCount();
+    ThreadPool::setWorkerCount(std::max(workers, 3));
+#endif
+
+    MeshConnectionInfo serial, parallel;
+    TestScope("BuildConnectionSerial", [&]() {
+        impl::BuildConnectionSerial(serial, indices, counts, points);
+    });
+    TestScope("BuildConnection", [&]() {
+        impl::BuildConnection(parallel, indices, counts, points);
+    });
+    Expect(serial.v2f_counts == parallel.v2f_counts);
+    Expect(serial.v2f_offsets == parallel.v2f_offsets);
+    Expect(serial.v2f_faces == parallel.v2f_faces);
+    Expect(serial.v2f_indices == parallel.v2f_indices);
+#ifdef muEnableThreadPool
+    ThreadPool::setWorkerCount(workers);
+#endif
+    Print("    %d faces, %d points\n", (int)counts.size(), (int)points.size());
+}
+
+TestCase(TestMeshTopologyContext)
+{
+    const int resolution = 128;
+    RawVector<int> counts, indices;
+    RawVector<float3> points;
+    SharedVector<float2> uv[ms::MeshSyncConstants::MAX_UV];
+    MeshGenerator::GenerateWaveMesh(counts, indices, points, uv, 1.0f, 0.25f, resolution, 0.0f);
+
+    // normals, tangents and re-indexing share one connection. both variants start from scratch on every run.
+    RawVector<float3> normals, normals_ref;
+    RawVector<float4> tangents, tangents_ref;
+    RawVector<int> new_indices, new_indices_ref, new2old_points, new2old_points_ref;
+    int connection_builds = 0;
+    auto shared = [&]() {
+        MeshTopologyContext topology;
+        topology.setup(counts, indices, points);
+        GenerateNormalsPoly(normals, topology, false);
+        GenerateTangentsPoly(tangents, uv[0], normals, topology);
+        MeshRefiner refiner;
+        refiner.points = points;
+        refiner.indices = indices;
+        refiner.counts = counts;
+        refiner.topology = &topology;
+        refiner.refine();
+        new_indices.swap(refiner.new_indices);
+        new2old_points.swap(refiner.new2old_points);
+        connection_builds = topology.getConnectionBuildCount();
+    };
+    auto separate = [&]() {
+        GenerateNormalsPoly(normals_ref, points, counts, indices, false);
+        GenerateTangentsPoly(tangents_ref, points, uv[0], normals_ref, counts, indices);
+        MeshRefiner refiner;
+        refiner.points = points;
+        refiner.indices = indices;
+        refiner.counts = counts;
+        refiner.refine();
+        new_indices_ref.swap(refiner.new_indices);
+        new2old_points_ref.swap(refiner.new2old_points);
+    };
+    // warm up, so that neither variant pays for the first allocations
+    shared();
+    separate();
+    TestScope("shared", shared, 10);
+    TestScope("separate", separate, 10);
+
+    Expect(connection_builds == 1);
+    Expect(normals == normals_ref);
+    Expect(tangents == tangents_ref);
+    Expect(new_indices == new_indices_ref);
+    Expect(new2old_points == new2old_points_ref);
+
+    // edge adjacency is built on demand on top of the shared connection.
+    // interior edges are shared by two quads. the border is open.
+    MeshTopologyContext topology;
+    topology.setup(counts, indices, points);
+    auto count_open_edges = [&]() {
+        const RawVector<int>& adjacency = topology.getEdgeAdjacency();
+        int num_open = 0;
+        for (int ii = 0; ii < (int)adjacency.size(); ++ii) {
+            if (adjacency[ii] == -1)
+                ++num_open;
+            else if (adjacency[adjacency[ii]] != ii)
+                return -1;
+        }
+        return num_open;
+    };
+    Expect(count_open_edges() == (resolution - 1) * 4);
+    Expect(topology.getConnectionBuildCount() == 1);
+
+    // double sided: interior edges are shared by four faces. only the border edges pair with their back faces.
+    RawVector<int> dcounts = counts, dindices = indices;
+    for (size_t fi = 0, offset = 0; fi < counts.size(); offset += counts[fi++]) {
+        dcounts.push_back(counts[fi]);
+        for (int ci = counts[fi] - 1; ci >= 0; --ci)
+            dindices.push_back(indices[offset + ci]);
+    }
+    topology.setup(dcounts, dindices, points);
+    Expect(count_open_edges() == (int)dindices.size() - (resolution - 1) * 8);
+    Print("    %d faces, %d points\n", (int)counts.size(), (int)points.size());
+}
+
 TestCase(TestHandedness)
 {
     {
@@ -811,6 +1532,384 @@ TestCase(TestSum)
     }, 1);
 }
 
+TestCase(TestSIMDBackend)
+{
+    // odd sizes to run the scalar tails too
+    const int N = 100003;
+    const int T = 5;
+    Print("backend: %s\n", GetSIMDBackendName_SIMD());
+
+    Random rnd;
+    RawVector<float> f1(N), f2(N), rf1(N), rf2(N);
+    RawVector<float3> v1(N), v2(N), rv1(N), rv2(N);
+    RawVector<float4> t1(N), t2(N), rt1(N), rt2(N);
+    RawVector<int> ints(N);
+    for (int i = 0; i < N; ++i) {
+        f1[i] = rnd.f11() * 1.5f; // out of [-1, 1] to test clamping
+        f2[i] = rnd.f11() * 1000.0f;
+        v1[i] = rnd.v3n() * rnd.f01() * 10.0f;
+        v2[i] = rnd.v3n();
+        t1[i] = rnd.v4t();
+        t2[i] = rnd.v4t();
+        ints[i] = (int)(rnd.f11() * 1e9f);
+    }
+
+    {
+        uint64_t r1, r2;
+        TestScope("SumInt32_SIMD", [&]() { r1 = SumInt32_SIMD((const uint32_t*)f2.cdata(), N); }, T);
+        TestScope("SumInt32_Generic", [&]() { r2 = SumInt32_Generic((const uint32_t*)f2.cdata(), N); }, T);
+        Expect(r1 == r2);
+    }
+    {
+        RawVector<half> h1(N), h2(N);
+        F32ToF16_SIMD(h1.data(), f2.cdata(), N);
+        F32ToF16_Generic(h2.data(), f2.cdata(), N);
+        Expect(memcmp(h1.cdata(), h2.cdata(), sizeof(half) * N) == 0);
+        F16ToF32_SIMD(rf1.data(), h1.cdata(), N);
+        F16ToF32_Generic(rf2.data(), h1.cdata(), N);
+        Expect(rf1 == rf2);
+    }
+
+#define TestNorm(T, To, From)\
+    {\
+        RawVector<T> n1(N), n2(N);\
+        To##_SIMD(n1.data(), f1.cdata(), N);\
+        To##_Generic(n2.data(), f1.cdata(), N);\
+        Expect(memcmp(n1.cdata(), n2.cdata(), sizeof(T) * N) == 0);\
+        From##_SIMD(rf1.data(), n1.cdata(), N);\
+        From##_Generic(rf2.data(), n1.cdata(), N);\
+        Expect(rf1 == rf2);\
+    }
+    TestNorm(snorm8, F32ToS8, S8ToF32);
+    TestNorm(unorm8, F32ToU8, U8ToF32);
+    TestNorm(unorm8n, F32ToU8N, U8NToF32);
+    TestNorm(snorm16, F32ToS16, S16ToF32);
+    TestNorm(unorm16, F32ToU16, U16ToF32);
+#undef TestNorm
+
+    {
+        rv1 = v1; rv2 = v1;
+        InvertX_SIMD(rv1.data(), N);
+        InvertX_Generic(rv2.data(), N);
+        Expect(rv1 == rv2);
+        rt1 = t1; rt2 = t1;
+        InvertX_SIMD(rt1.data(), N);
+        InvertX_Generic(rt2.data(), N);
+        Expect(rt1 == rt2);
+
+        rv1 = v1; rv2 = v1;
+        Scale_SIMD(rv1.data(), 0.01f, N);
+        Scale_Generic(rv2.data(), 0.01f, N);
+        Expect(rv1 == rv2);
+
+        rv1 = v1; rv2 = v1;
+        TestScope("Normalize_SIMD", [&]() { Normalize_SIMD(rv1.data(), N); }, 1);
+        TestScope("Normalize_Generic", [&]() { Normalize_Generic(rv2.data(), N); }, 1);
+        Expect(near_equal(rv1, rv2));
+    }
+    {
+        Lerp_SIMD(rf1.data(), f1.cdata(), f2.cdata(), N, 0.3f);
+        Lerp_Generic(rf2.data(), f1.cdata(), f2.cdata(), N, 0.3f);
+        Expect(near_equal(rf1, rf2));
+        LerpNormals_SIMD(rv1.data(), v1.cdata(), v2.cdata(), N, 0.3f);
+        LerpNormals_Generic(rv2.data(), v1.cdata(), v2.cdata(), N, 0.3f);
+        Expect(near_equal(rv1, rv2));
+        LerpTangents_SIMD(rt1.data(), t1.cdata(), t2.cdata(), N, 0.3f);
+        LerpTangents_Generic(rt2.data(), t1.cdata(), t2.cdata(), N, 0.3f);
+        Expect(near_equal(rt1, rt2));
+
+        Expect(NearEqual_SIMD(rf1.cdata(), rf2.cdata(), N, muEpsilon));
+        rf1[N - 1] += 1.0f;
+        Expect(!NearEqual_SIMD(rf1.cdata(), rf2.cdata(), N, muEpsilon));
+        rf1[N - 1] -= 1.0f;
+        rf1[7] += 1.0f;
+        Expect(!NearEqual_SIMD(rf1.cdata(), rf2.cdata(), N, muEpsilon));
+    }
+    {
+        int imin1, imax1, imin2, imax2;
+        TestScope("MinMax_SIMD", [&]() { MinMax_SIMD(ints.cdata(), N, imin1, imax1); }, T);
+        TestScope("MinMax_Generic", [&]() { MinMax_Generic(ints.cdata(), N, imin2, imax2); }, T);
+        Expect(imin1 == imin2 && imax1 == imax2);
+
+        float fmin1, fmax1, fmin2, fmax2;
+        MinMax_SIMD(f2.cdata(), N, fmin1, fmax1);
+        MinMax_Generic(f2.cdata(), N, fmin2, fmax2);
+        Expect(fmin1 == fmin2 && fmax1 == fmax2);
+
+        float2 min21, max21, min22, max22;
+        MinMax_SIMD((const float2*)f2.cdata(), N / 2, min21, max21);
+        MinMax_Generic((const float2*)f2.cdata(), N / 2, min22, max22);
+        Expect(min21 == min22 && max21 == max22);
+
+        float3 min31, max31, min32, max32;
+        TestScope("MinMax3_SIMD", [&]() { MinMax_SIMD(v1.cdata(), N, min31, max31); }, T);
+        TestScope("MinMax3_Generic", [&]() { MinMax_Generic(v1.cdata(), N, min32, max32); }, T);
+        Expect(min31 == min32 && max31 == max32);
+
+        float4 min41, max41, min42, max42;
+        MinMax_SIMD(t1.cdata(), N, min41, max41);
+        MinMax_Generic(t1.cdata(), N, min42, max42);
+        Expect(min41 == min42 && max41 == max42);
+    }
+    {
+        float4x4 m = transform(float3{ 1.0f, 2.0f, 3.0f }, rotate_y(30.0f * DegToRad), float3{ 1.5f, 0.5f, 2.0f });
+        TestScope("MulPoints_SIMD", [&]() { MulPoints_SIMD(m, v1.cdata(), rv1.data(), N); }, T);
+        TestScope("MulPoints_Generic", [&]() { MulPoints_Generic(m, v1.cdata(), rv2.data(), N); }, T);
+        Expect(near_equal(rv1, rv2));
+        MulVectors_SIMD(m, v1.cdata(), rv1.data(), N);
+        MulVectors_Generic(m, v1.cdata(), rv2.data(), N);
+        Expect(near_equal(rv1, rv2));
+    }
+    {
+        // a wavy grid of triangles
+        SharedVector<float3> points;
+        SharedVector<int> indices, counts;
+        SharedVector<float2> uv[ms::MeshSyncConstants::MAX_UV];
+        MeshGenerator::GenerateWaveMesh(counts, indices, points, uv, 10.0f, 0.5f, 128, 0.0f, true);
+        const int num_triangles = (int)indices.size() / 3;
+
+        RawVector<float3> flattened(indices.size());
+        RawVector<float> soa[9];
+        for (auto& s : soa)
+            s.resize(num_triangles);
+        for (size_t ii = 0; ii < indices.size(); ++ii) {
+            float3 p = points[indices[ii]];
+            flattened[ii] = p;
+            for (int c = 0; c < 3; ++c)
+                soa[(ii % 3) * 3 + c][ii / 3] = p[c];
+        }
+
+        for (int ri = 0; ri < 16; ++ri) {
+            // aim at the center of a random triangle
+            int target = (int)(rnd.f01() * (num_triangles - 1));
+            float3 center = (flattened[target * 3 + 0] + flattened[target * 3 + 1] + flattened[target * 3 + 2]) / 3.0f;
+            float3 dir = rnd.v3n();
+            float3 pos = center - dir * 20.0f;
+            int ti1 = -1, ti2 = -1;
+            float d1 = 0.0f, d2 = 0.0f;
+            int h1 = RayTrianglesIntersectionIndexed_SIMD(pos, dir, points.cdata(), indices.cdata(), num_triangles, ti1, d1);
+            int h2 = RayTrianglesIntersectionIndexed_Generic(pos, dir, points.cdata(), indices.cdata(), num_triangles, ti2, d2);
+            Expect(h1 == h2 && ti1 == ti2 && d1 == d2);
+            h1 = RayTrianglesIntersectionFlattened_SIMD(pos, dir, flattened.cdata(), num_triangles, ti1, d1);
+            h2 = RayTrianglesIntersectionFlattened_Generic(pos, dir, flattened.cdata(), num_triangles, ti2, d2);
+            Expect(h1 == h2 && ti1 == ti2 && d1 == d2);
+            h1 = RayTrianglesIntersectionSoA_SIMD(pos, dir,
+                soa[0].cdata(), soa[1].cdata(), soa[2].cdata(), soa[3].cdata(), soa[4].cdata(), soa[5].cdata(),
+                soa[6].cdata(), soa[7].cdata(), soa[8].cdata(), num_triangles, ti1, d1);
+            h2 = RayTrianglesIntersectionSoA_Generic(pos, dir,
+                soa[0].cdata(), soa[1].cdata(), soa[2].cdata(), soa[3].cdata(), soa[4].cdata(), soa[5].cdata(),
+                soa[6].cdata(), soa[7].cdata(), soa[8].cdata(), num_triangles, ti2, d2);
+            Expect(h1 == h2 && ti1 == ti2 && d1 == d2);
+            Expect(h1 > 0);
+        }
+
+        const int num_points = (int)points.size();
+        rv1.resize(num_points);
+        rv2.resize(num_points);
+        TestScope("GenerateNormalsTriangleIndexed_SIMD", [&]() {
+            GenerateNormalsTriangleIndexed_SIMD(rv1.data(), points.cdata(), indices.cdata(), num_triangles, num_points);
+        }, T);
+        TestScope("GenerateNormalsTriangleIndexed_Generic", [&]() {
+            GenerateNormalsTriangleIndexed_Generic(rv2.data(), points.cdata(), indices.cdata(), num_triangles, num_points);
+        }, T);
+        Expect(near_equal(rv1, rv2));
+        GenerateNormalsTriangleFlattened_SIMD(rv1.data(), flattened.cdata(), indices.cdata(), num_triangles, num_points);
+        GenerateNormalsTriangleFlattened_Generic(rv2.data(), flattened.cdata(), indices.cdata(), num_triangles, num_points);
+        Expect(near_equal(rv1, rv2));
+        GenerateNormalsTriangleSoA_SIMD(rv1.data(),
+            soa[0].cdata(), soa[1].cdata(), soa[2].cdata(), soa[3].cdata(), soa[4].cdata(), soa[5].cdata(),
+            soa[6].cdata(), soa[7].cdata(), soa[8].cdata(), indices.cdata(), num_triangles, num_points);
+        GenerateNormalsTriangleSoA_Generic(rv2.data(),
+            soa[0].cdata(), soa[1].cdata(), soa[2].cdata(), soa[3].cdata(), soa[4].cdata(), soa[5].cdata(),
+            soa[6].cdata(), soa[7].cdata(), soa[8].cdata(), indices.cdata(), num_triangles, num_points);
+        Expect(near_equal(rv1, rv2));
+    }
+}
+
+TestCase(TestSIMDISA)
+{
+    const int N = 100003;
+    Print("active ISA: %s\n", GetActiveSIMDISA());
+
+    Random rnd;
+    RawVector<float3> src(N), expected(N), result(N);
+    for (int i = 0; i < N; ++i)
+        src[i] = rnd.v3n() * rnd.f01() * 10.0f;
+    float4x4 m = transform(float3{ 1.0f, 2.0f, 3.0f }, rotate_y(0.5f), float3{ 2.0f, 2.0f, 2.0f });
+    MulPoints_Generic(m, src.cdata(), expected.data(), N);
+
+    // every supported ISA must be selectable and give the same results
+    auto isas = GetSupportedSIMDISAs();
+    Expect(!isas.empty() && strcmp(isas.back(), GetSIMDBackendName_SIMD()) == 0);
+    for (const char *isa : isas) {
+        Expect(SetActiveSIMDISA(isa));
+        Expect(strcmp(GetActiveSIMDISA(), isa) == 0);
+
+        MulPoints(m, src.cdata(), result.data(), N);
+        bool ok = NearEqual(result.cdata(), expected.cdata(), N);
+        Print("  %s: %s\n", isa, ok ? "ok" : "mismatch");
+        Expect(ok);
+    }
+
+    Expect(!SetActiveSIMDISA("unknown"));
+    Expect(!SetActiveSIMDISA(nullptr));
+    // "ispc" selects the ISPC target if this CPU can run one
+    Expect(SetActiveSIMDISA("ispc") == (isas.size() > 1));
+    Expect(SetActiveSIMDISA("auto"));
+    Expect(strcmp(GetActiveSIMDISA(), isas.front()) == 0);
+}
+
+TestCase(TestSIMDParallel)
+{
+    // large enough to be split into chunks. odd size to leave a partial chunk
+    const int N = 1000003;
+    const int T = 5;
+
+    Random rnd;
+    RawVector<float3> src(N), tmp(N), r1(N), r2(N);
+    RawVector<float3> n1(N), n2(N);
+    for (int i = 0; i < N; ++i) {
+        src[i] = rnd.v3n() * rnd.f01() * 10.0f;
+        n1[i] = rnd.v3n();
+        n2[i] = rnd.v3n();
+    }
+    float4x4 m = transform(float3{ 1.0f, 2.0f, 4.0f }, rotate_y(45.0f), float3{ 2.0f, 2.0f, 2.0f });
+
+    auto run = [&](RawVector<float3>& dst) {
+        MulPoints(m, src.cdata(), dst.data(), N);
+        MulVectors(m, dst.cdata(), tmp.data(), N);
+        Normalize(tmp.data(), N);
+        LerpNormals(tmp.data(), tmp.cdata(), n1.cdata(), N, 0.3f);
+        Lerp(dst.data(), dst.cdata(), tmp.cdata(), N, 0.5f);
+        Scale(dst.data(), 0.1f, N);
+        InvertX(dst.data(), N);
+    };
+    auto run_generic = [&](RawVector<float3>& dst) {
+        MulPoints_Generic(m, src.cdata(), dst.data(), N);
+        MulVectors_Generic(m, dst.cdata(), tmp.data(), N);
+        Normalize_Generic(tmp.data(), N);
+        LerpNormals_Generic(tmp.data(), tmp.cdata(), n1.cdata(), N, 0.3f);
+        Lerp_Generic((float*)dst.data(), (const float*)dst.cdata(), (const float*)tmp.cdata(), N * 3, 0.5f);
+        Scale_Generic(dst.data(), 0.1f, N);
+        InvertX_Generic(dst.data(), N);
+    };
+
+#ifdef muEnableThreadPool
+    int workers = ThreadPool::getWorkerCount();
+    ThreadPool::setWorkerCount(0);
+    TestScope("serial", [&]() { run(r1); }, T);
+    ThreadPool::setWorkerCount(std::max(workers, 3));
+    TestScope("parallel", [&]() { run(r1); }, T);
+    ThreadPool::setWorkerCount(workers);
+#else
+    TestScope("parallel", [&]() { run(r1); }, T);
+#endif
+    run_generic(r2);
+    Expect(NearEqual(r1.cdata(), r2.cdata(), N));
+
+    // chunked reduction must match the single pass one exactly
+    float3 pmin, pmax, gmin, gmax;
+    MinMax(r1.cdata(), N, pmin, pmax);
+    MinMax_Generic(r1.cdata(), N, gmin, gmax);
+    Expect(pmin == gmin && pmax == gmax);
+}
+
+TestCase(TestGatherAttributes)
+{
+    // shaped like Mesh::refine() on a face with many blendshapes: points expanded by seams and reordered
+    const int NumPoints = 1024 * 64;
+    const int NumIndices = NumPoints * 5 / 4 + 3;
+    const int NumFrames = 64;
+
+    Random rnd;
+    RawVector<int> indices(NumIndices);
+    for (int i = 0; i < NumIndices; ++i)
+        indices[i] = (int)(rnd.r() % NumPoints);
+
+    RawVector<float3> points(NumPoints);
+    RawVector<float2> uv(NumPoints);
+    RawVector<float4> colors(NumPoints);
+    RawVector<Weights4> weights(NumPoints);
+    std::vector<RawVector<float3>> deltas(NumFrames * 2);
+    for (int i = 0; i < NumPoints; ++i) {
+        points[i] = rnd.v3n();
+        uv[i] = { rnd.f01(), rnd.f01() };
+        colors[i] = { rnd.f01(), rnd.f01(), rnd.f01(), 1.0f };
+        weights[i].weights[0] = rnd.f01();
+        weights[i].indices[0] = i;
+    }
+    for (auto& d : deltas) {
+        d.resize_discard(NumPoints);
+        for (int i = 0; i < NumPoints; ++i)
+            d[i] = rnd.v3n();
+    }
+
+    RawVector<float3> r_points;
+    RawVector<float2> r_uv;
+    RawVector<float4> r_colors;
+    RawVector<Weights4> r_weights;
+    std::vector<RawVector<float3>> r_deltas(deltas.size());
+    r_points.resize_discard(NumIndices);
+    r_uv.resize_discard(NumIndices);
+    r_colors.resize_discard(NumIndices);
+    r_weights.resize_discard(NumIndices);
+    for (auto& d : r_deltas)
+        d.resize_discard(NumIndices);
+
+    std::vector<GatherStream> streams = {
+        { r_points.data(), points.cdata(), sizeof(float3) },
+        { r_uv.data(), uv.cdata(), sizeof(float2) },
+        { r_colors.data(), colors.cdata(), sizeof(float4) },
+        { r_weights.data(), weights.cdata(), sizeof(Weights4) },
+    };
+    for (size_t i = 0; i < deltas.size(); ++i)
+        streams.push_back({ r_deltas[i].data(), deltas[i].cdata(), sizeof(float3) });
+
+    // reference: one scalar pass per attribute
+    RawVector<float3> e_points(NumIndices);
+    RawVector<float2> e_uv(NumIndices);
+    RawVector<float4> e_colors(NumIndices);
+    RawVector<Weights4> e_weights(NumIndices);
+    std::vector<RawVector<float3>> e_deltas(deltas.size());
+    for (auto& d : e_deltas)
+        d.resize_discard(NumIndices);
+    auto copy = [&](auto *dst, const auto *src) {
+        for (int i = 0; i < NumIndices; ++i)
+            dst[i] = src[indices[i]];
+    };
+    TestScope("per attribute", [&]() {
+        copy(e_points.data(), points.cdata());
+        copy(e_uv.data(), uv.cdata());
+        copy(e_colors.data(), colors.cdata());
+        copy(e_weights.data(), weights.cdata());
+        for (size_t i = 0; i < deltas.size(); ++i)
+            copy(e_deltas[i].data(), deltas[i].cdata());
+    }, 5);
+    TestScope("GatherAttributes", [&]() {
+        GatherAttributes(streams.data(), streams.size(), indices.cdata(), indices.size());
+    }, 5);
+
+    Expect(r_points == e_points);
+    Expect(r_uv == e_uv);
+    Expect(r_colors == e_colors);
+    Expect(memcmp(r_weights.cdata(), e_weights.cdata(), r_weights.size_in_byte()) == 0);
+    bool deltas_match = true;
+    for (size_t i = 0; i < deltas.size(); ++i)
+        deltas_match = deltas_match && r_deltas[i] == e_deltas[i];
+    Expect(deltas_match);
+
+    // odd element size takes the generic path
+    RawVector<char> src3(NumPoints * 3), dst3(NumIndices * 3);
+    for (auto& c : src3)
+        c = (char)rnd.r();
+    GatherStream s3{ dst3.data(), src3.cdata(), 3 };
+    GatherAttributes(&s3, 1, indices.cdata(), indices.size());
+    bool odd_match = true;
+    for (int i = 0; i < NumIndices; ++i)
+        odd_match = odd_match && memcmp(&dst3[i * 3], &src3[indices[i] * 3], 3) == 0;
+    Expect(odd_match);
+}
+
 TestCase(TestCompareRawVector)
 {
     const size_t input_size = 10000000;
@@ -1168,6 +2267,91 @@ TestCase(Test_Quadify)
         QuadifyTriangles(points, triangles, false, 15.0f, dst_indices, dst_counts);
         Expect(dst_counts.size() == 4);
     }
+
+    // shuffled grid: only full search can pair triangles that are not next to each other
+    {
+        const int div = 128;
+        RawVector<float3> points;
+        RawVector<int> triangles;
+        for (int y = 0; y <= div; ++y)
+            for (int x = 0; x <= div; ++x)
+                points.push_back({ (float)x, (float)y, 0.0f });
+        std::vector<std::array<int, 3>> tris;
+        for (int y = 0; y < div; ++y) {
+            for (int x = 0; x < div; ++x) {
+                int i0 = y * (div + 1) + x;
+                int i1 = i0 + 1, i2 = i0 + div + 2, i3 = i0 + div + 1;
+                tris.push_back({ i0, i1, i2 });
+                tris.push_back({ i0, i2, i3 });
+            }
+        }
+        std::mt19937 rng(1);
+        std::shuffle(tris.begin(), tris.end(), rng);
+        for (auto& t : tris)
+            triangles.insert(triangles.end(), t.begin(), t.end());
+
+        RawVector<int> dst_indices, dst_counts;
+        TestScope("QuadifyTriangles full search", [&]() {
+            dst_indices.clear(); dst_counts.clear();
+            QuadifyTriangles(points, triangles, true, 15.0f, dst_indices, dst_counts);
+        });
+        Expect(dst_counts.size() == div * div);
+        Expect(dst_indices.size() == div * div * 4);
+
+        // all quads must face +z
+        bool ok = true;
+        for (size_t qi = 0; qi < dst_counts.size(); ++qi) {
+            const int *q = &dst_indices[qi * 4];
+            for (int i = 0; i < 4; ++i) {
+                float3 p0 = points[q[i]], p1 = points[q[(i + 1) % 4]], p2 = points[q[(i + 2) % 4]];
+                ok = ok && cross(p1 - p0, p2 - p1).z > 0.0f;
+            }
+        }
+        Expect(ok);
+    }
+
+    // pole: every triangle shares the center vertex. must not be quadratic in the valence.
+    {
+        const int n = 1024 * 64;
+        RawVector<float3> points;
+        RawVector<int> triangles;
+        points.push_back(float3::zero());
+        for (int i = 0; i < n; ++i) {
+            float a = (float)i / (float)n * 2.0f * PI;
+            points.push_back({ std::cos(a), std::sin(a), 0.0f });
+        }
+        for (int i = 0; i < n; ++i) {
+            triangles.push_back(0);
+            triangles.push_back(1 + i);
+            triangles.push_back(1 + (i + 1) % n);
+        }
+
+        RawVector<int> dst_indices, dst_counts;
+        TestScope("QuadifyTriangles pole", [&]() {
+            QuadifyTriangles(points, triangles, false, 90.0f, dst_indices, dst_counts);
+        });
+        int num_source_triangles = 0;
+        for (int c : dst_counts)
+            num_source_triangles += c - 2;
+        Expect(num_source_triangles == n);
+        Expect(dst_counts.size() < (size_t)n);
+    }
+
+    // folded square: merged only if the fold is within threshold_planarity
+    {
+        float3 points[] = {
+            {0.0f, 0.0f, 0.0f}, {1.0f, 0.0f, 0.0f}, {1.0f, 1.0f, 0.0f}, {0.0f, 1.0f, 0.5f},
+        };
+        int triangles[] = { 0,1,2, 0,2,3 };
+
+        RawVector<int> dst_indices, dst_counts;
+        QuadifyTriangles(points, triangles, true, 45.0f, dst_indices, dst_counts, 10.0f);
+        Expect(dst_counts.size() == 2);
+
+        dst_indices.clear(); dst_counts.clear();
+        QuadifyTriangles(points, triangles, true, 45.0f, dst_indices, dst_counts, 45.0f);
+        Expect(dst_counts.size() == 1);
+    }
 }
 
 #endif // SKIP_UTILS_TEST
\ No newline at end of file
@@ -3,6 +3,7 @@
 #include <vector>
 #include <memory>
 #include "MeshUtils/muAlgorithm.h"
+#include "MeshUtils/muBVH.h"
 #include "MeshUtils/muColor.h"
 #include "MeshUtils/muCompression.h"
 #include "MeshUtils/muConcurrency.h"
@@ -11,24 +12,37 @@
 #include "MeshUtils/muIntrusiveArray.h"
 #include "MeshUtils/muLimits.h"
 #include "MeshUtils/muMath.h"
+#include "MeshUtils/muMeshlet.h"
 #include "MeshUtils/muMisc.h"
 #include "MeshUtils/muQuat32.h"
 #include "MeshUtils/muRawVector.h"
 #include "MeshUtils/muSIMD.h"
 #include "MeshUtils/muStream.h"
+#include "MeshUtils/muTaskScheduler.h"
 #include "MeshUtils/muVertex.h"
 
 namespace mu {
 
 struct MeshConnectionInfo;
+struct MeshTopologyContext;
 
 bool GenerateNormalsPoly(RawVector<float3>& dst,
     const IArray<float3> points, const IArray<int> counts, const IArray<int> indices, bool flip);
+// uses the connection and face offsets of topology, building them if they are not yet
+bool GenerateNormalsPoly(RawVector<float3>& dst, MeshTopologyContext& topology, bool flip);
 
 void GenerateNormalsWithSmoothAngle(RawVector<float3>& dst,
     const IArray<float3> points,
     const IArray<int> counts, const IArray<int> indices,
     float smooth_angle, bool flip);
+void GenerateNormalsWithSmoothAngle(RawVector<float3>& dst, MeshTopologyContext& topology, float smooth_angle, bool flip);
+
+// points, uv and normals are per vertex. counts can be empty if indices are triangles.
+void GenerateTangentsPoly(RawVector<float4>& dst,
+    const IArray<float3> points, const IArray<float2> uv, const IArray<float3> normals,
+    const IArray<int> counts, const IArray<int> indices);
+void GenerateTangentsPoly(RawVector<float4>& dst,
+    const IArray<float2> uv, const IArray<float3> normals, MeshTopologyContext& topology);
 
 
 // PointsIter: indexed_iterator<const float3*, int*> or indexed_iterator_s<const float3*, int*>
@@ -45,8 +59,41 @@ void GenerateTangentsPoly(float4 *dst,
     const int *counts, const int *offsets, const int *indices,
     int num_faces, int num_vertices);
 
+// merges pairs of edge-adjacent triangles into quads. results are appended to dst_indices and dst_counts.
+// threshold_angle: max deviation (in degrees) of quad corners from 90 degrees.
+// threshold_planarity: max angle (in degrees) between normals of the two triangles.
+// full_search: pair any edge-adjacent triangles. otherwise only triangles next to each other in index order are paired.
+// O(n log n) in the number of candidate pairs.
 void QuadifyTriangles(const IArray<float3> vertices, const IArray<int> triangle_indices, bool full_search, float threshold_angle,
-    RawVector<int>& dst_indices, RawVector<int>& dst_counts);
+    RawVector<int>& dst_indices, RawVector<int>& dst_counts, float threshold_planarity = 90.0f);
+
+// dst[i] = the lowest index j that points[j] matches points[i] (dst[i] == i if no other point matches).
+// eps == 0: exact match (operator==). eps > 0: every component differs less than eps. matches are not transitive,
+// so with eps > 0 dst[i] is resolved to the representative of the matched point.
+// points are bucketed by a spatial hash, so this is O(n) expected.
+void WeldVertices(RawVector<int>& dst, const IArray<float3> points, float eps = 0.0f);
+
+struct VertexCacheStatistics
+{
+    float acmr = 0.0f; // average cache miss ratio: transformed vertices per triangle. 0.5 - 3.0, lower is better.
+    float atvr = 0.0f; // average transformed vertex ratio: transformed vertices per referenced vertex. 1.0 is optimal.
+};
+// simulates a FIFO post-transform cache of cache_size vertices over triangle indices.
+VertexCacheStatistics AnalyzeVertexCache(const IArray<int> triangle_indices, int num_vertices, int cache_size = 16);
+
+// reorders triangles in place for post-transform cache locality (Tipsify, Sander et al. 2007). linear time.
+// indices must be in [0, num_vertices).
+void OptimizeVertexCache(IArray<int> triangle_indices, int num_vertices, int cache_size = 16);
+
+// dst[new_index] = old_index. vertices are ordered by first use in indices, then unreferenced vertices in
+// the original order. indices are rewritten to the new vertex order.
+void OptimizeVertexFetch(RawVector<int>& dst, IArray<int> indices, int num_vertices);
+
+// splits triangles into meshlets of at most max_vertices (<= 256) vertices and max_triangles triangles. results are appended.
+// meshlets grow through the vertex to face connection, preferring triangles that add the fewest vertices.
+// dst_vertices: indices to points. dst_triangles: indices to the vertices of the meshlet.
+void BuildMeshlets(RawVector<Meshlet>& dst, RawVector<int>& dst_vertices, RawVector<uint8_t>& dst_triangles,
+    const IArray<int> triangle_indices, const IArray<float3> points, int max_vertices = 64, int max_triangles = 124);
 
 template<class Handler>
 void SelectEdge(const IArray<int>& indices, int ngon, const IArray<float3>& vertices,
@@ -123,9 +170,15 @@ inline void CopyWithIndices(T *dst, const T *src, const IArray<int> indices)
     if (!dst || !src)
         return;
 
-    size_t size = indices.size();
-    for (int i = 0; i < (int)size; ++i) {
-        dst[i] = src[indices[i]];
+    if constexpr (std::is_trivially_copyable<T>::value) {
+        GatherStream stream{ dst, src, sizeof(T) };
+        GatherAttributes(&stream, 1, indices.data(), indices.size());
+    }
+    else {
+        size_t size = indices.size();
+        for (int i = 0; i < (int)size; ++i) {
+            dst[i] = src[indices[i]];
+        }
     }
 }
 
@@ -200,3 +253,4 @@ inline void MirrorTopology(int *dst_counts, int *dst_indices, const IArray<int>&
 
 #include "MeshUtils_impl.h"
 #include "muMeshRefiner.h"
+#include "muMeshSimplifier.h"
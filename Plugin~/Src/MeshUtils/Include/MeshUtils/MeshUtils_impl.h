@@ -35,7 +35,7 @@ struct OffsetsC
 
 
 template<class Indices, class Counts>
-inline void BuildConnection(
+inline void BuildConnectionSerial(
     MeshConnectionInfo& connection, const Indices& indices, const Counts& counts, const IArray<float3>& vertices)
 {
     size_t num_points = vertices.size();
@@ -57,11 +57,7 @@ inline void BuildConnection(
             ii += c;
         }
 
-        int offset = 0;
-        for (size_t i = 0; i < num_points; ++i) {
-            connection.v2f_offsets[i] = offset;
-            offset += connection.v2f_counts[i];
-        }
+        parallel_exclusive_scan(connection.v2f_counts.cdata(), connection.v2f_offsets.data(), (int)num_points);
     }
 
     connection.v2f_counts.zeroclear();
@@ -80,6 +76,92 @@ inline void BuildConnection(
     }
 }
 
+// faces are split into one chunk per thread. each chunk counts its references into its own histogram,
+// the histograms are turned into per chunk write positions and each chunk scatters its faces without atomics.
+// faces are visited in the same order as BuildConnectionSerial() so the result is identical.
+template<class Indices, class Counts>
+inline void BuildConnection(
+    MeshConnectionInfo& connection, const Indices& indices, const Counts& counts, const IArray<float3>& vertices)
+{
+    const int MinIndicesPerChunk = 1024 * 32;
+
+    int num_points = (int)vertices.size();
+    int num_faces = (int)counts.size();
+    int num_indices = (int)indices.size();
+
+    int num_chunks = std::min(num_indices / MinIndicesPerChunk, parallel_concurrency());
+    // each chunk needs a histogram of num_points. don't let them outgrow the index buffer
+    num_chunks = std::min(num_chunks, (int)((int64_t)num_indices * 2 / std::max(num_points, 1)));
+    if (num_chunks <= 1) {
+        BuildConnectionSerial(connection, indices, counts, vertices);
+        return;
+    }
+
+    connection.v2f_counts.resize_discard(num_points);
+    connection.v2f_offsets.resize_discard(num_points);
+    connection.v2f_faces.resize_discard(num_indices);
+    connection.v2f_indices.resize_discard(num_indices);
+
+    const int faces_per_chunk = ceildiv(num_faces, num_chunks);
+    RawVector<int> chunk_offsets(num_chunks + 1); // first index of each chunk
+    RawVector<int> histograms((size_t)num_points * num_chunks);
+
+    // count
+    parallel_for(0, num_chunks, 1, [&](int ki) {
+        int fb = faces_per_chunk * ki;
+        int fe = std::min(fb + faces_per_chunk, num_faces);
+        int n = 0;
+        for (int fi = fb; fi < fe; ++fi)
+            n += counts[fi];
+        chunk_offsets[ki + 1] = n;
+    });
+    chunk_offsets[0] = 0;
+    for (int ki = 0; ki < num_chunks; ++ki)
+        chunk_offsets[ki + 1] += chunk_offsets[ki];
+
+    parallel_for(0, num_chunks, 1, [&](int ki) {
+        int *hist = histograms.data() + (size_t)num_points * ki;
+        std::fill_n(hist, num_points, 0);
+        int ib = chunk_offsets[ki];
+        int ie = chunk_offsets[ki + 1];
+        for (int ii = ib; ii < ie; ++ii)
+            hist[indices[ii]]++;
+    });
+
+    // histograms -> start of each chunk within the vertex's range
+    parallel_for_blocked(0, num_points, 1024 * 4, [&](int vb, int ve) {
+        for (int vi = vb; vi < ve; ++vi) {
+            int total = 0;
+            for (int ki = 0; ki < num_chunks; ++ki) {
+                int& h = histograms[(size_t)num_points * ki + vi];
+                int c = h;
+                h = total;
+                total += c;
+            }
+            connection.v2f_counts[vi] = total;
+        }
+    });
+    parallel_exclusive_scan(connection.v2f_counts.cdata(), connection.v2f_offsets.data(), num_points);
+
+    // scatter
+    parallel_for(0, num_chunks, 1, [&](int ki) {
+        int *pos = histograms.data() + (size_t)num_points * ki;
+        int fb = faces_per_chunk * ki;
+        int fe = std::min(fb + faces_per_chunk, num_faces);
+        int i = chunk_offsets[ki];
+        for (int fi = fb; fi < fe; ++fi) {
+            int c = counts[fi];
+            for (int ci = 0; ci < c; ++ci) {
+                int vi = indices[i + ci];
+                int ti = connection.v2f_offsets[vi] + pos[vi]++;
+                connection.v2f_faces[ti] = fi;
+                connection.v2f_indices[ti] = i + ci;
+            }
+            i += c;
+        }
+    });
+}
+
 inline void BuildWeldMap(
     MeshConnectionInfo& connection, const IArray<float3>& vertices)
 {
@@ -94,28 +176,14 @@ inline void BuildWeldMap(
     weld_offsets.resize_discard(n);
     weld_indices.resize_discard(n);
 
-    parallel_for(0, n, [&](int vi) {
-        int r = vi;
-        float3 p = vertices[vi];
-        for (int i = 0; i < vi; ++i) {
-            if (vertices[i] == p) {
-                r = i;
-                break;
-            }
-        }
-        weld_map[vi] = r;
-    });
+    WeldVertices(weld_map, vertices);
 
     weld_counts.zeroclear();
     for (int vi : weld_map) {
         weld_counts[vi]++;
     }
 
-    int offset = 0;
-    for (int vi = 0; vi < n; ++vi) {
-        weld_offsets[vi] = offset;
-        offset += weld_counts[vi];
-    }
+    parallel_exclusive_scan(weld_counts.cdata(), weld_offsets.data(), n);
 
     weld_counts.zeroclear();
     for (int vi = 0; vi < n; ++vi) {
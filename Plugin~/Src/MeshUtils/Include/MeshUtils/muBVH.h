@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cfloat>
+
+#include "MeshUtils/muMath.h"
+#include "MeshUtils/muRawVector.h"
+#include "MeshUtils/muIntrusiveArray.h"
+
+namespace mu {
+
+// bounding volume hierarchy over triangles for ray and closest point queries on large meshes.
+// built top-down with binned SAH. large nodes are binned and their subtrees built in parallel.
+// vertices of the triangles in each leaf are stored in SoA and tested by RayTrianglesIntersectionSoA() (ISPC or
+// intrinsics). for small meshes RayTrianglesIntersection*() without a BVH are faster.
+// refit() updates the bounds of a deforming mesh without changing the tree. queries get slower as nodes start to
+// overlap, so rebuild after large deformations.
+struct TriangleBVH
+{
+    // inputs. points are referenced again by refit(), indices only by build().
+    IArray<float3> points;
+    IArray<int> indices;            // triangles
+    int max_leaf_triangles = 8;     // leaves can be smaller if SAH says so
+    int num_bins = 16;              // 4 - 32
+
+    void build();
+    // points moved but their number and the triangles are the same as on build()
+    void refit();
+    void clear();
+    bool empty() const;
+    size_t getNodeCount() const;
+
+    // closest hit of the ray pos + dir * t (t >= 0). distance is t, so it is in units of dir's length.
+    // tindex is the index of the triangle in indices. returns false and leaves tindex -1 if nothing is hit.
+    bool raycast(float3 pos, float3 dir, int& tindex, float& distance) const;
+    // multiple rays. rays are traversed in packets of 8 that test boxes together, which pays off for coherent rays
+    // (e.g. picking or projection from one view). dst_tindices is -1 for missed rays and dst_distances FLT_MAX.
+    // packets run in parallel.
+    void raycast(const float3 *pos, const float3 *dir, int num_rays, int *dst_tindices, float *dst_distances) const;
+
+    // closest point on the mesh within max_distance from pos. returns false if there is none.
+    bool closestPoint(float3 pos, int& tindex, float3& dst_point, float max_distance = FLT_MAX) const;
+
+private:
+    struct Node
+    {
+        float3 bmin;
+        int offset;     // leaf: first triangle in m_order. inner: index of the left child. the right one follows it
+        float3 bmax;
+        int count;      // leaf: number of triangles. inner: 0
+    };
+    struct BuildContext;
+
+    void buildNode(BuildContext& ctx, int node_index, int first, int count, int depth);
+    void updateLeafVertices();
+    void raycastPacket(const float3 *pos, const float3 *dir, int num_rays, int *dst_tindices, float *dst_distances) const;
+
+    RawVector<Node> m_nodes;
+    RawVector<int> m_order;         // triangle indices in leaf order
+    RawVector<int> m_indices;       // copy of indices, for refit()
+    RawVector<float> m_vertices[9]; // v1x, v1y, v1z, v2x, ... of m_order
+};
+
+} // namespace mu
@@ -1,15 +1,109 @@
 #pragma once
 
 #include "MeshUtils/muConfig.h"
+#include <algorithm>
 #include <atomic>
+#include <exception>
+#include <functional>
+#include <iterator>
+#include <thread>
+#include <type_traits>
+#include <vector>
 #if defined(muEnablePPL)
     #include <ppl.h>
 #elif defined(muEnableTBB)
     #include <tbb/tbb.h>
+#elif !defined(muDisableThreadPool)
+    #define muEnableThreadPool
 #endif
 
 namespace mu {
 
+#ifdef muEnableThreadPool
+
+// Built-in work-stealing scheduler used by parallel_for & co. when neither PPL nor TBB is available.
+// Each worker owns a deque of range tasks. A range is split in halves until it fits the grain size,
+// the upper halves are pushed to the local deque and idle workers steal them from the front.
+// The thread that waits for a group participates in the execution, so nested parallel loops can't deadlock.
+class ThreadPool
+{
+public:
+    using RangeFunc = void(*)(const void *ctx, int begin, int end);
+
+    struct TaskGroup
+    {
+        std::atomic<int> pending{ 0 };
+        // the first exception thrown by a task. the rest of the group's tasks are skipped once it is set.
+        std::atomic<bool> failed{ false };
+        std::exception_ptr exception;
+    };
+
+    static ThreadPool& instance();
+
+    // 0: std::thread::hardware_concurrency() - 1. the calling thread always helps, so 0 workers means serial.
+    static void setWorkerCount(int n);
+    static int getWorkerCount();
+    // grain size used by parallel_for() variants that don't take granularity. 0: automatic
+    static void setDefaultGrainSize(int n);
+    static int getDefaultGrainSize();
+    // true if the current thread is one of the pool's workers
+    static bool isWorkerThread();
+
+    int workerCount() const;
+    int grainSize(int num_elements) const;
+
+    // executes func(ctx, b, e) for [begin, end) split into chunks of at most grain elements. blocks until done.
+    // an exception thrown by func is rethrown here after all chunks have finished.
+    void run(RangeFunc func, const void *ctx, int begin, int end, int grain);
+
+    // low level interface. wait() helps executing pending tasks until the group is completed and rethrows the
+    // exception of the group if a task threw.
+    void spawn(TaskGroup& group, RangeFunc func, const void *ctx, int begin, int end, int grain);
+    void wait(TaskGroup& group);
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+private:
+    ThreadPool();
+    ~ThreadPool();
+
+    class Impl;
+    Impl *m_impl = nullptr;
+};
+
+template<class Body>
+inline void parallel_for_impl(int begin, int end, int granularity, const Body& body)
+{
+    if (end <= begin)
+        return;
+    if (granularity >= end - begin || ThreadPool::getWorkerCount() == 0) {
+        for (; begin != end; ++begin) { body(begin); }
+        return;
+    }
+    ThreadPool::instance().run([](const void *ctx, int b, int e) {
+        const Body& f = *static_cast<const Body*>(ctx);
+        for (; b != e; ++b) { f(b); }
+    }, &body, begin, end, granularity);
+}
+
+template<class Body>
+inline void parallel_for_blocked_impl(int begin, int end, int granularity, const Body& body)
+{
+    if (end <= begin)
+        return;
+    if (granularity >= end - begin || ThreadPool::getWorkerCount() == 0) {
+        for (; begin < end; begin += granularity)
+            body(begin, std::min(begin + granularity, end));
+        return;
+    }
+    ThreadPool::instance().run([](const void *ctx, int b, int e) {
+        (*static_cast<const Body*>(ctx))(b, e);
+    }, &body, begin, end, granularity);
+}
+
+#endif // muEnableThreadPool
+
 template<class Index, class Body>
 inline void parallel_for(Index begin, Index end, const Body& body)
 {
@@ -17,12 +111,21 @@ inline void parallel_for(Index begin, Index end, const Body& body)
     concurrency::parallel_for(begin, end, body);
 #elif defined(muEnableTBB)
     tbb::parallel_for(begin, end, body);
+#elif defined(muEnableThreadPool)
+    const int b = (int)begin, e = (int)end;
+    parallel_for_impl(b, e, ThreadPool::instance().grainSize(e - b), [&body](int i) { body((Index)i); });
 #else
     for (; begin != end; ++begin) { body(begin); }
 #endif
 }
 
-#if defined(muEnablePPL) || defined(muEnableTBB)
+#if defined(muEnableThreadPool)
+template<class Body>
+inline void parallel_for(int begin, int end, int granularity, const Body& body)
+{
+    parallel_for_impl(begin, end, std::max(granularity, 1), body);
+}
+#elif defined(muEnablePPL) || defined(muEnableTBB)
 template<class Body>
 inline void parallel_for(int begin, int end, int granularity, const Body& body)
 {
@@ -47,6 +150,10 @@ inline void parallel_for(int begin, int end, int /*granularity*/, const Body& bo
 template<class Body>
 inline void parallel_for_blocked(int begin, int end, int granularity, const Body& body)
 {
+#if defined(muEnableThreadPool)
+    // the pool never splits a range below the grain, so the blocks can be handed over as they are
+    parallel_for_blocked_impl(begin, end, std::max(granularity, 1), body);
+#else
     int num_elements = end - begin;
     int num_blocks = ceildiv(num_elements, granularity);
     parallel_for(0, num_blocks, [&](int i) {
@@ -54,6 +161,7 @@ inline void parallel_for_blocked(int begin, int end, int granularity, const Body
         int end = std::min<int>(granularity * (i + 1), num_elements);
         body(begin, end);
     });
+#endif
 }
 
 template<class Iter, class Body>
@@ -63,6 +171,14 @@ inline void parallel_for_each(Iter begin, Iter end, const Body& body)
     concurrency::parallel_for_each(begin, end, body);
 #elif defined(muEnableTBB)
     tbb::parallel_for_each(begin, end, body);
+#elif defined(muEnableThreadPool)
+    using category = typename std::iterator_traits<Iter>::iterator_category;
+    if constexpr (std::is_base_of<std::random_access_iterator_tag, category>::value) {
+        parallel_for(0, (int)std::distance(begin, end), [&](int i) { body(begin[i]); });
+    }
+    else {
+        for (; begin != end; ++begin) { body(*begin); }
+    }
 #else
     for (; begin != end; ++begin) { body(*begin); }
 #endif
@@ -79,6 +195,15 @@ inline void parallel_invoke(Bodies... bodies) { concurrency::parallel_invoke(bod
 template <class... Bodies>
 inline void parallel_invoke(Bodies... bodies) { tbb::parallel_invoke(bodies...); }
 
+#elif defined(muEnableThreadPool)
+
+template <class... Bodies>
+inline void parallel_invoke(const Bodies&... bodies)
+{
+    const std::function<void()> tasks[] = { std::cref(bodies)... };
+    parallel_for(0, (int)sizeof...(Bodies), 1, [&tasks](int i) { tasks[i](); });
+}
+
 #else
 
 template <class Body>
@@ -92,6 +217,119 @@ void parallel_invoke(const Body& first, Args... args) {
 
 #endif
 
+
+// number of threads parallel_for() can run on. used to size per thread scratch buffers.
+inline int parallel_concurrency()
+{
+#if defined(muEnableThreadPool)
+    return ThreadPool::getWorkerCount() + 1;
+#else
+    return std::max((int)std::thread::hardware_concurrency(), 1);
+#endif
+}
+
+// the range is split into fixed chunks of granularity elements and partial results are joined in chunk order.
+// so the result doesn't depend on the number of threads even if join is not associative for floating point.
+// body: [](int begin, int end, T acc) -> T
+// join: [](const T& a, const T& b) -> T
+template<class T, class Body, class Join>
+inline T parallel_reduce(int begin, int end, int granularity, const T& identity, const Body& body, const Join& join)
+{
+    if (end <= begin)
+        return identity;
+    granularity = std::max(granularity, 1);
+    const int num_chunks = (end - begin + granularity - 1) / granularity;
+    if (num_chunks == 1)
+        return body(begin, end, identity);
+
+    std::vector<T> partials(num_chunks, identity);
+    parallel_for(0, num_chunks, 1, [&](int ci) {
+        int b = begin + granularity * ci;
+        int e = std::min(b + granularity, end);
+        partials[ci] = body(b, e, identity);
+    });
+
+    T ret = partials[0];
+    for (int ci = 1; ci < num_chunks; ++ci)
+        ret = join(ret, partials[ci]);
+    return ret;
+}
+
+// two pass chunked scan.
+// reduce_body: [](int begin, int end, T acc) -> T  accumulates a chunk. it must not write anything.
+// scan_body: [](int begin, int end, T prefix)      writes a chunk. prefix is the sum of everything before begin.
+// returns the sum of the whole range.
+template<class T, class ReduceBody, class ScanBody, class Join>
+inline T parallel_scan(int begin, int end, int granularity, const T& identity,
+    const ReduceBody& reduce_body, const ScanBody& scan_body, const Join& join)
+{
+    if (end <= begin)
+        return identity;
+    granularity = std::max(granularity, 1);
+    const int num_chunks = (end - begin + granularity - 1) / granularity;
+    if (num_chunks == 1) {
+        // the total must be taken before scan_body() writes: the scan can be in place
+        T total = reduce_body(begin, end, identity);
+        scan_body(begin, end, identity);
+        return total;
+    }
+
+    std::vector<T> prefixes(num_chunks + 1, identity);
+    parallel_for(0, num_chunks, 1, [&](int ci) {
+        int b = begin + granularity * ci;
+        int e = std::min(b + granularity, end);
+        prefixes[ci + 1] = reduce_body(b, e, identity);
+    });
+    for (int ci = 0; ci < num_chunks; ++ci)
+        prefixes[ci + 1] = join(prefixes[ci], prefixes[ci + 1]);
+
+    parallel_for(0, num_chunks, 1, [&](int ci) {
+        int b = begin + granularity * ci;
+        int e = std::min(b + granularity, end);
+        scan_body(b, e, prefixes[ci]);
+    });
+    return prefixes[num_chunks];
+}
+
+// dst[i] = src[0] + ... + src[i]. src and dst can be the same. returns the total.
+template<class T, class Op = std::plus<T>>
+inline T parallel_inclusive_scan(const T *src, T *dst, int num, const T& identity = T(), const Op& op = Op(), int granularity = 1024 * 16)
+{
+    return parallel_scan(0, num, granularity, identity,
+        [&](int b, int e, T acc) {
+            for (int i = b; i < e; ++i)
+                acc = op(acc, src[i]);
+            return acc;
+        },
+        [&](int b, int e, T acc) {
+            for (int i = b; i < e; ++i) {
+                acc = op(acc, src[i]);
+                dst[i] = acc;
+            }
+        },
+        op);
+}
+
+// dst[i] = src[0] + ... + src[i-1]. src and dst can be the same. returns the total.
+template<class T, class Op = std::plus<T>>
+inline T parallel_exclusive_scan(const T *src, T *dst, int num, const T& identity = T(), const Op& op = Op(), int granularity = 1024 * 16)
+{
+    return parallel_scan(0, num, granularity, identity,
+        [&](int b, int e, T acc) {
+            for (int i = b; i < e; ++i)
+                acc = op(acc, src[i]);
+            return acc;
+        },
+        [&](int b, int e, T acc) {
+            for (int i = b; i < e; ++i) {
+                T v = src[i];
+                dst[i] = acc;
+                acc = op(acc, v);
+            }
+        },
+        op);
+}
+
 template<class T>
 class scoped_lock
 {
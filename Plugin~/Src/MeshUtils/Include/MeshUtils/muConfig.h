@@ -6,6 +6,7 @@
 // available options:
 //   muEnablePPL
 //   muEnableTBB
+//   muDisableThreadPool (use serial loops instead of the built-in thread pool when PPL/TBB are disabled)
 //   muEnableAMP
 //   muEnableSymbol
 
@@ -1503,6 +1503,41 @@ inline bool ray_triangle_intersection(
     return distance >= T(0.0);
 }
 
+// closest point to pos on the triangle (p1, p2, p3). Ericson, Real-Time Collision Detection 5.1.5
+template<class T>
+inline tvec3<T> closest_point_on_triangle(
+    const tvec3<T>& pos, const tvec3<T>& p1, const tvec3<T>& p2, const tvec3<T>& p3)
+{
+    auto ab = p2 - p1;
+    auto ac = p3 - p1;
+    auto ap = pos - p1;
+    T d1 = dot(ab, ap), d2 = dot(ac, ap);
+    if (d1 <= T(0.0) && d2 <= T(0.0)) return p1;
+
+    auto bp = pos - p2;
+    T d3 = dot(ab, bp), d4 = dot(ac, bp);
+    if (d3 >= T(0.0) && d4 <= d3) return p2;
+
+    T vc = d1 * d4 - d3 * d2;
+    if (vc <= T(0.0) && d1 >= T(0.0) && d3 <= T(0.0))
+        return p1 + ab * (d1 / (d1 - d3));
+
+    auto cp = pos - p3;
+    T d5 = dot(ab, cp), d6 = dot(ac, cp);
+    if (d6 >= T(0.0) && d5 <= d6) return p3;
+
+    T vb = d5 * d2 - d1 * d6;
+    if (vb <= T(0.0) && d2 >= T(0.0) && d6 <= T(0.0))
+        return p1 + ac * (d2 / (d2 - d6));
+
+    T va = d3 * d6 - d5 * d4;
+    if (va <= T(0.0) && (d4 - d3) >= T(0.0) && (d5 - d6) >= T(0.0))
+        return p2 + (p3 - p2) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+
+    T denom = T(1.0) / (va + vb + vc);
+    return p1 + ab * (vb * denom) + ac * (vc * denom);
+}
+
 // pos must be on the triangle
 template<class T, class U>
 inline U triangle_interpolation(
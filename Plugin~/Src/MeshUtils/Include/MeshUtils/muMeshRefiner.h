@@ -4,8 +4,10 @@
 
 #include "MeshUtils/MeshUtilsConstants.h" //MAX_MESH_REFINER_ATTRIBUTES
 #include "MeshUtils/muMath.h"
+#include "MeshUtils/muMeshlet.h"
 #include "MeshUtils/muRawVector.h"
 #include "MeshUtils/muIntrusiveArray.h"
+#include "MeshUtils/muConcurrency.h"
 
 namespace mu {
 
@@ -58,6 +60,45 @@ bool IsEdgeOpened(const IArray<int>& indices, int ngon, const MeshConnectionInfo
 bool IsEdgeOpened(const IArray<int>& indices, const IArray<int>& counts, const IArray<int>& offsets, const MeshConnectionInfo& connection, int i0, int i1);
 
 
+// connectivity of one mesh shared by the stages of a refine (normals, tangents, re-indexing).
+// each part is built on first use and kept until the topology changes.
+// counts, indices and points are referenced, not copied. empty counts means indices are triangles.
+struct MeshTopologyContext
+{
+    // binds the mesh and discards everything built so far. call again when counts or indices change.
+    void setup(const IArray<int>& counts, const IArray<int>& indices, const IArray<float3>& points);
+    void clear();
+
+    const IArray<int>& getCounts() const { return m_counts; }
+    const IArray<int>& getIndices() const { return m_indices; }
+    const IArray<float3>& getPoints() const { return m_points; }
+
+    // first index of each face
+    const RawVector<int>& getOffsets();
+    const MeshConnectionInfo& getConnection();
+    // index -> index that starts the same edge in the opposite direction in the neighbor face.
+    // -1 if the edge is open, shared by more than two faces or the neighbor has inconsistent winding.
+    const RawVector<int>& getEdgeAdjacency();
+
+    // how many times the connection has been built from scratch
+    int getConnectionBuildCount() const { return m_connection_builds; }
+
+private:
+    IArray<int> m_counts;
+    IArray<int> m_indices;
+    IArray<float3> m_points;
+    RawVector<int> m_triangle_counts;
+
+    RawVector<int> m_offsets;
+    MeshConnectionInfo m_connection;
+    RawVector<int> m_edge_adjacency;
+    bool m_has_offsets = false;
+    bool m_has_connection = false;
+    bool m_has_edge_adjacency = false;
+    int m_connection_builds = 0;
+};
+
+
 
 struct MeshRefiner
 {
@@ -101,10 +142,15 @@ struct MeshRefiner
     bool gen_points = true;
     bool gen_lines = true;
     bool gen_triangles = true;
+    // find duplicated split vertices by hashing their attributes. vertices are resolved in parallel and
+    // all duplicates are merged, not only the most recently emitted one. the result is deterministic.
+    bool dedup_by_hash = false;
 
     IArray<int> counts;
     IArray<int> indices;
     IArray<float3> points;
+    // if set, its connection is used instead of building one. it must be set up with the same counts and indices.
+    MeshTopologyContext *topology = nullptr;
 
     // outputs
     RawVector<int> old2new_indices; // old index to new index
@@ -119,6 +165,12 @@ struct MeshRefiner
     RawVector<Split> splits;
     RawVector<Submesh> submeshes;
     MeshConnectionInfo connection;
+    // genMeshlets() outputs. meshlet vertices are local to the split like new_indices_submeshes
+    RawVector<Meshlet> meshlets;
+    RawVector<int> meshlet_vertices;
+    RawVector<uint8_t> meshlet_triangles;
+    // genIndices16() output. new_indices_submeshes narrowed to 16 bit
+    RawVector<uint16_t> new_indices_submeshes16;
 
 //----------------------------------------------------------------------------------------------------------------------
     // attributes
@@ -148,6 +200,14 @@ struct MeshRefiner
     // has_face_group: use upper 16 bit of material id as face groups
     void genSubmeshes(const IArray<int>& material_ids, bool has_face_group = false);
     void genSubmeshes();
+    // reorders triangles of each submesh for post-transform cache locality, then vertices of each split by first use.
+    // call after genSubmeshes(). new_points, new2old_points, attributes, old2new_indices and new indices are remapped.
+    void optimizeVertexCache(int cache_size = 16);
+    // splits triangle submeshes into meshlets. call after genSubmeshes() (and optimizeVertexCache() if used).
+    void genMeshlets(int max_vertices = 64, int max_triangles = 124);
+    // narrows new_indices_submeshes to new_indices_submeshes16. indices are local to the split, so this succeeds if
+    // every split has 65536 or less vertices. call after genSubmeshes() (and optimizeVertexCache() if used).
+    bool genIndices16();
     void clear();
 
     int getTrianglesIndexCountTotal() const;
@@ -155,18 +215,79 @@ struct MeshRefiner
     int getPointsIndexCountTotal() const;
 
 private:
+    // expanded attributes that the specialized refine kernels handle. other combinations use VirtualKernel.
+    enum KernelAttribute
+    {
+        KA_Normals  = 1 << 0,
+        KA_UV0      = 1 << 1,
+        KA_UV1      = 1 << 2,
+        KA_Colors   = 1 << 3,
+        KA_Count    = 1 << 4,
+    };
+    struct KernelArrays
+    {
+        int mask = 0;
+        IArray<float3> normals;
+        IArray<float2> uv0, uv1;
+        IArray<float4> colors;
+    };
+    template<int Mask> struct Kernel;
+    struct VirtualKernel;
+
     void setupSubmeshes();
+    const MeshConnectionInfo& getConnection() const;
+    template<int Mask> void refineWithKernel(const KernelArrays& arrays);
+    template<class KernelT> void refineImpl(const KernelT& kernel);
+    template<class KernelT> void resolveDuplicates(const KernelT& kernel, RawVector<int>& dst);
 
     class IAttribute
     {
     public:
         virtual ~IAttribute() {}
         virtual void prepare(int vertex_count, int index_count) = 0;
-        virtual bool compare(int vertex_index, int index_index) = 0;
-        virtual void emit(int index_index) = 0;
         virtual void clear() = 0;
+
+        // equal values must have equal hashes
+        virtual uint64_t hash(int index_index) const = 0;
+        virtual bool equals(int index_index1, int index_index2) const = 0;
+        // new values are src values at the given index indices
+        virtual void gather(const IArray<int>& index_indices) = 0;
+        // new values are reordered. order[i]: current index of the value that goes to i
+        virtual void reorder(const IArray<int>& order) = 0;
+        // registers values to the slot of a specialized kernel. false if there is no slot for it.
+        virtual bool getKernelArrays(KernelArrays& /*dst*/) const { return false; }
     };
 
+    // FNV-1a over 32 bit words. -0.0f is hashed as 0.0f because they compare equal.
+    template<class T>
+    static uint64_t hashValue(const T& v)
+    {
+        static_assert(sizeof(T) % sizeof(uint32_t) == 0, "unsupported attribute type");
+        uint32_t words[sizeof(T) / sizeof(uint32_t)];
+        memcpy(words, &v, sizeof(T));
+        uint64_t h = 0xcbf29ce484222325ull;
+        for (uint32_t w : words) {
+            if (w == 0x80000000u)
+                w = 0;
+            h = (h ^ w) * 0x100000001b3ull;
+        }
+        return h;
+    }
+
+    template<class T>
+    static void reorderValues(RawVector<T>& values, const IArray<int>& order)
+    {
+        if (values.size() != order.size())
+            return;
+        RawVector<T> tmp;
+        tmp.resize_discard(order.size());
+        parallel_for_blocked(0, (int)order.size(), 1024 * 16, [&](int begin, int end) {
+            for (int i = begin; i < end; ++i)
+                tmp[i] = values[order[i]];
+        });
+        values.swap(tmp);
+    }
+
     template<class T>
     class IndexedAttribute : public IAttribute
     {
@@ -176,22 +297,42 @@ private:
             clear();
         }
 
-        bool compare(int ni, int ii) override
+        void clear() override
         {
-            return (*new_values)[ni] == values[indices[ii]];
+            new_values->clear();
+            new2old->clear();
         }
 
-        void emit(int ii) override
+        uint64_t hash(int ii) const override
         {
-            int i = indices[ii];
-            new_values->push_back(values[i]);
-            new2old->push_back(i);
+            return hashValue(values[indices[ii]]);
         }
 
-        void clear() override
+        bool equals(int ii1, int ii2) const override
         {
-            new_values->clear();
-            new2old->clear();
+            return values[indices[ii1]] == values[indices[ii2]];
+        }
+
+        void gather(const IArray<int>& src) override
+        {
+            size_t n = src.size();
+            new_values->resize_discard(n);
+            new2old->resize_discard(n);
+            T *dst_values = new_values->data();
+            int *dst_new2old = new2old->data();
+            parallel_for_blocked(0, (int)n, 1024 * 16, [&](int begin, int end) {
+                for (int i = begin; i < end; ++i) {
+                    int vi = indices[src[i]];
+                    dst_values[i] = values[vi];
+                    dst_new2old[i] = vi;
+                }
+            });
+        }
+
+        void reorder(const IArray<int>& order) override
+        {
+            reorderValues(*new_values, order);
+            reorderValues(*new2old, order);
         }
 
         IArray<T> values;
@@ -209,20 +350,60 @@ private:
             clear();
         }
 
-        bool compare(int ni, int ii) override
+        void clear() override
         {
-            return (*new_values)[ni] == values[ii];
+            new_values->clear();
         }
 
-        void emit(int ii) override
+        uint64_t hash(int ii) const override
         {
-            new_values->push_back(values[ii]);
-            new2old->push_back(ii);
+            return hashValue(values[ii]);
         }
 
-        void clear() override
+        bool equals(int ii1, int ii2) const override
         {
-            new_values->clear();
+            return values[ii1] == values[ii2];
+        }
+
+        void gather(const IArray<int>& src) override
+        {
+            size_t n = src.size();
+            new_values->resize_discard(n);
+            new2old->resize_discard(n);
+            T *dst_values = new_values->data();
+            int *dst_new2old = new2old->data();
+            parallel_for_blocked(0, (int)n, 1024 * 16, [&](int begin, int end) {
+                for (int i = begin; i < end; ++i) {
+                    int ii = src[i];
+                    dst_values[i] = values[ii];
+                    dst_new2old[i] = ii;
+                }
+            });
+        }
+
+        void reorder(const IArray<int>& order) override
+        {
+            reorderValues(*new_values, order);
+            reorderValues(*new2old, order);
+        }
+
+        bool getKernelArrays(KernelArrays& dst) const override
+        {
+            auto assign = [&](IArray<T>& slot, KernelAttribute bit) {
+                if (dst.mask & bit)
+                    return false;
+                slot = values;
+                dst.mask |= bit;
+                return true;
+            };
+            if constexpr (std::is_same<T, float3>::value)
+                return assign(dst.normals, KA_Normals);
+            else if constexpr (std::is_same<T, float2>::value)
+                return assign(dst.uv0, KA_UV0) || assign(dst.uv1, KA_UV1);
+            else if constexpr (std::is_same<T, float4>::value)
+                return assign(dst.colors, KA_Colors);
+            else
+                return false;
         }
 
         IArray<T> values;
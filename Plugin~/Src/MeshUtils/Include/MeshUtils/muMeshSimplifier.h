@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cfloat>
+
+#include "MeshUtils/muMath.h"
+#include "MeshUtils/muRawVector.h"
+#include "MeshUtils/muIntrusiveArray.h"
+
+namespace mu {
+
+// quadric error metric edge collapse (Garland & Heckbert) on triangle meshes.
+// vertices are never moved nor created: each collapse merges a vertex into one of its neighbors, so the result is
+// an index buffer into the original vertices and every vertex attribute (normals, uv, colors, bone weights) stays valid.
+// vertices on open edges are locked. refined meshes split vertices at uv / normal seams, so seams are open edges and
+// are kept as is. edges between different face groups (submeshes) are locked too.
+// connected components are simplified independently in parallel.
+struct MeshSimplifier
+{
+    // inputs
+    IArray<float3> points;
+    IArray<int> indices;        // triangles
+    IArray<int> face_groups;    // can be empty or per-triangle data
+    float target_ratio = 0.5f;  // target triangle count relative to the input. applied to each connected component
+    float target_error = FLT_MAX; // max error relative to the size of the mesh (distance / bounding box diagonal)
+
+    // outputs
+    RawVector<int> new_indices;
+    RawVector<int> new_face_groups; // per-triangle. empty if face_groups is empty
+    float result_error = 0.0f;      // max error of the applied collapses, in the same unit as target_error
+
+    void simplify();
+    void clear();
+};
+
+} // namespace mu
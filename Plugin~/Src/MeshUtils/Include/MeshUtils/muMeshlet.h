@@ -0,0 +1,23 @@
+#pragma once
+
+#include "MeshUtils/muMath.h"
+
+namespace mu {
+
+// cluster of triangles for GPU-driven culling.
+// the cluster is back-facing from a view position if dot(normalize(cone_apex - view), cone_axis) >= cone_cutoff.
+struct Meshlet
+{
+    int submesh_index;
+    int vertex_offset;      // offset in meshlet vertices
+    int vertex_count;
+    int triangle_offset;    // offset in meshlet triangles. 3 local vertex indices per triangle
+    int triangle_count;
+    float3 center;          // bounding sphere
+    float radius;
+    float3 cone_apex;       // normal cone
+    float3 cone_axis;
+    float cone_cutoff;      // 1.0 if the cone can't be used for culling
+};
+
+} // namespace mu
@@ -3,9 +3,22 @@
 #include "MeshUtils/muHalf.h"
 #include "MeshUtils/muRawVector.h"
 #include "MeshUtils/muMath.h"
+#include <vector>
 
 namespace mu {
 
+// instruction set the kernels below run with. one of:
+//  - the ISPC kernels, named after the target ISPC picks among the ones MeshUtilsCore.ispc is built for
+//    ("sse4-i32x4", "avx1-i32x8" or "avx512skx-i32x16" by cpuid on x64, "neon-i32x4" on arm64). "ispc" is an alias.
+//  - the intrinsics implementation, named after its extension ("SSE2" on x64, "NEON" on arm64, "Generic" elsewhere)
+// ISPC is used if the module is built with it and the CPU supports one of its targets.
+// environment variable MESHSYNC_SIMD_ISA overrides it.
+const char* GetActiveSIMDISA();
+// usable ones, best first. the intrinsics implementation is always the last.
+std::vector<const char*> GetSupportedSIMDISAs();
+// name is case insensitive. "auto" selects the best one. returns false if it is unknown.
+bool SetActiveSIMDISA(const char *name);
+
 uint64_t SumInt32(const void *src, size_t num);
 
 // float <-> half
@@ -54,6 +67,17 @@ bool NearEqual(const float4 *src1, const float4 *src2, size_t num, float eps = m
 void MulPoints(const float4x4& m, const float3 src[], float3 dst[], size_t num_data);
 void MulVectors(const float4x4& m, const float3 src[], float3 dst[], size_t num_data);
 
+// one attribute of GatherAttributes(): dst[i] = src[indices[i]] for elements of element_size bytes
+struct GatherStream
+{
+    void *dst;
+    const void *src;
+    size_t element_size;
+};
+// gathers all streams with the same indices in one call. large inputs are split into chunks of indices shared by all
+// streams and the chunks run on the worker threads. dst must not overlap the source elements the indices refer to.
+void GatherAttributes(const GatherStream *streams, size_t num_streams, const int *indices, size_t num_indices);
+
 int RayTrianglesIntersectionIndexed(float3 pos, float3 dir, const float3 *vertices, const int *indices, int num_triangles, int& tindex, float& distance);
 int RayTrianglesIntersectionFlattened(float3 pos, float3 dir, const float3 *vertices, int num_triangles, int& tindex, float& distance);
 int RayTrianglesIntersectionSoA(float3 pos, float3 dir,
@@ -104,38 +128,54 @@ void GenerateTangentsTriangleSoA(float4 *dst,
 // ------------------------------------------------------------
 // internal (for test)
 // ------------------------------------------------------------
+// vector extension the _SIMD variants are built with: "SSE2", "NEON" or "Generic" (scalar fallback)
+const char* GetSIMDBackendName_SIMD();
+
 uint64_t SumInt32_Generic(const uint32_t *src, size_t num);
 uint64_t SumInt32_ISPC(const uint32_t *src, size_t num);
+uint64_t SumInt32_SIMD(const uint32_t *src, size_t num);
 
 void F32ToF16_Generic(half *dst, const float *src, size_t num);
 void F32ToF16_ISPC(half *dst, const float *src, size_t num);
+void F32ToF16_SIMD(half *dst, const float *src, size_t num);
 void F16ToF32_Generic(float *dst, const half *src, size_t num);
 void F16ToF32_ISPC(float *dst, const half *src, size_t num);
+void F16ToF32_SIMD(float *dst, const half *src, size_t num);
 
 void F32ToS8_Generic(snorm8 *dst, const float *src, size_t num);
 void F32ToS8_ISPC(snorm8 *dst, const float *src, size_t num);
+void F32ToS8_SIMD(snorm8 *dst, const float *src, size_t num);
 void S8ToF32_Generic(float *dst, const snorm8 *src, size_t num);
 void S8ToF32_ISPC(float *dst, const snorm8 *src, size_t num);
+void S8ToF32_SIMD(float *dst, const snorm8 *src, size_t num);
 
 void F32ToU8_Generic(unorm8 *dst, const float *src, size_t num);
 void F32ToU8_ISPC(unorm8 *dst, const float *src, size_t num);
+void F32ToU8_SIMD(unorm8 *dst, const float *src, size_t num);
 void U8ToF32_Generic(float *dst, const unorm8 *src, size_t num);
 void U8ToF32_ISPC(float *dst, const unorm8 *src, size_t num);
+void U8ToF32_SIMD(float *dst, const unorm8 *src, size_t num);
 
 void F32ToU8N_Generic(unorm8n *dst, const float *src, size_t num);
 void F32ToU8N_ISPC(unorm8n *dst, const float *src, size_t num);
+void F32ToU8N_SIMD(unorm8n *dst, const float *src, size_t num);
 void U8NToF32_Generic(float *dst, const unorm8n *src, size_t num);
 void U8NToF32_ISPC(float *dst, const unorm8n *src, size_t num);
+void U8NToF32_SIMD(float *dst, const unorm8n *src, size_t num);
 
 void F32ToS16_Generic(snorm16 *dst, const float *src, size_t num);
 void F32ToS16_ISPC(snorm16 *dst, const float *src, size_t num);
+void F32ToS16_SIMD(snorm16 *dst, const float *src, size_t num);
 void S16ToF32_Generic(float *dst, const snorm16 *src, size_t num);
 void S16ToF32_ISPC(float *dst, const snorm16 *src, size_t num);
+void S16ToF32_SIMD(float *dst, const snorm16 *src, size_t num);
 
 void F32ToU16_Generic(unorm16 *dst, const float *src, size_t num);
 void F32ToU16_ISPC(unorm16 *dst, const float *src, size_t num);
+void F32ToU16_SIMD(unorm16 *dst, const float *src, size_t num);
 void U16ToF32_Generic(float *dst, const unorm16 *src, size_t num);
 void U16ToF32_ISPC(float *dst, const unorm16 *src, size_t num);
+void U16ToF32_SIMD(float *dst, const unorm16 *src, size_t num);
 
 void F32ToS24_Generic(snorm24 *dst, const float *src, size_t num);
 void F32ToS24_ISPC(snorm24 *dst, const float *src, size_t num);
@@ -150,47 +190,65 @@ void S32ToF32_ISPC(float *dst, const snorm32 *src, size_t num);
 
 void InvertX_Generic(float3 *dst, size_t num);
 void InvertX_ISPC(float3 *dst, size_t num);
+void InvertX_SIMD(float3 *dst, size_t num);
 void InvertX_Generic(float4 *dst, size_t num);
 void InvertX_ISPC(float4 *dst, size_t num);
+void InvertX_SIMD(float4 *dst, size_t num);
 
 void Scale_Generic(float *dst, float s, size_t num);
 void Scale_Generic(float3 *dst, float s, size_t num);
 void Scale_ISPC(float *dst, float s, size_t num);
+void Scale_SIMD(float *dst, float s, size_t num);
 void Scale_ISPC(float3 *dst, float s, size_t num);
+void Scale_SIMD(float3 *dst, float s, size_t num);
 
 void Normalize_Generic(float3 *dst, size_t num);
 void Normalize_ISPC(float3 *dst, size_t num);
+void Normalize_SIMD(float3 *dst, size_t num);
 
 void Lerp_Generic(float *dst, const float *src1, const float *src2, size_t num, float w);
 void Lerp_ISPC(float *dst, const float *src1, const float *src2, size_t num, float w);
+void Lerp_SIMD(float *dst, const float *src1, const float *src2, size_t num, float w);
 void LerpNormals_Generic(float3 *dst, const float3 *src1, const float3 *src2, size_t num, float w);
 void LerpNormals_ISPC(float3 *dst, const float3 *src1, const float3 *src2, size_t num, float w);
+void LerpNormals_SIMD(float3 *dst, const float3 *src1, const float3 *src2, size_t num, float w);
 void LerpTangents_Generic(float4 *dst, const float4 *src1, const float4 *src2, size_t num, float w);
 void LerpTangents_ISPC(float4 *dst, const float4 *src1, const float4 *src2, size_t num, float w);
+void LerpTangents_SIMD(float4 *dst, const float4 *src1, const float4 *src2, size_t num, float w);
 
 void MinMax_Generic(const int *src, size_t num, int& dst_min, int& dst_max);
 void MinMax_ISPC(const int *src, size_t num, int& dst_min, int& dst_max);
+void MinMax_SIMD(const int *src, size_t num, int& dst_min, int& dst_max);
 void MinMax_Generic(const float *src, size_t num, float& dst_min, float& dst_max);
 void MinMax_ISPC(const float *src, size_t num, float& dst_min, float& dst_max);
+void MinMax_SIMD(const float *src, size_t num, float& dst_min, float& dst_max);
 void MinMax_Generic(const float2 *src, size_t num, float2& dst_min, float2& dst_max);
 void MinMax_ISPC(const float2 *src, size_t num, float2& dst_min, float2& dst_max);
+void MinMax_SIMD(const float2 *src, size_t num, float2& dst_min, float2& dst_max);
 void MinMax_Generic(const float3 *src, size_t num, float3& dst_min, float3& dst_max);
 void MinMax_ISPC(const float3 *src, size_t num, float3& dst_min, float3& dst_max);
+void MinMax_SIMD(const float3 *src, size_t num, float3& dst_min, float3& dst_max);
 void MinMax_Generic(const float4 *src, size_t num, float4& dst_min, float4& dst_max);
 void MinMax_ISPC(const float4 *src, size_t num, float4& dst_min, float4& dst_max);
+void MinMax_SIMD(const float4 *src, size_t num, float4& dst_min, float4& dst_max);
 
 bool NearEqual_Generic(const float *src1, const float *src2, size_t num, float eps);
 bool NearEqual_ISPC(const float *src1, const float *src2, size_t num, float eps);
+bool NearEqual_SIMD(const float *src1, const float *src2, size_t num, float eps);
 
 void MulPoints_Generic(const float4x4& m, const float3 src[], float3 dst[], size_t num_data);
 void MulPoints_ISPC(const float4x4& m, const float3 src[], float3 dst[], size_t num_data);
+void MulPoints_SIMD(const float4x4& m, const float3 src[], float3 dst[], size_t num_data);
 void MulVectors_Generic(const float4x4& m, const float3 src[], float3 dst[], size_t num_data);
 void MulVectors_ISPC(const float4x4& m, const float3 src[], float3 dst[], size_t num_data);
+void MulVectors_SIMD(const float4x4& m, const float3 src[], float3 dst[], size_t num_data);
 
 int RayTrianglesIntersectionIndexed_Generic(float3 pos, float3 dir, const float3 *vertices, const int *indices, int num_triangles, int& tindex, float& distance);
 int RayTrianglesIntersectionIndexed_ISPC(float3 pos, float3 dir, const float3 *vertices, const int *indices, int num_triangles, int& tindex, float& distance);
+int RayTrianglesIntersectionIndexed_SIMD(float3 pos, float3 dir, const float3 *vertices, const int *indices, int num_triangles, int& tindex, float& distance);
 int RayTrianglesIntersectionFlattened_Generic(float3 pos, float3 dir, const float3 *vertices, int num_triangles, int& tindex, float& distance);
 int RayTrianglesIntersectionFlattened_ISPC(float3 pos, float3 dir, const float3 *vertices, int num_triangles, int& tindex, float& distance);
+int RayTrianglesIntersectionFlattened_SIMD(float3 pos, float3 dir, const float3 *vertices, int num_triangles, int& tindex, float& distance);
 int RayTrianglesIntersectionSoA_Generic(float3 pos, float3 dir,
     const float *v1x, const float *v1y, const float *v1z,
     const float *v2x, const float *v2y, const float *v2z,
@@ -201,6 +259,11 @@ int RayTrianglesIntersectionSoA_ISPC(float3 pos, float3 dir,
     const float *v2x, const float *v2y, const float *v2z,
     const float *v3x, const float *v3y, const float *v3z,
     int num_triangles, int& tindex, float& distance);
+int RayTrianglesIntersectionSoA_SIMD(float3 pos, float3 dir,
+    const float *v1x, const float *v1y, const float *v1z,
+    const float *v2x, const float *v2y, const float *v2z,
+    const float *v3x, const float *v3y, const float *v3z,
+    int num_triangles, int& tindex, float& distance);
 
 bool PolyInside_Generic(const float px[], const float py[], int ngon, const float2 minp, const float2 maxp, const float2 pos);
 bool PolyInside_ISPC(const float px[], const float py[], int ngon, const float2 minp, const float2 maxp, const float2 pos);
@@ -215,12 +278,18 @@ void GenerateNormalsTriangleIndexed_Generic(float3 *dst,
 void GenerateNormalsTriangleIndexed_ISPC(float3 *dst,
     const float3 *vertices, const int *indices,
     int num_triangles, int num_vertices);
+void GenerateNormalsTriangleIndexed_SIMD(float3 *dst,
+    const float3 *vertices, const int *indices,
+    int num_triangles, int num_vertices);
 void GenerateNormalsTriangleFlattened_Generic(float3 *dst,
     const float3 *vertices, const int *indices,
     int num_triangles, int num_vertices);
 void GenerateNormalsTriangleFlattened_ISPC(float3 *dst,
     const float3 *vertices, const int *indices,
     int num_triangles, int num_vertices);
+void GenerateNormalsTriangleFlattened_SIMD(float3 *dst,
+    const float3 *vertices, const int *indices,
+    int num_triangles, int num_vertices);
 void GenerateNormalsTriangleSoA_Generic(float3 *dst,
     const float *v1x, const float *v1y, const float *v1z,
     const float *v2x, const float *v2y, const float *v2z,
@@ -233,6 +302,12 @@ void GenerateNormalsTriangleSoA_ISPC(float3 *dst,
     const float *v3x, const float *v3y, const float *v3z,
     const int *indices,
     int num_triangles, int num_vertices);
+void GenerateNormalsTriangleSoA_SIMD(float3 *dst,
+    const float *v1x, const float *v1y, const float *v1z,
+    const float *v2x, const float *v2y, const float *v2z,
+    const float *v3x, const float *v3y, const float *v3z,
+    const int *indices,
+    int num_triangles, int num_vertices);
 
 void GenerateTangentsTriangleIndexed_Generic(float4 *dst,
     const float3 *vertices, const float2 *uv, const float3 *normals, const int *indices,
@@ -288,6 +363,11 @@ inline bool near_equal(const VT<quatf>& a, const VT<quatf>& b, float epsilon = m
     return a.size() == b.size() && NearEqual((const float4*)a.cdata(), (const float4*)b.cdata(), a.size(), epsilon);\
 }\
 inline bool near_equal(const VT<int>& a, const VT<int>& b, float epsilon = muEpsilon)\
+{\
+    (void)epsilon;\
+    return a == b;\
+}\
+inline bool near_equal(const VT<uint16_t>& a, const VT<uint16_t>& b, float epsilon = muEpsilon)\
 {\
     (void)epsilon;\
     return a == b;\
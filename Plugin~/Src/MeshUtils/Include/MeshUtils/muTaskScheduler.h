@@ -0,0 +1,197 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace mu {
+
+enum class TaskPriority
+{
+    High,   // interactive work that someone is waiting for
+    Normal,
+    Low,    // background work such as preloading
+};
+
+// Type-erased state shared between TaskScheduler and TaskFuture.
+class TaskState : public std::enable_shared_from_this<TaskState>
+{
+public:
+    enum class Status
+    {
+        Blocked,    // continuation waiting for its antecedent
+        Pending,    // queued
+        Running,
+        Completed,
+        Canceled,
+    };
+
+    explicit TaskState(TaskPriority priority);
+    virtual ~TaskState();
+
+    Status getStatus() const;
+    TaskPriority getPriority() const;
+    bool isFinished() const;
+    bool isCancelRequested() const;
+
+    // if the task has not started yet, it is executed on the calling thread.
+    // this keeps tasks that wait for other tasks from exhausting the workers.
+    void wait();
+
+    // returns true if the task is guaranteed not to run. running tasks can poll TaskScheduler::isCurrentTaskCanceled().
+    bool cancel();
+
+    // executes the task if it is pending. returns false if it has already been taken or canceled.
+    bool tryRun();
+
+    void addContinuation(const std::shared_ptr<TaskState>& task);
+
+protected:
+    virtual void invoke() = 0;
+
+private:
+    void finish(Status status);
+    void release();
+
+    std::atomic<Status> m_status;
+    std::atomic_bool m_cancel_requested{ false };
+    TaskPriority m_priority;
+
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    std::vector<std::shared_ptr<TaskState>> m_continuations;
+    std::shared_ptr<TaskState> m_antecedent;
+};
+
+template<class T>
+class TaskStateT : public TaskState
+{
+public:
+    using result_t = std::conditional_t<std::is_void<T>::value, char, T>;
+    using func_t = std::function<T()>;
+
+    TaskStateT(func_t&& func, TaskPriority priority)
+        : TaskState(priority), m_func(std::move(func))
+    {
+    }
+
+    result_t& getResult() { return m_result; }
+    std::exception_ptr getError() const { return m_error; }
+
+protected:
+    void invoke() override
+    {
+        try {
+            if constexpr (std::is_void<T>::value)
+                m_func();
+            else
+                m_result = m_func();
+        }
+        catch (...) {
+            m_error = std::current_exception();
+        }
+        m_func = nullptr; // release captures early
+    }
+
+private:
+    func_t m_func;
+    result_t m_result{};
+    std::exception_ptr m_error;
+};
+
+
+template<class T>
+class TaskFuture
+{
+public:
+    using state_ptr = std::shared_ptr<TaskStateT<T>>;
+
+    TaskFuture() = default;
+    explicit TaskFuture(state_ptr state) : m_state(std::move(state)) {}
+
+    bool valid() const { return m_state != nullptr; }
+    bool isReady() const { return m_state && m_state->isFinished(); }
+    bool isCanceled() const { return m_state && m_state->getStatus() == TaskState::Status::Canceled; }
+    bool cancel() { return m_state && m_state->cancel(); }
+    void wait() const { if (m_state) m_state->wait(); }
+
+    // waits and returns the result. rethrows the exception thrown by the task.
+    // a canceled task yields a default constructed value.
+    T get() const
+    {
+        m_state->wait();
+        if (m_state->getError())
+            std::rethrow_exception(m_state->getError());
+        if constexpr (!std::is_void<T>::value)
+            return m_state->getResult();
+    }
+
+    // F: [](TaskFuture<T> antecedent) -> R. runs after this task completes or is canceled.
+    template<class F>
+    auto then(F&& f, TaskPriority priority = TaskPriority::Normal) -> TaskFuture<std::invoke_result_t<F, TaskFuture<T>>>;
+
+private:
+    state_ptr m_state;
+};
+
+
+class TaskScheduler
+{
+public:
+    static TaskScheduler& instance();
+
+    // maximum number of tasks that run at the same time.
+    // 0: the cores parallel_for() leaves unused (at least 2), so the two pools don't oversubscribe the CPU.
+    static void setMaxConcurrency(int n);
+    static int getMaxConcurrency();
+    // number of worker threads currently alive, including ones that are about to exit
+    static int getNumThreads();
+    // true if cancel() was requested for the task that is running on the current thread
+    static bool isCurrentTaskCanceled();
+
+    template<class F>
+    auto submit(F&& f, TaskPriority priority = TaskPriority::Normal) -> TaskFuture<std::invoke_result_t<F>>
+    {
+        using R = std::invoke_result_t<F>;
+        auto state = std::make_shared<TaskStateT<R>>(std::function<R()>(std::forward<F>(f)), priority);
+        enqueue(state);
+        return TaskFuture<R>(state);
+    }
+
+    // internal
+    void enqueue(const std::shared_ptr<TaskState>& task);
+
+    TaskScheduler(const TaskScheduler&) = delete;
+    TaskScheduler& operator=(const TaskScheduler&) = delete;
+
+private:
+    TaskScheduler();
+    ~TaskScheduler();
+
+    class Impl;
+    Impl *m_impl = nullptr;
+
+    friend class TaskState;
+};
+
+
+template<class T>
+template<class F>
+inline auto TaskFuture<T>::then(F&& f, TaskPriority priority) -> TaskFuture<std::invoke_result_t<F, TaskFuture<T>>>
+{
+    using R = std::invoke_result_t<F, TaskFuture<T>>;
+    TaskFuture<T> antecedent = *this;
+    auto state = std::make_shared<TaskStateT<R>>(
+        std::function<R()>([antecedent, f = std::forward<F>(f)]() mutable { return f(antecedent); }),
+        priority);
+    m_state->addContinuation(state);
+    return TaskFuture<R>(state);
+}
+
+} // namespace mu
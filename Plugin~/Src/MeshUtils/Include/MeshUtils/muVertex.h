@@ -205,4 +205,31 @@ void Interleave(void *dst, VertexFormat format, size_t num,
 
 template<class VertexT> void Interleave_Generic(VertexT *dst, const typename VertexT::source_t& src, size_t num);
 
+
+// layout-driven interleave. each attribute is converted to its own format and written at its offset in every vertex.
+
+enum class VertexAttributeFormat
+{
+    Float32,
+    Float16,
+    SNorm8,
+    SNorm16,
+    UNorm8,
+    UNorm16,
+};
+
+struct VertexAttributeDesc
+{
+    const float *src = nullptr; // src_dimension floats per vertex. null is treated as zeros
+    int src_dimension = 0;
+    VertexAttributeFormat format = VertexAttributeFormat::Float32;
+    int dimension = 0;          // components to write. components missing in src are zero
+    int offset = 0;             // byte offset in the vertex. should be aligned to the component size
+};
+
+size_t GetVertexAttributeSize(VertexAttributeFormat format, int dimension);
+
+// dst must have num * stride bytes. vertices are processed in parallel blocks.
+void Interleave(void *dst, size_t stride, size_t num, const VertexAttributeDesc *attributes, size_t num_attributes);
+
 } // namespace mu
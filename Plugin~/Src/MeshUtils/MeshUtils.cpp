@@ -5,31 +5,66 @@
 
 namespace mu {
 
-bool GenerateNormalsPoly(RawVector<float3>& dst,
-    const IArray<float3> points, const IArray<int> counts, const IArray<int> indices, bool flip)
+namespace {
+
+// not normalized. faces with less than 3 vertices get zero.
+void GenerateFaceNormals(RawVector<float3>& dst,
+    const IArray<float3> points, const IArray<int> counts, const IArray<int> offsets, const IArray<int> indices, bool flip)
 {
-    const size_t num_faces = counts.size();
+    const int num_faces = (int)counts.size();
     const int i1 = flip ? 2 : 1;
     const int i2 = flip ? 1 : 2;
 
-    dst.resize_discard(points.size());
-    dst.zeroclear();
+    dst.resize_discard(num_faces);
+    parallel_for_blocked(0, num_faces, 1024 * 8, [&](int begin, int end) {
+        for (int fi = begin; fi < end; ++fi) {
+            if (counts[fi] < 3) {
+                dst[fi] = float3::zero();
+                continue;
+            }
+            const int *face = &indices[offsets[fi]];
+            float3 p0 = points[face[0]];
+            float3 p1 = points[face[i1]];
+            float3 p2 = points[face[i2]];
+            dst[fi] = cross(p1 - p0, p2 - p0);
+        }
+    });
+}
 
-    int offset = 0;
-    for (size_t fi = 0; fi < num_faces; ++fi) {
-        const int ngon = counts[fi];
-        if (ngon < 3)
-            continue;
+} // namespace
 
-        const int *face = &indices[offset];
-        float3 p0 = points[face[0]];
-        float3 p1 = points[face[i1]];
-        float3 p2 = points[face[i2]];
-        float3 n = cross(p1 - p0, p2 - p0);
-        for (int ci = 0; ci < ngon; ++ci)
-            dst[face[ci]] += n;
-        offset += ngon;
-    }
+// face normals are computed once and gathered per vertex through the connection.
+// connected faces are listed in face order, so the sums are the same as scattering faces one by one.
+bool GenerateNormalsPoly(RawVector<float3>& dst,
+    const IArray<float3> points, const IArray<int> counts, const IArray<int> indices, bool flip)
+{
+    MeshTopologyContext topology;
+    topology.setup(counts, indices, points);
+    return GenerateNormalsPoly(dst, topology, flip);
+}
+
+bool GenerateNormalsPoly(RawVector<float3>& dst, MeshTopologyContext& topology, bool flip)
+{
+    const IArray<float3>& points = topology.getPoints();
+    const IArray<int>& counts = topology.getCounts();
+    const IArray<int>& indices = topology.getIndices();
+    const int num_points = (int)points.size();
+
+    const RawVector<int>& offsets = topology.getOffsets();
+    RawVector<float3> face_normals;
+    parallel_invoke(
+        [&]() { GenerateFaceNormals(face_normals, points, counts, offsets, indices, flip); },
+        [&]() { topology.getConnection(); });
+    const MeshConnectionInfo& connection = topology.getConnection();
+
+    dst.resize_discard(num_points);
+    parallel_for_blocked(0, num_points, 1024 * 4, [&](int begin, int end) {
+        for (int vi = begin; vi < end; ++vi) {
+            float3 n = float3::zero();
+            connection.eachConnectedFaces(vi, [&](int fi, int) { n += face_normals[fi]; });
+            dst[vi] = n;
+        }
+    });
     Normalize(dst.data(), dst.size());
     return true;
 }
@@ -37,209 +72,760 @@ bool GenerateNormalsPoly(RawVector<float3>& dst,
 void GenerateNormalsWithSmoothAngle(RawVector<float3>& dst,
     const IArray<float3> points, const IArray<int> counts, const IArray<int> indices, float smooth_angle, bool flip)
 {
-    MeshConnectionInfo connection;
-    connection.buildConnection(indices, counts, points);
+    MeshTopologyContext topology;
+    topology.setup(counts, indices, points);
+    GenerateNormalsWithSmoothAngle(dst, topology, smooth_angle, flip);
+}
 
-    const size_t num_faces = counts.size();
-    const int i1 = flip ? 2 : 1;
-    const int i2 = flip ? 1 : 2;
+void GenerateNormalsWithSmoothAngle(RawVector<float3>& dst, MeshTopologyContext& topology, float smooth_angle, bool flip)
+{
+    const IArray<float3>& points = topology.getPoints();
+    const IArray<int>& counts = topology.getCounts();
+    const IArray<int>& indices = topology.getIndices();
+    const int num_faces = (int)counts.size();
 
-    // gen face normals
-    int offset = 0;
+    const RawVector<int>& offsets = topology.getOffsets();
     RawVector<float3> face_normals;
-    face_normals.resize_zeroclear(num_faces);
-    for (size_t fi = 0; fi < num_faces; ++fi)
-    {
-        int count = counts[fi];
-        if (count < 3)
-            continue;
-
-        const int *face = &indices[offset];
-        float3 p0 = points[face[0]];
-        float3 p1 = points[face[i1]];
-        float3 p2 = points[face[i2]];
-        float3 n = cross(p1 - p0, p2 - p0);
-        face_normals[fi] = n;
-        offset += count;
-    }
-    Normalize(face_normals.data(), face_normals.size());
-
-    // gen vertex normals
+    parallel_invoke(
+        [&]() {
+            GenerateFaceNormals(face_normals, points, counts, offsets, indices, flip);
+            Normalize(face_normals.data(), face_normals.size());
+        },
+        [&]() { topology.getConnection(); });
+    const MeshConnectionInfo& connection = topology.getConnection();
+
+    // gen vertex normals. each corner is written by its own face, so faces can be processed in parallel.
     dst.resize_discard(indices.size());
-    dst.zeroclear();
-    offset = 0;
     const float angle = std::cos(smooth_angle * DegToRad) - 0.001f;
-    for (size_t fi = 0; fi < num_faces; ++fi)
-    {
-        int count = counts[fi];
-        if (count < 3)
-            continue;
+    parallel_for_blocked(0, num_faces, 1024 * 4, [&](int begin, int end) {
+        for (int fi = begin; fi < end; ++fi) {
+            const int count = counts[fi];
+            const int offset = offsets[fi];
+            if (count < 3) {
+                for (int ci = 0; ci < count; ++ci)
+                    dst[offset + ci] = float3::zero();
+                continue;
+            }
 
-        const int *face = &indices[offset];
-        auto& face_normal = face_normals[fi];
-        for (int ci = 0; ci < count; ++ci) {
-            int vi = face[ci];
-            auto normal = float3::zero();
-            connection.eachConnectedFaces(vi, [&](int fi2, int) {
-                float3 n = face_normals[fi2];
-                if (dot(face_normal, n) > angle) {
-                    normal += n;
-                }
-            });
-            dst[offset + ci] = normal;
+            const float3 face_normal = face_normals[fi];
+            for (int ci = 0; ci < count; ++ci) {
+                auto normal = float3::zero();
+                connection.eachConnectedFaces(indices[offset + ci], [&](int fi2, int) {
+                    float3 n = face_normals[fi2];
+                    if (dot(face_normal, n) > angle) {
+                        normal += n;
+                    }
+                });
+                dst[offset + ci] = normal;
+            }
         }
-        offset += count;
-    }
+    });
 
     // normalize
     Normalize(dst.data(), dst.size());
 }
 
+void GenerateTangentsPoly(RawVector<float4>& dst,
+    const IArray<float3> points, const IArray<float2> uv, const IArray<float3> normals,
+    const IArray<int> counts, const IArray<int> indices)
+{
+    MeshTopologyContext topology;
+    topology.setup(counts, indices, points);
+    GenerateTangentsPoly(dst, uv, normals, topology);
+}
 
-
-void QuadifyTriangles(const IArray<float3> points, const IArray<int> indices, bool full_search, float threshold_angle,
-    RawVector<int>& dst_indices, RawVector<int>& dst_counts)
+// polygons are fan triangulated. tangents of each face are accumulated to its corners in parallel,
+// then the corners are gathered per vertex through the connection.
+void GenerateTangentsPoly(RawVector<float4>& dst,
+    const IArray<float2> uv, const IArray<float3> normals, MeshTopologyContext& topology)
 {
-    struct Connection
-    {
-        int nindex;
-        float nangle;
-        int quad[4];
-        bool merged;
+    const IArray<float3>& points = topology.getPoints();
+    const IArray<int>& counts = topology.getCounts();
+    const IArray<int>& indices = topology.getIndices();
+    const int num_points = (int)points.size();
+    const int num_indices = (int)indices.size();
+    const int num_faces = (int)counts.size();
+
+    const RawVector<int>& offsets = topology.getOffsets();
+    RawVector<float3> corner_tangents, corner_binormals;
+    auto accumulate = [&]() {
+        corner_tangents.resize_zeroclear(num_indices);
+        corner_binormals.resize_zeroclear(num_indices);
+        parallel_for_blocked(0, num_faces, 1024 * 4, [&](int begin, int end) {
+            for (int fi = begin; fi < end; ++fi) {
+                const int count = counts[fi];
+                const int offset = offsets[fi];
+                const int *face = &indices[offset];
+                for (int ti = 0; ti < count - 2; ++ti) {
+                    int ci[3] = { 0, ti + 1, ti + 2 };
+                    float3 v[3] = { points[face[ci[0]]], points[face[ci[1]]], points[face[ci[2]]] };
+                    float2 u[3] = { uv[face[ci[0]]], uv[face[ci[1]]], uv[face[ci[2]]] };
+                    float3 t[3];
+                    float3 b[3];
+                    compute_triangle_tangent(v, u, t, b);
+                    for (int i = 0; i < 3; ++i) {
+                        corner_tangents[offset + ci[i]] += t[i];
+                        corner_binormals[offset + ci[i]] += b[i];
+                    }
+                }
+            }
+        });
     };
-    int num_triangles = (int)indices.size() / 3;
-    RawVector<Connection> connections(num_triangles);
-
-    auto make_unique = [](int *begin, int *end) {
-        for (auto i = begin; i + 1 < end; ++i) {
-            auto p = std::find(i + 1, end, *i);
-            if (p != end) {
-                // shift elements
-                auto q = p + 1;
-                while (q != end)
-                    *p++ = std::move(*q++);
-                --end;
+    parallel_invoke(accumulate, [&]() { topology.getConnection(); });
+    const MeshConnectionInfo& connection = topology.getConnection();
+
+    dst.resize_discard(num_points);
+    parallel_for_blocked(0, num_points, 1024 * 4, [&](int begin, int end) {
+        for (int vi = begin; vi < end; ++vi) {
+            float3 t = float3::zero();
+            float3 b = float3::zero();
+            connection.eachConnectedFaces(vi, [&](int, int ii) {
+                t += corner_tangents[ii];
+                b += corner_binormals[ii];
+            });
+            dst[vi] = orthogonalize_tangent(t, b, normals[vi]);
+        }
+    });
+}
+
+
+void WeldVertices(RawVector<int>& dst, const IArray<float3> points, float eps)
+{
+    const int n = (int)points.size();
+    dst.resize_discard(n);
+    if (n == 0)
+        return;
+
+    auto is_finite = [](const float3& p) { return std::isfinite(p.x) && std::isfinite(p.y) && std::isfinite(p.z); };
+
+    // bounds of finite points
+    struct Bounds { float3 bmin, bmax; };
+    const float inf = std::numeric_limits<float>::infinity();
+    Bounds bounds = parallel_reduce(0, n, 1024 * 16, Bounds{ float3{ inf, inf, inf }, float3{ -inf, -inf, -inf } },
+        [&](int begin, int end, Bounds b) {
+            for (int i = begin; i < end; ++i) {
+                const float3& p = points[i];
+                if (is_finite(p)) {
+                    b.bmin = min(b.bmin, p);
+                    b.bmax = max(b.bmax, p);
+                }
             }
-            else
-                break;
+            return b;
+        },
+        [](const Bounds& a, const Bounds& b) { return Bounds{ min(a.bmin, b.bmin), max(a.bmax, b.bmax) }; });
+
+    // meshes are mostly surfaces. aim for roughly one point per cell over the bounding box's surface.
+    float cell_size = 0.0f;
+    if (bounds.bmin.x <= bounds.bmax.x) {
+        float3 e = bounds.bmax - bounds.bmin;
+        float area = 2.0f * (e.x * e.y + e.y * e.z + e.z * e.x);
+        cell_size = area > 0.0f ? std::sqrt(area / (float)n) : std::max(std::max(e.x, e.y), e.z) / (float)n;
+    }
+    else {
+        bounds.bmin = float3::zero();
+    }
+    cell_size = std::max(cell_size, eps);
+    if (!(cell_size > 0.0f) || !std::isfinite(cell_size))
+        cell_size = 1.0f;
+    const float inv_cell = 1.0f / cell_size;
+
+    // non-finite points share one special cell. they can only match exactly (e.g. inf == inf)
+    const int64_t special = std::numeric_limits<int64_t>::min();
+    auto cell_of = [&](const float3& p, int64_t c[3]) {
+        if (!is_finite(p)) {
+            c[0] = c[1] = c[2] = special;
+            return false;
         }
-        return end;
+        float3 t = (p - bounds.bmin) * inv_cell;
+        c[0] = (int64_t)std::floor(t.x);
+        c[1] = (int64_t)std::floor(t.y);
+        c[2] = (int64_t)std::floor(t.z);
+        return true;
     };
 
-    auto overlapped = [](const int *a, const int *b) {
-        int i00 = a[0], i01 = a[1], i02 = a[2];
-        int i10 = b[0], i11 = b[1], i12 = b[2];
-        int ret = 0;
-        if (i00 == i10) ++ret;
-        if (i00 == i11) ++ret;
-        if (i00 == i12) ++ret;
-        if (i01 == i10) ++ret;
-        if (i01 == i11) ++ret;
-        if (i01 == i12) ++ret;
-        if (i02 == i10) ++ret;
-        if (i02 == i11) ++ret;
-        if (i02 == i12) ++ret;
-        return ret;
+    int table_bits = 1;
+    while ((1 << table_bits) < n && table_bits < 30)
+        ++table_bits;
+    const uint32_t mask = (1u << table_bits) - 1;
+    auto bucket_of = [mask](int64_t x, int64_t y, int64_t z) {
+        uint64_t h = (uint64_t)x * 0x9E3779B185EBCA87ull;
+        h ^= (uint64_t)y * 0xC2B2AE3D27D4EB4Full + (h << 6) + (h >> 2);
+        h ^= (uint64_t)z * 0x165667B19E3779F9ull + (h << 6) + (h >> 2);
+        return (uint32_t)(h ^ (h >> 32)) & mask;
     };
 
-    parallel_for(0, num_triangles, 8192, [&](int ti1) {
-        auto& cd = connections[ti1];
-        cd.nindex = -1;
-        cd.nangle = 180.0f;
-        cd.merged = false;
+    // counting sort of point indices by bucket. indices stay ascending within each bucket.
+    RawVector<int> buckets, offsets, sorted;
+    buckets.resize_discard(n);
+    offsets.resize_zeroclear(mask + 2);
+    sorted.resize_discard(n);
+    parallel_for_blocked(0, n, 1024 * 4, [&](int begin, int end) {
+        int64_t c[3];
+        for (int i = begin; i < end; ++i) {
+            cell_of(points[i], c);
+            buckets[i] = bucket_of(c[0], c[1], c[2]);
+        }
+    });
+    for (int i = 0; i < n; ++i)
+        ++offsets[buckets[i] + 1];
+    parallel_inclusive_scan(offsets.cdata(), offsets.data(), (int)offsets.size());
+    {
+        RawVector<int> pos;
+        pos.assign(offsets.cdata(), offsets.cdata() + (mask + 1));
+        for (int i = 0; i < n; ++i)
+            sorted[pos[buckets[i]]++] = i;
+    }
+
+    auto match = [eps](const float3& a, const float3& b) {
+        return eps > 0.0f ? near_equal(a, b, eps) : a == b;
+    };
 
-        auto *tri1 = indices.data() + (ti1 * 3);
-        const float3 normal1 = normalize(cross(points[tri1[1]] - points[tri1[0]], points[tri1[2]] - points[tri1[0]]));
+    parallel_for_blocked(0, n, 1024, [&](int begin, int end) {
+        int64_t c[3];
+        for (int vi = begin; vi < end; ++vi) {
+            const float3 p = points[vi];
+            int best = vi;
+            auto search_bucket = [&](uint32_t b) {
+                for (int k = offsets[b]; k < offsets[b + 1]; ++k) {
+                    int j = sorted[k];
+                    if (j >= best)
+                        break;
+                    if (match(points[j], p)) {
+                        best = j;
+                        break;
+                    }
+                }
+            };
 
-        int ti2begin, ti2end;
-        if (full_search) {
-            ti2begin = std::max(ti1 - 1, 0);
-            ti2end = num_triangles;
+            if (!cell_of(p, c) || eps <= 0.0f) {
+                // exactly matching points always fall in the same cell
+                search_bucket(buckets[vi]);
+            }
+            else {
+                for (int64_t z = c[2] - 1; z <= c[2] + 1; ++z)
+                    for (int64_t y = c[1] - 1; y <= c[1] + 1; ++y)
+                        for (int64_t x = c[0] - 1; x <= c[0] + 1; ++x)
+                            search_bucket(bucket_of(x, y, z));
+            }
+            dst[vi] = best;
         }
-        else {
-            ti2begin = std::max(ti1 - 1, 0);
-            ti2end = std::min(ti1 + 2, num_triangles);
+    });
+
+    if (eps > 0.0f) {
+        // dst[j] for j < i is already final, so one pass resolves chains
+        for (int i = 0; i < n; ++i)
+            dst[i] = dst[dst[i]];
+    }
+}
+
+
+VertexCacheStatistics AnalyzeVertexCache(const IArray<int> indices, int num_vertices, int cache_size)
+{
+    VertexCacheStatistics ret;
+    const int num_indices = (int)indices.size();
+    if (num_indices < 3 || num_vertices <= 0)
+        return ret;
+
+    // timestamps[vi]: value of misses when vi entered the cache. a FIFO cache holds the last cache_size misses.
+    RawVector<int> timestamps;
+    timestamps.resize_discard(num_vertices);
+    std::fill(timestamps.begin(), timestamps.end(), -cache_size - 1);
+    RawVector<char> referenced;
+    referenced.resize_zeroclear(num_vertices);
+
+    int misses = 0, num_referenced = 0;
+    for (int ii = 0; ii < num_indices; ++ii) {
+        const int vi = indices[ii];
+        if (misses - timestamps[vi] > cache_size)
+            timestamps[vi] = misses++;
+        if (!referenced[vi]) {
+            referenced[vi] = 1;
+            ++num_referenced;
         }
+    }
+    ret.acmr = (float)misses / (float)(num_indices / 3);
+    ret.atvr = (float)misses / (float)num_referenced;
+    return ret;
+}
 
-        for (int ti2 = ti2begin; ti2 != ti2end; ++ti2) {
-            auto *tri2 = indices.data() + (ti2 * 3);
+void OptimizeVertexCache(IArray<int> indices, int num_vertices, int cache_size)
+{
+    const int num_triangles = (int)indices.size() / 3;
+    if (num_triangles == 0 || num_vertices <= 0)
+        return;
+
+    // vertex to triangle adjacency
+    RawVector<int> live, offsets, triangles;
+    live.resize_zeroclear(num_vertices);
+    for (int ii = 0; ii < num_triangles * 3; ++ii)
+        ++live[indices[ii]];
+    offsets.resize_discard(num_vertices + 1);
+    offsets[num_vertices] = parallel_exclusive_scan(live.cdata(), offsets.data(), num_vertices);
+    triangles.resize_discard(num_triangles * 3);
+    {
+        RawVector<int> pos;
+        pos.assign(offsets.cdata(), offsets.cdata() + num_vertices);
+        for (int ii = 0; ii < num_triangles * 3; ++ii)
+            triangles[pos[indices[ii]]++] = ii / 3;
+    }
 
-            if (overlapped(tri1, tri2) != 2)
+    RawVector<int> cache_time, dead_end, candidates, dst;
+    RawVector<char> emitted;
+    cache_time.resize_zeroclear(num_vertices);
+    emitted.resize_zeroclear(num_triangles);
+    dead_end.reserve(num_triangles * 3);
+    dst.resize_discard(num_triangles * 3);
+
+    int timestamp = cache_size + 1;
+    int cursor = 1;
+    int num_emitted = 0;
+    int fanning = 0;
+
+    auto next_vertex = [&]() {
+        // the candidate that stays longest in the cache after its remaining triangles are emitted
+        int best = -1, best_priority = -1;
+        for (int vi : candidates) {
+            if (live[vi] <= 0)
                 continue;
+            int priority = 0;
+            if (timestamp - cache_time[vi] + 2 * live[vi] <= cache_size)
+                priority = timestamp - cache_time[vi];
+            if (priority > best_priority) {
+                best = vi;
+                best_priority = priority;
+            }
+        }
+        if (best != -1)
+            return best;
+
+        // dead end: most recently referenced vertex that still has triangles
+        while (!dead_end.empty()) {
+            int vi = dead_end.back();
+            dead_end.pop_back();
+            if (live[vi] > 0)
+                return vi;
+        }
+        while (cursor < num_vertices) {
+            if (live[cursor] > 0)
+                return cursor;
+            ++cursor;
+        }
+        return -1;
+    };
 
-            float3 normal2 = normalize(cross(points[tri2[1]] - points[tri2[0]], points[tri2[2]] - points[tri2[0]]));
-            if (dot(normal1, normal2) < 0.0f)
+    while (fanning >= 0) {
+        candidates.clear();
+        for (int i = offsets[fanning]; i < offsets[fanning + 1]; ++i) {
+            const int ti = triangles[i];
+            if (emitted[ti])
                 continue;
+            emitted[ti] = 1;
+            for (int c = 0; c < 3; ++c) {
+                const int vi = indices[ti * 3 + c];
+                dst[num_emitted * 3 + c] = vi;
+                dead_end.push_back(vi);
+                candidates.push_back(vi);
+                --live[vi];
+                if (timestamp - cache_time[vi] > cache_size)
+                    cache_time[vi] = timestamp++;
+            }
+            ++num_emitted;
+        }
+        fanning = next_vertex();
+    }
+    dst.copy_to(indices.data());
+}
 
-            int quad[6];
-            std::copy(tri1, tri1 + 3, quad);
-            std::copy(tri2, tri2 + 3, quad + 3);
-            std::sort(quad, quad + 6);
-            std::unique(quad, quad + 6);
-
-            float3 qpoints[4];
-            for (int i = 0; i < 4; ++i)
-                qpoints[i] = points[quad[i]];
-
-            float3 center = float3::zero();
-            for (auto& v : qpoints)
-                center += v;
-            center *= 0.25f;
-
-            float angles[4]{
-                0.0f,
-                angle_between2_signed(qpoints[0], qpoints[1], center, normal1) * RadToDeg,
-                angle_between2_signed(qpoints[0], qpoints[2], center, normal1) * RadToDeg,
-                angle_between2_signed(qpoints[0], qpoints[3], center, normal1) * RadToDeg,
-            };
+void OptimizeVertexFetch(RawVector<int>& dst, IArray<int> indices, int num_vertices)
+{
+    const int num_indices = (int)indices.size();
+    RawVector<int> old2new;
+    old2new.resize_discard(num_vertices);
+    std::fill(old2new.begin(), old2new.end(), -1);
+    dst.resize_discard(num_vertices);
+
+    int n = 0;
+    for (int ii = 0; ii < num_indices; ++ii) {
+        int& ni = old2new[indices[ii]];
+        if (ni == -1) {
+            ni = n++;
+            dst[ni] = indices[ii];
+        }
+        indices[ii] = ni;
+    }
+    for (int vi = 0; vi < num_vertices; ++vi) {
+        if (old2new[vi] == -1)
+            dst[n++] = vi;
+    }
+}
 
-            int cwi[4], quad_tmp[4];
-            std::iota(cwi, cwi + 4, 0);
-            std::sort(cwi, cwi + 4, [&angles](int a, int b) {
-                return angles[a] < angles[b];
-            });
-            for (int i = 0; i < 4; ++i) {
-                quad_tmp[i] = quad[cwi[i]];
-                qpoints[i] = points[quad_tmp[i]];
+void BuildMeshlets(RawVector<Meshlet>& dst, RawVector<int>& dst_vertices, RawVector<uint8_t>& dst_triangles,
+    const IArray<int> indices, const IArray<float3> points, int max_vertices, int max_triangles)
+{
+    const int num_triangles = (int)indices.size() / 3;
+    if (num_triangles == 0)
+        return;
+    max_vertices = clamp(max_vertices, 3, 256);
+    max_triangles = std::max(max_triangles, 1);
+
+    MeshConnectionInfo connection;
+    connection.buildConnection(indices, 3, points);
+
+    RawVector<int> slots; // local index of each point in the current meshlet, or -1
+    RawVector<char> used, listed;
+    slots.resize_discard(points.size());
+    std::fill(slots.begin(), slots.end(), -1);
+    used.resize_zeroclear(num_triangles);
+    listed.resize_zeroclear(num_triangles);
+
+    RawVector<int> vertices, triangles, candidates;
+    auto new_vertex_count = [&](int ti) {
+        int n = 0;
+        for (int c = 0; c < 3; ++c)
+            n += slots[indices[ti * 3 + c]] == -1 ? 1 : 0;
+        return n;
+    };
+
+    auto flush = [&]() {
+        if (triangles.empty())
+            return;
+        Meshlet m{};
+        m.vertex_offset = (int)dst_vertices.size();
+        m.vertex_count = (int)vertices.size();
+        m.triangle_offset = (int)dst_triangles.size();
+        m.triangle_count = (int)triangles.size();
+
+        // bounding sphere: center of the box, radius to the farthest vertex
+        float3 bmin = points[vertices[0]], bmax = bmin;
+        for (int vi : vertices) {
+            bmin = min(bmin, points[vi]);
+            bmax = max(bmax, points[vi]);
+        }
+        m.center = (bmin + bmax) * 0.5f;
+        float r2 = 0.0f;
+        for (int vi : vertices)
+            r2 = std::max(r2, length_sq(points[vi] - m.center));
+        m.radius = std::sqrt(r2);
+
+        // normal cone
+        float3 axis = float3::zero();
+        RawVector<float3> normals;
+        normals.resize_discard(triangles.size());
+        for (size_t i = 0; i < triangles.size(); ++i) {
+            const int *tri = &indices[triangles[i] * 3];
+            float3 n = cross(points[tri[1]] - points[tri[0]], points[tri[2]] - points[tri[0]]);
+            float len = length(n);
+            normals[i] = len > 0.0f ? n / len : float3::zero();
+            axis += normals[i];
+        }
+        float axis_len = length(axis);
+        m.cone_axis = axis_len > 0.0f ? axis / axis_len : float3{ 0.0f, 0.0f, 1.0f };
+        m.cone_apex = m.center;
+        m.cone_cutoff = 1.0f;
+        float min_dot = 1.0f;
+        for (auto& n : normals)
+            min_dot = std::min(min_dot, dot(n, m.cone_axis));
+        if (axis_len > 0.0f && min_dot > 0.1f) {
+            // move the apex back so that the cone contains the planes of all triangles
+            float max_t = 0.0f;
+            for (size_t i = 0; i < triangles.size(); ++i) {
+                float3 p0 = points[indices[triangles[i] * 3]];
+                float dn = dot(m.cone_axis, normals[i]);
+                if (dn > 0.0f)
+                    max_t = std::max(max_t, dot(m.center - p0, normals[i]) / dn);
             }
+            m.cone_apex = m.center - m.cone_axis * max_t;
+            m.cone_cutoff = std::sqrt(1.0f - min_dot * min_dot);
+        }
+        dst.push_back(m);
 
-            int corners[4][3]{
-                { 3, 0, 1 },
-                { 0, 1, 2 },
-                { 1, 2, 3 },
-                { 2, 3, 0 }
-            };
-            float diff = 0.0f;
-            for (int i = 0; i < 4; ++i) {
-                float angle = angle_between2(
-                    qpoints[corners[i][0]],
-                    qpoints[corners[i][2]],
-                    qpoints[corners[i][1]]) * RadToDeg;
-                diff = std::max(diff, abs(angle - 90.0f));
+        dst_vertices.insert(dst_vertices.end(), vertices.begin(), vertices.end());
+        for (int ti : triangles) {
+            for (int c = 0; c < 3; ++c)
+                dst_triangles.push_back((uint8_t)slots[indices[ti * 3 + c]]);
+        }
+        for (int vi : vertices)
+            slots[vi] = -1;
+        for (int ti : candidates)
+            listed[ti] = 0;
+        vertices.clear();
+        triangles.clear();
+        candidates.clear();
+    };
+
+    auto add_triangle = [&](int ti) {
+        used[ti] = 1;
+        triangles.push_back(ti);
+        for (int c = 0; c < 3; ++c) {
+            int vi = indices[ti * 3 + c];
+            if (slots[vi] == -1) {
+                slots[vi] = (int)vertices.size();
+                vertices.push_back(vi);
             }
-            if (diff < threshold_angle && diff < cd.nangle) {
-                cd.nindex = ti2;
-                cd.nangle = diff;
-                std::copy(quad_tmp, quad_tmp + 4, cd.quad);
+            connection.eachConnectedFaces(vi, [&](int fi, int) {
+                if (!used[fi] && !listed[fi]) {
+                    listed[fi] = 1;
+                    candidates.push_back(fi);
+                }
+            });
+        }
+    };
+
+    int cursor = 0;
+    for (;;) {
+        // the adjacent triangle that adds the fewest vertices. earlier triangles win ties to keep the index order.
+        int best = -1, best_new = 4;
+        for (int ti : candidates) {
+            if (used[ti])
+                continue;
+            int n = new_vertex_count(ti);
+            if (n < best_new || (n == best_new && ti < best)) {
+                best = ti;
+                best_new = n;
             }
         }
+        candidates.erase(std::remove_if(candidates.begin(), candidates.end(), [&](int ti) {
+            if (!used[ti])
+                return false;
+            listed[ti] = 0;
+            return true;
+        }), candidates.end());
+
+        if (best == -1) {
+            // no adjacent triangle left. continue with the next unused triangle.
+            while (cursor < num_triangles && used[cursor])
+                ++cursor;
+            if (cursor == num_triangles)
+                break;
+            best = cursor;
+            best_new = new_vertex_count(best);
+        }
+        if ((int)vertices.size() + best_new > max_vertices || (int)triangles.size() >= max_triangles) {
+            flush();
+            continue;
+        }
+        add_triangle(best);
+    }
+    flush();
+}
+
+// triangle pairs are found through shared edges instead of comparing triangles with each other.
+// half-edges are bucketed by their smaller vertex and each bucket is sorted by the other vertex, so edges shared by
+// exactly two triangles are found in O(n log n) even around high valence vertices.
+// candidates are merged best score first. candidates only compete with others in the same connected component,
+// so components are processed in parallel and the result is the same as a global best-first pass.
+void QuadifyTriangles(const IArray<float3> points, const IArray<int> indices, bool full_search, float threshold_angle,
+    RawVector<int>& dst_indices, RawVector<int>& dst_counts, float threshold_planarity)
+{
+    const int num_points = (int)points.size();
+    const int num_triangles = (int)indices.size() / 3;
+    const int num_half_edges = num_triangles * 3;
+    if (num_triangles == 0)
+        return;
+
+    auto edge_begin = [&](int hi) { return indices[hi]; };
+    auto edge_end = [&](int hi) { return indices[hi - hi % 3 + (hi % 3 + 1) % 3]; };
+    auto is_valid_triangle = [&](int ti) {
+        const int *tri = &indices[ti * 3];
+        for (int i = 0; i < 3; ++i) {
+            if (tri[i] < 0 || tri[i] >= num_points)
+                return false;
+        }
+        return tri[0] != tri[1] && tri[1] != tri[2] && tri[2] != tri[0];
+    };
+
+    // bucket half-edges by the smaller vertex index
+    RawVector<char> valid;
+    RawVector<int> bucket_counts, bucket_offsets, half_edges;
+    valid.resize_discard(num_triangles);
+    parallel_for_blocked(0, num_triangles, 1024 * 8, [&](int begin, int end) {
+        for (int ti = begin; ti < end; ++ti)
+            valid[ti] = is_valid_triangle(ti);
     });
+    bucket_counts.resize_zeroclear(num_points);
+    for (int hi = 0; hi < num_half_edges; ++hi) {
+        if (valid[hi / 3])
+            ++bucket_counts[std::min(edge_begin(hi), edge_end(hi))];
+    }
+    bucket_offsets.resize_discard(num_points + 1);
+    bucket_offsets[num_points] = parallel_exclusive_scan(bucket_counts.cdata(), bucket_offsets.data(), num_points);
+    half_edges.resize_discard(bucket_offsets[num_points]);
+    {
+        RawVector<int> pos;
+        pos.assign(bucket_offsets.cdata(), bucket_offsets.cdata() + num_points);
+        for (int hi = 0; hi < num_half_edges; ++hi) {
+            if (valid[hi / 3])
+                half_edges[pos[std::min(edge_begin(hi), edge_end(hi))]++] = hi;
+        }
+    }
 
-    for (int ti1 = 0; ti1 < num_triangles; ++ti1) {
-        auto& cd = connections[ti1];
-        if (cd.merged)
-            continue;
+    // evaluate each edge shared by exactly two triangles with opposite winding.
+    // the result is stored at the half-edge with the smaller index to keep the order deterministic.
+    struct Candidate
+    {
+        int tri[2];
+        float score;
+        int quad[4];
+    };
+    RawVector<Candidate> edge_candidates;
+    RawVector<char> has_candidate;
+    edge_candidates.resize_discard(num_half_edges);
+    has_candidate.resize_zeroclear(num_half_edges);
+
+    const float planarity = std::cos(clamp(threshold_planarity, 0.0f, 180.0f) * DegToRad);
+    auto evaluate = [&](int h0, int h1, Candidate& dst) {
+        const int t0 = h0 / 3, t1 = h1 / 3;
+        if (!full_search && std::abs(t0 - t1) != 1)
+            return false;
+
+        // t0: a -> b -> c, t1: b -> a -> d. the quad a, d, b, c keeps the winding of both triangles.
+        const int a = edge_begin(h0);
+        const int b = edge_end(h0);
+        const int c = indices[t0 * 3 + (h0 % 3 + 2) % 3];
+        const int d = indices[t1 * 3 + (h1 % 3 + 2) % 3];
+        if (c == d)
+            return false;
+
+        const float3 pa = points[a], pb = points[b], pc = points[c], pd = points[d];
+        float3 n0 = cross(pb - pa, pc - pa);
+        float3 n1 = cross(pa - pb, pd - pb);
+        const float l0 = length(n0), l1 = length(n1);
+        if (!(l0 > 0.0f) || !(l1 > 0.0f))
+            return false;
+        n0 /= l0;
+        n1 /= l1;
+        if (dot(n0, n1) < planarity)
+            return false;
+
+        const int quad[4]{ a, d, b, c };
+        const float3 qpoints[4]{ pa, pd, pb, pc };
+        const float3 normal = n0 + n1;
+        float diff = 0.0f;
+        for (int i = 0; i < 4; ++i) {
+            const float3& prev = qpoints[(i + 3) % 4];
+            const float3& cur = qpoints[i];
+            const float3& next = qpoints[(i + 1) % 4];
+            // reject concave quads
+            if (dot(cross(cur - prev, next - cur), normal) <= 0.0f)
+                return false;
+            float angle = angle_between2(prev, next, cur) * RadToDeg;
+            diff = std::max(diff, std::abs(angle - 90.0f));
+        }
+        if (!(diff < threshold_angle))
+            return false;
+
+        dst.tri[0] = t0;
+        dst.tri[1] = t1;
+        dst.score = diff;
+        std::copy(quad, quad + 4, dst.quad);
+        return true;
+    };
 
-        if (cd.nindex != -1 && !connections[cd.nindex].merged) {
-            connections[cd.nindex].merged = true;
-            dst_indices.insert(dst_indices.end(), cd.quad, cd.quad + 4);
-            dst_counts.push_back(4);
+    // each bucket is sorted by the other vertex of the edge, so half-edges on the same edge are adjacent.
+    // poles and fans with high valence stay O(n log n) instead of comparing every pair in the bucket.
+    parallel_for_blocked(0, num_points, 1024 * 4, [&](int begin, int end) {
+        for (int vi = begin; vi < end; ++vi) {
+            int *bucket = half_edges.data() + bucket_offsets[vi];
+            const int n = bucket_counts[vi];
+            auto other = [&](int hi) { return edge_begin(hi) ^ edge_end(hi) ^ vi; };
+            std::sort(bucket, bucket + n, [&](int h0, int h1) {
+                const int o0 = other(h0), o1 = other(h1);
+                return o0 != o1 ? o0 < o1 : h0 < h1;
+            });
+            for (int i = 0; i < n;) {
+                int run = 1;
+                while (i + run < n && other(bucket[i + run]) == other(bucket[i]))
+                    ++run;
+                const int h0 = bucket[i];
+                i += run;
+                if (run != 2)
+                    continue;
+                const int h1 = bucket[i - 1];
+                if (edge_begin(h0) != edge_end(h1))
+                    continue;
+                if (evaluate(h0, h1, edge_candidates[h0]))
+                    has_candidate[h0] = 1;
+            }
         }
-        else {
-            auto *tri1 = indices.data() + (ti1 * 3);
-            dst_indices.insert(dst_indices.end(), tri1, tri1 + 3);
+    });
+
+    RawVector<Candidate> candidates;
+    for (int hi = 0; hi < num_half_edges; ++hi) {
+        if (has_candidate[hi])
+            candidates.push_back(edge_candidates[hi]);
+    }
+    const int num_candidates = (int)candidates.size();
+
+    // connected components of triangles linked by candidates
+    RawVector<int> parents;
+    parents.resize_discard(num_triangles);
+    std::iota(parents.begin(), parents.end(), 0);
+    auto find_root = [&](int ti) {
+        while (parents[ti] != ti) {
+            parents[ti] = parents[parents[ti]];
+            ti = parents[ti];
+        }
+        return ti;
+    };
+    for (auto& c : candidates) {
+        int r0 = find_root(c.tri[0]);
+        int r1 = find_root(c.tri[1]);
+        if (r0 != r1)
+            parents[std::max(r0, r1)] = std::min(r0, r1);
+    }
+
+    // order candidates by component, then best score first
+    RawVector<int> roots, order;
+    roots.resize_discard(num_candidates);
+    order.resize_discard(num_candidates);
+    for (int ci = 0; ci < num_candidates; ++ci)
+        roots[ci] = find_root(candidates[ci].tri[0]);
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&](int a, int b) {
+        if (roots[a] != roots[b])
+            return roots[a] < roots[b];
+        if (candidates[a].score != candidates[b].score)
+            return candidates[a].score < candidates[b].score;
+        return a < b;
+    });
+
+    RawVector<int> groups;
+    for (int i = 0; i < num_candidates; ++i) {
+        if (i == 0 || roots[order[i]] != roots[order[i - 1]])
+            groups.push_back(i);
+    }
+    groups.push_back(num_candidates);
+
+    // partners[ti]: the candidate that ti is merged with, or -1
+    RawVector<int> partners;
+    partners.resize_discard(num_triangles);
+    std::fill(partners.begin(), partners.end(), -1);
+    parallel_for(0, (int)groups.size() - 1, 64, [&](int gi) {
+        for (int i = groups[gi]; i < groups[gi + 1]; ++i) {
+            const int ci = order[i];
+            const auto& c = candidates[ci];
+            if (partners[c.tri[0]] == -1 && partners[c.tri[1]] == -1) {
+                partners[c.tri[0]] = ci;
+                partners[c.tri[1]] = ci;
+            }
+        }
+    });
+
+    // output in the order of the first triangle of each face
+    for (int ti = 0; ti < num_triangles; ++ti) {
+        const int ci = partners[ti];
+        if (ci == -1) {
+            const int *tri = &indices[ti * 3];
+            dst_indices.insert(dst_indices.end(), tri, tri + 3);
             dst_counts.push_back(3);
         }
+        else {
+            const auto& c = candidates[ci];
+            if (ti != std::min(c.tri[0], c.tri[1]))
+                continue;
+            dst_indices.insert(dst_indices.end(), c.quad, c.quad + 4);
+            dst_counts.push_back(4);
+        }
     }
 }
 
@@ -0,0 +1,605 @@
+#include "pch.h"
+#include <atomic>
+#include "MeshUtils/muBVH.h"
+#include "MeshUtils/muSIMD.h"
+#include "MeshUtils/muConcurrency.h"
+#include "muSIMDVector.h"
+
+namespace mu {
+
+static const int MaxBins = 32;
+// SAH splits are used up to this depth. deeper nodes are split at the median so that the depth stays bounded.
+static const int MaxSAHDepth = 48;
+// enough for MaxSAHDepth + log2(max triangle count)
+static const int StackSize = 128;
+// nodes with more triangles than this are binned in parallel and their children built as separate tasks
+static const int ParallelBuildThreshold = 1024 * 16;
+static const int PacketSize = 8;
+
+namespace {
+
+struct AABB
+{
+    float3 bmin = { FLT_MAX, FLT_MAX, FLT_MAX };
+    float3 bmax = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+    void expand(const float3& p) { bmin = min(bmin, p); bmax = max(bmax, p); }
+    void expand(const float3& mn, const float3& mx) { bmin = min(bmin, mn); bmax = max(bmax, mx); }
+    void expand(const AABB& v) { expand(v.bmin, v.bmax); }
+    bool valid() const { return bmin.x <= bmax.x; }
+    float halfArea() const
+    {
+        if (!valid())
+            return 0.0f;
+        float3 e = bmax - bmin;
+        return e.x * e.y + e.y * e.z + e.z * e.x;
+    }
+};
+
+// per axis bins of a node. left uninitialized on construction: nodes are many and only num_bins entries are used.
+struct Bins
+{
+    float3 bmin[3][MaxBins];
+    float3 bmax[3][MaxBins];
+    int counts[3][MaxBins];
+    int num_bins;
+
+    void reset(int n)
+    {
+        num_bins = n;
+        for (int a = 0; a < 3; ++a) {
+            for (int b = 0; b < n; ++b) {
+                bmin[a][b] = { FLT_MAX, FLT_MAX, FLT_MAX };
+                bmax[a][b] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+                counts[a][b] = 0;
+            }
+        }
+    }
+
+    void add(int a, int b, const float3& mn, const float3& mx)
+    {
+        bmin[a][b] = min(bmin[a][b], mn);
+        bmax[a][b] = max(bmax[a][b], mx);
+        ++counts[a][b];
+    }
+
+    void join(const Bins& v)
+    {
+        for (int a = 0; a < 3; ++a) {
+            for (int b = 0; b < num_bins; ++b) {
+                bmin[a][b] = min(bmin[a][b], v.bmin[a][b]);
+                bmax[a][b] = max(bmax[a][b], v.bmax[a][b]);
+                counts[a][b] += v.counts[a][b];
+            }
+        }
+    }
+};
+
+// triangles are partitioned as these instead of indices, so that binning reads memory sequentially
+struct PrimRef
+{
+    float3 bmin;
+    int index;
+    float3 bmax;
+    int pad;
+
+    float center(int a) const { return (bmin[a] + bmax[a]) * 0.5f; }
+};
+
+struct NodeBounds
+{
+    AABB bounds;    // of triangles
+    AABB centroids;
+};
+
+} // namespace
+
+// ray_triangle_intersection() accepts hits slightly outside of triangles (barycentric eps). bounds are padded so that
+// such hits are not culled by the boxes.
+static inline void TriangleBounds(const float3& p1, const float3& p2, const float3& p3, float3& dst_min, float3& dst_max)
+{
+    float3 mn = min(min(p1, p2), p3);
+    float3 mx = max(max(p1, p2), p3);
+    float3 e = mx - mn;
+    float3 a = max(abs(mn), abs(mx));
+    float pad = std::max(std::max(std::max(e.x, e.y), e.z) * 1e-3f, std::max(std::max(a.x, a.y), a.z) * 1e-6f);
+    dst_min = mn - pad;
+    dst_max = mx + pad;
+}
+
+// zero components become huge instead of inf so that (b - p) * inv never produces NaN
+static inline float3 InvDir(const float3& d)
+{
+    return {
+        d.x != 0.0f ? 1.0f / d.x : FLT_MAX,
+        d.y != 0.0f ? 1.0f / d.y : FLT_MAX,
+        d.z != 0.0f ? 1.0f / d.z : FLT_MAX,
+    };
+}
+
+// entry distance of the ray into the box, or FLT_MAX if the ray misses it or enters it beyond tmax
+static inline float RayBox(const float3& pos, const float3& inv, const float3& bmin, const float3& bmax, float tmax)
+{
+    float3 t1 = (bmin - pos) * inv;
+    float3 t2 = (bmax - pos) * inv;
+    float3 tn = min(t1, t2);
+    float3 tf = max(t1, t2);
+    float tnear = std::max(std::max(std::max(tn.x, tn.y), tn.z), 0.0f);
+    float tfar = std::min(std::min(tf.x, tf.y), tf.z);
+    return tnear <= tfar && tnear <= tmax ? tnear : FLT_MAX;
+}
+
+static inline float BoxDistanceSq(const float3& pos, const float3& bmin, const float3& bmax)
+{
+    float3 d = max(max(bmin - pos, pos - bmax), float3::zero());
+    return dot(d, d);
+}
+
+
+struct TriangleBVH::BuildContext
+{
+    RawVector<PrimRef> refs;
+    std::atomic<int> num_nodes{ 1 };
+    int num_bins = 16;
+};
+
+void TriangleBVH::build()
+{
+    const int num_triangles = (int)(indices.size() / 3);
+    if (num_triangles == 0) {
+        clear();
+        return;
+    }
+
+    m_indices.assign(indices.data(), indices.data() + num_triangles * 3);
+
+    BuildContext ctx;
+    ctx.num_bins = clamp(num_bins, 4, MaxBins);
+    ctx.refs.resize_discard(num_triangles);
+    parallel_for_blocked(0, num_triangles, 1024 * 8, [&](int begin, int end) {
+        for (int ti = begin; ti < end; ++ti) {
+            const int *tri = &m_indices[ti * 3];
+            PrimRef& ref = ctx.refs[ti];
+            TriangleBounds(points[tri[0]], points[tri[1]], points[tri[2]], ref.bmin, ref.bmax);
+            ref.index = ti;
+            ref.pad = 0;
+        }
+    });
+
+    m_nodes.resize_discard(num_triangles * 2 - 1);
+    buildNode(ctx, 0, 0, num_triangles, 0);
+    m_nodes.resize(ctx.num_nodes.load());
+
+    m_order.resize_discard(num_triangles);
+    for (int i = 0; i < num_triangles; ++i)
+        m_order[i] = ctx.refs[i].index;
+
+    updateLeafVertices();
+}
+
+void TriangleBVH::buildNode(BuildContext& ctx, int node_index, int first, int count, int depth)
+{
+    PrimRef *refs = ctx.refs.data() + first;
+    const bool parallel = count > ParallelBuildThreshold;
+
+    auto accumulate_bounds = [&](int begin, int end, NodeBounds acc) {
+        for (int i = begin; i < end; ++i) {
+            const PrimRef& r = refs[i];
+            acc.bounds.expand(r.bmin, r.bmax);
+            acc.centroids.expand((r.bmin + r.bmax) * 0.5f);
+        }
+        return acc;
+    };
+    NodeBounds nb;
+    if (parallel) {
+        nb = parallel_reduce(0, count, ParallelBuildThreshold, NodeBounds(), accumulate_bounds,
+            [](NodeBounds a, const NodeBounds& b) { a.bounds.expand(b.bounds); a.centroids.expand(b.centroids); return a; });
+    }
+    else {
+        nb = accumulate_bounds(0, count, NodeBounds());
+    }
+
+    Node& node = m_nodes[node_index];
+    node.bmin = nb.bounds.bmin;
+    node.bmax = nb.bounds.bmax;
+
+    auto make_leaf = [&]() {
+        node.offset = first;
+        node.count = count;
+    };
+    // leaves are tested by the SIMD kernel, so a few more triangles in a leaf are cheaper than another level of nodes
+    if (count <= std::max(max_leaf_triangles, 1)) {
+        make_leaf();
+        return;
+    }
+
+    const float3 cmin = nb.centroids.bmin;
+    const float3 cextent = nb.centroids.bmax - cmin;
+    const int nbins = ctx.num_bins;
+    float3 bin_scale;
+    for (int a = 0; a < 3; ++a)
+        bin_scale[a] = cextent[a] > 0.0f ? (float)nbins / cextent[a] * 0.9999f : 0.0f;
+    auto bin_of = [&](const PrimRef& r, int a) {
+        return clamp((int)((r.center(a) - cmin[a]) * bin_scale[a]), 0, nbins - 1);
+    };
+
+    int split_axis = -1, split_bin = -1;
+    float split_cost = FLT_MAX;
+    if (depth < MaxSAHDepth) {
+        auto accumulate_bins = [&](int begin, int end, Bins& acc) {
+            for (int i = begin; i < end; ++i) {
+                const PrimRef& r = refs[i];
+                for (int a = 0; a < 3; ++a)
+                    acc.add(a, bin_of(r, a), r.bmin, r.bmax);
+            }
+        };
+        Bins bins;
+        bins.reset(nbins);
+        if (parallel) {
+            bins = parallel_reduce(0, count, ParallelBuildThreshold, bins,
+                [&](int begin, int end, Bins acc) { accumulate_bins(begin, end, acc); return acc; },
+                [](Bins a, const Bins& b) { a.join(b); return a; });
+        }
+        else {
+            accumulate_bins(0, count, bins);
+        }
+
+        for (int a = 0; a < 3; ++a) {
+            if (bin_scale[a] == 0.0f)
+                continue;
+
+            float right_area[MaxBins];
+            int right_count[MaxBins];
+            AABB r;
+            int rc = 0;
+            for (int b = nbins - 1; b > 0; --b) {
+                r.expand(bins.bmin[a][b], bins.bmax[a][b]);
+                rc += bins.counts[a][b];
+                right_area[b] = r.halfArea();
+                right_count[b] = rc;
+            }
+
+            AABB l;
+            int lc = 0;
+            for (int b = 0; b < nbins - 1; ++b) {
+                l.expand(bins.bmin[a][b], bins.bmax[a][b]);
+                lc += bins.counts[a][b];
+                if (lc == 0 || right_count[b + 1] == 0)
+                    continue;
+                float cost = l.halfArea() * lc + right_area[b + 1] * right_count[b + 1];
+                if (cost < split_cost) {
+                    split_cost = cost;
+                    split_axis = a;
+                    split_bin = b;
+                }
+            }
+        }
+    }
+
+    int num_left = 0;
+    if (split_axis >= 0) {
+        PrimRef *mid = std::partition(refs, refs + count, [&](const PrimRef& r) { return bin_of(r, split_axis) <= split_bin; });
+        num_left = (int)(mid - refs);
+    }
+    else {
+        // too deep or all centroids are at the same place. split at the median of the longest axis
+        int axis = 0;
+        if (cextent.y > cextent[axis]) axis = 1;
+        if (cextent.z > cextent[axis]) axis = 2;
+        num_left = count / 2;
+        std::nth_element(refs, refs + num_left, refs + count,
+            [axis](const PrimRef& r1, const PrimRef& r2) { return r1.center(axis) < r2.center(axis); });
+    }
+
+    int left = ctx.num_nodes.fetch_add(2);
+    node.offset = left;
+    node.count = 0;
+
+    auto build_left = [&]() { buildNode(ctx, left, first, num_left, depth + 1); };
+    auto build_right = [&]() { buildNode(ctx, left + 1, first + num_left, count - num_left, depth + 1); };
+    if (parallel) {
+        parallel_invoke(build_left, build_right);
+    }
+    else {
+        build_left();
+        build_right();
+    }
+}
+
+void TriangleBVH::updateLeafVertices()
+{
+    const int num_triangles = (int)m_order.size();
+    for (auto& v : m_vertices)
+        v.resize_discard(num_triangles);
+
+    parallel_for_blocked(0, num_triangles, 1024 * 8, [&](int begin, int end) {
+        for (int i = begin; i < end; ++i) {
+            const int *tri = &m_indices[m_order[i] * 3];
+            for (int vi = 0; vi < 3; ++vi) {
+                float3 p = points[tri[vi]];
+                m_vertices[vi * 3 + 0][i] = p.x;
+                m_vertices[vi * 3 + 1][i] = p.y;
+                m_vertices[vi * 3 + 2][i] = p.z;
+            }
+        }
+    });
+}
+
+void TriangleBVH::refit()
+{
+    if (m_nodes.empty())
+        return;
+
+    updateLeafVertices();
+
+    const int num_nodes = (int)m_nodes.size();
+    parallel_for_blocked(0, num_nodes, 1024, [&](int begin, int end) {
+        for (int ni = begin; ni < end; ++ni) {
+            Node& node = m_nodes[ni];
+            if (node.count == 0)
+                continue;
+            AABB bounds;
+            for (int i = node.offset; i < node.offset + node.count; ++i) {
+                float3 p[3], mn, mx;
+                for (int vi = 0; vi < 3; ++vi)
+                    p[vi] = { m_vertices[vi * 3 + 0][i], m_vertices[vi * 3 + 1][i], m_vertices[vi * 3 + 2][i] };
+                TriangleBounds(p[0], p[1], p[2], mn, mx);
+                bounds.expand(mn, mx);
+            }
+            node.bmin = bounds.bmin;
+            node.bmax = bounds.bmax;
+        }
+    });
+
+    // children are always allocated after their parent. so in reverse order every child is done before its parent.
+    for (int ni = num_nodes - 1; ni >= 0; --ni) {
+        Node& node = m_nodes[ni];
+        if (node.count != 0)
+            continue;
+        const Node& l = m_nodes[node.offset];
+        const Node& r = m_nodes[node.offset + 1];
+        node.bmin = min(l.bmin, r.bmin);
+        node.bmax = max(l.bmax, r.bmax);
+    }
+}
+
+void TriangleBVH::clear()
+{
+    m_nodes.clear();
+    m_order.clear();
+    m_indices.clear();
+    for (auto& v : m_vertices)
+        v.clear();
+}
+
+bool TriangleBVH::empty() const
+{
+    return m_nodes.empty();
+}
+
+size_t TriangleBVH::getNodeCount() const
+{
+    return m_nodes.size();
+}
+
+
+bool TriangleBVH::raycast(float3 pos, float3 dir, int& tindex, float& distance) const
+{
+    tindex = -1;
+    distance = FLT_MAX;
+    if (m_nodes.empty())
+        return false;
+
+    const float3 inv = InvDir(dir);
+    const Node *nodes = m_nodes.data();
+    struct Entry { int node; float t; };
+    Entry stack[StackSize];
+    int sp = 0;
+
+    if (RayBox(pos, inv, nodes[0].bmin, nodes[0].bmax, distance) == FLT_MAX)
+        return false;
+    stack[sp++] = { 0, 0.0f };
+    while (sp > 0) {
+        Entry e = stack[--sp];
+        if (e.t > distance)
+            continue;
+        const Node& node = nodes[e.node];
+        if (node.count > 0) {
+            const int o = node.offset;
+            int ti;
+            float d;
+            if (RayTrianglesIntersectionSoA(pos, dir,
+                    m_vertices[0].data() + o, m_vertices[1].data() + o, m_vertices[2].data() + o,
+                    m_vertices[3].data() + o, m_vertices[4].data() + o, m_vertices[5].data() + o,
+                    m_vertices[6].data() + o, m_vertices[7].data() + o, m_vertices[8].data() + o,
+                    node.count, ti, d) && d < distance) {
+                distance = d;
+                tindex = m_order[o + ti];
+            }
+        }
+        else {
+            const Node& l = nodes[node.offset];
+            const Node& r = nodes[node.offset + 1];
+            float tl = RayBox(pos, inv, l.bmin, l.bmax, distance);
+            float tr = RayBox(pos, inv, r.bmin, r.bmax, distance);
+            // push the far one first so that the near one is visited next
+            if (tl <= tr) {
+                if (tr != FLT_MAX) stack[sp++] = { node.offset + 1, tr };
+                if (tl != FLT_MAX) stack[sp++] = { node.offset, tl };
+            }
+            else {
+                if (tl != FLT_MAX) stack[sp++] = { node.offset, tl };
+                stack[sp++] = { node.offset + 1, tr };
+            }
+        }
+    }
+    return tindex >= 0;
+}
+
+void TriangleBVH::raycastPacket(const float3 *pos, const float3 *dir, int num_rays, int *dst_tindices, float *dst_distances) const
+{
+    // rays in SoA so that a box is tested against the whole packet at once. unused slots have tmax -1 and never hit.
+    struct Packet
+    {
+        float ox[PacketSize], oy[PacketSize], oz[PacketSize];
+        float ix[PacketSize], iy[PacketSize], iz[PacketSize];
+        float tmax[PacketSize];
+    } rays;
+    for (int ri = 0; ri < PacketSize; ++ri) {
+        bool active = ri < num_rays;
+        float3 o = active ? pos[ri] : float3::zero();
+        float3 inv = active ? InvDir(dir[ri]) : float3::one();
+        rays.ox[ri] = o.x; rays.oy[ri] = o.y; rays.oz[ri] = o.z;
+        rays.ix[ri] = inv.x; rays.iy[ri] = inv.y; rays.iz[ri] = inv.z;
+        rays.tmax[ri] = active ? FLT_MAX : -1.0f;
+    }
+    for (int ri = 0; ri < num_rays; ++ri)
+        dst_tindices[ri] = -1;
+
+    // bit i is set if ray i enters the box. tnear is the nearest entry among them.
+    auto packet_box = [&rays](const Node& n, float& tnear) {
+        int mask = 0;
+#ifdef muSIMDVector_Backend
+        using namespace simd;
+        const vfloat nx = set1(n.bmin.x), ny = set1(n.bmin.y), nz = set1(n.bmin.z);
+        const vfloat xx = set1(n.bmax.x), xy = set1(n.bmax.y), xz = set1(n.bmax.z);
+        vfloat vnear = set1(FLT_MAX);
+        for (int i = 0; i < PacketSize; i += Width) {
+            vfloat ox = load(rays.ox + i), oy = load(rays.oy + i), oz = load(rays.oz + i);
+            vfloat ix = load(rays.ix + i), iy = load(rays.iy + i), iz = load(rays.iz + i);
+            vfloat t1x = (nx - ox) * ix, t2x = (xx - ox) * ix;
+            vfloat t1y = (ny - oy) * iy, t2y = (xy - oy) * iy;
+            vfloat t1z = (nz - oz) * iz, t2z = (xz - oz) * iz;
+            vfloat tn = max(max(max(min(t1x, t2x), min(t1y, t2y)), min(t1z, t2z)), set1(0.0f));
+            vfloat tf = min(min(max(t1x, t2x), max(t1y, t2y)), max(t1z, t2z));
+            vmask hit = (tn <= tf) & (tn <= load(rays.tmax + i));
+            vnear = min(vnear, select(hit, tn, set1(FLT_MAX)));
+            mask |= movemask(hit) << i;
+        }
+        float tmp[Width];
+        store(tmp, vnear);
+        tnear = FLT_MAX;
+        for (int i = 0; i < Width; ++i)
+            tnear = std::min(tnear, tmp[i]);
+#else
+        tnear = FLT_MAX;
+        for (int ri = 0; ri < PacketSize; ++ri) {
+            float t = RayBox({ rays.ox[ri], rays.oy[ri], rays.oz[ri] }, { rays.ix[ri], rays.iy[ri], rays.iz[ri] },
+                n.bmin, n.bmax, rays.tmax[ri]);
+            if (t != FLT_MAX) {
+                mask |= 1 << ri;
+                tnear = std::min(tnear, t);
+            }
+        }
+#endif
+        return mask;
+    };
+
+    if (!m_nodes.empty()) {
+        const Node *nodes = m_nodes.data();
+        int stack[StackSize];
+        int sp = 0;
+        float t;
+        if (packet_box(nodes[0], t))
+            stack[sp++] = 0;
+        while (sp > 0) {
+            const Node& node = nodes[stack[--sp]];
+            if (node.count > 0) {
+                const int o = node.offset;
+                int mask = packet_box(node, t);
+                for (int ri = 0; mask != 0; ++ri, mask >>= 1) {
+                    if ((mask & 1) == 0)
+                        continue;
+                    int ti;
+                    float d;
+                    if (RayTrianglesIntersectionSoA(pos[ri], dir[ri],
+                            m_vertices[0].data() + o, m_vertices[1].data() + o, m_vertices[2].data() + o,
+                            m_vertices[3].data() + o, m_vertices[4].data() + o, m_vertices[5].data() + o,
+                            m_vertices[6].data() + o, m_vertices[7].data() + o, m_vertices[8].data() + o,
+                            node.count, ti, d) && d < rays.tmax[ri]) {
+                        rays.tmax[ri] = d;
+                        dst_tindices[ri] = m_order[o + ti];
+                    }
+                }
+            }
+            else {
+                float tl, tr;
+                int ml = packet_box(nodes[node.offset], tl);
+                int mr = packet_box(nodes[node.offset + 1], tr);
+                if (tl <= tr) {
+                    if (mr) stack[sp++] = node.offset + 1;
+                    if (ml) stack[sp++] = node.offset;
+                }
+                else {
+                    if (ml) stack[sp++] = node.offset;
+                    if (mr) stack[sp++] = node.offset + 1;
+                }
+            }
+        }
+    }
+    for (int ri = 0; ri < num_rays; ++ri)
+        dst_distances[ri] = rays.tmax[ri];
+}
+
+void TriangleBVH::raycast(const float3 *pos, const float3 *dir, int num_rays, int *dst_tindices, float *dst_distances) const
+{
+    parallel_for_blocked(0, num_rays, PacketSize * 8, [&](int begin, int end) {
+        for (int i = begin; i < end; i += PacketSize)
+            raycastPacket(pos + i, dir + i, std::min(PacketSize, end - i), dst_tindices + i, dst_distances + i);
+    });
+}
+
+bool TriangleBVH::closestPoint(float3 pos, int& tindex, float3& dst_point, float max_distance) const
+{
+    tindex = -1;
+    if (m_nodes.empty())
+        return false;
+
+    float best = max_distance < std::sqrt(FLT_MAX) ? max_distance * max_distance : FLT_MAX;
+    const Node *nodes = m_nodes.data();
+    struct Entry { int node; float d2; };
+    Entry stack[StackSize];
+    int sp = 0;
+
+    float d2 = BoxDistanceSq(pos, nodes[0].bmin, nodes[0].bmax);
+    if (d2 > best)
+        return false;
+    stack[sp++] = { 0, d2 };
+    while (sp > 0) {
+        Entry e = stack[--sp];
+        if (e.d2 > best)
+            continue;
+        const Node& node = nodes[e.node];
+        if (node.count > 0) {
+            for (int i = node.offset; i < node.offset + node.count; ++i) {
+                float3 p1 = { m_vertices[0][i], m_vertices[1][i], m_vertices[2][i] };
+                float3 p2 = { m_vertices[3][i], m_vertices[4][i], m_vertices[5][i] };
+                float3 p3 = { m_vertices[6][i], m_vertices[7][i], m_vertices[8][i] };
+                float3 q = closest_point_on_triangle(pos, p1, p2, p3);
+                float qd2 = length_sq(q - pos);
+                if (qd2 <= best && (tindex < 0 || qd2 < best)) {
+                    best = qd2;
+                    tindex = m_order[i];
+                    dst_point = q;
+                }
+            }
+        }
+        else {
+            const Node& l = nodes[node.offset];
+            const Node& r = nodes[node.offset + 1];
+            float dl = BoxDistanceSq(pos, l.bmin, l.bmax);
+            float dr = BoxDistanceSq(pos, r.bmin, r.bmax);
+            if (dl <= dr) {
+                if (dr <= best) stack[sp++] = { node.offset + 1, dr };
+                if (dl <= best) stack[sp++] = { node.offset, dl };
+            }
+            else {
+                if (dl <= best) stack[sp++] = { node.offset, dl };
+                if (dr <= best) stack[sp++] = { node.offset + 1, dr };
+            }
+        }
+    }
+    return tindex >= 0;
+}
+
+} // namespace mu
@@ -0,0 +1,305 @@
+#include "pch.h"
+#include "MeshUtils/muConcurrency.h"
+#include "MeshUtils/muMath.h" //ceildiv
+
+#ifdef muEnableThreadPool
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace mu {
+
+namespace {
+
+struct RangeTask
+{
+    ThreadPool::RangeFunc func = nullptr;
+    const void *ctx = nullptr;
+    int begin = 0;
+    int end = 0;
+    int grain = 1;
+    ThreadPool::TaskGroup *group = nullptr;
+};
+
+class WorkQueue
+{
+public:
+    void push(const RangeTask& task)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_tasks.push_back(task);
+    }
+
+    // owner side: LIFO for locality
+    bool pop(RangeTask& dst)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_tasks.empty())
+            return false;
+        dst = m_tasks.back();
+        m_tasks.pop_back();
+        return true;
+    }
+
+    // thief side: FIFO, takes the largest ranges
+    bool steal(RangeTask& dst)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_tasks.empty())
+            return false;
+        dst = m_tasks.front();
+        m_tasks.pop_front();
+        return true;
+    }
+
+private:
+    std::mutex m_mutex;
+    std::deque<RangeTask> m_tasks;
+};
+
+std::atomic<int> g_requested_workers{ 0 };
+std::atomic<int> g_default_grain{ 0 };
+std::mutex g_config_mutex;
+
+} // namespace
+
+
+class ThreadPool::Impl
+{
+public:
+    explicit Impl(int num_workers)
+    {
+        // queue 0 is shared by the threads that don't belong to the pool
+        m_queues.resize(num_workers + 1);
+        for (auto& q : m_queues)
+            q = std::make_unique<WorkQueue>();
+        for (int i = 0; i < num_workers; ++i)
+            m_workers.emplace_back([this, i]() { workerMain(i + 1); });
+    }
+
+    ~Impl()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_sleep_mutex);
+            m_stop = true;
+        }
+        m_cond.notify_all();
+        for (auto& t : m_workers)
+            t.join();
+    }
+
+    int workerCount() const { return (int)m_workers.size(); }
+
+    bool isOwnWorker() const { return s_current == this; }
+
+    void push(const RangeTask& task)
+    {
+        m_queues[localIndex()]->push(task);
+        ++m_num_queued;
+        if (m_num_sleeping.load() > 0) {
+            std::lock_guard<std::mutex> lock(m_sleep_mutex);
+            m_cond.notify_one();
+        }
+    }
+
+    void execute(RangeTask task)
+    {
+        TaskGroup& group = *task.group;
+        if (!group.failed.load(std::memory_order_relaxed)) {
+            try {
+                // split lazily: keep the lower half and publish the upper half for thieves
+                while (task.end - task.begin > task.grain) {
+                    RangeTask upper = task;
+                    upper.begin = task.begin + (task.end - task.begin) / 2;
+                    task.end = upper.begin;
+                    group.pending.fetch_add(1, std::memory_order_relaxed);
+                    try {
+                        push(upper);
+                    }
+                    catch (...) {
+                        group.pending.fetch_sub(1, std::memory_order_relaxed);
+                        throw;
+                    }
+                }
+                task.func(task.ctx, task.begin, task.end);
+            }
+            catch (...) {
+                // keep the first one. it is published to the waiting thread by the release below.
+                if (!group.failed.exchange(true))
+                    group.exception = std::current_exception();
+            }
+        }
+        group.pending.fetch_sub(1, std::memory_order_release);
+    }
+
+    void wait(TaskGroup& group)
+    {
+        RangeTask task;
+        while (group.pending.load(std::memory_order_acquire) != 0) {
+            if (findTask(task))
+                execute(task);
+            else
+                std::this_thread::yield();
+        }
+        if (group.exception) {
+            std::exception_ptr e = group.exception;
+            group.exception = nullptr;
+            group.failed = false;
+            std::rethrow_exception(e);
+        }
+    }
+
+private:
+    int localIndex() const { return isOwnWorker() ? s_index : 0; }
+
+    bool findTask(RangeTask& dst)
+    {
+        const int self = localIndex();
+        const int n = (int)m_queues.size();
+        if (m_queues[self]->pop(dst)) {
+            --m_num_queued;
+            return true;
+        }
+        for (int i = 1; i <= n; ++i) {
+            int victim = (self + i) % n;
+            if (victim != self && m_queues[victim]->steal(dst)) {
+                --m_num_queued;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void workerMain(int index)
+    {
+        s_current = this;
+        s_index = index;
+
+        RangeTask task;
+        for (;;) {
+            if (findTask(task)) {
+                execute(task);
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(m_sleep_mutex);
+            ++m_num_sleeping;
+            m_cond.wait(lock, [this]() { return m_stop || m_num_queued.load() > 0; });
+            --m_num_sleeping;
+            if (m_stop)
+                break;
+        }
+        s_current = nullptr;
+    }
+
+    std::vector<std::unique_ptr<WorkQueue>> m_queues;
+    std::vector<std::thread> m_workers;
+    std::atomic<int> m_num_queued{ 0 };
+    std::atomic<int> m_num_sleeping{ 0 };
+    std::mutex m_sleep_mutex;
+    std::condition_variable m_cond;
+    bool m_stop = false;
+
+    static thread_local Impl *s_current;
+    static thread_local int s_index;
+};
+
+thread_local ThreadPool::Impl *ThreadPool::Impl::s_current = nullptr;
+thread_local int ThreadPool::Impl::s_index = 0;
+
+
+static int ResolveWorkerCount(int n)
+{
+    if (n > 0)
+        return n;
+    int hw = (int)std::thread::hardware_concurrency();
+    return std::max(hw - 1, 0);
+}
+
+ThreadPool& ThreadPool::instance()
+{
+    static ThreadPool s_instance;
+    return s_instance;
+}
+
+ThreadPool::ThreadPool()
+{
+    m_impl = new Impl(ResolveWorkerCount(g_requested_workers));
+}
+
+ThreadPool::~ThreadPool()
+{
+    delete m_impl;
+}
+
+void ThreadPool::setWorkerCount(int n)
+{
+    // must not be called while parallel work is in flight
+    std::lock_guard<std::mutex> lock(g_config_mutex);
+    g_requested_workers = std::max(n, 0);
+    ThreadPool& pool = instance();
+    if (pool.m_impl->workerCount() != ResolveWorkerCount(n)) {
+        delete pool.m_impl;
+        pool.m_impl = new Impl(ResolveWorkerCount(n));
+    }
+}
+
+int ThreadPool::getWorkerCount()
+{
+    return instance().workerCount();
+}
+
+void ThreadPool::setDefaultGrainSize(int n)
+{
+    g_default_grain = std::max(n, 0);
+}
+
+int ThreadPool::getDefaultGrainSize()
+{
+    return g_default_grain;
+}
+
+bool ThreadPool::isWorkerThread()
+{
+    return instance().m_impl->isOwnWorker();
+}
+
+int ThreadPool::workerCount() const
+{
+    return m_impl->workerCount();
+}
+
+int ThreadPool::grainSize(int num_elements) const
+{
+    int grain = g_default_grain;
+    if (grain > 0)
+        return grain;
+    // roughly 8 chunks per thread leaves enough room for stealing to balance uneven bodies
+    int num_threads = m_impl->workerCount() + 1;
+    return std::max(ceildiv(num_elements, num_threads * 8), 1);
+}
+
+void ThreadPool::run(RangeFunc func, const void *ctx, int begin, int end, int grain)
+{
+    TaskGroup group;
+    group.pending = 1;
+    m_impl->execute({ func, ctx, begin, end, std::max(grain, 1), &group });
+    m_impl->wait(group);
+}
+
+void ThreadPool::spawn(TaskGroup& group, RangeFunc func, const void *ctx, int begin, int end, int grain)
+{
+    group.pending.fetch_add(1, std::memory_order_relaxed);
+    m_impl->push({ func, ctx, begin, end, std::max(grain, 1), &group });
+}
+
+void ThreadPool::wait(TaskGroup& group)
+{
+    m_impl->wait(group);
+}
+
+} // namespace mu
+
+#endif // muEnableThreadPool
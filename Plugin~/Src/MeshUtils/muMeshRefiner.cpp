@@ -4,6 +4,11 @@
 
 namespace mu {
 
+static inline uint64_t HashCombine(uint64_t h, uint64_t v)
+{
+    return (h ^ v) * 0x9E3779B185EBCA87ull;
+}
+
 
 void MeshConnectionInfo::clear()
 {
@@ -75,6 +80,101 @@ bool IsEdgeOpened(const IArray<int>& indices, const IArray<int>& counts, const I
 }
 
 
+void MeshTopologyContext::setup(const IArray<int>& counts, const IArray<int>& indices, const IArray<float3>& points)
+{
+    m_indices = indices;
+    m_points = points;
+    if (counts.empty() && !indices.empty()) {
+        m_triangle_counts.resize_discard(indices.size() / 3);
+        std::fill(m_triangle_counts.begin(), m_triangle_counts.end(), 3);
+        m_counts = m_triangle_counts;
+    }
+    else {
+        m_triangle_counts.clear();
+        m_counts = counts;
+    }
+    m_has_offsets = m_has_connection = m_has_edge_adjacency = false;
+}
+
+void MeshTopologyContext::clear()
+{
+    m_counts.reset();
+    m_indices.reset();
+    m_points.reset();
+    m_triangle_counts.clear();
+    m_offsets.clear();
+    m_connection.clear();
+    m_edge_adjacency.clear();
+    m_has_offsets = m_has_connection = m_has_edge_adjacency = false;
+}
+
+const RawVector<int>& MeshTopologyContext::getOffsets()
+{
+    if (!m_has_offsets) {
+        m_offsets.resize_discard(m_counts.size());
+        parallel_exclusive_scan(m_counts.data(), m_offsets.data(), (int)m_counts.size());
+        m_has_offsets = true;
+    }
+    return m_offsets;
+}
+
+const MeshConnectionInfo& MeshTopologyContext::getConnection()
+{
+    if (!m_has_connection) {
+        m_connection.buildConnection(m_indices, m_counts, m_points);
+        m_has_connection = true;
+        ++m_connection_builds;
+    }
+    return m_connection;
+}
+
+const RawVector<int>& MeshTopologyContext::getEdgeAdjacency()
+{
+    if (m_has_edge_adjacency)
+        return m_edge_adjacency;
+
+    const RawVector<int>& offsets = getOffsets();
+    const MeshConnectionInfo& connection = getConnection();
+    const int num_faces = (int)m_counts.size();
+
+    // the edge a -> b of a face is matched with b -> a of another face. b's connection lists every candidate.
+    m_edge_adjacency.resize_discard(m_indices.size());
+    parallel_for_blocked(0, num_faces, 1024 * 4, [&](int begin, int end) {
+        for (int fi = begin; fi < end; ++fi) {
+            const int count = m_counts[fi];
+            const int offset = offsets[fi];
+            if (count < 3) {
+                std::fill_n(&m_edge_adjacency[offset], count, -1);
+                continue;
+            }
+            for (int ci = 0; ci < count; ++ci) {
+                const int a = m_indices[offset + ci];
+                const int b = m_indices[offset + (ci + 1) % count];
+                int found = -1, num_found = 0;
+                connection.eachConnectedFaces(b, [&](int fi2, int ii2) {
+                    const int count2 = m_counts[fi2];
+                    if (fi2 == fi || count2 < 3)
+                        return;
+                    const int next = offsets[fi2] + (ii2 - offsets[fi2] + 1) % count2;
+                    if (m_indices[next] == a) {
+                        found = ii2;
+                        ++num_found;
+                    }
+                    else {
+                        const int prev = offsets[fi2] + (ii2 - offsets[fi2] + count2 - 1) % count2;
+                        if (m_indices[prev] == a)
+                            ++num_found; // same winding
+                    }
+                });
+                m_edge_adjacency[offset + ci] = num_found == 1 ? found : -1;
+            }
+        }
+    });
+    m_has_edge_adjacency = true;
+    return m_edge_adjacency;
+}
+
+
 int MeshRefiner::getTrianglesIndexCountTotal() const
 {
     int ret = 0;
@@ -106,37 +206,67 @@ void MeshRefiner::retopology(bool flip_faces)
     new_indices_lines.resize_discard(getLinesIndexCountTotal());
     new_indices_points.resize_discard(getPointsIndexCountTotal());
 
-    auto& src = new_indices;
-    auto dst_tri = new_indices_tri.data();
-    auto dst_lines = new_indices_lines.data();
-    auto dst_points = new_indices_points.data();
-
     const int i1 = flip_faces ? 2 : 1;
     const int i2 = flip_faces ? 1 : 2;
-    size_t num_faces = new_counts.size();
+    const int num_faces = (int)new_counts.size();
 
-    int n = 0;
-    for (size_t fi = 0; fi < num_faces; ++fi) {
-        int count = new_counts[fi];
+    // read & write positions of each chunk of faces are resolved by a scan, then chunks are filled in parallel
+    struct Offsets
+    {
+        int src, tri, lines, points;
+        Offsets operator+(const Offsets& v) const { return { src + v.src, tri + v.tri, lines + v.lines, points + v.points }; }
+    };
+    auto accumulate = [this](int count, Offsets& o) {
         if (count >= 3) {
-            if (!gen_triangles)continue;
-            for (int ni = 0; ni < count - 2; ++ni) {
-                *(dst_tri++) = src[n + 0];
-                *(dst_tri++) = src[n + ni + i1];
-                *(dst_tri++) = src[n + ni + i2];
-            }
+            if (!gen_triangles) return;
+            o.tri += (count - 2) * 3;
         }
         else if (count == 2) {
-            if (!gen_lines)continue;
-            for (int ni = 0; ni < 2; ++ni)
-                *(dst_lines++) = src[n + ni];
+            if (!gen_lines) return;
+            o.lines += 2;
         }
         else if (count == 1) {
-            if (!gen_points)continue;
-            *(dst_points++) = src[n];
+            if (!gen_points) return;
+            o.points += 1;
         }
-        n += count;
-    }
+        o.src += count;
+    };
+
+    parallel_scan(0, num_faces, 1024 * 8, Offsets{},
+        [&](int begin, int end, Offsets o) {
+            for (int fi = begin; fi < end; ++fi)
+                accumulate(new_counts[fi], o);
+            return o;
+        },
+        [&](int begin, int end, Offsets o) {
+            const int *src = new_indices.cdata();
+            int *dst_tri = new_indices_tri.data() + o.tri;
+            int *dst_lines = new_indices_lines.data() + o.lines;
+            int *dst_points = new_indices_points.data() + o.points;
+            int n = o.src;
+            for (int fi = begin; fi < end; ++fi) {
+                int count = new_counts[fi];
+                if (count >= 3) {
+                    if (!gen_triangles)continue;
+                    for (int ni = 0; ni < count - 2; ++ni) {
+                        *(dst_tri++) = src[n + 0];
+                        *(dst_tri++) = src[n + ni + i1];
+                        *(dst_tri++) = src[n + ni + i2];
+                    }
+                }
+                else if (count == 2) {
+                    if (!gen_lines)continue;
+                    for (int ni = 0; ni < 2; ++ni)
+                        *(dst_lines++) = src[n + ni];
+                }
+                else if (count == 1) {
+                    if (!gen_points)continue;
+                    *(dst_points++) = src[n];
+                }
+                n += count;
+            }
+        },
+        std::plus<Offsets>());
 }
 
 void MeshRefiner::genSubmeshes(const IArray<int>& material_ids, bool has_face_group)
@@ -300,6 +430,121 @@ void MeshRefiner::genSubmeshes()
     setupSubmeshes();
 }
 
+void MeshRefiner::optimizeVertexCache(int cache_size)
+{
+    parallel_for(0, (int)submeshes.size(), 1, [&](int smi) {
+        auto& sm = submeshes[smi];
+        if (sm.topology != Topology::Triangles)
+            return;
+        OptimizeVertexCache(IArray<int>(new_indices_submeshes.data() + sm.index_offset, sm.index_count),
+            splits[sm.split_index].vertex_count, cache_size);
+    });
+
+    // submesh indices are local to their split and the submeshes of a split are contiguous.
+    // order[i]: current index of the vertex that goes to i
+    const int num_vertices = (int)new_points.size();
+    RawVector<int> order, old2new_vertices;
+    order.resize_discard(num_vertices);
+    old2new_vertices.resize_discard(num_vertices);
+    parallel_for(0, (int)splits.size(), 1, [&](int spi) {
+        auto& split = splits[spi];
+        int index_begin = 0, index_end = 0;
+        if (split.submesh_count > 0) {
+            auto& first = submeshes[split.submesh_offset];
+            auto& last = submeshes[split.submesh_offset + split.submesh_count - 1];
+            index_begin = first.index_offset;
+            index_end = last.index_offset + last.index_count;
+        }
+
+        RawVector<int> local_order;
+        OptimizeVertexFetch(local_order,
+            IArray<int>(new_indices_submeshes.data() + index_begin, index_end - index_begin), split.vertex_count);
+        for (int i = 0; i < split.vertex_count; ++i) {
+            int vi = split.vertex_offset + local_order[i];
+            order[split.vertex_offset + i] = vi;
+            old2new_vertices[vi] = split.vertex_offset + i;
+        }
+    });
+
+    reorderValues(new_points, order);
+    reorderValues(new2old_points, order);
+    for (auto& attr : attributes)
+        attr->reorder(order);
+
+    auto remap = [&](RawVector<int>& indices) {
+        parallel_for_blocked(0, (int)indices.size(), 1024 * 16, [&](int begin, int end) {
+            for (int i = begin; i < end; ++i) {
+                if (indices[i] >= 0)
+                    indices[i] = old2new_vertices[indices[i]];
+            }
+        });
+    };
+    remap(old2new_indices);
+    remap(new_indices);
+    remap(new_indices_tri);
+    remap(new_indices_lines);
+    remap(new_indices_points);
+}
+
+void MeshRefiner::genMeshlets(int max_vertices, int max_triangles)
+{
+    struct Result
+    {
+        RawVector<Meshlet> meshlets;
+        RawVector<int> vertices;
+        RawVector<uint8_t> triangles;
+    };
+    const int num_submeshes = (int)submeshes.size();
+    std::vector<Result> results(num_submeshes);
+    parallel_for(0, num_submeshes, 1, [&](int smi) {
+        auto& sm = submeshes[smi];
+        if (sm.topology != Topology::Triangles)
+            return;
+        auto& split = splits[sm.split_index];
+        auto& r = results[smi];
+        BuildMeshlets(r.meshlets, r.vertices, r.triangles,
+            IArray<int>(new_indices_submeshes.data() + sm.index_offset, sm.index_count),
+            IArray<float3>(new_points.data() + split.vertex_offset, split.vertex_count),
+            max_vertices, max_triangles);
+        for (auto& m : r.meshlets)
+            m.submesh_index = smi;
+    });
+
+    meshlets.clear();
+    meshlet_vertices.clear();
+    meshlet_triangles.clear();
+    for (auto& r : results) {
+        const int vertex_offset = (int)meshlet_vertices.size();
+        const int triangle_offset = (int)meshlet_triangles.size();
+        for (auto& m : r.meshlets) {
+            m.vertex_offset += vertex_offset;
+            m.triangle_offset += triangle_offset;
+        }
+        meshlets.insert(meshlets.end(), r.meshlets.begin(), r.meshlets.end());
+        meshlet_vertices.insert(meshlet_vertices.end(), r.vertices.begin(), r.vertices.end());
+        meshlet_triangles.insert(meshlet_triangles.end(), r.triangles.begin(), r.triangles.end());
+    }
+}
+
+bool MeshRefiner::genIndices16()
+{
+    new_indices_submeshes16.clear();
+    for (auto& split : splits) {
+        if (split.vertex_count > 0x10000)
+            return false;
+    }
+
+    const int n = (int)new_indices_submeshes.size();
+    new_indices_submeshes16.resize_discard(n);
+    const int *src = new_indices_submeshes.data();
+    uint16_t *dst = new_indices_submeshes16.data();
+    parallel_for_blocked(0, n, 1024 * 64, [&](int begin, int end) {
+        for (int i = begin; i < end; ++i)
+            dst[i] = (uint16_t)src[i];
+    });
+    return true;
+}
+
 void MeshRefiner::setupSubmeshes()
 {
     int num_splits = (int)splits.size();
@@ -339,14 +584,93 @@ void MeshRefiner::clear()
     new_indices_lines.clear();
     new_indices_points.clear();
     new_indices_submeshes.clear();
+    new_indices_submeshes16.clear();
 
     new_points.clear();
     splits.clear();
     submeshes.clear();
     connection.clear();
+    meshlets.clear();
+    meshlet_vertices.clear();
+    meshlet_triangles.clear();
 }
 
+template<int Mask>
+struct MeshRefiner::Kernel
+{
+    const KernelArrays& arrays;
+
+    uint64_t hash(int ii) const
+    {
+        uint64_t h = 0;
+        if constexpr ((Mask & KA_Normals) != 0) h = HashCombine(h, hashValue(arrays.normals[ii]));
+        if constexpr ((Mask & KA_UV0) != 0)     h = HashCombine(h, hashValue(arrays.uv0[ii]));
+        if constexpr ((Mask & KA_UV1) != 0)     h = HashCombine(h, hashValue(arrays.uv1[ii]));
+        if constexpr ((Mask & KA_Colors) != 0)  h = HashCombine(h, hashValue(arrays.colors[ii]));
+        return h;
+    }
+
+    bool equals(int ii1, int ii2) const
+    {
+        if constexpr ((Mask & KA_Normals) != 0) { if (!(arrays.normals[ii1] == arrays.normals[ii2])) return false; }
+        if constexpr ((Mask & KA_UV0) != 0)     { if (!(arrays.uv0[ii1] == arrays.uv0[ii2])) return false; }
+        if constexpr ((Mask & KA_UV1) != 0)     { if (!(arrays.uv1[ii1] == arrays.uv1[ii2])) return false; }
+        if constexpr ((Mask & KA_Colors) != 0)  { if (!(arrays.colors[ii1] == arrays.colors[ii2])) return false; }
+        return true;
+    }
+};
+
+// fallback for attribute combinations that have no specialized kernel
+struct MeshRefiner::VirtualKernel
+{
+    const RawVector<IAttribute*>& attributes;
+
+    uint64_t hash(int ii) const
+    {
+        uint64_t h = 0;
+        for (auto& attr : attributes)
+            h = HashCombine(h, attr->hash(ii));
+        return h;
+    }
+
+    bool equals(int ii1, int ii2) const
+    {
+        for (auto& attr : attributes) {
+            if (!attr->equals(ii1, ii2))
+                return false;
+        }
+        return true;
+    }
+};
+
 void MeshRefiner::refine()
+{
+    KernelArrays arrays;
+    bool specialized = true;
+    for (auto& attr : attributes)
+        specialized = specialized && attr->getKernelArrays(arrays);
+
+    if (specialized)
+        refineWithKernel<0>(arrays);
+    else
+        refineImpl(VirtualKernel{ attributes });
+}
+
+template<int Mask>
+void MeshRefiner::refineWithKernel(const KernelArrays& arrays)
+{
+    if constexpr (Mask + 1 < KA_Count) {
+        if (arrays.mask != Mask) {
+            refineWithKernel<Mask + 1>(arrays);
+            return;
+        }
+    }
+    refineImpl(Kernel<Mask>{ arrays });
+}
+
+// vertices are emitted as indices to their source corners and attributes are gathered at the end
+template<class KernelT>
+void MeshRefiner::refineImpl(const KernelT& kernel)
 {
     buildConnection();
 
@@ -389,32 +713,47 @@ void MeshRefiner::refine()
         num_indices_points = 0;
     };
 
-    auto compare_all_attributes = [&](int ni, int ii) {
-        for (auto& attr : attributes) {
-            if (!attr->compare(ni, ii))
-                return false;
+    RawVector<int> src_indices; // new vertex index to source corner
+    src_indices.reserve(num_indices);
+
+    // dedup_by_hash: duplicates are resolved up front
+    RawVector<int> reps, rep2new, rep_split;
+    if (dedup_by_hash) {
+        resolveDuplicates(kernel, reps);
+        rep2new.resize_discard(num_indices);
+        rep_split.resize(num_indices, -1);
+    }
+
+    auto find_or_emit_vertex_hashed = [&](int vi, int ii) {
+        int ri = reps[ii];
+        int spi = (int)splits.size();
+        if (rep_split[ri] != spi) {
+            rep_split[ri] = spi;
+            rep2new[ri] = (int)new_points.size();
+            new_points.push_back(points[vi]);
+            new2old_points.push_back(vi);
+            src_indices.push_back(ri);
         }
-        return true;
+        return old2new_indices[ii] = rep2new[ri];
     };
 
+    // otherwise only the vertex most recently emitted for each point is compared
+    RawVector<int> recent;
+    if (!dedup_by_hash)
+        recent.resize(points.size(), -1);
+
     auto find_or_emit_vertex = [&](int vi, int ii) {
-        int offset = connection.v2f_offsets[vi];
-        int connection_count = connection.v2f_counts[vi];
-        for (int ci = 0; ci < connection_count; ++ci) {
-            int& ni = old2new_indices[connection.v2f_indices[offset + ci]];
-            if (ni != -1 && compare_all_attributes(ni, ii)) {
-                return ni;
-            }
-            else {
-                ni = (int)new_points.size();
-                new_points.push_back(points[vi]);
-                new2old_points.push_back(vi);
-                for (auto& attr : attributes)
-                    attr->emit(ii);
-                return ni;
-            }
+        if (dedup_by_hash)
+            return find_or_emit_vertex_hashed(vi, ii);
+
+        int& ni = recent[vi];
+        if (ni == -1 || !kernel.equals(src_indices[ni], ii)) {
+            ni = (int)new_points.size();
+            new_points.push_back(points[vi]);
+            new2old_points.push_back(vi);
+            src_indices.push_back(ii);
         }
-        return 0;
+        return old2new_indices[ii] = ni;
     };
 
     new_counts.reserve(counts.size());
@@ -426,8 +765,9 @@ void MeshRefiner::refine()
             if (split_unit > 0 && (int)new_points.size() - offset_vertices + count > split_unit) {
                 add_new_split();
 
-                // clear vertex cache
-                memset(old2new_indices.data(), -1, old2new_indices.size() * sizeof(int));
+                // clear vertex cache. rep_split is per split so it needs no clearing.
+                if (!dedup_by_hash)
+                    memset(recent.data(), -1, recent.size() * sizeof(int));
             }
 
             for (int ci = 0; ci < count; ++ci) {
@@ -448,13 +788,96 @@ void MeshRefiner::refine()
         offset += count;
     }
     add_new_split();
+
+    for (auto& attr : attributes)
+        attr->gather(src_indices);
+}
+
+// dst[ii] = the first index of the same vertex whose attributes all match ii's (dst[ii] == ii if ii is the first).
+// each vertex's corners are visited in index order, so the result doesn't depend on threading.
+template<class KernelT>
+void MeshRefiner::resolveDuplicates(const KernelT& kernel, RawVector<int>& dst)
+{
+    const int num_indices = (int)indices.size();
+    const int num_points = (int)points.size();
+    dst.resize_discard(num_indices);
+
+    RawVector<uint64_t> hashes;
+    hashes.resize_discard(num_indices);
+    parallel_for_blocked(0, num_indices, 1024 * 8, [&](int begin, int end) {
+        for (int ii = begin; ii < end; ++ii)
+            hashes[ii] = kernel.hash(ii);
+    });
+
+    auto equals = [&](int ii1, int ii2) {
+        return hashes[ii1] == hashes[ii2] && kernel.equals(ii1, ii2);
+    };
+
+    const MeshConnectionInfo& conn = getConnection();
+    parallel_for_blocked(0, num_points, 1024 * 4, [&](int begin, int end) {
+        // open addressing table of the representatives found so far. only used for high valence vertices.
+        RawVector<int> table;
+        RawVector<int> found;
+        for (int vi = begin; vi < end; ++vi) {
+            const int count = conn.v2f_counts[vi];
+            const int *corners = &conn.v2f_indices[conn.v2f_offsets[vi]];
+
+            if (count <= 16) {
+                found.clear();
+                for (int ci = 0; ci < count; ++ci) {
+                    int ii = corners[ci];
+                    int r = ii;
+                    for (int fi : found) {
+                        if (equals(fi, ii)) {
+                            r = fi;
+                            break;
+                        }
+                    }
+                    if (r == ii)
+                        found.push_back(ii);
+                    dst[ii] = r;
+                }
+            }
+            else {
+                int size = 32;
+                while (size < count * 2)
+                    size *= 2;
+                const uint32_t mask = (uint32_t)size - 1;
+                table.resize_discard(size);
+                std::fill(table.begin(), table.end(), -1);
+                for (int ci = 0; ci < count; ++ci) {
+                    int ii = corners[ci];
+                    uint32_t slot = (uint32_t)(hashes[ii] ^ (hashes[ii] >> 32)) & mask;
+                    for (;;) {
+                        int& t = table[slot];
+                        if (t == -1) {
+                            t = ii;
+                            dst[ii] = ii;
+                            break;
+                        }
+                        if (equals(t, ii)) {
+                            dst[ii] = t;
+                            break;
+                        }
+                        slot = (slot + 1) & mask;
+                    }
+                }
+            }
+        }
+    });
 }
 
 void MeshRefiner::buildConnection()
 {
-    if (connection.v2f_counts.size() != points.size()) {
+    if (topology)
+        topology->getConnection();
+    else if (connection.v2f_counts.size() != points.size())
         connection.buildConnection(indices, counts, points);
-    }
+}
+
+const MeshConnectionInfo& MeshRefiner::getConnection() const
+{
+    return topology ? topology->getConnection() : connection;
 }
 
 } // namespace mu
@@ -0,0 +1,424 @@
+#include "pch.h"
+#include "MeshUtils/muMeshSimplifier.h"
+#include "MeshUtils/MeshUtils.h"
+
+namespace mu {
+
+namespace {
+
+// symmetric 4x4 matrix of a sum of squared distances to planes. weight is the sum of the plane weights (areas).
+struct Quadric
+{
+    double a00, a01, a02, a11, a12, a22;
+    double b0, b1, b2;
+    double c;
+    double weight;
+
+    static Quadric fromPlane(const float3& n, float d, float w)
+    {
+        Quadric q;
+        q.a00 = w * n.x * n.x; q.a01 = w * n.x * n.y; q.a02 = w * n.x * n.z;
+        q.a11 = w * n.y * n.y; q.a12 = w * n.y * n.z; q.a22 = w * n.z * n.z;
+        q.b0 = w * n.x * d; q.b1 = w * n.y * d; q.b2 = w * n.z * d;
+        q.c = w * d * d;
+        q.weight = w;
+        return q;
+    }
+
+    Quadric& operator+=(const Quadric& v)
+    {
+        a00 += v.a00; a01 += v.a01; a02 += v.a02;
+        a11 += v.a11; a12 += v.a12; a22 += v.a22;
+        b0 += v.b0; b1 += v.b1; b2 += v.b2;
+        c += v.c;
+        weight += v.weight;
+        return *this;
+    }
+
+    Quadric operator+(const Quadric& v) const
+    {
+        Quadric r = *this;
+        r += v;
+        return r;
+    }
+
+    // mean squared distance to the planes
+    double evaluate(const float3& p) const
+    {
+        double x = p.x, y = p.y, z = p.z;
+        double r =
+            a00 * x * x + 2.0 * a01 * x * y + 2.0 * a02 * x * z +
+            a11 * y * y + 2.0 * a12 * y * z + a22 * z * z +
+            2.0 * (b0 * x + b1 * y + b2 * z) + c;
+        return weight > 0.0 ? std::max(r, 0.0) / weight : 0.0;
+    }
+};
+
+struct Collapse
+{
+    int from, to;
+    double cost;
+};
+
+} // namespace
+
+
+void MeshSimplifier::clear()
+{
+    points.reset();
+    indices.reset();
+    face_groups.reset();
+    new_indices.clear();
+    new_face_groups.clear();
+    result_error = 0.0f;
+}
+
+void MeshSimplifier::simplify()
+{
+    const int num_points = (int)points.size();
+    const int num_triangles = (int)indices.size() / 3;
+    new_indices.clear();
+    new_face_groups.clear();
+    result_error = 0.0f;
+    if (num_triangles == 0)
+        return;
+
+    auto is_valid_triangle = [&](int ti) {
+        const int *tri = &indices[ti * 3];
+        for (int i = 0; i < 3; ++i) {
+            if (tri[i] < 0 || tri[i] >= num_points)
+                return false;
+        }
+        return tri[0] != tri[1] && tri[1] != tri[2] && tri[2] != tri[0];
+    };
+
+    // errors are relative to the bounding box diagonal
+    float3 bmin, bmax;
+    MinMax(points.data(), points.size(), bmin, bmax);
+    double extent = length(bmax - bmin);
+    if (!(extent > 0.0))
+        extent = 1.0;
+    const double max_cost = target_error < FLT_MAX ?
+        (double)target_error * extent * (double)target_error * extent : DBL_MAX;
+
+    // connected components. vertices at the same position are connected so that seams don't separate components.
+    RawVector<int> weld, parents;
+    WeldVertices(weld, points);
+    parents.resize_discard(num_points);
+    std::iota(parents.begin(), parents.end(), 0);
+    auto find_root = [&](int vi) {
+        while (parents[vi] != vi) {
+            parents[vi] = parents[parents[vi]];
+            vi = parents[vi];
+        }
+        return vi;
+    };
+    auto unite = [&](int a, int b) {
+        a = find_root(a);
+        b = find_root(b);
+        if (a != b)
+            parents[std::max(a, b)] = std::min(a, b);
+    };
+    for (int ti = 0; ti < num_triangles; ++ti) {
+        if (!is_valid_triangle(ti))
+            continue;
+        const int *tri = &indices[ti * 3];
+        unite(weld[tri[0]], weld[tri[1]]);
+        unite(weld[tri[0]], weld[tri[2]]);
+    }
+
+    // group triangles by component
+    RawVector<int> component_of, component_offsets, component_triangles;
+    component_of.resize_discard(num_points);
+    std::fill(component_of.begin(), component_of.end(), -1);
+    int num_components = 0;
+    RawVector<int> triangle_components;
+    triangle_components.resize_discard(num_triangles);
+    for (int ti = 0; ti < num_triangles; ++ti) {
+        if (!is_valid_triangle(ti)) {
+            triangle_components[ti] = -1;
+            continue;
+        }
+        int& c = component_of[find_root(weld[indices[ti * 3]])];
+        if (c == -1)
+            c = num_components++;
+        triangle_components[ti] = c;
+    }
+    component_offsets.resize_zeroclear(num_components + 1);
+    for (int ti = 0; ti < num_triangles; ++ti) {
+        if (triangle_components[ti] != -1)
+            ++component_offsets[triangle_components[ti] + 1];
+    }
+    for (int ci = 0; ci < num_components; ++ci)
+        component_offsets[ci + 1] += component_offsets[ci];
+    component_triangles.resize_discard(component_offsets[num_components]);
+    {
+        RawVector<int> pos;
+        pos.assign(component_offsets.cdata(), component_offsets.cdata() + num_components);
+        for (int ti = 0; ti < num_triangles; ++ti) {
+            if (triangle_components[ti] != -1)
+                component_triangles[pos[triangle_components[ti]]++] = ti;
+        }
+    }
+
+    // results per triangle. triangles keep their identity, so the output keeps the input order.
+    RawVector<int> result_indices;
+    RawVector<char> alive;
+    RawVector<int> local_ids;
+    result_indices.assign(indices.data(), indices.data() + num_triangles * 3);
+    alive.resize_zeroclear(num_triangles);
+    local_ids.resize_discard(num_points);
+    RawVector<double> component_costs;
+    component_costs.resize_zeroclear(num_components);
+
+    // components have disjoint triangles and vertices, so they can write to the shared arrays in parallel
+    parallel_for(0, num_components, 1, [&](int ci) {
+        const int *ctris = component_triangles.cdata() + component_offsets[ci];
+        const int nt = component_offsets[ci + 1] - component_offsets[ci];
+
+        // local vertices
+        RawVector<int> verts;
+        for (int i = 0; i < nt; ++i) {
+            for (int c = 0; c < 3; ++c)
+                local_ids[indices[ctris[i] * 3 + c]] = -1;
+        }
+        for (int i = 0; i < nt; ++i) {
+            for (int c = 0; c < 3; ++c) {
+                int vi = indices[ctris[i] * 3 + c];
+                if (local_ids[vi] == -1) {
+                    local_ids[vi] = (int)verts.size();
+                    verts.push_back(vi);
+                }
+            }
+        }
+        const int nv = (int)verts.size();
+
+        RawVector<int> tris;
+        tris.resize_discard(nt * 3);
+        for (int i = 0; i < nt * 3; ++i)
+            tris[i] = local_ids[indices[ctris[i / 3] * 3 + i % 3]];
+        auto group_of = [&](int t) { return face_groups.empty() ? 0 : face_groups[ctris[t]]; };
+        auto pos = [&](int lv) { return points[verts[lv]]; };
+
+        // plane quadrics weighted by triangle area
+        RawVector<Quadric> quadrics;
+        quadrics.resize_zeroclear(nv);
+        for (int t = 0; t < nt; ++t) {
+            const int *tri = &tris[t * 3];
+            float3 n = cross(pos(tri[1]) - pos(tri[0]), pos(tri[2]) - pos(tri[0]));
+            float len = length(n);
+            if (len > 0.0f) {
+                n /= len;
+                Quadric q = Quadric::fromPlane(n, -dot(n, pos(tri[0])), len * 0.5f);
+                for (int c = 0; c < 3; ++c)
+                    quadrics[tri[c]] += q;
+            }
+        }
+
+        // lock vertices on open, non-manifold and face group boundary edges
+        RawVector<char> locked;
+        locked.resize_zeroclear(nv);
+        {
+            struct Edge
+            {
+                int v0, v1, tri;
+                bool forward;
+                bool operator<(const Edge& v) const { return v0 != v.v0 ? v0 < v.v0 : (v1 != v.v1 ? v1 < v.v1 : tri < v.tri); }
+            };
+            RawVector<Edge> edges;
+            edges.resize_discard(nt * 3);
+            for (int t = 0; t < nt; ++t) {
+                for (int c = 0; c < 3; ++c) {
+                    int a = tris[t * 3 + c], b = tris[t * 3 + (c + 1) % 3];
+                    edges[t * 3 + c] = { std::min(a, b), std::max(a, b), t, a < b };
+                }
+            }
+            std::sort(edges.begin(), edges.end());
+            for (int i = 0; i < nt * 3;) {
+                int j = i + 1;
+                while (j < nt * 3 && edges[j].v0 == edges[i].v0 && edges[j].v1 == edges[i].v1)
+                    ++j;
+                bool open = j - i != 2 ||
+                    edges[i].forward == edges[i + 1].forward ||
+                    group_of(edges[i].tri) != group_of(edges[i + 1].tri);
+                if (open) {
+                    locked[edges[i].v0] = 1;
+                    locked[edges[i].v1] = 1;
+                }
+                i = j;
+            }
+        }
+
+        const int target = std::max((int)((double)nt * (double)target_ratio), 0);
+        RawVector<char> tri_alive, touched;
+        tri_alive.resize_discard(nt);
+        std::fill(tri_alive.begin(), tri_alive.end(), 1);
+        touched.resize_discard(nv);
+        int num_alive = nt;
+        double max_applied = 0.0;
+
+        RawVector<int> v2t_counts, v2t_offsets, v2t;
+        RawVector<Collapse> collapses;
+        RawVector<int> neighbors_u, neighbors_v;
+        while (num_alive > target) {
+            // vertex to triangle adjacency of alive triangles
+            v2t_counts.resize_zeroclear(nv);
+            for (int t = 0; t < nt; ++t) {
+                if (tri_alive[t]) {
+                    for (int c = 0; c < 3; ++c)
+                        ++v2t_counts[tris[t * 3 + c]];
+                }
+            }
+            v2t_offsets.resize_discard(nv + 1);
+            v2t_offsets[0] = 0;
+            for (int v = 0; v < nv; ++v)
+                v2t_offsets[v + 1] = v2t_offsets[v] + v2t_counts[v];
+            v2t.resize_discard(v2t_offsets[nv]);
+            for (int v = 0; v < nv; ++v)
+                v2t_counts[v] = 0;
+            for (int t = 0; t < nt; ++t) {
+                if (tri_alive[t]) {
+                    for (int c = 0; c < 3; ++c) {
+                        int v = tris[t * 3 + c];
+                        v2t[v2t_offsets[v] + v2t_counts[v]++] = t;
+                    }
+                }
+            }
+
+            // candidate collapses, cheapest first
+            collapses.clear();
+            for (int t = 0; t < nt; ++t) {
+                if (!tri_alive[t])
+                    continue;
+                for (int c = 0; c < 3; ++c) {
+                    int a = tris[t * 3 + c], b = tris[t * 3 + (c + 1) % 3];
+                    for (int k = 0; k < 2; ++k) {
+                        int from = k == 0 ? a : b, to = k == 0 ? b : a;
+                        if (locked[from])
+                            continue;
+                        double cost = (quadrics[from] + quadrics[to]).evaluate(pos(to));
+                        if (cost <= max_cost)
+                            collapses.push_back({ from, to, cost });
+                    }
+                }
+            }
+            if (collapses.empty())
+                break;
+            std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) {
+                if (a.cost != b.cost)
+                    return a.cost < b.cost;
+                return a.from != b.from ? a.from < b.from : a.to < b.to;
+            });
+
+            std::fill(touched.begin(), touched.end(), 0);
+            int num_collapsed = 0;
+            for (auto& col : collapses) {
+                if (num_alive <= target)
+                    break;
+                const int u = col.from, v = col.to;
+                if (touched[u] || touched[v])
+                    continue;
+
+                auto each_tri = [&](int vi, auto&& body) {
+                    for (int i = v2t_offsets[vi]; i < v2t_offsets[vi + 1]; ++i) {
+                        if (tri_alive[v2t[i]])
+                            body(v2t[i]);
+                    }
+                };
+                auto contains = [&](int t, int vi) {
+                    return tris[t * 3] == vi || tris[t * 3 + 1] == vi || tris[t * 3 + 2] == vi;
+                };
+
+                // link condition: the common neighbors of u and v must be the opposite vertices of their shared triangles
+                auto gather_neighbors = [&](int vi, RawVector<int>& dst) {
+                    dst.clear();
+                    each_tri(vi, [&](int t) {
+                        for (int c = 0; c < 3; ++c) {
+                            int w = tris[t * 3 + c];
+                            if (w != vi)
+                                dst.push_back(w);
+                        }
+                    });
+                    std::sort(dst.begin(), dst.end());
+                    dst.erase(std::unique(dst.begin(), dst.end()), dst.end());
+                };
+                gather_neighbors(u, neighbors_u);
+                gather_neighbors(v, neighbors_v);
+                int num_common = 0;
+                for (int w : neighbors_u) {
+                    if (std::binary_search(neighbors_v.begin(), neighbors_v.end(), w))
+                        ++num_common;
+                }
+                int num_shared = 0;
+                each_tri(u, [&](int t) { if (contains(t, v)) ++num_shared; });
+                if (num_shared == 0 || num_common != num_shared)
+                    continue;
+
+                // reject collapses that flip or degenerate remaining triangles
+                bool valid = true;
+                const float3 pv = pos(v);
+                each_tri(u, [&](int t) {
+                    if (!valid || contains(t, v))
+                        return;
+                    float3 p[3], q[3];
+                    for (int c = 0; c < 3; ++c) {
+                        int w = tris[t * 3 + c];
+                        p[c] = pos(w);
+                        q[c] = w == u ? pv : p[c];
+                    }
+                    float3 n0 = cross(p[1] - p[0], p[2] - p[0]);
+                    float3 n1 = cross(q[1] - q[0], q[2] - q[0]);
+                    float l0 = length(n0), l1 = length(n1);
+                    if (!(l1 > 0.0f) || !(dot(n0, n1) > 0.0f) || dot(n0, n1) < l0 * l1 * 0.1f)
+                        valid = false;
+                });
+                if (!valid)
+                    continue;
+
+                // apply
+                quadrics[v] += quadrics[u];
+                each_tri(u, [&](int t) {
+                    for (int c = 0; c < 3; ++c)
+                        touched[tris[t * 3 + c]] = 1;
+                    if (contains(t, v)) {
+                        tri_alive[t] = 0;
+                        --num_alive;
+                    }
+                    else {
+                        for (int c = 0; c < 3; ++c) {
+                            if (tris[t * 3 + c] == u)
+                                tris[t * 3 + c] = v;
+                        }
+                    }
+                });
+                max_applied = std::max(max_applied, col.cost);
+                ++num_collapsed;
+            }
+            if (num_collapsed == 0)
+                break;
+        }
+
+        for (int t = 0; t < nt; ++t) {
+            const int ti = ctris[t];
+            alive[ti] = tri_alive[t];
+            for (int c = 0; c < 3; ++c)
+                result_indices[ti * 3 + c] = verts[tris[t * 3 + c]];
+        }
+        component_costs[ci] = max_applied;
+    });
+
+    for (int ti = 0; ti < num_triangles; ++ti) {
+        if (!alive[ti])
+            continue;
+        new_indices.insert(new_indices.end(), &result_indices[ti * 3], &result_indices[ti * 3] + 3);
+        if (!face_groups.empty())
+            new_face_groups.push_back(face_groups[ti]);
+    }
+
+    double max_cost_applied = 0.0;
+    for (double c : component_costs)
+        max_cost_applied = std::max(max_cost_applied, c);
+    result_error = (float)(std::sqrt(max_cost_applied) / extent);
+}
+
+} // namespace mu
@@ -5,14 +5,226 @@
 #include "MeshUtils/muMath.h"
 #include "MeshUtils/muSIMD.h"
 #include "MeshUtils/muRawVector.h"
+#include "MeshUtils/muConcurrency.h"
+#include "MeshUtils/muLog.h"
+
+#include <atomic>
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    #include <xmmintrin.h>
+#endif
+#if defined(muEnableISPC) && (defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__))
+    #define muISPCTargetX86
+    #ifdef _MSC_VER
+        #include <intrin.h>
+    #else
+        #include <cpuid.h>
+    #endif
+#endif
 
 namespace mu {
 
 //#undef muEnableISPC
 
+// ------------------------------------------------------------
+// ISA selection
+// ------------------------------------------------------------
+// ISPC (if enabled and usable on this CPU) comes first, followed by the intrinsics implementation, which is always
+// usable. the active one is decided on first use: the first one, or MESHSYNC_SIMD_ISA if it is set.
+// ISPC picks its own target among the ones MeshUtilsCore.ispc is built for (add_ispc_targets() in ISPC.cmake).
+// the ISPC ISA is named after that target (e.g. "avx1-i32x8"). "ispc" is accepted as an alias.
+
+#ifdef muISPCTargetX86
+struct CPUFeatures
+{
+    bool sse4 = false;      // SSE4.1, SSE4.2, POPCNT
+    bool avx = false;       // AVX and YMM state enabled by the OS
+    bool avx512skx = false; // AVX-512 F, CD, DQ, BW, VL and ZMM / opmask state enabled by the OS
+};
+
+static CPUFeatures DetectCPUFeatures()
+{
+    auto cpuid = [](uint32_t leaf, uint32_t (&r)[4]) {
+#ifdef _MSC_VER
+        __cpuidex((int*)r, (int)leaf, 0);
+#else
+        __cpuid_count(leaf, 0, r[0], r[1], r[2], r[3]);
+#endif
+    };
+    auto bit = [](uint32_t v, int i) { return (v & (1u << i)) != 0; };
+
+    uint32_t r[4];
+    cpuid(0, r);
+    const uint32_t max_leaf = r[0];
+    cpuid(1, r);
+    const uint32_t ecx1 = r[2];
+    uint32_t ebx7 = 0;
+    if (max_leaf >= 7) {
+        cpuid(7, r);
+        ebx7 = r[1];
+    }
+
+    // the CPU may support AVX while the OS doesn't save YMM / ZMM registers. XCR0 tells which ones it does.
+    uint64_t xcr0 = 0;
+    if (bit(ecx1, 27)) { // OSXSAVE
+#ifdef _MSC_VER
+        xcr0 = _xgetbv(0);
+#else
+        uint32_t lo, hi;
+        __asm__ __volatile__("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+        xcr0 = ((uint64_t)hi << 32) | lo;
+#endif
+    }
+    const bool os_ymm = (xcr0 & 0x06) == 0x06;
+    const bool os_zmm = os_ymm && (xcr0 & 0xe0) == 0xe0;
+
+    CPUFeatures ret;
+    ret.sse4 = bit(ecx1, 19) && bit(ecx1, 20) && bit(ecx1, 23);
+    ret.avx = ret.sse4 && os_ymm && bit(ecx1, 28);
+    ret.avx512skx = ret.avx && os_zmm &&
+        bit(ebx7, 16) && bit(ebx7, 28) && bit(ebx7, 17) && bit(ebx7, 30) && bit(ebx7, 31);
+    return ret;
+}
+
+// the target ISPC's dispatcher selects: the best one the CPU supports among --target=sse4-i32x4,avx1-i32x8,avx512skx-i32x16.
+// nullptr if none is, in which case calling into ISPC would abort.
+static const char* SelectISPCTarget()
+{
+    const CPUFeatures cpu = DetectCPUFeatures();
+    if (cpu.avx512skx)
+        return "avx512skx-i32x16";
+    if (cpu.avx)
+        return "avx1-i32x8";
+    if (cpu.sse4)
+        return "sse4-i32x4";
+    return nullptr;
+}
+#elif defined(muEnableISPC)
+// single target build (--target=neon-i32x4 on Android).
+static const char* SelectISPCTarget() { return "neon-i32x4"; }
+#endif
+
+#ifdef muEnableISPC
+static const char* GetISPCTarget()
+{
+    static const char* const s_target = SelectISPCTarget();
+    return s_target;
+}
+
+static const int NumISAs = 2;
+#else
+static const int NumISAs = 1;
+#endif
+static const int IntrinsicsISA = NumISAs - 1;
+
+static bool IsISASupported(int isa)
+{
+#ifdef muEnableISPC
+    if (isa < IntrinsicsISA)
+        return GetISPCTarget() != nullptr;
+#endif
+    return isa == IntrinsicsISA;
+}
+
+static const char* GetISAName([[maybe_unused]] int isa)
+{
+#ifdef muEnableISPC
+    if (isa < IntrinsicsISA)
+        return GetISPCTarget() ? GetISPCTarget() : "ispc";
+#endif
+    return GetSIMDBackendName_SIMD();
+}
+
+static int GetBestISA()
+{
+    for (int i = 0; i < NumISAs; ++i) {
+        if (IsISASupported(i))
+            return i;
+    }
+    return IntrinsicsISA;
+}
+
+static bool EqualIgnoreCase(const char *a, const char *b)
+{
+    for (; *a && *b; ++a, ++b) {
+        if (::tolower((unsigned char)*a) != ::tolower((unsigned char)*b))
+            return false;
+    }
+    return *a == *b;
+}
+
+// "auto" resolves to the best ISA. returns -1 if name is unknown.
+static int FindISA(const char *name)
+{
+    if (!name)
+        return -1;
+    if (EqualIgnoreCase(name, "auto"))
+        return GetBestISA();
+#ifdef muEnableISPC
+    if (EqualIgnoreCase(name, "ispc"))
+        return IsISASupported(0) ? 0 : -1;
+#endif
+    for (int i = 0; i < NumISAs; ++i) {
+        if (IsISASupported(i) && EqualIgnoreCase(name, GetISAName(i)))
+            return i;
+    }
+    return -1;
+}
+
+static std::atomic<int> g_active_isa{ -1 };
+
+static int InitActiveISA()
+{
+    int isa = GetBestISA();
+    if (const char *env = ::getenv("MESHSYNC_SIMD_ISA")) {
+        int requested = FindISA(env);
+        if (requested >= 0)
+            isa = requested;
+        else
+            muLogWarning("MESHSYNC_SIMD_ISA=%s is unknown. using %s\n", env, GetISAName(isa));
+    }
+
+    // SetActiveSIMDISA() may have been called in the meantime. it takes precedence.
+    int expected = -1;
+    g_active_isa.compare_exchange_strong(expected, isa);
+    return g_active_isa.load();
+}
+
+static inline int GetActiveISA()
+{
+    int isa = g_active_isa.load(std::memory_order_relaxed);
+    return isa >= 0 ? isa : InitActiveISA();
+}
+
+const char* GetActiveSIMDISA()
+{
+    return GetISAName(GetActiveISA());
+}
+
+std::vector<const char*> GetSupportedSIMDISAs()
+{
+    std::vector<const char*> ret;
+    for (int i = 0; i < NumISAs; ++i) {
+        if (IsISASupported(i))
+            ret.push_back(GetISAName(i));
+    }
+    return ret;
+}
+
+bool SetActiveSIMDISA(const char *name)
+{
+    int isa = FindISA(name);
+    if (isa < 0)
+        return false;
+    g_active_isa.store(isa);
+    return true;
+}
+
+
 #ifdef muEnableISPC
 #include "MeshUtilsCore.h"
 
+static inline bool IsISPCActive() { return GetActiveISA() != IntrinsicsISA; }
+
 #ifdef muSIMD_SumInt32
 uint64_t SumInt32_ISPC(const uint32_t *src, size_t num)
 {
@@ -280,25 +492,69 @@ void GenerateTangentsTriangleSoA_ISPC(float4 *dst,
 #endif // muEnableISPC
 
 
-#ifdef muEnableISPC
-    #define Forward(Name, ...) Name##_ISPC(__VA_ARGS__)
+// each public function forwards to the ISPC kernel if it is enabled in muSIMDConfig.h and an ISPC target is active
+// (see SetActiveSIMDISA()), otherwise to the intrinsics implementation (muSIMDIntrinsics.cpp). kernels that have no
+// intrinsics version (24 / 32 bit norm conversions done in double precision, PolyInside and tangent generation) fall
+// back to the scalar one.
+#define ForwardISPC(Alt, Name, ...) (IsISPCActive() ? Name##_ISPC(__VA_ARGS__) : Alt(Name, __VA_ARGS__))
+#define ForwardSIMD(Name, ...) Name##_SIMD(__VA_ARGS__)
+#define ForwardGeneric(Name, ...) Name##_Generic(__VA_ARGS__)
+
+// reductions over large arrays are split into chunks and each chunk is processed by the SIMD kernel in parallel.
+// chunks are fixed size and joined in order, so results are identical regardless of thread count.
+static const size_t ReduceChunkSize = 1024 * 64;
+
+// element-wise kernels are bandwidth bound. on large arrays they are split into chunks that fit in L2 and processed by
+// the worker threads. small arrays stay on the calling thread: waking the workers costs more than it gains.
+static const size_t ParallelThresholdBytes = 1024 * 1024;
+static const size_t ParallelChunkBytes = 1024 * 128;
+
+// body(offset, count) is called for each chunk. chunks are aligned to 64 elements so vector kernels have full blocks.
+template<class T, class Body>
+static inline void EachChunk(size_t num, const Body& body)
+{
+    if (num * sizeof(T) <= ParallelThresholdBytes) {
+        body(size_t(0), num);
+        return;
+    }
+    const int chunk = (int)(ParallelChunkBytes / sizeof(T)) & ~63;
+    parallel_for_blocked(0, (int)num, chunk, [&body](int begin, int end) {
+        body((size_t)begin, (size_t)(end - begin));
+    });
+}
+
+#if defined(muEnableISPC) && defined(muSIMD_SumInt32)
+    #define Forward(...) ForwardISPC(ForwardSIMD, __VA_ARGS__)
 #else
-    #define Forward(Name, ...) Name##_Generic(__VA_ARGS__)
+    #define Forward ForwardSIMD
 #endif
-
-#if defined(muSIMD_SumInt32) || !defined(muEnableISPC)
 uint64_t SumInt32(const void *src, size_t num)
 {
-    return Forward(SumInt32, (uint32_t*)src, num / sizeof(uint32_t));
+    const uint32_t *data = (const uint32_t*)src;
+    const size_t n = num / sizeof(uint32_t);
+    if (n <= ReduceChunkSize)
+        return Forward(SumInt32, data, n);
+
+    return parallel_reduce(0, (int)n, (int)ReduceChunkSize, uint64_t(0),
+        [data](int begin, int end, uint64_t acc) { return acc + Forward(SumInt32, data + begin, end - begin); },
+        std::plus<uint64_t>());
 }
-#endif
+#undef Forward
 
-#if defined(muSIMD_Float_Half_Conversion) || !defined(muEnableISPC)
+#if defined(muEnableISPC) && defined(muSIMD_Float_Half_Conversion)
+    #define Forward(...) ForwardISPC(ForwardSIMD, __VA_ARGS__)
+#else
+    #define Forward ForwardSIMD
+#endif
 void F32ToF16(half *dst, const float *src, size_t num) { Forward(F32ToF16, dst, src, num); }
 void F16ToF32(float *dst, const half *src, size_t num) { Forward(F16ToF32, dst, src, num); }
-#endif
+#undef Forward
 
-#if defined(muSIMD_Float_Norm_Conversion) || !defined(muEnableISPC)
+#if defined(muEnableISPC) && defined(muSIMD_Float_Norm_Conversion)
+    #define Forward(...) ForwardISPC(ForwardSIMD, __VA_ARGS__)
+#else
+    #define Forward ForwardSIMD
+#endif
 void F32ToS8(snorm8 *dst, const float *src, size_t num) { Forward(F32ToS8, dst, src, num); }
 void S8ToF32(float *dst, const snorm8 *src, size_t num) { Forward(S8ToF32, dst, src, num); }
 void F32ToU8(unorm8 *dst, const float *src, size_t num) { Forward(F32ToU8, dst, src, num); }
@@ -309,50 +565,80 @@ void F32ToS16(snorm16 *dst, const float *src, size_t num) { Forward(F32ToS16, ds
 void S16ToF32(float *dst, const snorm16 *src, size_t num) { Forward(S16ToF32, dst, src, num); }
 void F32ToU16(unorm16 *dst, const float *src, size_t num) { Forward(F32ToU16, dst, src, num); }
 void U16ToF32(float *dst, const unorm16 *src, size_t num) { Forward(U16ToF32, dst, src, num); }
+#undef Forward
+#if defined(muEnableISPC) && defined(muSIMD_Float_Norm_Conversion)
+    #define Forward(...) ForwardISPC(ForwardGeneric, __VA_ARGS__)
+#else
+    #define Forward ForwardGeneric
+#endif
 void F32ToS24(snorm24 *dst, const float *src, size_t num) { Forward(F32ToS24, dst, src, num); }
 void S24ToF32(float *dst, const snorm24 *src, size_t num) { Forward(S24ToF32, dst, src, num); }
 void F32ToS32(snorm32 *dst, const float *src, size_t num) { Forward(F32ToS32, dst, src, num); }
 void S32ToF32(float *dst, const snorm32 *src, size_t num) { Forward(S32ToF32, dst, src, num); }
-#endif
+#undef Forward
 
 
-#if defined(muSIMD_InvertX3) || !defined(muEnableISPC)
+#if defined(muEnableISPC) && defined(muSIMD_InvertX3)
+    #define Forward(...) ForwardISPC(ForwardSIMD, __VA_ARGS__)
+#else
+    #define Forward ForwardSIMD
+#endif
 void InvertX(float3 *dst, size_t num)
 {
-    Forward(InvertX, dst, num);
+    EachChunk<float3>(num, [&](size_t i, size_t n) { Forward(InvertX, dst + i, n); });
 }
+#undef Forward
+#if defined(muEnableISPC) && defined(muSIMD_InvertX4)
+    #define Forward(...) ForwardISPC(ForwardSIMD, __VA_ARGS__)
+#else
+    #define Forward ForwardSIMD
 #endif
-#if defined(muSIMD_InvertX4) || !defined(muEnableISPC)
 void InvertX(float4 *dst, size_t num)
 {
-    Forward(InvertX, dst, num);
+    EachChunk<float4>(num, [&](size_t i, size_t n) { Forward(InvertX, dst + i, n); });
 }
-#endif
+#undef Forward
 
-#if defined(muSIMD_Scale) || !defined(muEnableISPC)
+#if defined(muEnableISPC) && defined(muSIMD_Scale)
+    #define Forward(...) ForwardISPC(ForwardSIMD, __VA_ARGS__)
+#else
+    #define Forward ForwardSIMD
+#endif
 void Scale(float *dst, float s, size_t num)
 {
-    Forward(Scale, dst, s, num);
+    EachChunk<float>(num, [&](size_t i, size_t n) { Forward(Scale, dst + i, s, n); });
 }
+#undef Forward
+#if defined(muEnableISPC) && defined(muSIMD_Scale)
+    #define Forward(...) ForwardISPC(ForwardSIMD, __VA_ARGS__)
+#else
+    #define Forward ForwardSIMD
 #endif
-#if defined(muSIMD_Scale) || !defined(muEnableISPC)
 void Scale(float3 *dst, float s, size_t num)
 {
-    Forward(Scale, dst, s, num);
+    EachChunk<float3>(num, [&](size_t i, size_t n) { Forward(Scale, dst + i, s, n); });
 }
-#endif
+#undef Forward
 
-#if defined(muSIMD_Normalize) || !defined(muEnableISPC)
+#if defined(muEnableISPC) && defined(muSIMD_Normalize)
+    #define Forward(...) ForwardISPC(ForwardSIMD, __VA_ARGS__)
+#else
+    #define Forward ForwardSIMD
+#endif
 void Normalize(float3 *dst, size_t num)
 {
-    Forward(Normalize, dst, num);
+    EachChunk<float3>(num, [&](size_t i, size_t n) { Forward(Normalize, dst + i, n); });
 }
-#endif
+#undef Forward
 
-#if defined(muSIMD_Lerp) || !defined(muEnableISPC)
+#if defined(muEnableISPC) && defined(muSIMD_Lerp)
+    #define Forward(...) ForwardISPC(ForwardSIMD, __VA_ARGS__)
+#else
+    #define Forward ForwardSIMD
+#endif
 void Lerp(float *dst, const float *src1, const float *src2, size_t num, float w)
 {
-    Forward(Lerp, dst, src1, src2, num, w);
+    EachChunk<float>(num, [&](size_t i, size_t n) { Forward(Lerp, dst + i, src1 + i, src2 + i, n, w); });
 }
 void Lerp(float2 *dst, const float2 *src1, const float2 *src2, size_t num, float w)
 {
@@ -369,24 +655,53 @@ void Lerp(float4 *dst, const float4 *src1, const float4 *src2, size_t num, float
 
 void LerpNormals(float3 *dst, const float3 *src1, const float3 *src2, size_t num, float w)
 {
-    Forward(LerpNormals, dst, src1, src2, num, w);
+    EachChunk<float3>(num, [&](size_t i, size_t n) { Forward(LerpNormals, dst + i, src1 + i, src2 + i, n, w); });
 }
 
 void LerpTangents(float4 * dst, const float4 * src1, const float4 * src2, size_t num, float w)
 {
-    Forward(LerpTangents, dst, src1, src2, num, w);
+    EachChunk<float4>(num, [&](size_t i, size_t n) { Forward(LerpTangents, dst + i, src1 + i, src2 + i, n, w); });
 }
-#endif
+#undef Forward
 
-#if defined(muSIMD_MinMax) || !defined(muEnableISPC)
-void MinMax(const int *p, size_t num, int& dst_min, int& dst_max) { Forward(MinMax, p, num, dst_min, dst_max); }
-void MinMax(const float *p, size_t num, float& dst_min, float& dst_max) { Forward(MinMax, p, num, dst_min, dst_max); }
-void MinMax(const float2 *p, size_t num, float2& dst_min, float2& dst_max) { Forward(MinMax, p, num, dst_min, dst_max); }
-void MinMax(const float3 *p, size_t num, float3& dst_min, float3& dst_max) { Forward(MinMax, p, num, dst_min, dst_max); }
-void MinMax(const float4 *p, size_t num, float4& dst_min, float4& dst_max) { Forward(MinMax, p, num, dst_min, dst_max); }
+#if defined(muEnableISPC) && defined(muSIMD_MinMax)
+    #define Forward(...) ForwardISPC(ForwardSIMD, __VA_ARGS__)
+#else
+    #define Forward ForwardSIMD
 #endif
+template<class T>
+static inline void MinMaxImpl(const T *p, size_t num, T& dst_min, T& dst_max)
+{
+    if (num <= ReduceChunkSize) {
+        Forward(MinMax, p, num, dst_min, dst_max);
+        return;
+    }
+
+    using range_t = std::pair<T, T>;
+    range_t r = parallel_reduce(0, (int)num, (int)ReduceChunkSize, range_t{ p[0], p[0] },
+        [p](int begin, int end, range_t acc) {
+            T rmin, rmax;
+            Forward(MinMax, p + begin, end - begin, rmin, rmax);
+            return range_t{ min(acc.first, rmin), max(acc.second, rmax) };
+        },
+        [](const range_t& a, const range_t& b) {
+            return range_t{ min(a.first, b.first), max(a.second, b.second) };
+        });
+    dst_min = r.first;
+    dst_max = r.second;
+}
+void MinMax(const int *p, size_t num, int& dst_min, int& dst_max) { MinMaxImpl(p, num, dst_min, dst_max); }
+void MinMax(const float *p, size_t num, float& dst_min, float& dst_max) { MinMaxImpl(p, num, dst_min, dst_max); }
+void MinMax(const float2 *p, size_t num, float2& dst_min, float2& dst_max) { MinMaxImpl(p, num, dst_min, dst_max); }
+void MinMax(const float3 *p, size_t num, float3& dst_min, float3& dst_max) { MinMaxImpl(p, num, dst_min, dst_max); }
+void MinMax(const float4 *p, size_t num, float4& dst_min, float4& dst_max) { MinMaxImpl(p, num, dst_min, dst_max); }
+#undef Forward
 
-#if defined(muSIMD_NearEqual) || !defined(muEnableISPC)
+#if defined(muEnableISPC) && defined(muSIMD_NearEqual)
+    #define Forward(...) ForwardISPC(ForwardSIMD, __VA_ARGS__)
+#else
+    #define Forward ForwardSIMD
+#endif
 bool NearEqual(const float *src1, const float *src2, size_t num, float eps)
 {
     return Forward(NearEqual, src1, src2, num, eps);
@@ -403,34 +718,134 @@ bool NearEqual(const float4 *src1, const float4 *src2, size_t num, float eps)
 {
     return NearEqual((const float*)src1, (const float*)src2, num * 4, eps);
 }
-#endif
+#undef Forward
 
-#if defined(muSIMD_MulPoints3) || !defined(muEnableISPC)
+#if defined(muEnableISPC) && defined(muSIMD_MulPoints3)
+    #define Forward(...) ForwardISPC(ForwardSIMD, __VA_ARGS__)
+#else
+    #define Forward ForwardSIMD
+#endif
 void MulPoints(const float4x4& m, const float3 src[], float3 dst[], size_t num_data)
 {
-    Forward(MulPoints, m, src, dst, num_data);
+    EachChunk<float3>(num_data, [&](size_t i, size_t n) { Forward(MulPoints, m, src + i, dst + i, n); });
 }
+#undef Forward
+#if defined(muEnableISPC) && defined(muSIMD_MulVectors3)
+    #define Forward(...) ForwardISPC(ForwardSIMD, __VA_ARGS__)
+#else
+    #define Forward ForwardSIMD
 #endif
-#if defined(muSIMD_MulVectors3) || !defined(muEnableISPC)
 void MulVectors(const float4x4& m, const float3 src[], float3 dst[], size_t num_data)
 {
-    Forward(MulVectors, m, src, dst, num_data);
+    EachChunk<float3>(num_data, [&](size_t i, size_t n) { Forward(MulVectors, m, src + i, dst + i, n); });
 }
+#undef Forward
+
+// gathers are bound by the latency of the scattered source reads, so elements are copied with plain fixed size copies
+// while the source element a few iterations ahead is prefetched.
+// large inputs are split into chunks of indices and the chunks run in parallel. each chunk gathers the streams one after
+// another. chunks are as large as still keeps the threads busy: interleaving the streams in smaller pieces was measured
+// slower because each stream's source drops out of the cache before the next piece of the same stream.
+static const size_t GatherMinChunkSize = 1024 * 64;
+static const size_t GatherPrefetchDistance = 16;
+
+static inline void GatherPrefetch(const void *p)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_prefetch(p);
+#elif defined(_M_X64) || defined(_M_IX86)
+    _mm_prefetch((const char*)p, _MM_HINT_T0);
+#else
+    (void)p;
 #endif
+}
+
+template<size_t N>
+static inline void GatherTile(char *dst, const char *src, const int *indices, size_t num)
+{
+    size_t i = 0;
+    if (num > GatherPrefetchDistance) {
+        for (; i < num - GatherPrefetchDistance; ++i) {
+            GatherPrefetch(src + (size_t)indices[i + GatherPrefetchDistance] * N);
+            memcpy(dst + i * N, src + (size_t)indices[i] * N, N);
+        }
+    }
+    for (; i < num; ++i)
+        memcpy(dst + i * N, src + (size_t)indices[i] * N, N);
+}
+
+static void GatherTile(const GatherStream& s, const int *indices, size_t offset, size_t num)
+{
+    const size_t size = s.element_size;
+    char *dst = (char*)s.dst + offset * size;
+    const char *src = (const char*)s.src;
+    switch (size) {
+    case 1: GatherTile<1>(dst, src, indices, num); break;
+    case 2: GatherTile<2>(dst, src, indices, num); break;
+    case 4: GatherTile<4>(dst, src, indices, num); break;
+    case 8: GatherTile<8>(dst, src, indices, num); break;
+    case 12: GatherTile<12>(dst, src, indices, num); break;
+    case 16: GatherTile<16>(dst, src, indices, num); break;
+    case 32: GatherTile<32>(dst, src, indices, num); break;
+    default:
+        for (size_t i = 0; i < num; ++i)
+            memcpy(dst + i * size, src + (size_t)indices[i] * size, size);
+        break;
+    }
+}
+
+void GatherAttributes(const GatherStream *streams, size_t num_streams, const int *indices, size_t num_indices)
+{
+    if (num_streams == 0 || num_indices == 0)
+        return;
+
+    size_t row_size = 0;
+    for (size_t si = 0; si < num_streams; ++si)
+        row_size += streams[si].element_size;
+
+    auto body = [&](size_t begin, size_t end) {
+        for (size_t si = 0; si < num_streams; ++si) {
+            if (streams[si].dst && streams[si].src)
+                GatherTile(streams[si], indices + begin, begin, end - begin);
+        }
+    };
+
+    if (num_indices <= GatherMinChunkSize || num_indices * row_size <= ParallelThresholdBytes) {
+        body(0, num_indices);
+        return;
+    }
+    size_t num_chunks = (size_t)parallel_concurrency() * 2;
+    size_t chunk_size = std::max(GatherMinChunkSize, (num_indices + num_chunks - 1) / num_chunks);
+    parallel_for_blocked(0, (int)num_indices, (int)chunk_size, [&](int begin, int end) {
+        body((size_t)begin, (size_t)end);
+    });
+}
 
-#if defined(muSIMD_RayTrianglesIntersectionIndexed) || !defined(muEnableISPC)
+#if defined(muEnableISPC) && defined(muSIMD_RayTrianglesIntersectionIndexed)
+    #define Forward(...) ForwardISPC(ForwardSIMD, __VA_ARGS__)
+#else
+    #define Forward ForwardSIMD
+#endif
 int RayTrianglesIntersectionIndexed(float3 pos, float3 dir, const float3 *vertices, const int *indices, int num_triangles, int& tindex, float& result)
 {
     return Forward(RayTrianglesIntersectionIndexed, pos, dir, vertices, indices, num_triangles, tindex, result);
 }
+#undef Forward
+#if defined(muEnableISPC) && defined(muSIMD_RayTrianglesIntersectionFlattened)
+    #define Forward(...) ForwardISPC(ForwardSIMD, __VA_ARGS__)
+#else
+    #define Forward ForwardSIMD
 #endif
-#if defined(muSIMD_RayTrianglesIntersectionFlattened) || !defined(muEnableISPC)
 int RayTrianglesIntersectionFlattened(float3 pos, float3 dir, const float3 *vertices, int num_triangles, int& tindex, float& result)
 {
     return Forward(RayTrianglesIntersectionFlattened, pos, dir, vertices, num_triangles, tindex, result);
 }
+#undef Forward
+#if defined(muEnableISPC) && defined(muSIMD_RayTrianglesIntersectionSoA)
+    #define Forward(...) ForwardISPC(ForwardSIMD, __VA_ARGS__)
+#else
+    #define Forward ForwardSIMD
 #endif
-#if defined(muSIMD_RayTrianglesIntersectionSoA) || !defined(muEnableISPC)
 int RayTrianglesIntersectionSoA(float3 pos, float3 dir,
     const float *v1x, const float *v1y, const float *v1z,
     const float *v2x, const float *v2y, const float *v2z,
@@ -439,43 +854,67 @@ int RayTrianglesIntersectionSoA(float3 pos, float3 dir,
 {
     return Forward(RayTrianglesIntersectionSoA, pos, dir, v1x, v1y, v1z, v2x, v2y, v2z, v3x, v3y, v3z, num_triangles, tindex, result);
 }
-#endif
+#undef Forward
 
-#if defined(muSIMD_PolyInside) || !defined(muEnableISPC)
+#if defined(muEnableISPC) && defined(muSIMD_PolyInside)
+    #define Forward(...) ForwardISPC(ForwardGeneric, __VA_ARGS__)
+#else
+    #define Forward ForwardGeneric
+#endif
 bool PolyInside(const float2 poly[], int ngon, const float2 minp, const float2 maxp, const float2 pos)
 {
     return Forward(PolyInside, poly, ngon, minp, maxp, pos);
 }
+#undef Forward
+#if defined(muEnableISPC) && defined(muSIMD_PolyInside)
+    #define Forward(...) ForwardISPC(ForwardGeneric, __VA_ARGS__)
+#else
+    #define Forward ForwardGeneric
 #endif
-#if defined(muSIMD_PolyInside) || !defined(muEnableISPC)
 bool PolyInside(const float2 poly[], int ngon, const float2 pos)
 {
     return Forward(PolyInside, poly, ngon, pos);
 }
+#undef Forward
+#if defined(muEnableISPC) && defined(muSIMD_PolyInsideSoA)
+    #define Forward(...) ForwardISPC(ForwardGeneric, __VA_ARGS__)
+#else
+    #define Forward ForwardGeneric
 #endif
-#if defined(muSIMD_PolyInsideSoA) || !defined(muEnableISPC)
 bool PolyInside(const float px[], const float py[], int ngon, const float2 minp, const float2 maxp, const float2 pos)
 {
     return Forward(PolyInside, px, py, ngon, minp, maxp, pos);
 }
-#endif
+#undef Forward
 
-#if defined(muSIMD_GenerateNormalsTriangleIndexed) || !defined(muEnableISPC)
+#if defined(muEnableISPC) && defined(muSIMD_GenerateNormalsTriangleIndexed)
+    #define Forward(...) ForwardISPC(ForwardSIMD, __VA_ARGS__)
+#else
+    #define Forward ForwardSIMD
+#endif
 void GenerateNormalsTriangleIndexed(float3 *dst,
     const float3 *vertices, const int *indices, int num_triangles, int num_vertices)
 {
     return Forward(GenerateNormalsTriangleIndexed, dst, vertices, indices, num_triangles, num_vertices);
 }
+#undef Forward
+#if defined(muEnableISPC) && defined(muSIMD_GenerateNormalsTriangleFlattened)
+    #define Forward(...) ForwardISPC(ForwardSIMD, __VA_ARGS__)
+#else
+    #define Forward ForwardSIMD
 #endif
-#if defined(muSIMD_GenerateNormalsTriangleFlattened) || !defined(muEnableISPC)
 void GenerateNormalsTriangleFlattened(float3 *dst,
     const float3 *vertices, const int *indices,
     int num_triangles, int num_vertices)
 {
     return Forward(GenerateNormalsTriangleFlattened, dst, vertices, indices, num_triangles, num_vertices);
 }
+#undef Forward
+#if defined(muEnableISPC) && defined(muSIMD_GenerateNormalsTriangleSoA)
+    #define Forward(...) ForwardISPC(ForwardSIMD, __VA_ARGS__)
+#else
+    #define Forward ForwardSIMD
 #endif
-#if defined(muSIMD_GenerateNormalsTriangleSoA) || !defined(muEnableISPC)
 void GenerateNormalsTriangleSoA(float3 *dst,
     const float *v1x, const float *v1y, const float *v1z,
     const float *v2x, const float *v2y, const float *v2z,
@@ -486,26 +925,38 @@ void GenerateNormalsTriangleSoA(float3 *dst,
         v1x, v1y, v1z, v2x, v2y, v2z, v3x, v3y, v3z,
         indices, num_triangles, num_vertices);
 }
-#endif
+#undef Forward
 
 
-#if defined(muSIMD_GenerateTangentsTriangleIndexed) || !defined(muEnableISPC)
+#if defined(muEnableISPC) && defined(muSIMD_GenerateTangentsTriangleIndexed)
+    #define Forward(...) ForwardISPC(ForwardGeneric, __VA_ARGS__)
+#else
+    #define Forward ForwardGeneric
+#endif
 void GenerateTangentsTriangleIndexed(float4 *dst,
     const float3 *vertices, const float2 *uv, const float3 *normals, const int *indices,
     int num_triangles, int num_vertices)
 {
     return Forward(GenerateTangentsTriangleIndexed, dst, vertices, uv, normals, indices, num_triangles, num_vertices);
 }
+#undef Forward
+#if defined(muEnableISPC) && defined(muSIMD_GenerateTangentsTriangleFlattened)
+    #define Forward(...) ForwardISPC(ForwardGeneric, __VA_ARGS__)
+#else
+    #define Forward ForwardGeneric
 #endif
-#if defined(muSIMD_GenerateTangentsTriangleFlattened) || !defined(muEnableISPC)
 void GenerateTangentsTriangleFlattened(float4 *dst,
     const float3 *vertices, const float2 *uv, const float3 *normals, const int *indices,
     int num_triangles, int num_vertices)
 {
     return Forward(GenerateTangentsTriangleFlattened, dst, vertices, uv, normals, indices, num_triangles, num_vertices);
 }
+#undef Forward
+#if defined(muEnableISPC) && defined(muSIMD_GenerateTangentsTriangleSoA)
+    #define Forward(...) ForwardISPC(ForwardGeneric, __VA_ARGS__)
+#else
+    #define Forward ForwardGeneric
 #endif
-#if defined(muSIMD_GenerateTangentsTriangleSoA) || !defined(muEnableISPC)
 void GenerateTangentsTriangleSoA(float4 *dst,
     const float *v1x, const float *v1y, const float *v1z,
     const float *v2x, const float *v2y, const float *v2z,
@@ -521,7 +972,9 @@ void GenerateTangentsTriangleSoA(float4 *dst,
         u1x, u1y, u2x, u2y, u3x, u3y,
         normals, indices, num_triangles, num_vertices);
 }
-#endif
-
 #undef Forward
+
+#undef ForwardGeneric
+#undef ForwardSIMD
+#undef ForwardISPC
 } // namespace mu
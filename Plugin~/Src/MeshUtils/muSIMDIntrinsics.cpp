@@ -0,0 +1,666 @@
+#include "pch.h"
+#include "MeshUtils/muMath.h"
+#include "MeshUtils/muSIMD.h"
+#include "muSIMDVector.h"
+
+// intrinsics implementations of muSIMD kernels. used when ISPC is not available or the kernel is not enabled in muSIMDConfig.h.
+// results are identical to the _Generic ones: same operations in the same order, no FMA nor approximate reciprocals.
+// tails that don't fill a register are processed by the scalar code.
+
+namespace mu {
+
+#ifdef muSIMDVector_Backend
+using namespace simd;
+
+const char* GetSIMDBackendName_SIMD() { return muSIMDVector_Backend; }
+
+uint64_t SumInt32_SIMD(const uint32_t *src, size_t num)
+{
+    // 32 bit lanes can't hold the sum. accumulate low and high 16 bits separately and flush before they overflow.
+    const size_t FlushInterval = 0xffff;
+    const vint lmask = set1i(0xffff);
+
+    uint64_t ret = 0;
+    size_t i = 0;
+    while (num - i >= Width) {
+        vint lo = set1i(0), hi = set1i(0);
+        size_t end = std::min(i + FlushInterval * Width, num - (num - i) % Width);
+        for (; i < end; i += Width) {
+            vint v = loadi((const int32_t*)src + i);
+            lo = lo + (v & lmask);
+            hi = hi + shr<16>(v);
+        }
+        uint32_t tl[Width], th[Width];
+        storei((int32_t*)tl, lo);
+        storei((int32_t*)th, hi);
+        for (int li = 0; li < Width; ++li)
+            ret += (uint64_t)tl[li] + ((uint64_t)th[li] << 16);
+    }
+    for (; i < num; ++i)
+        ret += src[i];
+    return ret;
+}
+
+
+void F32ToF16_SIMD(half *dst, const float *src, size_t num)
+{
+    const vint sign_mask = set1i(0x8000), exp_mask = set1i(0x1f), mant_mask = set1i(0x3ff), exp_bias = set1i(127 - 15), zero_i = set1i(0);
+
+    size_t i = 0;
+    for (; i + Width <= num; i += Width) {
+        vint n = asint(load(src + i));
+        vint sign = shr<16>(n) & sign_mask;
+        vint exponent = shl<10>(maxi(shr<23>(n) - exp_bias, zero_i) & exp_mask);
+        vint mantissa = shr<13>(n) & mant_mask;
+        store_16(dst + i, sign | exponent | mantissa);
+    }
+    for (; i < num; ++i)
+        dst[i] = src[i];
+}
+
+void F16ToF32_SIMD(float *dst, const half *src, size_t num)
+{
+    const vint sign_mask = set1i(0x8000), exp_mask = set1i(0x1f), mant_mask = set1i(0x3ff), byte_mask = set1i(0xff), exp_bias = set1i(127 - 15);
+
+    size_t i = 0;
+    for (; i + Width <= num; i += Width) {
+        vint v = load_u16((const uint16_t*)src + i);
+        vint sign = shl<16>(v & sign_mask);
+        vint exponent = shl<23>(((shr<10>(v) & exp_mask) + exp_bias) & byte_mask);
+        vint mantissa = shl<13>(v & mant_mask);
+        store(dst + i, asfloat(sign | exponent | mantissa));
+    }
+    for (; i < num; ++i)
+        dst[i] = src[i];
+}
+
+
+// float -> norm: clamp, scale and truncate like the constructors of snorm8 & co.
+template<class T>
+static inline void FloatToNorm(T *dst, const float *src, size_t num, float lo, float hi, float scale, float bias)
+{
+    const vfloat vlo = set1(lo), vhi = set1(hi);
+    const vfloat vs = set1(scale), vb = set1(bias), vc = set1(T::C);
+
+    size_t i = 0;
+    for (; i + Width <= num; i += Width) {
+        vfloat v = min(max(load(src + i), vlo), vhi);
+        if (scale != 1.0f)
+            v = v * vs + vb;
+        vint r = cvtt(v * vc);
+        if (sizeof(T) == 1)
+            store_8(dst + i, r);
+        else
+            store_16(dst + i, r);
+    }
+    for (; i < num; ++i)
+        dst[i] = src[i];
+}
+
+// norm -> float
+template<class T, class Loader>
+static inline void NormToFloat(float *dst, const T *src, size_t num, const Loader& loader, bool signed_remap)
+{
+    const vfloat vr = set1(T::R), two = set1(2.0f), one = set1(1.0f);
+
+    size_t i = 0;
+    for (; i + Width <= num; i += Width) {
+        vfloat v = cvt(loader(src + i)) * vr;
+        if (signed_remap)
+            v = v * two - one;
+        store(dst + i, v);
+    }
+    for (; i < num; ++i)
+        dst[i] = src[i];
+}
+
+void F32ToS8_SIMD(snorm8 *dst, const float *src, size_t num) { FloatToNorm(dst, src, num, -1.0f, 1.0f, 1.0f, 0.0f); }
+void F32ToU8_SIMD(unorm8 *dst, const float *src, size_t num) { FloatToNorm(dst, src, num, 0.0f, 1.0f, 1.0f, 0.0f); }
+void F32ToU8N_SIMD(unorm8n *dst, const float *src, size_t num) { FloatToNorm(dst, src, num, -1.0f, 1.0f, 0.5f, 0.5f); }
+void F32ToS16_SIMD(snorm16 *dst, const float *src, size_t num) { FloatToNorm(dst, src, num, -1.0f, 1.0f, 1.0f, 0.0f); }
+void F32ToU16_SIMD(unorm16 *dst, const float *src, size_t num) { FloatToNorm(dst, src, num, 0.0f, 1.0f, 1.0f, 0.0f); }
+
+void S8ToF32_SIMD(float *dst, const snorm8 *src, size_t num) { NormToFloat(dst, src, num, [](const snorm8 *p) { return load_s8((const int8_t*)p); }, false); }
+void U8ToF32_SIMD(float *dst, const unorm8 *src, size_t num) { NormToFloat(dst, src, num, [](const unorm8 *p) { return load_u8((const uint8_t*)p); }, false); }
+void U8NToF32_SIMD(float *dst, const unorm8n *src, size_t num) { NormToFloat(dst, src, num, [](const unorm8n *p) { return load_u8((const uint8_t*)p); }, true); }
+void S16ToF32_SIMD(float *dst, const snorm16 *src, size_t num) { NormToFloat(dst, src, num, [](const snorm16 *p) { return load_s16((const int16_t*)p); }, false); }
+void U16ToF32_SIMD(float *dst, const unorm16 *src, size_t num) { NormToFloat(dst, src, num, [](const unorm16 *p) { return load_u16((const uint16_t*)p); }, false); }
+
+
+// Stride-component vectors are processed as flat float arrays. a block of Stride registers covers a whole number
+// of elements (Width is a multiple of 4), so lane j of register k always holds component (k * Width + j) % Stride.
+template<int Stride> struct BlockTraits { static const int Registers = Stride == 3 ? 3 : 1; };
+
+template<int Stride>
+static inline void ComponentPattern(vfloat (&dst)[BlockTraits<Stride>::Registers], float on, float off)
+{
+    for (int k = 0; k < BlockTraits<Stride>::Registers; ++k) {
+        float t[Width];
+        for (int j = 0; j < Width; ++j)
+            t[j] = (k * Width + j) % Stride == 0 ? on : off;
+        dst[k] = load(t);
+    }
+}
+
+template<class T, int Stride>
+static inline void InvertXImpl(T *dst, size_t num)
+{
+    const int R = BlockTraits<Stride>::Registers;
+    vfloat pattern[R];
+    ComponentPattern<Stride>(pattern, -1.0f, 1.0f);
+
+    float *d = (float*)dst;
+    const size_t block = Width * R / Stride;
+    size_t i = 0;
+    for (; i + block <= num; i += block) {
+        for (int k = 0; k < R; ++k) {
+            float *p = d + i * Stride + k * Width;
+            store(p, load(p) * pattern[k]);
+        }
+    }
+    for (; i < num; ++i)
+        dst[i].x *= -1.0f;
+}
+void InvertX_SIMD(float3 *dst, size_t num) { InvertXImpl<float3, 3>(dst, num); }
+void InvertX_SIMD(float4 *dst, size_t num) { InvertXImpl<float4, 4>(dst, num); }
+
+void Scale_SIMD(float *dst, float s, size_t num)
+{
+    const vfloat vs = set1(s);
+    size_t i = 0;
+    for (; i + Width <= num; i += Width)
+        store(dst + i, load(dst + i) * vs);
+    for (; i < num; ++i)
+        dst[i] *= s;
+}
+void Scale_SIMD(float3 *dst, float s, size_t num)
+{
+    Scale_SIMD((float*)dst, s, num * 3);
+}
+
+static inline void normalize3(vfloat& x, vfloat& y, vfloat& z)
+{
+    vfloat len = sqrt(x * x + y * y + z * z);
+    x = x / len;
+    y = y / len;
+    z = z / len;
+}
+
+void Normalize_SIMD(float3 *dst, size_t num)
+{
+    size_t i = 0;
+    for (; i + Width <= num; i += Width) {
+        vfloat x, y, z;
+        load3((float*)(dst + i), x, y, z);
+        normalize3(x, y, z);
+        store3((float*)(dst + i), x, y, z);
+    }
+    for (; i < num; ++i)
+        dst[i] = normalize(dst[i]);
+}
+
+void Lerp_SIMD(float *dst, const float *src1, const float *src2, size_t num, float w)
+{
+    const float iw = 1.0f - w;
+    const vfloat vw = set1(w), viw = set1(iw);
+    size_t i = 0;
+    for (; i + Width <= num; i += Width)
+        store(dst + i, load(src1 + i) * viw + load(src2 + i) * vw);
+    for (; i < num; ++i)
+        dst[i] = src1[i] * iw + src2[i] * w;
+}
+
+void LerpNormals_SIMD(float3 *dst, const float3 *src1, const float3 *src2, size_t num, float w)
+{
+    const float iw = 1.0f - w;
+    const vfloat vw = set1(w), viw = set1(iw);
+    size_t i = 0;
+    for (; i + Width <= num; i += Width) {
+        vfloat x1, y1, z1, x2, y2, z2;
+        load3((const float*)(src1 + i), x1, y1, z1);
+        load3((const float*)(src2 + i), x2, y2, z2);
+        vfloat x = x1 * viw + x2 * vw;
+        vfloat y = y1 * viw + y2 * vw;
+        vfloat z = z1 * viw + z2 * vw;
+        normalize3(x, y, z);
+        store3((float*)(dst + i), x, y, z);
+    }
+    for (; i < num; ++i)
+        dst[i] = normalize(src1[i] * iw + src2[i] * w);
+}
+
+void LerpTangents_SIMD(float4 *dst, const float4 *src1, const float4 *src2, size_t num, float w)
+{
+    const float iw = 1.0f - w;
+    const vfloat vw = set1(w), viw = set1(iw);
+    size_t i = 0;
+    for (; i + Width <= num; i += Width) {
+        vfloat x1, y1, z1, w1, x2, y2, z2, w2;
+        load4((const float*)(src1 + i), x1, y1, z1, w1);
+        load4((const float*)(src2 + i), x2, y2, z2, w2);
+        vfloat x = x1 * viw + x2 * vw;
+        vfloat y = y1 * viw + y2 * vw;
+        vfloat z = z1 * viw + z2 * vw;
+        normalize3(x, y, z);
+        store4((float*)(dst + i), x, y, z, w1);
+    }
+    for (; i < num; ++i) {
+        const float4& t1 = src1[i];
+        const float4& t2 = src2[i];
+        float3 r = normalize(to_vec3(t1) * iw + to_vec3(t2) * w);
+        dst[i] = { r.x, r.y, r.z, t1.w };
+    }
+}
+
+
+// the new value is passed first so that ties resolve the same way as std::min / std::max in the scalar path
+static inline vfloat vmin(vfloat acc, vfloat v) { return min(v, acc); }
+static inline vfloat vmax(vfloat acc, vfloat v) { return max(v, acc); }
+static inline vint vmin(vint acc, vint v) { return mini(v, acc); }
+static inline vint vmax(vint acc, vint v) { return maxi(v, acc); }
+static inline vfloat vload(const float *p) { return load(p); }
+static inline vint vload(const int *p) { return loadi((const int32_t*)p); }
+static inline void vstore(float *p, vfloat v) { store(p, v); }
+static inline void vstore(int *p, vint v) { storei((int32_t*)p, v); }
+
+template<class T, class S, int Stride>
+static inline void MinMaxImpl(const T *src, size_t num, T& dst_min, T& dst_max)
+{
+    using V = decltype(vload((const S*)nullptr));
+    const int R = BlockTraits<Stride>::Registers;
+    const size_t block = Width * R / Stride;
+    if (num < block * 2) {
+        MinMax_Generic(src, num, dst_min, dst_max);
+        return;
+    }
+
+    const S *s = (const S*)src;
+    V rmin[R], rmax[R];
+    for (int k = 0; k < R; ++k)
+        rmin[k] = rmax[k] = vload(s + k * Width);
+
+    size_t i = block;
+    for (; i + block <= num; i += block) {
+        for (int k = 0; k < R; ++k) {
+            V v = vload(s + i * Stride + k * Width);
+            rmin[k] = vmin(rmin[k], v);
+            rmax[k] = vmax(rmax[k], v);
+        }
+    }
+
+    S tmin[Width * R], tmax[Width * R];
+    for (int k = 0; k < R; ++k) {
+        vstore(tmin + k * Width, rmin[k]);
+        vstore(tmax + k * Width, rmax[k]);
+    }
+    T lo = ((const T*)tmin)[0], hi = ((const T*)tmax)[0];
+    for (size_t j = 1; j < block; ++j) {
+        lo = min(lo, ((const T*)tmin)[j]);
+        hi = max(hi, ((const T*)tmax)[j]);
+    }
+    for (; i < num; ++i) {
+        lo = min(lo, src[i]);
+        hi = max(hi, src[i]);
+    }
+    dst_min = lo;
+    dst_max = hi;
+}
+void MinMax_SIMD(const int *src, size_t num, int& dst_min, int& dst_max) { MinMaxImpl<int, int, 1>(src, num, dst_min, dst_max); }
+void MinMax_SIMD(const float *src, size_t num, float& dst_min, float& dst_max) { MinMaxImpl<float, float, 1>(src, num, dst_min, dst_max); }
+void MinMax_SIMD(const float2 *src, size_t num, float2& dst_min, float2& dst_max) { MinMaxImpl<float2, float, 2>(src, num, dst_min, dst_max); }
+void MinMax_SIMD(const float3 *src, size_t num, float3& dst_min, float3& dst_max) { MinMaxImpl<float3, float, 3>(src, num, dst_min, dst_max); }
+void MinMax_SIMD(const float4 *src, size_t num, float4& dst_min, float4& dst_max) { MinMaxImpl<float4, float, 4>(src, num, dst_min, dst_max); }
+
+bool NearEqual_SIMD(const float *src1, const float *src2, size_t num, float eps)
+{
+    const vfloat veps = set1(eps);
+    const int all = (1 << Width) - 1;
+    size_t i = 0;
+    for (; i + Width <= num; i += Width) {
+        if (movemask(abs(load(src1 + i) - load(src2 + i)) < veps) != all)
+            return false;
+    }
+    for (; i < num; ++i) {
+        if (!near_equal(src1[i], src2[i], eps))
+            return false;
+    }
+    return true;
+}
+
+template<bool Point>
+static inline void MulImpl(const float4x4& m, const float3 src[], float3 dst[], size_t num)
+{
+    vfloat c[4][3];
+    for (int ci = 0; ci < 4; ++ci)
+        for (int ri = 0; ri < 3; ++ri)
+            c[ci][ri] = set1(m[ci][ri]);
+
+    size_t i = 0;
+    for (; i + Width <= num; i += Width) {
+        vfloat x, y, z;
+        load3((const float*)(src + i), x, y, z);
+        vfloat r[3];
+        for (int ri = 0; ri < 3; ++ri) {
+            r[ri] = c[0][ri] * x + c[1][ri] * y + c[2][ri] * z;
+            if (Point)
+                r[ri] = r[ri] + c[3][ri];
+        }
+        store3((float*)(dst + i), r[0], r[1], r[2]);
+    }
+    for (; i < num; ++i)
+        dst[i] = Point ? mul_p(m, src[i]) : mul_v(m, src[i]);
+}
+void MulPoints_SIMD(const float4x4& m, const float3 src[], float3 dst[], size_t num_data) { MulImpl<true>(m, src, dst, num_data); }
+void MulVectors_SIMD(const float4x4& m, const float3 src[], float3 dst[], size_t num_data) { MulImpl<false>(m, src, dst, num_data); }
+
+
+// vertices of Width triangles gathered into SoA registers
+struct TriangleBlock
+{
+    vfloat v[3][3]; // [vertex][component]
+
+    template<class Fetch>
+    TriangleBlock(int first, const Fetch& fetch)
+    {
+        float3 p[3][Width];
+        for (int l = 0; l < Width; ++l)
+            fetch(first + l, p[0][l], p[1][l], p[2][l]);
+        for (int vi = 0; vi < 3; ++vi)
+            for (int c = 0; c < 3; ++c)
+                v[vi][c] = build([&](int l) { return p[vi][l][c]; });
+    }
+};
+
+// same as ray_triangle_intersection() in muMath.h. returns lanes that hit and their distances.
+static inline int RayTriangles(const float3& pos, const float3& dir,
+    vfloat p1x, vfloat p1y, vfloat p1z,
+    vfloat p2x, vfloat p2y, vfloat p2z,
+    vfloat p3x, vfloat p3y, vfloat p3z,
+    vfloat& distance)
+{
+    const vfloat epsdet = set1(1e-10f), neps = set1(-1e-4f), peps = set1(1 + 1e-4f), vzero = zero(), one = set1(1.0f);
+    const vfloat dx = set1(dir.x), dy = set1(dir.y), dz = set1(dir.z);
+
+    vfloat e1x = p2x - p1x, e1y = p2y - p1y, e1z = p2z - p1z;
+    vfloat e2x = p3x - p1x, e2y = p3y - p1y, e2z = p3z - p1z;
+    vfloat px = dy * e2z - dz * e2y;
+    vfloat py = dz * e2x - dx * e2z;
+    vfloat pz = dx * e2y - dy * e2x;
+    vfloat det = e1x * px + e1y * py + e1z * pz;
+    vmask reject = abs(det) < epsdet;
+    vfloat inv_det = one / det;
+    vfloat tx = set1(pos.x) - p1x, ty = set1(pos.y) - p1y, tz = set1(pos.z) - p1z;
+    vfloat u = (tx * px + ty * py + tz * pz) * inv_det;
+    reject = reject | (u < neps) | (u > peps);
+    vfloat qx = ty * e1z - tz * e1y;
+    vfloat qy = tz * e1x - tx * e1z;
+    vfloat qz = tx * e1y - ty * e1x;
+    vfloat v = (dx * qx + dy * qy + dz * qz) * inv_det;
+    reject = reject | (v < neps) | (u + v > peps);
+    distance = (e2x * qx + e2y * qy + e2z * qz) * inv_det;
+    return movemask(andnot(reject, distance >= vzero));
+}
+
+template<class Fetch>
+static inline int RayTrianglesImpl(const float3& pos, const float3& dir, int num_triangles, int& tindex, float& distance, const Fetch& fetch)
+{
+    int num_hits = 0;
+    distance = FLT_MAX;
+
+    int ti = 0;
+    for (; ti + Width <= num_triangles; ti += Width) {
+        TriangleBlock tb(ti, fetch);
+        vfloat d;
+        int hits = RayTriangles(pos, dir,
+            tb.v[0][0], tb.v[0][1], tb.v[0][2],
+            tb.v[1][0], tb.v[1][1], tb.v[1][2],
+            tb.v[2][0], tb.v[2][1], tb.v[2][2], d);
+        if (hits) {
+            float td[Width];
+            store(td, d);
+            for (int l = 0; l < Width; ++l) {
+                if (hits & (1 << l)) {
+                    ++num_hits;
+                    if (td[l] < distance) {
+                        distance = td[l];
+                        tindex = ti + l;
+                    }
+                }
+            }
+        }
+    }
+    for (; ti < num_triangles; ++ti) {
+        float3 p1, p2, p3;
+        fetch(ti, p1, p2, p3);
+        float d;
+        if (ray_triangle_intersection(pos, dir, p1, p2, p3, d)) {
+            ++num_hits;
+            if (d < distance) {
+                distance = d;
+                tindex = ti;
+            }
+        }
+    }
+    return num_hits;
+}
+
+int RayTrianglesIntersectionIndexed_SIMD(float3 pos, float3 dir, const float3 *vertices, const int *indices, int num_triangles, int& tindex, float& distance)
+{
+    return RayTrianglesImpl(pos, dir, num_triangles, tindex, distance, [&](int ti, float3& p1, float3& p2, float3& p3) {
+        p1 = vertices[indices[ti * 3 + 0]];
+        p2 = vertices[indices[ti * 3 + 1]];
+        p3 = vertices[indices[ti * 3 + 2]];
+    });
+}
+
+int RayTrianglesIntersectionFlattened_SIMD(float3 pos, float3 dir, const float3 *vertices, int num_triangles, int& tindex, float& distance)
+{
+    return RayTrianglesImpl(pos, dir, num_triangles, tindex, distance, [&](int ti, float3& p1, float3& p2, float3& p3) {
+        p1 = vertices[ti * 3 + 0];
+        p2 = vertices[ti * 3 + 1];
+        p3 = vertices[ti * 3 + 2];
+    });
+}
+
+int RayTrianglesIntersectionSoA_SIMD(float3 pos, float3 dir,
+    const float *v1x, const float *v1y, const float *v1z,
+    const float *v2x, const float *v2y, const float *v2z,
+    const float *v3x, const float *v3y, const float *v3z,
+    int num_triangles, int& tindex, float& distance)
+{
+    int num_hits = 0;
+    distance = FLT_MAX;
+
+    int ti = 0;
+    for (; ti + Width <= num_triangles; ti += Width) {
+        vfloat d;
+        int hits = RayTriangles(pos, dir,
+            load(v1x + ti), load(v1y + ti), load(v1z + ti),
+            load(v2x + ti), load(v2y + ti), load(v2z + ti),
+            load(v3x + ti), load(v3y + ti), load(v3z + ti), d);
+        if (hits) {
+            float td[Width];
+            store(td, d);
+            for (int l = 0; l < Width; ++l) {
+                if (hits & (1 << l)) {
+                    ++num_hits;
+                    if (td[l] < distance) {
+                        distance = td[l];
+                        tindex = ti + l;
+                    }
+                }
+            }
+        }
+    }
+    for (; ti < num_triangles; ++ti) {
+        float d;
+        if (ray_triangle_intersection(pos, dir,
+            { v1x[ti], v1y[ti], v1z[ti] },
+            { v2x[ti], v2y[ti], v2z[ti] },
+            { v3x[ti], v3y[ti], v3z[ti] }, d))
+        {
+            ++num_hits;
+            if (d < distance) {
+                distance = d;
+                tindex = ti;
+            }
+        }
+    }
+    return num_hits;
+}
+
+
+// gathering indexed or flattened vertices costs more than the cross products save. only SoA input computes face
+// normals Width triangles at a time. accumulating them into vertices is a scatter and stays scalar, in the same order
+// as the scalar path so that the sums are identical. the final normalization is vectorized in all cases.
+static inline void FaceNormals(
+    vfloat p0x, vfloat p0y, vfloat p0z,
+    vfloat p1x, vfloat p1y, vfloat p1z,
+    vfloat p2x, vfloat p2y, vfloat p2z,
+    float (&n)[3][Width])
+{
+    vfloat e1x = p1x - p0x, e1y = p1y - p0y, e1z = p1z - p0z;
+    vfloat e2x = p2x - p0x, e2y = p2y - p0y, e2z = p2z - p0z;
+    store(n[0], e1y * e2z - e1z * e2y);
+    store(n[1], e1z * e2x - e1x * e2z);
+    store(n[2], e1x * e2y - e1y * e2x);
+}
+
+template<class Fetch>
+static inline void GenerateNormalsImpl(float3 *dst, const int *indices, int num_triangles, int num_vertices, const Fetch& fetch)
+{
+    memset(dst, 0, sizeof(float3)*num_vertices);
+
+    for (int ti = 0; ti < num_triangles; ++ti) {
+        float3 p0, p1, p2;
+        fetch(ti, p0, p1, p2);
+        float3 n = cross(p1 - p0, p2 - p0);
+        int ti3 = ti * 3;
+        for (int ci = 0; ci < 3; ++ci)
+            dst[indices[ti3 + ci]] += n;
+    }
+    Normalize_SIMD(dst, num_vertices);
+}
+
+void GenerateNormalsTriangleIndexed_SIMD(float3 *dst,
+    const float3 *vertices, const int *indices, int num_triangles, int num_vertices)
+{
+    GenerateNormalsImpl(dst, indices, num_triangles, num_vertices, [&](int ti, float3& p0, float3& p1, float3& p2) {
+        p0 = vertices[indices[ti * 3 + 0]];
+        p1 = vertices[indices[ti * 3 + 1]];
+        p2 = vertices[indices[ti * 3 + 2]];
+    });
+}
+
+void GenerateNormalsTriangleFlattened_SIMD(float3 *dst,
+    const float3 *vertices, const int *indices, int num_triangles, int num_vertices)
+{
+    GenerateNormalsImpl(dst, indices, num_triangles, num_vertices, [&](int ti, float3& p0, float3& p1, float3& p2) {
+        p0 = vertices[ti * 3 + 0];
+        p1 = vertices[ti * 3 + 1];
+        p2 = vertices[ti * 3 + 2];
+    });
+}
+
+void GenerateNormalsTriangleSoA_SIMD(float3 *dst,
+    const float *v1x, const float *v1y, const float *v1z,
+    const float *v2x, const float *v2y, const float *v2z,
+    const float *v3x, const float *v3y, const float *v3z,
+    const int *indices, int num_triangles, int num_vertices)
+{
+    memset(dst, 0, sizeof(float3)*num_vertices);
+
+    float n[3][Width];
+    int ti = 0;
+    for (; ti + Width <= num_triangles; ti += Width) {
+        FaceNormals(
+            load(v1x + ti), load(v1y + ti), load(v1z + ti),
+            load(v2x + ti), load(v2y + ti), load(v2z + ti),
+            load(v3x + ti), load(v3y + ti), load(v3z + ti), n);
+        for (int l = 0; l < Width; ++l) {
+            float3 fn = { n[0][l], n[1][l], n[2][l] };
+            int ti3 = (ti + l) * 3;
+            for (int ci = 0; ci < 3; ++ci)
+                dst[indices[ti3 + ci]] += fn;
+        }
+    }
+    for (; ti < num_triangles; ++ti) {
+        float3 p0 = { v1x[ti], v1y[ti], v1z[ti] };
+        float3 p1 = { v2x[ti], v2y[ti], v2z[ti] };
+        float3 p2 = { v3x[ti], v3y[ti], v3z[ti] };
+        float3 fn = cross(p1 - p0, p2 - p0);
+        int ti3 = ti * 3;
+        for (int ci = 0; ci < 3; ++ci)
+            dst[indices[ti3 + ci]] += fn;
+    }
+    Normalize_SIMD(dst, num_vertices);
+}
+
+#else // muSIMDVector_Backend
+
+// no vector unit. everything falls back to the scalar path.
+const char* GetSIMDBackendName_SIMD() { return "Generic"; }
+
+#define Fallback(Ret, Name, Params, ...) Ret Name##_SIMD Params { return Name##_Generic(__VA_ARGS__); }
+
+Fallback(uint64_t, SumInt32, (const uint32_t *src, size_t num), src, num)
+Fallback(void, F32ToF16, (half *dst, const float *src, size_t num), dst, src, num)
+Fallback(void, F16ToF32, (float *dst, const half *src, size_t num), dst, src, num)
+Fallback(void, F32ToS8, (snorm8 *dst, const float *src, size_t num), dst, src, num)
+Fallback(void, S8ToF32, (float *dst, const snorm8 *src, size_t num), dst, src, num)
+Fallback(void, F32ToU8, (unorm8 *dst, const float *src, size_t num), dst, src, num)
+Fallback(void, U8ToF32, (float *dst, const unorm8 *src, size_t num), dst, src, num)
+Fallback(void, F32ToU8N, (unorm8n *dst, const float *src, size_t num), dst, src, num)
+Fallback(void, U8NToF32, (float *dst, const unorm8n *src, size_t num), dst, src, num)
+Fallback(void, F32ToS16, (snorm16 *dst, const float *src, size_t num), dst, src, num)
+Fallback(void, S16ToF32, (float *dst, const snorm16 *src, size_t num), dst, src, num)
+Fallback(void, F32ToU16, (unorm16 *dst, const float *src, size_t num), dst, src, num)
+Fallback(void, U16ToF32, (float *dst, const unorm16 *src, size_t num), dst, src, num)
+Fallback(void, InvertX, (float3 *dst, size_t num), dst, num)
+Fallback(void, InvertX, (float4 *dst, size_t num), dst, num)
+Fallback(void, Scale, (float *dst, float s, size_t num), dst, s, num)
+Fallback(void, Scale, (float3 *dst, float s, size_t num), dst, s, num)
+Fallback(void, Normalize, (float3 *dst, size_t num), dst, num)
+Fallback(void, Lerp, (float *dst, const float *src1, const float *src2, size_t num, float w), dst, src1, src2, num, w)
+Fallback(void, LerpNormals, (float3 *dst, const float3 *src1, const float3 *src2, size_t num, float w), dst, src1, src2, num, w)
+Fallback(void, LerpTangents, (float4 *dst, const float4 *src1, const float4 *src2, size_t num, float w), dst, src1, src2, num, w)
+Fallback(void, MinMax, (const int *src, size_t num, int& dst_min, int& dst_max), src, num, dst_min, dst_max)
+Fallback(void, MinMax, (const float *src, size_t num, float& dst_min, float& dst_max), src, num, dst_min, dst_max)
+Fallback(void, MinMax, (const float2 *src, size_t num, float2& dst_min, float2& dst_max), src, num, dst_min, dst_max)
+Fallback(void, MinMax, (const float3 *src, size_t num, float3& dst_min, float3& dst_max), src, num, dst_min, dst_max)
+Fallback(void, MinMax, (const float4 *src, size_t num, float4& dst_min, float4& dst_max), src, num, dst_min, dst_max)
+Fallback(bool, NearEqual, (const float *src1, const float *src2, size_t num, float eps), src1, src2, num, eps)
+Fallback(void, MulPoints, (const float4x4& m, const float3 src[], float3 dst[], size_t num_data), m, src, dst, num_data)
+Fallback(void, MulVectors, (const float4x4& m, const float3 src[], float3 dst[], size_t num_data), m, src, dst, num_data)
+Fallback(int, RayTrianglesIntersectionIndexed,
+    (float3 pos, float3 dir, const float3 *vertices, const int *indices, int num_triangles, int& tindex, float& distance),
+    pos, dir, vertices, indices, num_triangles, tindex, distance)
+Fallback(int, RayTrianglesIntersectionFlattened,
+    (float3 pos, float3 dir, const float3 *vertices, int num_triangles, int& tindex, float& distance),
+    pos, dir, vertices, num_triangles, tindex, distance)
+Fallback(int, RayTrianglesIntersectionSoA,
+    (float3 pos, float3 dir,
+        const float *v1x, const float *v1y, const float *v1z,
+        const float *v2x, const float *v2y, const float *v2z,
+        const float *v3x, const float *v3y, const float *v3z,
+        int num_triangles, int& tindex, float& distance),
+    pos, dir, v1x, v1y, v1z, v2x, v2y, v2z, v3x, v3y, v3z, num_triangles, tindex, distance)
+Fallback(void, GenerateNormalsTriangleIndexed,
+    (float3 *dst, const float3 *vertices, const int *indices, int num_triangles, int num_vertices),
+    dst, vertices, indices, num_triangles, num_vertices)
+Fallback(void, GenerateNormalsTriangleFlattened,
+    (float3 *dst, const float3 *vertices, const int *indices, int num_triangles, int num_vertices),
+    dst, vertices, indices, num_triangles, num_vertices)
+Fallback(void, GenerateNormalsTriangleSoA,
+    (float3 *dst,
+        const float *v1x, const float *v1y, const float *v1z,
+        const float *v2x, const float *v2y, const float *v2z,
+        const float *v3x, const float *v3y, const float *v3z,
+        const int *indices, int num_triangles, int num_vertices),
+    dst, v1x, v1y, v1z, v2x, v2y, v2z, v3x, v3y, v3z, indices, num_triangles, num_vertices)
+
+#undef Fallback
+
+#endif // muSIMDVector_Backend
+
+} // namespace mu
@@ -0,0 +1,300 @@
+#pragma once
+
+// thin wrappers over SSE2 / NEON registers for the intrinsics backend of muSIMD (muSIMDIntrinsics.cpp).
+// kernels are written once against vfloat / vint / vmask and Width.
+// SSE2 is the baseline of every x64 build and NEON of every arm64 build, so no per-ISA compilation or dispatch is needed.
+// both have 4 lanes and behave the same where the kernels depend on it (min / max with NaN, cvtt out of range).
+// muSIMDVector_Backend is not defined on other targets, where the scalar kernels are used.
+
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #include <emmintrin.h>
+    #define muSIMDVector_SSE2
+    #define muSIMDVector_Backend "SSE2"
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+    #include <arm_neon.h>
+    #define muSIMDVector_NEON
+    #define muSIMDVector_Backend "NEON"
+#endif
+
+#ifdef muSIMDVector_Backend
+namespace mu {
+namespace simd {
+
+#if defined(muSIMDVector_SSE2)
+
+static const int Width = 4;
+struct vfloat { __m128 v; };
+struct vint { __m128i v; };
+struct vmask { __m128 v; };
+
+inline vfloat load(const float *p) { return { _mm_loadu_ps(p) }; }
+inline void store(float *p, vfloat a) { _mm_storeu_ps(p, a.v); }
+inline vfloat set1(float a) { return { _mm_set1_ps(a) }; }
+template<class F> inline vfloat build(const F& f) { return { _mm_setr_ps(f(0), f(1), f(2), f(3)) }; } // lane i = f(i)
+inline vfloat operator+(vfloat a, vfloat b) { return { _mm_add_ps(a.v, b.v) }; }
+inline vfloat operator-(vfloat a, vfloat b) { return { _mm_sub_ps(a.v, b.v) }; }
+inline vfloat operator*(vfloat a, vfloat b) { return { _mm_mul_ps(a.v, b.v) }; }
+inline vfloat operator/(vfloat a, vfloat b) { return { _mm_div_ps(a.v, b.v) }; }
+inline vfloat min(vfloat a, vfloat b) { return { _mm_min_ps(a.v, b.v) }; }
+inline vfloat max(vfloat a, vfloat b) { return { _mm_max_ps(a.v, b.v) }; }
+inline vfloat sqrt(vfloat a) { return { _mm_sqrt_ps(a.v) }; }
+inline vfloat abs(vfloat a) { return { _mm_andnot_ps(_mm_set1_ps(-0.0f), a.v) }; }
+
+inline vmask operator<(vfloat a, vfloat b) { return { _mm_cmplt_ps(a.v, b.v) }; }
+inline vmask operator<=(vfloat a, vfloat b) { return { _mm_cmple_ps(a.v, b.v) }; }
+inline vmask operator>(vfloat a, vfloat b) { return { _mm_cmpgt_ps(a.v, b.v) }; }
+inline vmask operator>=(vfloat a, vfloat b) { return { _mm_cmpge_ps(a.v, b.v) }; }
+inline vmask operator&(vmask a, vmask b) { return { _mm_and_ps(a.v, b.v) }; }
+inline vmask operator|(vmask a, vmask b) { return { _mm_or_ps(a.v, b.v) }; }
+inline vmask andnot(vmask a, vmask b) { return { _mm_andnot_ps(a.v, b.v) }; }
+inline vfloat select(vmask m, vfloat a, vfloat b) { return { _mm_or_ps(_mm_and_ps(m.v, a.v), _mm_andnot_ps(m.v, b.v)) }; } // m ? a : b
+inline int movemask(vmask m) { return _mm_movemask_ps(m.v); }
+
+inline vint loadi(const int32_t *p) { return { _mm_loadu_si128((const __m128i*)p) }; }
+inline void storei(int32_t *p, vint a) { _mm_storeu_si128((__m128i*)p, a.v); }
+inline vint set1i(int32_t a) { return { _mm_set1_epi32(a) }; }
+inline vint operator+(vint a, vint b) { return { _mm_add_epi32(a.v, b.v) }; }
+inline vint operator-(vint a, vint b) { return { _mm_sub_epi32(a.v, b.v) }; }
+inline vint operator&(vint a, vint b) { return { _mm_and_si128(a.v, b.v) }; }
+inline vint operator|(vint a, vint b) { return { _mm_or_si128(a.v, b.v) }; }
+template<int N> inline vint shl(vint a) { return { _mm_slli_epi32(a.v, N) }; }
+template<int N> inline vint shr(vint a) { return { _mm_srli_epi32(a.v, N) }; }
+inline vint mini(vint a, vint b)
+{
+    __m128i m = _mm_cmplt_epi32(a.v, b.v);
+    return { _mm_or_si128(_mm_and_si128(m, a.v), _mm_andnot_si128(m, b.v)) };
+}
+inline vint maxi(vint a, vint b)
+{
+    __m128i m = _mm_cmpgt_epi32(a.v, b.v);
+    return { _mm_or_si128(_mm_and_si128(m, a.v), _mm_andnot_si128(m, b.v)) };
+}
+inline vint cvtt(vfloat a) { return { _mm_cvttps_epi32(a.v) }; }
+inline vfloat cvt(vint a) { return { _mm_cvtepi32_ps(a.v) }; }
+inline vint asint(vfloat a) { return { _mm_castps_si128(a.v) }; }
+inline vfloat asfloat(vint a) { return { _mm_castsi128_ps(a.v) }; }
+
+inline vint load_u16(const uint16_t *p) { return { _mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i*)p), _mm_setzero_si128()) }; }
+inline vint load_s16(const int16_t *p)
+{
+    __m128i t = _mm_loadl_epi64((const __m128i*)p);
+    return { _mm_srai_epi32(_mm_unpacklo_epi16(t, t), 16) };
+}
+inline vint load_u8(const uint8_t *p)
+{
+    int32_t t;
+    memcpy(&t, p, 4);
+    __m128i z = _mm_setzero_si128();
+    return { _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(t), z), z) };
+}
+inline vint load_s8(const int8_t *p)
+{
+    int32_t t;
+    memcpy(&t, p, 4);
+    __m128i b = _mm_cvtsi32_si128(t);
+    __m128i w = _mm_unpacklo_epi8(b, b);
+    return { _mm_srai_epi32(_mm_unpacklo_epi16(w, w), 24) };
+}
+inline __m128i narrow16(vint a)
+{
+    // sign extend the low 16 bits so that the signed saturating pack keeps them as is
+    __m128i t = _mm_srai_epi32(_mm_slli_epi32(a.v, 16), 16);
+    return _mm_packs_epi32(t, t);
+}
+inline void store_16(void *p, vint a) { _mm_storel_epi64((__m128i*)p, narrow16(a)); }
+inline void store_8(void *p, vint a)
+{
+    __m128i t = narrow16(vint{ _mm_and_si128(a.v, _mm_set1_epi32(0xff)) });
+    int32_t r = _mm_cvtsi128_si32(_mm_packus_epi16(t, t));
+    memcpy(p, &r, 4);
+}
+
+
+// AoS <-> SoA. load3 / store3 handle Width float3 (Width * 3 floats), load4 / store4 handle Width float4.
+inline void load3(const float *p, vfloat& x, vfloat& y, vfloat& z)
+{
+    __m128 a = _mm_loadu_ps(p + 0);
+    __m128 b = _mm_loadu_ps(p + 4);
+    __m128 c = _mm_loadu_ps(p + 8);
+    __m128 t0 = _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 1, 3, 2));
+    __m128 t1 = _mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 0, 2, 1));
+    x.v = _mm_shuffle_ps(a, t0, _MM_SHUFFLE(2, 0, 3, 0));
+    y.v = _mm_shuffle_ps(t1, t0, _MM_SHUFFLE(3, 1, 2, 0));
+    z.v = _mm_shuffle_ps(t1, c, _MM_SHUFFLE(3, 0, 3, 1));
+}
+inline void store3(float *p, vfloat x, vfloat y, vfloat z)
+{
+    __m128 t0 = _mm_shuffle_ps(x.v, y.v, _MM_SHUFFLE(2, 0, 2, 0));
+    __m128 t1 = _mm_shuffle_ps(z.v, x.v, _MM_SHUFFLE(3, 1, 2, 0));
+    __m128 t2 = _mm_shuffle_ps(y.v, z.v, _MM_SHUFFLE(3, 1, 3, 1));
+    _mm_storeu_ps(p + 0, _mm_shuffle_ps(t0, t1, _MM_SHUFFLE(2, 0, 2, 0)));
+    _mm_storeu_ps(p + 4, _mm_shuffle_ps(t2, t0, _MM_SHUFFLE(3, 1, 2, 0)));
+    _mm_storeu_ps(p + 8, _mm_shuffle_ps(t1, t2, _MM_SHUFFLE(3, 1, 3, 1)));
+}
+inline void load4(const float *p, vfloat& x, vfloat& y, vfloat& z, vfloat& w)
+{
+    x.v = _mm_loadu_ps(p + 0);
+    y.v = _mm_loadu_ps(p + 4);
+    z.v = _mm_loadu_ps(p + 8);
+    w.v = _mm_loadu_ps(p + 12);
+    _MM_TRANSPOSE4_PS(x.v, y.v, z.v, w.v);
+}
+inline void store4(float *p, vfloat x, vfloat y, vfloat z, vfloat w)
+{
+    _MM_TRANSPOSE4_PS(x.v, y.v, z.v, w.v);
+    _mm_storeu_ps(p + 0, x.v);
+    _mm_storeu_ps(p + 4, y.v);
+    _mm_storeu_ps(p + 8, z.v);
+    _mm_storeu_ps(p + 12, w.v);
+}
+
+#elif defined(muSIMDVector_NEON)
+
+static const int Width = 4;
+struct vfloat { float32x4_t v; };
+struct vint { int32x4_t v; };
+struct vmask { uint32x4_t v; };
+
+inline vfloat load(const float *p) { return { vld1q_f32(p) }; }
+inline void store(float *p, vfloat a) { vst1q_f32(p, a.v); }
+inline vfloat set1(float a) { return { vdupq_n_f32(a) }; }
+template<class F> inline vfloat build(const F& f) // lane i = f(i)
+{
+    const float t[4] = { f(0), f(1), f(2), f(3) };
+    return { vld1q_f32(t) };
+}
+inline vfloat operator+(vfloat a, vfloat b) { return { vaddq_f32(a.v, b.v) }; }
+inline vfloat operator-(vfloat a, vfloat b) { return { vsubq_f32(a.v, b.v) }; }
+inline vfloat operator*(vfloat a, vfloat b) { return { vmulq_f32(a.v, b.v) }; }
+inline vfloat operator/(vfloat a, vfloat b)
+{
+#if defined(__aarch64__) || defined(_M_ARM64)
+    return { vdivq_f32(a.v, b.v) };
+#else
+    float ta[4], tb[4];
+    vst1q_f32(ta, a.v);
+    vst1q_f32(tb, b.v);
+    for (int i = 0; i < 4; ++i)
+        ta[i] /= tb[i];
+    return { vld1q_f32(ta) };
+#endif
+}
+// same as minps / maxps: b is returned when the comparison fails (NaN or equal). vminq_f32 would propagate NaN.
+inline vfloat min(vfloat a, vfloat b) { return { vbslq_f32(vcltq_f32(a.v, b.v), a.v, b.v) }; }
+inline vfloat max(vfloat a, vfloat b) { return { vbslq_f32(vcgtq_f32(a.v, b.v), a.v, b.v) }; }
+inline vfloat sqrt(vfloat a)
+{
+#if defined(__aarch64__) || defined(_M_ARM64)
+    return { vsqrtq_f32(a.v) };
+#else
+    float t[4];
+    vst1q_f32(t, a.v);
+    for (int i = 0; i < 4; ++i)
+        t[i] = std::sqrt(t[i]);
+    return { vld1q_f32(t) };
+#endif
+}
+inline vfloat abs(vfloat a) { return { vabsq_f32(a.v) }; }
+
+inline vmask operator<(vfloat a, vfloat b) { return { vcltq_f32(a.v, b.v) }; }
+inline vmask operator<=(vfloat a, vfloat b) { return { vcleq_f32(a.v, b.v) }; }
+inline vmask operator>(vfloat a, vfloat b) { return { vcgtq_f32(a.v, b.v) }; }
+inline vmask operator>=(vfloat a, vfloat b) { return { vcgeq_f32(a.v, b.v) }; }
+inline vmask operator&(vmask a, vmask b) { return { vandq_u32(a.v, b.v) }; }
+inline vmask operator|(vmask a, vmask b) { return { vorrq_u32(a.v, b.v) }; }
+inline vmask andnot(vmask a, vmask b) { return { vbicq_u32(b.v, a.v) }; } // ~a & b
+inline vfloat select(vmask m, vfloat a, vfloat b) { return { vbslq_f32(m.v, a.v, b.v) }; } // m ? a : b
+inline int movemask(vmask m)
+{
+    const int32_t shifts[4] = { 0, 1, 2, 3 };
+    uint32x4_t bits = vshlq_u32(vshrq_n_u32(m.v, 31), vld1q_s32(shifts));
+    uint32_t t[4];
+    vst1q_u32(t, bits);
+    return (int)(t[0] | t[1] | t[2] | t[3]);
+}
+
+inline vint loadi(const int32_t *p) { return { vld1q_s32(p) }; }
+inline void storei(int32_t *p, vint a) { vst1q_s32(p, a.v); }
+inline vint set1i(int32_t a) { return { vdupq_n_s32(a) }; }
+inline vint operator+(vint a, vint b) { return { vaddq_s32(a.v, b.v) }; }
+inline vint operator-(vint a, vint b) { return { vsubq_s32(a.v, b.v) }; }
+inline vint operator&(vint a, vint b) { return { vandq_s32(a.v, b.v) }; }
+inline vint operator|(vint a, vint b) { return { vorrq_s32(a.v, b.v) }; }
+template<int N> inline vint shl(vint a) { return { vshlq_n_s32(a.v, N) }; }
+template<int N> inline vint shr(vint a) { return { vreinterpretq_s32_u32(vshrq_n_u32(vreinterpretq_u32_s32(a.v), N)) }; }
+inline vint mini(vint a, vint b) { return { vminq_s32(a.v, b.v) }; }
+inline vint maxi(vint a, vint b) { return { vmaxq_s32(a.v, b.v) }; }
+// vcvtq_s32_f32 saturates and maps NaN to 0. cvttps2dq returns 0x80000000 for both, so do the same.
+inline vint cvtt(vfloat a)
+{
+    uint32x4_t in_range = vcltq_f32(vabsq_f32(a.v), vdupq_n_f32(2147483648.0f));
+    return { vbslq_s32(in_range, vcvtq_s32_f32(a.v), vdupq_n_s32(INT32_MIN)) };
+}
+inline vfloat cvt(vint a) { return { vcvtq_f32_s32(a.v) }; }
+inline vint asint(vfloat a) { return { vreinterpretq_s32_f32(a.v) }; }
+inline vfloat asfloat(vint a) { return { vreinterpretq_f32_s32(a.v) }; }
+
+inline vint load_u16(const uint16_t *p) { return { vreinterpretq_s32_u32(vmovl_u16(vld1_u16(p))) }; }
+inline vint load_s16(const int16_t *p) { return { vmovl_s16(vld1_s16(p)) }; }
+inline vint load_u8(const uint8_t *p)
+{
+    uint8_t t[8] = {};
+    memcpy(t, p, 4);
+    return { vreinterpretq_s32_u32(vmovl_u16(vget_low_u16(vmovl_u8(vld1_u8(t))))) };
+}
+inline vint load_s8(const int8_t *p)
+{
+    int8_t t[8] = {};
+    memcpy(t, p, 4);
+    return { vmovl_s16(vget_low_s16(vmovl_s8(vld1_s8(t)))) };
+}
+inline void store_16(void *p, vint a)
+{
+    uint16x4_t t = vmovn_u32(vreinterpretq_u32_s32(a.v));
+    memcpy(p, &t, 8);
+}
+inline void store_8(void *p, vint a)
+{
+    uint16x4_t t16 = vmovn_u32(vreinterpretq_u32_s32(a.v));
+    uint8x8_t t8 = vmovn_u16(vcombine_u16(t16, t16));
+    memcpy(p, &t8, 4);
+}
+
+
+// AoS <-> SoA. load3 / store3 handle Width float3 (Width * 3 floats), load4 / store4 handle Width float4.
+inline void load3(const float *p, vfloat& x, vfloat& y, vfloat& z)
+{
+    float32x4x3_t t = vld3q_f32(p);
+    x.v = t.val[0]; y.v = t.val[1]; z.v = t.val[2];
+}
+inline void store3(float *p, vfloat x, vfloat y, vfloat z)
+{
+    float32x4x3_t t;
+    t.val[0] = x.v; t.val[1] = y.v; t.val[2] = z.v;
+    vst3q_f32(p, t);
+}
+inline void load4(const float *p, vfloat& x, vfloat& y, vfloat& z, vfloat& w)
+{
+    float32x4x4_t t = vld4q_f32(p);
+    x.v = t.val[0]; y.v = t.val[1]; z.v = t.val[2]; w.v = t.val[3];
+}
+inline void store4(float *p, vfloat x, vfloat y, vfloat z, vfloat w)
+{
+    float32x4x4_t t;
+    t.val[0] = x.v; t.val[1] = y.v; t.val[2] = z.v; t.val[3] = w.v;
+    vst4q_f32(p, t);
+}
+
+#endif
+
+inline vfloat zero() { return set1(0.0f); }
+inline vint select(vmask m, vint a, vint b) { return asint(select(m, asfloat(a), asfloat(b))); }
+inline vfloat madd(vfloat a, vfloat b, vfloat c) { return a * b + c; } // not fused. results must match the scalar path.
+
+} // namespace simd
+} // namespace mu
+#endif // muSIMDVector_Backend
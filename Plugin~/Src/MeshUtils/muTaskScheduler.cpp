@@ -0,0 +1,329 @@
+#include "pch.h"
+#include "MeshUtils/muTaskScheduler.h"
+#include "MeshUtils/muConcurrency.h"
+
+#include <deque>
+#include <thread>
+
+namespace mu {
+
+namespace {
+
+thread_local TaskState *g_current_task = nullptr;
+std::atomic<int> g_max_concurrency{ 0 };
+
+int ResolveMaxConcurrency(int n)
+{
+    if (n > 0)
+        return n;
+    // tasks do their heavy lifting with parallel_for(), which already keeps every core busy.
+    // so the scheduler only gets the cores parallel_for() leaves unused, but at least 2 because
+    // tasks often block on file or network I/O.
+    int hw = (int)std::thread::hardware_concurrency();
+    return std::max(hw + 1 - parallel_concurrency(), 2);
+}
+
+} // namespace
+
+
+class TaskScheduler::Impl
+{
+public:
+    ~Impl()
+    {
+        std::vector<std::shared_ptr<TaskState>> remaining;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+            for (auto& q : m_queues) {
+                remaining.insert(remaining.end(), q.begin(), q.end());
+                q.clear();
+            }
+        }
+        m_cond.notify_all();
+        for (auto& task : remaining)
+            task->cancel();
+        for (auto& t : m_threads)
+            t.join();
+    }
+
+    int getNumThreads()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return (int)m_threads.size();
+    }
+
+    void enqueue(const std::shared_ptr<TaskState>& task)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (!m_stop) {
+                m_queues[(int)task->getPriority()].push_back(task);
+                if (m_num_idle == 0 && m_num_workers < ResolveMaxConcurrency(g_max_concurrency)) {
+                    joinExitedWorkers();
+                    ++m_num_workers;
+                    m_threads.emplace_back([this]() { workerMain(); });
+                }
+                m_cond.notify_one();
+                return;
+            }
+        }
+        // shutting down
+        task->cancel();
+    }
+
+    void updateConcurrency()
+    {
+        // excess workers exit after their current task. new ones are spawned on demand.
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_cond.notify_all();
+    }
+
+private:
+    bool hasTask() const
+    {
+        for (auto& q : m_queues)
+            if (!q.empty())
+                return true;
+        return false;
+    }
+
+    // m_mutex must be locked. exited workers have nothing left to do once they released the lock,
+    // so the join doesn't block for long.
+    void joinExitedWorkers()
+    {
+        for (auto id : m_exited) {
+            auto it = std::find_if(m_threads.begin(), m_threads.end(),
+                [id](const std::thread& t) { return t.get_id() == id; });
+            if (it != m_threads.end()) {
+                it->join();
+                m_threads.erase(it);
+            }
+        }
+        m_exited.clear();
+    }
+
+    std::shared_ptr<TaskState> popTask()
+    {
+        for (auto& q : m_queues) {
+            if (!q.empty()) {
+                auto ret = std::move(q.front());
+                q.pop_front();
+                return ret;
+            }
+        }
+        return nullptr;
+    }
+
+    void workerMain()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        for (;;) {
+            if (m_stop || m_num_workers > ResolveMaxConcurrency(g_max_concurrency))
+                break;
+            if (auto task = popTask()) {
+                lock.unlock();
+                // may fail if someone waiting for the task has already run it inline
+                task->tryRun();
+                task.reset();
+                lock.lock();
+                continue;
+            }
+            ++m_num_idle;
+            m_cond.wait(lock);
+            --m_num_idle;
+        }
+        --m_num_workers;
+        // joined by the next enqueue() that spawns a worker, or by the destructor
+        m_exited.push_back(std::this_thread::get_id());
+    }
+
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    std::deque<std::shared_ptr<TaskState>> m_queues[3]; // indexed by TaskPriority
+    std::vector<std::thread> m_threads;
+    std::vector<std::thread::id> m_exited;
+    int m_num_workers = 0;
+    int m_num_idle = 0;
+    bool m_stop = false;
+};
+
+
+TaskState::TaskState(TaskPriority priority)
+    : m_status(Status::Pending), m_priority(priority)
+{
+}
+
+TaskState::~TaskState()
+{
+}
+
+TaskState::Status TaskState::getStatus() const
+{
+    return m_status.load();
+}
+
+TaskPriority TaskState::getPriority() const
+{
+    return m_priority;
+}
+
+bool TaskState::isFinished() const
+{
+    Status s = m_status.load();
+    return s == Status::Completed || s == Status::Canceled;
+}
+
+bool TaskState::isCancelRequested() const
+{
+    return m_cancel_requested.load();
+}
+
+void TaskState::wait()
+{
+    for (;;) {
+        Status s = m_status.load();
+        if (s == Status::Completed || s == Status::Canceled)
+            return;
+
+        if (s == Status::Pending) {
+            if (tryRun())
+                return;
+            continue;
+        }
+
+        std::shared_ptr<TaskState> antecedent;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            antecedent = m_antecedent;
+        }
+        if (s == Status::Blocked && antecedent) {
+            antecedent->wait();
+            antecedent.reset();
+        }
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cond.wait(lock, [this]() {
+            Status s = m_status.load();
+            return s != Status::Running && s != Status::Blocked;
+        });
+    }
+}
+
+bool TaskState::cancel()
+{
+    m_cancel_requested = true;
+    Status s = Status::Pending;
+    if (m_status.compare_exchange_strong(s, Status::Canceled) ||
+        (s == Status::Blocked && m_status.compare_exchange_strong(s, Status::Canceled)))
+    {
+        finish(Status::Canceled);
+        return true;
+    }
+    return s == Status::Canceled;
+}
+
+bool TaskState::tryRun()
+{
+    Status s = Status::Pending;
+    if (!m_status.compare_exchange_strong(s, Status::Running))
+        return false;
+
+    // keep this alive even if the scheduler drops its reference while we are running
+    auto self = shared_from_this();
+    TaskState *prev = g_current_task;
+    g_current_task = this;
+    invoke();
+    g_current_task = prev;
+    finish(Status::Completed);
+    return true;
+}
+
+void TaskState::addContinuation(const std::shared_ptr<TaskState>& task)
+{
+    task->m_status = Status::Blocked;
+    {
+        std::lock_guard<std::mutex> lock(task->m_mutex);
+        task->m_antecedent = shared_from_this();
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!isFinished()) {
+            m_continuations.push_back(task);
+            return;
+        }
+    }
+    task->release();
+}
+
+void TaskState::finish(Status status)
+{
+    std::vector<std::shared_ptr<TaskState>> continuations;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_status = status;
+        m_antecedent.reset();
+        continuations.swap(m_continuations);
+    }
+    m_cond.notify_all();
+    for (auto& c : continuations)
+        c->release();
+}
+
+void TaskState::release()
+{
+    Status s = Status::Blocked;
+    if (!m_status.compare_exchange_strong(s, Status::Pending))
+        return; // canceled
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_antecedent.reset();
+    }
+    m_cond.notify_all();
+    TaskScheduler::instance().enqueue(shared_from_this());
+}
+
+
+TaskScheduler& TaskScheduler::instance()
+{
+    static TaskScheduler s_instance;
+    return s_instance;
+}
+
+TaskScheduler::TaskScheduler()
+{
+    m_impl = new Impl();
+}
+
+TaskScheduler::~TaskScheduler()
+{
+    delete m_impl;
+}
+
+void TaskScheduler::setMaxConcurrency(int n)
+{
+    g_max_concurrency = std::max(n, 0);
+    instance().m_impl->updateConcurrency();
+}
+
+int TaskScheduler::getMaxConcurrency()
+{
+    return ResolveMaxConcurrency(g_max_concurrency);
+}
+
+int TaskScheduler::getNumThreads()
+{
+    return instance().m_impl->getNumThreads();
+}
+
+bool TaskScheduler::isCurrentTaskCanceled()
+{
+    return g_current_task && g_current_task->isCancelRequested();
+}
+
+void TaskScheduler::enqueue(const std::shared_ptr<TaskState>& task)
+{
+    m_impl->enqueue(task);
+}
+
+} // namespace mu
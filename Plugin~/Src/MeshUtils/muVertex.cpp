@@ -1,6 +1,9 @@
 #include "pch.h"
 #include "MeshUtils/muMath.h"
 #include "MeshUtils/muVertex.h"
+#include "MeshUtils/muHalf.h"
+#include "MeshUtils/muSIMD.h"
+#include "MeshUtils/muConcurrency.h"
 
 namespace mu {
 
@@ -105,4 +108,86 @@ void Interleave(void *dst, VertexFormat format, size_t num,
     }
 }
 
+
+size_t GetVertexAttributeSize(VertexAttributeFormat format, int dimension)
+{
+    switch (format) {
+    case VertexAttributeFormat::Float32: return sizeof(float) * dimension;
+    case VertexAttributeFormat::Float16: return sizeof(half) * dimension;
+    case VertexAttributeFormat::SNorm8: return sizeof(snorm8) * dimension;
+    case VertexAttributeFormat::SNorm16: return sizeof(snorm16) * dimension;
+    case VertexAttributeFormat::UNorm8: return sizeof(unorm8) * dimension;
+    case VertexAttributeFormat::UNorm16: return sizeof(unorm16) * dimension;
+    default: return 0;
+    }
+}
+
+template<class T>
+static void InterleaveAttribute(char *dst, size_t stride, const VertexAttributeDesc& attr, size_t begin, size_t end)
+{
+    const int dim = attr.dimension;
+    const int src_dim = attr.src_dimension;
+    const int num_copy = attr.src ? std::min(dim, src_dim) : 0;
+    for (size_t i = begin; i < end; ++i) {
+        T *d = (T*)(dst + stride * i + attr.offset);
+        const float *s = attr.src ? attr.src + src_dim * i : nullptr;
+        int c = 0;
+        for (; c < num_copy; ++c)
+            d[c] = s[c];
+        for (; c < dim; ++c)
+            d[c] = 0.0f;
+    }
+}
+
+// float32 is copied as is and float16 goes through the SIMD converter when the source is not padded nor truncated.
+static void InterleaveFloat32(char *dst, size_t stride, const VertexAttributeDesc& attr, size_t begin, size_t end)
+{
+    if (!attr.src || attr.src_dimension != attr.dimension) {
+        InterleaveAttribute<float>(dst, stride, attr, begin, end);
+        return;
+    }
+    const size_t size = sizeof(float) * attr.dimension;
+    for (size_t i = begin; i < end; ++i)
+        memcpy(dst + stride * i + attr.offset, attr.src + attr.dimension * i, size);
+}
+
+static void InterleaveFloat16(char *dst, size_t stride, const VertexAttributeDesc& attr, size_t begin, size_t end)
+{
+    if (!attr.src || attr.src_dimension != attr.dimension) {
+        InterleaveAttribute<half>(dst, stride, attr, begin, end);
+        return;
+    }
+    const int dim = attr.dimension;
+    const size_t size = sizeof(half) * dim;
+    const size_t batch = 256;
+    half tmp[batch * 4];
+    for (size_t bi = begin; bi < end; bi += batch) {
+        const size_t n = std::min(batch, end - bi);
+        F32ToF16(tmp, attr.src + dim * bi, n * dim);
+        for (size_t i = 0; i < n; ++i)
+            memcpy(dst + stride * (bi + i) + attr.offset, tmp + dim * i, size);
+    }
+}
+
+void Interleave(void *dst_, size_t stride, size_t num, const VertexAttributeDesc *attributes, size_t num_attributes)
+{
+    char *dst = (char*)dst_;
+    parallel_for_blocked(0, (int)num, 1024 * 4, [&](int begin, int end) {
+        for (size_t ai = 0; ai < num_attributes; ++ai) {
+            const VertexAttributeDesc& attr = attributes[ai];
+            if (attr.dimension <= 0 || attr.dimension > 4)
+                continue;
+            switch (attr.format) {
+            case VertexAttributeFormat::Float32: InterleaveFloat32(dst, stride, attr, begin, end); break;
+            case VertexAttributeFormat::Float16: InterleaveFloat16(dst, stride, attr, begin, end); break;
+            case VertexAttributeFormat::SNorm8: InterleaveAttribute<snorm8>(dst, stride, attr, begin, end); break;
+            case VertexAttributeFormat::SNorm16: InterleaveAttribute<snorm16>(dst, stride, attr, begin, end); break;
+            case VertexAttributeFormat::UNorm8: InterleaveAttribute<unorm8>(dst, stride, attr, begin, end); break;
+            case VertexAttributeFormat::UNorm16: InterleaveAttribute<unorm16>(dst, stride, attr, begin, end); break;
+            default: break;
+            }
+        }
+    });
+}
+
 } // namespace mu
@@ -268,10 +268,20 @@ msAPI void msLightSetSpotAngle(ms::Light *self, float v) { self->spot_angle = v;
 
 
 #pragma region Mesh
+// refined meshes have either 32 bit indices or 16 bit indices16. both can be read in either width.
+template<class T>
+static inline void ReadMeshIndices(const ms::Mesh& mesh, T *dst, size_t count, size_t offset)
+{
+    if (!mesh.indices16.empty())
+        std::copy_n(mesh.indices16.cdata() + offset, count, dst);
+    else
+        std::copy_n(mesh.indices.cdata() + offset, count, dst);
+}
+
 msAPI ms::Mesh* msMeshCreate() { return ms::Mesh::create_raw(); }
 msAPI uint32_t msMeshGetDataFlags(const ms::Mesh *self) { return (uint32_t&)self->md_flags; }
 msAPI int msMeshGetNumPoints(const ms::Mesh *self) { return (int)self->points.size(); }
-msAPI int msMeshGetNumIndices(const ms::Mesh *self) { return (int)self->indices.size(); }
+msAPI int msMeshGetNumIndices(const ms::Mesh *self) { return (int)(self->indices16.empty() ? self->indices.size() : self->indices16.size()); }
 msAPI int msMeshGetNumCounts(const ms::Mesh *self) { return (int)self->counts.size(); }
 msAPI void msMeshReadPoints(const ms::Mesh *self, float3 *dst) { self->points.copy_to(dst); }
 msAPI void msMeshReadNormals(const ms::Mesh *self, float3 *dst) { self->normals.copy_to(dst); }
@@ -282,7 +292,8 @@ msAPI void msMeshReadUV(const ms::Mesh *self, float2 *dst, int index) {
 }
 msAPI void msMeshReadColors(const ms::Mesh *self, float4 *dst) { self->colors.copy_to(dst); }
 msAPI void msMeshReadVelocities(const ms::Mesh *self, float3 *dst) { self->velocities.copy_to(dst); }
-msAPI void msMeshReadIndices(const ms::Mesh *self, int *dst) { self->indices.copy_to(dst); }
+msAPI void msMeshReadIndices(const ms::Mesh *self, int *dst) { ReadMeshIndices(*self, dst, msMeshGetNumIndices(self), 0); }
+msAPI void msMeshReadIndices16(const ms::Mesh *self, uint16_t *dst) { ReadMeshIndices(*self, dst, msMeshGetNumIndices(self), 0); }
 msAPI void msMeshReadCounts(const ms::Mesh *self, int *dst) { self->counts.copy_to(dst); }
 msAPI const mu::float3* msMeshGetPointsPtr(const ms::Mesh *self) { return self->points.cdata(); }
 msAPI const mu::float3* msMeshGetNormalsPtr(const ms::Mesh *self) { return self->normals.cdata(); }
@@ -293,11 +304,30 @@ msAPI const mu::float2* msMeshGetUVPtr(const ms::Mesh *self, int index) {
 }
 msAPI const mu::float4* msMeshGetColorsPtr(const ms::Mesh *self) { return self->colors.cdata(); }
 msAPI const mu::float3* msMeshGetVelocitiesPtr(const ms::Mesh *self) { return self->velocities.cdata(); }
-msAPI const int* msMeshGetIndicesPtr(const ms::Mesh *self) { return self->indices.cdata(); }
+// the pointers are null if the mesh has the other width. msMeshGetNumIndices() applies to whichever is not null,
+// and msMeshReadIndices() / msMeshReadIndices16() work in either case.
+msAPI const int* msMeshGetIndicesPtr(const ms::Mesh *self) { return self->indices.empty() ? nullptr : self->indices.cdata(); }
+msAPI const uint16_t* msMeshGetIndices16Ptr(const ms::Mesh *self) { return self->indices16.empty() ? nullptr : self->indices16.cdata(); }
 msAPI const int* msMeshGetCountsPtr(const ms::Mesh *self) { return self->counts.cdata(); }
 msAPI int msMeshGetNumSubmeshes(const ms::Mesh *self) { return (int)self->submeshes.size(); }
 msAPI const ms::SubmeshData* msMeshGetSubmesh(const ms::Mesh *self, int i) { return &self->submeshes[i]; }
 msAPI ms::Bounds msMeshGetBounds(const ms::Mesh *self) { return self->bounds; }
+msAPI int msMeshGetNumMeshlets(const ms::Mesh *self) { return (int)self->meshlets.size(); }
+msAPI int msMeshGetNumMeshletVertices(const ms::Mesh *self) { return (int)self->meshlet_vertices.size(); }
+msAPI int msMeshGetNumMeshletTriangles(const ms::Mesh *self) { return (int)self->meshlet_triangles.size(); }
+msAPI bool msMeshWriteVertexBuffer(const ms::Mesh *self, void *dst, int stride, const ms::VertexAttributeLayout *layout, int num_attributes)
+{
+    return self->writeVertexBuffer(dst, stride, layout, num_attributes);
+}
+msAPI int msVertexAttributeGetSize(mu::VertexAttributeFormat format, int dimension) { return (int)mu::GetVertexAttributeSize(format, dimension); }
+msAPI void msMeshReadMeshlets(const ms::Mesh *self, mu::Meshlet *dst) { self->meshlets.copy_to(dst); }
+msAPI void msMeshReadMeshletVertices(const ms::Mesh *self, int *dst) { self->meshlet_vertices.copy_to(dst); }
+msAPI void msMeshReadMeshletTriangles(const ms::Mesh *self, uint8_t *dst) { self->meshlet_triangles.copy_to(dst); }
+msAPI int msMeshGetNumBatchSources(const ms::Mesh *self) { return (int)self->batch_sources.size(); }
+msAPI const char* msMeshGetBatchSource(const ms::Mesh *self, int i) { return self->batch_sources[i].c_str(); }
+msAPI void msMeshReadBatchSourceIDs(const ms::Mesh *self, int *dst) { self->batch_source_ids.copy_to(dst); }
+msAPI int msMeshGetNumLODs(const ms::Mesh *self) { return (int)self->lods.size(); }
+msAPI ms::Mesh* msMeshGetLOD(const ms::Mesh *self, int i) { return self->lods[i].get(); }
 
 msAPI void msMeshReadBoneWeights4(const ms::Mesh *self, mu::Weights4 *dst) { self->weights4.copy_to(dst); }
 msAPI void msMeshReadBoneCounts(const ms::Mesh *self, uint8_t *dst) { self->bone_counts.copy_to(dst); }
@@ -394,15 +424,28 @@ msAPI void msMeshWriteBoneWeights4(ms::Mesh *self, const mu::Weights4 *data, int
         return;
     }
 
+    // stored as sparse weights. per-bone dense weights are not needed.
     int num_points = (int)self->points.size();
-    for (auto& bone : bones)
-        bone->weights.resize_zeroclear(num_points);
+    auto& counts = self->sparse_bone_counts;
+    auto& weights = self->sparse_bone_weights;
+    counts.resize_discard(num_points);
+    weights.resize_discard(num_points * 4);
+    int offset = 0;
     for (int vi = 0; vi < num_points; ++vi) {
-        auto& indices = data[vi].indices;
-        auto& weights = data[vi].weights;
-        for (int wi = 0; wi < 4; ++wi)
-            bones[indices[wi]]->weights[vi] = weights[wi];
+        int n = 0;
+        for (int wi = 0; wi < 4; ++wi) {
+            if (data[vi].weights[wi] > 0.0f) {
+                weights[offset + n].weight = data[vi].weights[wi];
+                weights[offset + n].index = data[vi].indices[wi];
+                ++n;
+            }
+        }
+        counts[vi] = (uint8_t)n;
+        offset += n;
     }
+    weights.resize(offset);
+    for (auto& bone : bones)
+        bone->weights.clear();
 }
 msAPI void msMeshWriteBoneCounts(ms::Mesh *self, uint8_t *data, int size)
 {
@@ -416,18 +459,15 @@ msAPI void msMeshWriteBoneWeightsV(ms::Mesh *self, uint8_t *counts, int counts_s
         return;
     }
 
+    // stored as sparse weights. per-bone dense weights are not needed.
     int num_points = (int)self->points.size();
+    int num_weights = 0;
+    for (int vi = 0; vi < num_points; ++vi)
+        num_weights += counts[vi];
+    self->sparse_bone_counts.assign(counts, counts + num_points);
+    self->sparse_bone_weights.assign(weights, weights + num_weights);
     for (auto& bone : bones)
-        bone->weights.resize_zeroclear(num_points);
-
-    int offset = 0;
-    for (int vi = 0; vi < num_points; ++vi) {
-        int num_weights = counts[vi];
-        auto *data = &weights[offset];
-        for (int wi = 0; wi < num_weights; ++wi)
-            bones[data->index]->weights[vi] = data->weight;
-        offset += num_weights;
-    }
+        bone->weights.clear();
 }
 msAPI void msMeshSetRootBonePath(ms::Mesh *self, const char *v)
 {
@@ -458,7 +498,8 @@ msAPI void msMeshSetLocal2World(ms::Mesh *self, const float4x4 *v) { self->refin
 msAPI void msMeshSetWorld2Local(ms::Mesh *self, const float4x4 *v) { self->refine_settings.world2local = *v; }
 
 msAPI int msSubmeshGetNumIndices(const ms::SubmeshData *self) { return (int)self->index_count; }
-msAPI void msSubmeshReadIndices(const ms::SubmeshData *self, const ms::Mesh *mesh, int *dst) { mesh->indices.copy_to(dst, self->index_count, self->index_offset); }
+msAPI void msSubmeshReadIndices(const ms::SubmeshData *self, const ms::Mesh *mesh, int *dst) { ReadMeshIndices(*mesh, dst, self->index_count, self->index_offset); }
+msAPI void msSubmeshReadIndices16(const ms::SubmeshData *self, const ms::Mesh *mesh, uint16_t *dst) { ReadMeshIndices(*mesh, dst, self->index_count, self->index_offset); }
 msAPI int msSubmeshGetMaterialID(const ms::SubmeshData *self) { return self->material_id; }
 msAPI ms::Topology msSubmeshGetTopology(const ms::SubmeshData *self) { return self->topology; }
 
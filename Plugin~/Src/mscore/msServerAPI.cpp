@@ -99,6 +99,10 @@ msAPI int msGetProtocolVersion() {
     return msProtocolVersion;
 }
 
+msAPI const char* msGetActiveSIMDISA() {
+    return mu::GetActiveSIMDISA();
+}
+
 msAPI bool msServerIsStarted(const int port) {
     std::map<uint16_t, ServerPtr>::iterator it = g_servers.find(port);
     if (it == g_servers.end())
@@ -165,6 +169,26 @@ msAPI void msServerSetZUpCorrectionMode(ms::Server *server, ms::ZUpCorrectionMod
     if (server)
         server->getSettings().import_settings.zup_correction_mode = v;
 }
+msAPI void msServerGetRefineCacheSettings(ms::Server *server, ms::MeshRefineCacheSettings *dst)
+{
+    if (server && dst)
+        *dst = server->getSettings().refine_cache;
+}
+msAPI void msServerSetRefineCacheSettings(ms::Server *server, const ms::MeshRefineCacheSettings *v)
+{
+    if (server && v)
+        server->getSettings().refine_cache = *v;
+}
+msAPI void msServerGetRefineCacheStats(ms::Server *server, ms::MeshRefineCacheStats *dst)
+{
+    if (server && dst)
+        *dst = server->getRefineCache().getStats();
+}
+msAPI void msServerClearRefineCache(ms::Server *server)
+{
+    if (server)
+        server->getRefineCache().clear();
+}
 
 msAPI int msServerGetNumMessages(ms::Server *server)
 {
@@ -1394,12 +1394,32 @@ internal delegate void DeleteInstanceHandler(string path);
                 }
             }
             if (dataFlags.hasIndices && !keepIndices) {
+                // 16 bit indices are passed to the mesh as is. the index format applies to all submeshes.
+                bool indices16 = dataFlags.hasIndices16;
+                mesh.indexFormat = indices16 ? UnityEngine.Rendering.IndexFormat.UInt16 : UnityEngine.Rendering.IndexFormat.UInt32;
+
                 int subMeshCount = data.numSubmeshes;
                 mesh.subMeshCount = subMeshCount;
                 for (int smi = 0; smi < subMeshCount; ++smi) {
                     SubmeshData submesh = data.GetSubmesh(smi);
                     SubmeshData.Topology topology = submesh.topology;
 
+                    if (indices16) {
+                        MeshTopology mt16 = MeshTopology.Triangles;
+                        switch (topology)
+                        {
+                            case SubmeshData.Topology.Points: mt16 = MeshTopology.Points; break;
+                            case SubmeshData.Topology.Lines: mt16 = MeshTopology.Lines; break;
+                            case SubmeshData.Topology.Quads: mt16 = MeshTopology.Quads; break;
+                            default: break;
+                        }
+                        NativeArray<ushort> indices = new NativeArray<ushort>(submesh.numIndices, Allocator.Temp);
+                        submesh.ReadIndices16(data, Misc.ForceGetPointer(ref indices));
+                        mesh.SetIndices(indices, mt16, smi, false);
+                        indices.Dispose();
+                        continue;
+                    }
+
                     m_tmpI.Resize(submesh.numIndices);
                     submesh.ReadIndices(data, m_tmpI);
 
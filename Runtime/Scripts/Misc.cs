@@ -281,6 +281,18 @@ internal static class Misc {
         return union.pointer;
     }
 
+    [StructLayout(LayoutKind.Explicit)]
+    struct NAUShort {
+        [FieldOffset(0)] public NativeArray<ushort> nativeArray;
+        [FieldOffset(0)] public IntPtr              pointer;
+    }
+
+    public static IntPtr ForceGetPointer(ref NativeArray<ushort> na) {
+        var union = new NAUShort();
+        union.nativeArray = na;
+        return union.pointer;
+    }
+
     internal class UniqueNameGenerator {
         public string Gen(string name) {
             var uniqueName = name;
@@ -26,6 +26,9 @@ internal static class Lib {
     [DllImport(name)]
     static extern int msGetProtocolVersion();
 
+    [DllImport(name)]
+    static extern IntPtr msGetActiveSIMDISA();
+
         #endregion
 
     static string version;
@@ -43,6 +46,11 @@ internal static class Lib {
         return msGetProtocolVersion();
     }
 
+    // instruction set the mesh processing kernels run with (an ISPC target such as "avx1-i32x8", "SSE2" or "NEON"). can be overridden by MESHSYNC_SIMD_ISA.
+    internal static string GetActiveSIMDISA() {
+        return Marshal.PtrToStringAnsi(msGetActiveSIMDISA());
+    }
+
     public const int invalidID = -1;
 
     public const uint maxVerticesPerMesh =
@@ -2067,6 +2075,62 @@ internal struct LightData {
 
 #region Mesh
 
+// layout must match mu::Meshlet
+internal struct Meshlet {
+    public int     submeshIndex;
+    public int     vertexOffset;
+    public int     vertexCount;
+    public int     triangleOffset;
+    public int     triangleCount;
+    public Vector3 center;
+    public float   radius;
+    public Vector3 coneApex;
+    public Vector3 coneAxis;
+    public float   coneCutoff;
+}
+
+// must match mu::VertexAttributeFormat
+internal enum VertexAttributeFormat {
+    Float32,
+    Float16,
+    SNorm8,
+    SNorm16,
+    UNorm8,
+    UNorm16,
+}
+
+// must match ms::VertexSemantic
+internal enum VertexSemantic {
+    Position,
+    Normal,
+    Tangent,
+    Color,
+    Velocity,
+    UV0,
+    UV1,
+    UV2,
+    UV3,
+    UV4,
+    UV5,
+    UV6,
+    UV7,
+}
+
+// layout must match ms::VertexAttributeLayout
+internal struct VertexAttributeLayout {
+    public VertexSemantic        semantic;
+    public VertexAttributeFormat format;
+    public int                   dimension; // 0: dimension of the semantic
+    public int                   offset;
+
+    [DllImport(Lib.name)]
+    static extern int msVertexAttributeGetSize(VertexAttributeFormat format, int dimension);
+
+    internal static int GetSize(VertexAttributeFormat format, int dimension) {
+        return msVertexAttributeGetSize(format, dimension);
+    }
+}
+
 internal struct SubmeshData {
     #region internal
 
@@ -2078,6 +2142,9 @@ internal struct SubmeshData {
     [DllImport(Lib.name)]
     static extern void msSubmeshReadIndices(IntPtr self, IntPtr mesh, IntPtr dst);
 
+    [DllImport(Lib.name)]
+    static extern void msSubmeshReadIndices16(IntPtr self, IntPtr mesh, IntPtr dst);
+
     [DllImport(Lib.name)]
     static extern int msSubmeshGetMaterialID(IntPtr self);
 
@@ -2109,6 +2176,10 @@ internal struct SubmeshData {
     internal void ReadIndices(MeshData mesh, PinnedList<int> dst) {
         msSubmeshReadIndices(self, mesh.self, dst);
     }
+
+    internal void ReadIndices16(MeshData mesh, IntPtr dst) {
+        msSubmeshReadIndices16(self, mesh.self, dst);
+    }
 }
 
 internal struct BlendShapeData {
@@ -2238,6 +2309,22 @@ internal struct MeshDataFlags {
         get { return flags[19]; }
     }
 
+    public bool hasSparseBoneWeights {
+        get { return flags[20]; }
+    }
+
+    public bool hasMeshlets {
+        get { return flags[21]; }
+    }
+
+    public bool hasIndices16 {
+        get { return flags[22]; }
+    }
+
+    public bool hasBatchSources {
+        get { return flags[23]; }
+    }
+
     const int UV_START_BIT_POS = 24;
 
     public bool HasUV(int index) {
@@ -2291,6 +2378,9 @@ internal struct MeshData {
     [DllImport(Lib.name)]
     static extern void msMeshReadIndices(IntPtr self, IntPtr dst);
 
+    [DllImport(Lib.name)]
+    static extern void msMeshReadIndices16(IntPtr self, IntPtr dst);
+
     [DllImport(Lib.name)]
     static extern IntPtr msMeshGetPointsPtr(IntPtr self);
 
@@ -2348,6 +2438,42 @@ internal struct MeshData {
     [DllImport(Lib.name)]
     static extern Bounds msMeshGetBounds(IntPtr self);
 
+    [DllImport(Lib.name)]
+    static extern int msMeshGetNumMeshlets(IntPtr self);
+
+    [DllImport(Lib.name)]
+    static extern int msMeshGetNumMeshletVertices(IntPtr self);
+
+    [DllImport(Lib.name)]
+    static extern int msMeshGetNumMeshletTriangles(IntPtr self);
+
+    [DllImport(Lib.name)]
+    static extern void msMeshReadMeshlets(IntPtr self, IntPtr dst);
+
+    [DllImport(Lib.name)]
+    static extern byte msMeshWriteVertexBuffer(IntPtr self, IntPtr dst, int stride, VertexAttributeLayout[] layout, int numAttributes);
+
+    [DllImport(Lib.name)]
+    static extern void msMeshReadMeshletVertices(IntPtr self, IntPtr dst);
+
+    [DllImport(Lib.name)]
+    static extern void msMeshReadMeshletTriangles(IntPtr self, IntPtr dst);
+
+    [DllImport(Lib.name)]
+    static extern int msMeshGetNumBatchSources(IntPtr self);
+
+    [DllImport(Lib.name)]
+    static extern IntPtr msMeshGetBatchSource(IntPtr self, int i);
+
+    [DllImport(Lib.name)]
+    static extern void msMeshReadBatchSourceIDs(IntPtr self, IntPtr dst);
+
+    [DllImport(Lib.name)]
+    static extern int msMeshGetNumLODs(IntPtr self);
+
+    [DllImport(Lib.name)]
+    static extern MeshData msMeshGetLOD(IntPtr self, int i);
+
     [DllImport(Lib.name)]
     static extern void msMeshReadBoneWeights4(IntPtr self, IntPtr dst);
 
@@ -2437,6 +2563,59 @@ internal struct MeshData {
         get { return msMeshGetBounds(self); }
     }
 
+    internal int numMeshlets {
+        get { return msMeshGetNumMeshlets(self); }
+    }
+
+    internal int numMeshletVertices {
+        get { return msMeshGetNumMeshletVertices(self); }
+    }
+
+    // 3 bytes per triangle
+    internal int numMeshletTriangles {
+        get { return msMeshGetNumMeshletTriangles(self); }
+    }
+
+    internal void ReadMeshlets(PinnedList<Meshlet> dst) {
+        msMeshReadMeshlets(self, dst);
+    }
+
+    // fills dst (numPoints * stride bytes) with an interleaved vertex buffer. can be called from worker threads.
+    internal bool WriteVertexBuffer(IntPtr dst, int stride, VertexAttributeLayout[] layout) {
+        return msMeshWriteVertexBuffer(self, dst, stride, layout, layout.Length) != 0;
+    }
+
+    internal void ReadMeshletVertices(PinnedList<int> dst) {
+        msMeshReadMeshletVertices(self, dst);
+    }
+
+    internal void ReadMeshletTriangles(PinnedList<byte> dst) {
+        msMeshReadMeshletTriangles(self, dst);
+    }
+
+    // paths of the meshes merged into this mesh by static batching
+    internal int numBatchSources {
+        get { return msMeshGetNumBatchSources(self); }
+    }
+
+    internal string GetBatchSource(int i) {
+        return Misc.S(msMeshGetBatchSource(self, i));
+    }
+
+    // per-vertex index to the batch sources
+    internal void ReadBatchSourceIDs(PinnedList<int> dst) {
+        msMeshReadBatchSourceIDs(self, dst);
+    }
+
+    // simplified levels generated on import when ServerSettings.flags.generateLODs is set. LOD1 first.
+    internal int numLODs {
+        get { return msMeshGetNumLODs(self); }
+    }
+
+    internal MeshData GetLOD(int i) {
+        return msMeshGetLOD(self, i);
+    }
+
     internal void ReadPoints(PinnedList<Vector3> dst) {
         msMeshReadPoints(self, dst);
     }
@@ -2477,6 +2656,10 @@ internal struct MeshData {
         msMeshReadIndices(self, dst);
     }
 
+    internal void ReadIndices16(IntPtr dst) {
+        msMeshReadIndices16(self, dst);
+    }
+
     internal void WritePoints(Vector3[] v) {
         msMeshWritePoints(self, v, v.Length);
     }
@@ -13,9 +13,59 @@ namespace Unity.MeshSync {
 
 #region Server
 
+internal enum MeshRefineCacheEviction {
+    Disabled,
+    LeastRecentlyUsed,
+    FirstInFirstOut,
+}
+
+internal struct MeshRefineCacheSettings {
+    public MeshRefineCacheEviction eviction;
+    public uint                    maxMemoryMB;
+    public uint                    maxRecords;
+
+    public static MeshRefineCacheSettings defaultValue {
+        get {
+            return new MeshRefineCacheSettings {
+                eviction    = MeshRefineCacheEviction.LeastRecentlyUsed,
+                maxMemoryMB = 256,
+                maxRecords  = 4096,
+            };
+        }
+    }
+}
+
+internal struct MeshRefineCacheStats {
+    public ulong hits;
+    public ulong misses;
+    public ulong evictions;
+    public ulong topologyHits;   // refines that reused the remap tables of the previous refine of the mesh
+    public ulong topologyMisses;
+    public ulong memoryUsage; // in bytes
+    public uint  numRecords;
+}
+
 internal struct ServerSettings {
     public struct Flags {
         public BitFlags flags;
+
+        // SceneImportFlagsBit
+        public bool generateLODs {
+            get { return flags[0]; }
+            set { flags[0] = value; }
+        }
+
+        // meshes that fit are refined to 16 bit indices. MeshData.hasIndices16 tells which width a mesh has.
+        public bool genIndices16 {
+            get { return flags[1]; }
+            set { flags[1] = value; }
+        }
+
+        // static batching of the meshes in each message. see MeshData.numBatchSources.
+        public bool mergeMeshes {
+            get { return flags[2]; }
+            set { flags[2] = value; }
+        }
     }
 
 
@@ -23,10 +73,14 @@ internal struct ServerSettings {
     public int    maxThreads;
     public ushort port;
 
-    public Flags             flags; // reserved
+    public Flags             flags;
     public uint              meshSplitUnit;
     public uint              meshMaxBoneInfluence; // 4 or 255 (variable)
     public ZUpCorrectionMode zUpCorrectionMode;
+    public int               lodLevels; // used with flags.generateLODs
+    public float             lodRatio;
+
+    public MeshRefineCacheSettings refineCache;
 
     public static ServerSettings defaultValue {
         get {
@@ -38,6 +92,9 @@ internal struct ServerSettings {
                 meshSplitUnit        = Lib.maxVerticesPerMesh,
                 meshMaxBoneInfluence = Lib.maxBoneInfluence,
                 zUpCorrectionMode    = ZUpCorrectionMode.FlipYZ,
+                lodLevels            = 3,
+                lodRatio             = 0.5f,
+                refineCache          = MeshRefineCacheSettings.defaultValue,
             };
             return ret;
         }
@@ -61,6 +118,18 @@ internal struct Server {
     [DllImport(Lib.name)]
     static extern void msServerSetZUpCorrectionMode(IntPtr self, ZUpCorrectionMode v);
 
+    [DllImport(Lib.name)]
+    static extern void msServerGetRefineCacheSettings(IntPtr self, ref MeshRefineCacheSettings dst);
+
+    [DllImport(Lib.name)]
+    static extern void msServerSetRefineCacheSettings(IntPtr self, ref MeshRefineCacheSettings v);
+
+    [DllImport(Lib.name)]
+    static extern void msServerGetRefineCacheStats(IntPtr self, ref MeshRefineCacheStats dst);
+
+    [DllImport(Lib.name)]
+    static extern void msServerClearRefineCache(IntPtr self);
+
     [DllImport(Lib.name)]
     static extern int msServerGetNumMessages(IntPtr self);
 
@@ -168,6 +237,27 @@ internal struct Server {
         set { msServerSetZUpCorrectionMode(self, value); }
     }
 
+    internal MeshRefineCacheSettings refineCacheSettings {
+        get {
+            MeshRefineCacheSettings ret = default(MeshRefineCacheSettings);
+            msServerGetRefineCacheSettings(self, ref ret);
+            return ret;
+        }
+        set { msServerSetRefineCacheSettings(self, ref value); }
+    }
+
+    internal MeshRefineCacheStats refineCacheStats {
+        get {
+            MeshRefineCacheStats ret = default(MeshRefineCacheStats);
+            msServerGetRefineCacheStats(self, ref ret);
+            return ret;
+        }
+    }
+
+    internal void ClearRefineCache() {
+        msServerClearRefineCache(self);
+    }
+
     public int numMessages {
         get { return msServerGetNumMessages(self); }
     }